@@ -52,6 +52,23 @@
 #include <stdlib.h>
 #include "mqtt_configs.h"
 
+#if IOVEC_SUPPORT
+#include <sys/uio.h>
+#endif
+
+
+/* @brief IO vector for scatter-gather encoders, same layout as POSIX iovec when supported */
+#if IOVEC_SUPPORT
+typedef struct iovec mqtt_iovec_t;
+#else
+typedef struct mqtt_iovec
+{
+	void   *iov_base;  /*!< Start of the buffer */
+	size_t  iov_len;   /*!< Length of buffer    */
+
+}mqtt_iovec_t;
+#endif
+
 
 /******************************************************************************/
 /*                                                                            */
@@ -63,8 +80,23 @@
 #define MQTT_API_VERSION  1.0
 #define MQTT_VERSION      MQTT_PROTOCOL_VERSION
 
-/* Avoid Structure padding */
-#pragma pack(1)
+/* @brief Defines for Remaining Length field of Fixed Header */
+#define MQTT_MAX_REMAINING_LENGTH       268435455  /*!< Maximum value of Remaining Length field (4 bytes encoded) */
+#define MQTT_REMAINING_LENGTH_MAX_SIZE  4          /*!< Maximum number of bytes in Remaining Length field         */
+#define MQTT_MAX_FIXED_HEADER_LENGTH    5          /*!< Maximum size of MQTT Fixed Header                         */
+
+#if PUBLISH_MESSAGE_LENGTH > MQTT_MAX_REMAINING_LENGTH
+#error "PUBLISH_MESSAGE_LENGTH exceeds MQTT maximum Remaining Length"
+#endif
+
+
+/* @brief Defines for in-flight message table */
+#define MQTT_INFLIGHT_SLOTS       INFLIGHT_TABLE_SIZE        /*!< Number of in-flight table slots, mqtt_configs.h */
+#define MQTT_INFLIGHT_SLOT_MASK   (MQTT_INFLIGHT_SLOTS - 1)  /*!< Mask for message ID to home slot index          */
+
+#if (INFLIGHT_TABLE_SIZE & (INFLIGHT_TABLE_SIZE - 1)) || INFLIGHT_TABLE_SIZE > 32768
+#error "INFLIGHT_TABLE_SIZE must be a power of 2, not larger than 32768"
+#endif
 
 
 /* State Machine defines */
@@ -105,9 +137,13 @@ typedef enum mqtt_qos
 /* @brief Defines for PUBLISH Message */
 #define MQTT_PUBLISH_MESSAGE      3               /*!< MQTT Publish message identifier value                     */
 #define MQTT_TOPIC_LENGTH         TOPIC_LENGTH    /*!< Publish message topic length, mqtt_configs.h              */
-#define PUBLISH_PAYLOAD_LENGTH    MESSAGE_LENGTH  /*!< Publish message payload message length,mqtt_configs.h     */
+#define PUBLISH_PAYLOAD_LENGTH    PUBLISH_MESSAGE_LENGTH  /*!< Publish message payload message length,mqtt_configs.h */
 #define MQTT_MESSAGE_ID_OFFSET    2               /*!< Publish message, message ID length offset value           */
 #define PUBLISH_NULL_MESSAGE      "\0"            /*!< Publish NULL message for clearing retain at broker/server */
+#define MQTT_PUBLISH_IOV_COUNT    2               /*!< Number of io vectors of publish packet, (header, payload) */
+
+/*!< Size of publish header scratch buffer, fixed header, topic length, topic and message ID */
+#define MQTT_PUBLISH_HEADER_LENGTH  (MQTT_MAX_FIXED_HEADER_LENGTH + 2 + MQTT_TOPIC_LENGTH + MQTT_MESSAGE_ID_OFFSET)
 
 
 /* PUBACK, PUBREC, PUBREL, PUBCOMP */
@@ -115,6 +151,7 @@ typedef enum mqtt_qos
 #define MQTT_PUBREC_MESSAGE       5               /*!< MQTT Publish receive message identifier value  */
 #define MQTT_PUBREL_MESSAGE       6               /*!< MQTT Publish release message identifier value  */
 #define MQTT_PUBCOMP_MESSAGE      7               /*!< MQTT Publish complete message identifier value */
+#define MQTT_PUBREL_LENGTH        4               /*!< Length of PUBREL packet, fixed header and message ID */
 
 
 /* @brief Defines for Disconnect */
@@ -124,6 +161,13 @@ typedef enum mqtt_qos
 /* Defines for MQTT SUBSRIBE, SUBACK message */
 #define MQTT_SUBSCRIBE_MESSAGE    8               /*!< MQTT Subscribe message identifier value */
 #define MQTT_SUBACK_MESSAGE       9               /*!< MQTT Suback message identifier value    */
+#define MQTT_SUBACK_FAILURE       0x80            /*!< Suback return code of rejected topic filter */
+#define MQTT_MAX_TOPIC_FILTER     65535           /*!< Maximum topic filter length of subscribe list encoders */
+
+
+/* Defines for MQTT UNSUBSCRIBE, UNSUBACK message */
+#define MQTT_UNSUBSCRIBE_MESSAGE  10              /*!< MQTT Unsubscribe message identifier value */
+#define MQTT_UNSUBACK_MESSAGE     11              /*!< MQTT Unsuback message identifier value    */
 
 
 /* Defines for MQTT PPINGREQ and PINGRESP */
@@ -131,21 +175,46 @@ typedef enum mqtt_qos
 #define MQTT_PINRESP_MESSAGE      13              /*!< MQTT Suback message identifier value    */
 
 
+/* @brief Fixed header first byte, message type (bits 7-4), dup (bit 3), qos (bits 2-1), retain (bit 0) */
+#define MQTT_HEADER_TYPE_SHIFT    4               /*!< Shift of message type in fixed header byte   */
+#define MQTT_HEADER_DUP_FLAG      0x08            /*!< Duplicate flag of fixed header byte          */
+#define MQTT_HEADER_QOS_SHIFT     1               /*!< Shift of qos level in fixed header byte      */
+#define MQTT_HEADER_QOS_MASK      0x06            /*!< Mask of qos level in fixed header byte       */
+#define MQTT_HEADER_RETAIN_FLAG   0x01            /*!< Retain flag of fixed header byte             */
+
+#define MQTT_HEADER_TYPE(control) ((uint8_t)((control) >> MQTT_HEADER_TYPE_SHIFT))                           /*!< Message type of header byte */
+#define MQTT_HEADER_QOS(control)  ((uint8_t)(((control) & MQTT_HEADER_QOS_MASK) >> MQTT_HEADER_QOS_SHIFT))   /*!< Qos level of header byte    */
+
+
+/* @brief Connect flags byte of CONNECT variable header */
+#define MQTT_CONNECT_FLAG_CLEAN_SESSION  0x02     /*!< Clean / New session, previous history is deleted */
+#define MQTT_CONNECT_FLAG_WILL           0x04     /*!< Flag for enabling the qos and retain options     */
+#define MQTT_CONNECT_WILL_QOS_SHIFT      3        /*!< Shift of will qos in connect flags byte          */
+#define MQTT_CONNECT_WILL_QOS_MASK       0x18     /*!< Mask of will qos in connect flags byte           */
+#define MQTT_CONNECT_FLAG_WILL_RETAIN    0x20     /*!< Enable retain option                             */
+#define MQTT_CONNECT_FLAG_PASSWORD       0x40     /*!< Enable password option                           */
+#define MQTT_CONNECT_FLAG_USER_NAME      0x80     /*!< Enable user name option                          */
+
+
 /******************************************************************************/
 /*                                                                            */
 /*                  Data Structures for MQTT Control Messages                 */
 /*                                                                            */
 /******************************************************************************/
 
+/*
+ * Control message structures describe the wire layout of packets built in place, they are
+ * byte packed and only used through byte pointers and explicit encoders, packing is not
+ * applied to any other structure of this header.
+ */
+#pragma pack(push, 1)
+
 
 /* MQTT Fixed Header, common to all control messages */
 typedef struct mqtt_header
 {
-	uint8_t retain_flag     : 1;  /*!< Message Retain Flag, (LSB)                                              */
-	uint8_t qos_level       : 2;  /*!< Quality of service Level, (LSB)                                         */
-	uint8_t dup_flag        : 1;  /*!< Duplicate Flag, (LSB)                                                   */
-	uint8_t message_type    : 4;  /*!< MQTT Control Packet / Message Type, (MSB)                               */
-	uint8_t message_length;       /*!< Length of MQTT Message (Remaining Length, excludes fixed header length) */
+	uint8_t control;              /*!< Message type, dup, qos and retain, (MQTT_HEADER_ defines)               */
+	uint8_t message_length;       /*!< Length of MQTT Message (Remaining Length first byte, 1 to 4 bytes long)  */
 
 }mqtt_header_t;
 
@@ -164,18 +233,8 @@ typedef struct mqtt_payload_opts
 
 /* @brief MQTT CONNECT structures */
 
-/* Connect Flags bit fields */
-typedef struct mqtt_connect_flags
-{
-	uint8_t reserved        : 1;  /*!< Reserved not set                                 */
-	uint8_t clean_session   : 1;  /*!< Clean / New session, previous history is deleted */
-	uint8_t will_flag       : 1;  /*!< Flag for enabling the qos and retain options     */
-	uint8_t will_qos        : 2;  /*!< Enable qos (quality of service) option           */
-	uint8_t will_retain     : 1;  /*!< Enable retain option                             */
-	uint8_t password_flag   : 1;  /*!< Enable password option                           */
-	uint8_t user_name_flag  : 1;  /*!< Enable user name option                          */
-
-}mqtt_connect_flags_t;
+/* Connect Flags byte, (MQTT_CONNECT_FLAG_ defines) */
+typedef uint8_t mqtt_connect_flags_t;
 
 /* Main MQTT Connect Structure */
 typedef struct mqtt_connect
@@ -205,9 +264,9 @@ typedef struct mqtt_connack
 /* @brief MQTT PUBLISH structure */
 typedef struct mqtt_publish
 {
-	mqtt_header_t fixed_header;              /*!< MQTT Fixed Header            */
-	uint16_t      topic_length;              /*!< Publish message topic length */
-	char          payload[MESSAGE_LENGTH];   /*!< publish message pay load     */
+	mqtt_header_t fixed_header;                     /*!< MQTT Fixed Header            */
+	uint16_t      topic_length;                     /*!< Publish message topic length */
+	char          payload[PUBLISH_PAYLOAD_LENGTH];  /*!< publish message pay load     */
 
 }mqtt_publish_t;
 
@@ -251,6 +310,54 @@ typedef struct mqtt_pingreq
 }mqtt_pingreq_t;
 
 
+#pragma pack(pop)
+
+
+
+/* @brief MQTT in-flight message states */
+typedef enum mqtt_inflight_states
+{
+	MQTT_INFLIGHT_FREE            = 0,  /*!< Slot not used                                 */
+	MQTT_INFLIGHT_PUBLISH_SENT    = 1,  /*!< Publish sent, waiting for PUBACK or PUBREC    */
+	MQTT_INFLIGHT_PUBREL_SENT     = 2,  /*!< Publish release sent, waiting for PUBCOMP     */
+	MQTT_INFLIGHT_PUBREC_RECEIVED = 3,  /*!< PUBREC received, PUBREL not queued yet        */
+	MQTT_INFLIGHT_REQUEST_SENT    = 4   /*!< SUBSCRIBE or UNSUBSCRIBE sent, (qos 0 slot)   */
+
+}mqtt_inflight_state_t;
+
+
+
+/* @brief In-flight message completion callback, called before the message ID is released */
+typedef void (*mqtt_complete_callback_t)(void *context, uint16_t message_id, void *buffer, size_t buffer_length);
+
+/* @brief In-flight barrier callback, called when all messages sent before the barrier are acknowledged */
+typedef void (*mqtt_barrier_callback_t)(void *context, uint32_t barrier);
+
+
+
+/* @brief MQTT in-flight message table, open addressed on message ID, one array per field */
+typedef struct mqtt_inflight
+{
+	uint16_t message_id[MQTT_INFLIGHT_SLOTS];     /*!< Message ID of slot, 0 = free slot             */
+	uint8_t  state[MQTT_INFLIGHT_SLOTS];          /*!< In-flight state of message                    */
+	uint8_t  qos[MQTT_INFLIGHT_SLOTS];            /*!< Quality of service of message                 */
+	uint32_t sequence[MQTT_INFLIGHT_SLOTS];       /*!< Send order of message, for barriers           */
+	uint32_t timestamp[MQTT_INFLIGHT_SLOTS];      /*!< Time of last send, user defined units         */
+	void     *buffer[MQTT_INFLIGHT_SLOTS];        /*!< Buffer holding the control packet, (optional) */
+	size_t   buffer_length[MQTT_INFLIGHT_SLOTS];  /*!< Length of control packet in buffer            */
+	uint16_t next_message_id;                     /*!< Last allocated message ID                     */
+	uint16_t count;                               /*!< Number of messages in-flight                  */
+	uint16_t window_size;                         /*!< Maximum number of messages in-flight          */
+	uint32_t next_sequence;                       /*!< Send order of last allocated message          */
+	uint32_t barrier;                             /*!< Pending barrier for callback, 0 = none        */
+
+	mqtt_complete_callback_t complete_callback;   /*!< Message acknowledged callback, (optional)     */
+	mqtt_barrier_callback_t  barrier_callback;    /*!< Barrier reached callback, (optional)          */
+	void                     *callback_context;   /*!< User context passed to callbacks              */
+
+}mqtt_inflight_t;
+
+
 
 /* @brief MQTT client handle structure */
 typedef struct mqtt_client_handle
@@ -263,11 +370,93 @@ typedef struct mqtt_client_handle
 	mqtt_subscribe_t  *subscribe_msg;    /*!< Pointer to the subscribe structure          */
 	mqtt_pingreq_t    *pingrequest_msg;  /*!< Pointer to the pingrequest structure        */
 	mqtt_disconnect_t *disconnect_msg;   /*!< Pointer to the disconnect message structure */
+	mqtt_inflight_t   *inflight_table;   /*!< Pointer to the in-flight table, (optional)  */
+	uint16_t          message_id;        /*!< Message ID of last qos > 0 publish          */
 
 }mqtt_client_t;
 
 
 
+/* @brief MQTT publish batch entry */
+typedef struct mqtt_publish_entry
+{
+	char       *topic;           /*!< Publish topic name                                 */
+	const void *message;         /*!< Message to be published                            */
+	size_t     message_length;   /*!< Length of message                                  */
+	mqtt_qos_t qos;              /*!< Quality of service value                           */
+	uint8_t    retain;           /*!< Enable retain for message retention at broker      */
+	uint16_t   message_id;       /*!< Message ID assigned by batch encoder for qos > 0   */
+
+}mqtt_publish_entry_t;
+
+
+
+/* @brief MQTT subscribe list entry */
+typedef struct mqtt_subscribe_entry
+{
+	char       *topic;           /*!< Subscribe topic filter                              */
+	mqtt_qos_t qos;              /*!< Requested quality of service value                  */
+	uint8_t    return_code;      /*!< Granted qos or MQTT_SUBACK_FAILURE, set from SUBACK */
+
+}mqtt_subscribe_entry_t;
+
+
+
+/* @brief MQTT prepared publish template, header pre-encoded for one topic, qos and retain */
+typedef struct mqtt_publish_template
+{
+	uint8_t    header[MQTT_PUBLISH_HEADER_LENGTH];  /*!< Publish header, fixed header is patched in before topic length field */
+	uint8_t    header_byte;                         /*!< Pre-encoded first byte of fixed header, (type, qos, retain)         */
+	mqtt_qos_t qos;                                 /*!< Quality of service value                                           */
+	uint16_t   topic_length;                        /*!< Publish topic length                                               */
+	uint16_t   variable_length;                     /*!< Length of topic length field, topic and message ID                 */
+
+}mqtt_publish_template_t;
+
+
+
+/* @brief MQTT control packet decoded from input stream */
+typedef struct mqtt_packet
+{
+	uint8_t  message_type;      /*!< MQTT Control Packet / Message Type                          */
+	uint8_t  flags;             /*!< Fixed header flags, (dup, qos and retain for publish)        */
+	uint32_t remaining_length;  /*!< Length of variable header and payload                       */
+	uint8_t  *body;             /*!< Pointer to variable header and payload in decoder buffer    */
+	uint8_t  *packet;           /*!< Pointer to start of control packet (fixed header)           */
+	size_t   packet_length;     /*!< Length of control packet including fixed header             */
+
+}mqtt_packet_t;
+
+
+
+/* @brief MQTT received PUBLISH message, topic and message point into the packet (not terminated) */
+typedef struct mqtt_publish_view
+{
+	const char    *topic;           /*!< Pointer to topic name in packet                 */
+	uint16_t      topic_length;     /*!< Length of topic name                            */
+	uint16_t      message_id;       /*!< Message ID for qos > 0, 0 for qos 0             */
+	mqtt_qos_t    qos;              /*!< Quality of service value of message             */
+	uint8_t       retain;           /*!< Retain flag of message                          */
+	uint8_t       dup;              /*!< Duplicate flag of message                       */
+	const uint8_t *message;         /*!< Pointer to message in packet                    */
+	size_t        message_length;   /*!< Length of message, from Remaining Length field  */
+
+}mqtt_publish_view_t;
+
+
+
+/* @brief MQTT incremental input stream decoder */
+typedef struct mqtt_decoder
+{
+	uint8_t *buffer;         /*!< Pointer to the decoder buffer, given by user           */
+	size_t  buffer_length;   /*!< Length of decoder buffer, limits largest packet length */
+	size_t  read_index;      /*!< Index of first byte not yet decoded                    */
+	size_t  write_index;     /*!< Index after last byte received                         */
+
+}mqtt_decoder_t;
+
+
+
 /* @brief MQTT State Machine message states */
 typedef enum mqtt_message_states
 {
@@ -288,6 +477,8 @@ typedef enum mqtt_message_states
 
 	mqtt_subscribe_state    = MQTT_SUBSCRIBE_MESSAGE,   /*!< Subscribe message send state           */
 	mqtt_suback_state       = MQTT_SUBACK_MESSAGE,      /*!< Suback message receive state           */
+	mqtt_unsubscribe_state  = MQTT_UNSUBSCRIBE_MESSAGE, /*!< Unsubscribe message send state         */
+	mqtt_unsuback_state     = MQTT_UNSUBACK_MESSAGE,    /*!< Unsuback message receive state         */
 
 	mqtt_pingrequest_state  = MQTT_PINGREQ_MESSAGE,     /*!< Pingreq message send state             */
 	mqtt_pingresponse_state = MQTT_PINRESP_MESSAGE      /*!< Pinresponse message receive state      */
@@ -304,6 +495,46 @@ typedef enum mqtt_message_states
 
 
 
+/*
+ * @brief  Encodes Remaining Length field of fixed header (1 to 4 bytes).
+ * @param  *buffer          : pointer to the buffer, (minimum MQTT_REMAINING_LENGTH_MAX_SIZE bytes)
+ * @param  remaining_length : length of variable header and payload
+ * @retval uint8_t          : number of bytes encoded, fail = 0
+ */
+uint8_t mqtt_encode_remaining_length(uint8_t *buffer, uint32_t remaining_length);
+
+
+
+/*
+ * @brief  Decodes Remaining Length field of fixed header.
+ * @param  *buffer           : pointer to the first byte of Remaining Length field
+ * @param  buffer_length     : number of bytes available in buffer
+ * @param  *remaining_length : pointer to decoded Remaining Length value
+ * @retval int8_t            : number of bytes decoded, 0 = incomplete field, -1 = malformed field
+ */
+int8_t mqtt_decode_remaining_length(const uint8_t *buffer, size_t buffer_length, uint32_t *remaining_length);
+
+
+
+/*
+ * @brief  Returns number of bytes needed to encode Remaining Length field.
+ * @param  remaining_length : length of variable header and payload
+ * @retval uint8_t          : size of Remaining Length field, fail = 0
+ */
+uint8_t mqtt_remaining_length_size(uint32_t remaining_length);
+
+
+
+/*
+ * @brief  Initializes mqtt client structure, must be called before other client functions.
+ * @param  *client         : pointer to mqtt client structure (mqtt_client_t).
+ * @param  *inflight_table : pointer to in-flight table for message IDs of qos > 0 publish, (NULL for none)
+ * @retval int8_t          : 1 = Success, -1 = Error
+ */
+int8_t mqtt_client_init(mqtt_client_t *client, mqtt_inflight_t *inflight_table);
+
+
+
 /*
  * @brief  Configures mqtt client user name and password.
  * @param  *client   : pointer to mqtt client structure (mqtt_client_t).
@@ -338,6 +569,17 @@ int8_t mqtt_connect_options(mqtt_client_t *client, uint8_t session, uint8_t reta
 
 
 
+/*
+ * @brief  Returns first byte of fixed header, reserved flags of message type are taken from table.
+ * @param  message_type   : MQTT control packet type
+ * @param  message_qos    : Quality of service value, (PUBLISH only)
+ * @param  message_retain : Enable retain for message retention at broker, (PUBLISH only)
+ * @retval uint8_t        : fixed header byte, fail = 0
+ */
+uint8_t mqtt_fixed_header_byte(uint8_t message_type, mqtt_qos_t message_qos, uint8_t message_retain);
+
+
+
 /*
  * @brief  Returns the value of message type from input buffer.
  * @param  *client  : pointer to mqtt client structure (mqtt_client_t).
@@ -347,6 +589,24 @@ uint8_t get_mqtt_message_type(mqtt_client_t *client);
 
 
 
+/*
+ * @brief  Returns the value of Remaining Length from input buffer.
+ * @param  *client   : pointer to mqtt client structure (mqtt_client_t).
+ * @retval  uint32_t : value of Remaining Length, fail = 0
+ */
+uint32_t get_mqtt_message_length(mqtt_client_t *client);
+
+
+
+/*
+ * @brief  Returns message ID of PUBACK, PUBREC, PUBREL, PUBCOMP, SUBACK or UNSUBACK message from input buffer.
+ * @param  *client   : pointer to mqtt client structure (mqtt_client_t).
+ * @retval  uint16_t : message ID, fail = 0
+ */
+uint16_t get_mqtt_message_id(mqtt_client_t *client);
+
+
+
 /*
  * @brief  Returns the value of connack message status from input buffer.
  * @param  *client  : pointer to mqtt client structure (mqtt_client_t).
@@ -368,23 +628,156 @@ int8_t mqtt_publish_options(mqtt_client_t *client, uint8_t message_retain, mqtt_
 
 
 /*
- * @brief  Configures mqtt PUBLISH message structure.
+ * @brief  Configures mqtt PUBLISH message structure, message ID of qos > 0 publish is
+ *         allocated from in-flight table of client and returned in client->message_id.
+ *         Publish structure is retransmit buffer of the in-flight message, so next qos > 0
+ *         publish fails until it is acknowledged, (window of 1, mqtt_publish_iov() pipelines).
  * @param  *client                : pointer to mqtt client structure (mqtt_client_t).
  * @param  *publish_topic         : publish topic name
  * @param  *publish_message       : message to be published
  * @param  publish_message_length : length of publish message
  * @retval size_t                 : length of publish control packet, fail = 0;
  */
-size_t mqtt_publish(mqtt_client_t *client, char *publish_topic, char *publish_message, uint16_t publish_message_length);
+size_t mqtt_publish(mqtt_client_t *client, char *publish_topic, char *publish_message, size_t publish_message_length);
+
+
+
+/*
+ * @brief  Returns length of PUBLISH control packet for given topic and message length.
+ * @param  topic_length   : length of publish topic
+ * @param  message_length : length of publish message
+ * @param  message_qos    : Quality of service value (0:Fire and forget, 1:At-least once, 2:Exactly once)
+ * @retval size_t         : length of publish control packet, fail = 0;
+ */
+size_t mqtt_publish_packet_size(size_t topic_length, size_t message_length, mqtt_qos_t message_qos);
+
+
+
+/*
+ * @brief  Returns length of PUBLISH header (fixed header, topic and message ID) for given topic and message length.
+ * @param  topic_length   : length of publish topic
+ * @param  message_length : length of publish message
+ * @param  message_qos    : Quality of service value (0:Fire and forget, 1:At-least once, 2:Exactly once)
+ * @retval size_t         : length of publish header, fail = 0;
+ */
+size_t mqtt_publish_header_size(size_t topic_length, size_t message_length, mqtt_qos_t message_qos);
+
+
+
+/*
+ * @brief  Encodes PUBLISH header into scratch buffer and io vectors pointing to header and message,
+ *         message is not copied and can be sent with writev().
+ * @param  *header_buffer         : header scratch buffer, (MQTT_PUBLISH_HEADER_LENGTH bytes for configured topic length)
+ * @param  header_buffer_length   : length of header scratch buffer
+ * @param  *publish_topic         : publish topic name
+ * @param  *publish_message       : message to be published
+ * @param  publish_message_length : length of publish message
+ * @param  message_retain         : Enable retain for message retention at broker
+ * @param  message_qos            : Quality of service value (0:Fire and forget, 1:At-least once, 2:Exactly once)
+ * @param  message_id             : message ID for qos > 0, (not used for qos 0)
+ * @param  *iov                   : pointer to io vector array, (MQTT_PUBLISH_IOV_COUNT)
+ * @retval size_t                 : length of publish control packet, fail = 0;
+ */
+size_t mqtt_publish_iov(uint8_t *header_buffer, size_t header_buffer_length, char *publish_topic, const void *publish_message, size_t publish_message_length,
+		                uint8_t message_retain, mqtt_qos_t message_qos, uint16_t message_id, mqtt_iovec_t *iov);
+
+
+
+/*
+ * @brief  Encodes batch of PUBLISH control packets back to back into one buffer,
+ *         stops at the first entry that does not fit or has bad parameters.
+ * @param  *entries        : array of publish entries, message ID of qos > 0 entries is updated
+ * @param  entry_count     : number of publish entries
+ * @param  *buffer         : output buffer
+ * @param  buffer_length   : length of output buffer
+ * @param  *message_id     : pointer to the message id variable, incremented for each qos > 0 entry
+ * @param  *encoded_length : pointer to number of bytes encoded into buffer
+ * @retval size_t          : number of entries encoded
+ */
+size_t mqtt_publish_batch(mqtt_publish_entry_t *entries, size_t entry_count, uint8_t *buffer, size_t buffer_length,
+		                  uint16_t *message_id, size_t *encoded_length);
+
+
+
+/*
+ * @brief  Encodes batch of PUBLISH headers back to back into header scratch buffer and io vectors,
+ *         two io vectors (header, message) per entry, messages are not copied.
+ *         Stops at the first entry that does not fit or has bad parameters.
+ * @param  *entries              : array of publish entries, message ID of qos > 0 entries is updated
+ * @param  entry_count           : number of publish entries
+ * @param  *header_buffer        : header scratch buffer
+ * @param  header_buffer_length  : length of header scratch buffer
+ * @param  *iov                  : pointer to io vector array
+ * @param  iov_count             : number of io vectors in array
+ * @param  *message_id           : pointer to the message id variable, incremented for each qos > 0 entry
+ * @param  *encoded_length       : pointer to total length of encoded control packets
+ * @retval size_t                : number of entries encoded, (io vectors used = 2 * entries)
+ */
+size_t mqtt_publish_batch_iov(mqtt_publish_entry_t *entries, size_t entry_count, uint8_t *header_buffer, size_t header_buffer_length,
+		                      mqtt_iovec_t *iov, size_t iov_count, uint16_t *message_id, size_t *encoded_length);
+
+
+
+/*
+ * @brief  Prepares publish template, pre-encodes fixed header flags, topic length and topic.
+ * @param  *publish_template : pointer to mqtt publish template structure (mqtt_publish_template_t).
+ * @param  *publish_topic    : publish topic name, (maximum MQTT_TOPIC_LENGTH)
+ * @param  message_retain    : Enable retain for message retention at broker
+ * @param  message_qos       : Quality of service value (0:Fire and forget, 1:At-least once, 2:Exactly once)
+ * @retval int8_t            : 1 = Success, -1 = Error
+ */
+int8_t mqtt_publish_prepare(mqtt_publish_template_t *publish_template, char *publish_topic, uint8_t message_retain, mqtt_qos_t message_qos);
+
+
+
+/*
+ * @brief  Patches Remaining Length and message ID into prepared publish header and fills io vectors,
+ *         header is valid until the template is used again.
+ * @param  *publish_template      : pointer to mqtt publish template structure (mqtt_publish_template_t).
+ * @param  *publish_message       : message to be published
+ * @param  publish_message_length : length of publish message
+ * @param  message_id             : message ID for qos > 0, (not used for qos 0)
+ * @param  *iov                   : pointer to io vector array, (MQTT_PUBLISH_IOV_COUNT)
+ * @retval size_t                 : length of publish control packet, fail = 0;
+ */
+size_t mqtt_publish_prepared_iov(mqtt_publish_template_t *publish_template, const void *publish_message, size_t publish_message_length,
+		                         uint16_t message_id, mqtt_iovec_t *iov);
+
+
+
+/*
+ * @brief  Encodes PUBLISH control packet from prepared publish template into buffer.
+ * @param  *publish_template      : pointer to mqtt publish template structure (mqtt_publish_template_t).
+ * @param  *publish_message       : message to be published
+ * @param  publish_message_length : length of publish message
+ * @param  message_id             : message ID for qos > 0, (not used for qos 0)
+ * @param  *buffer                : output buffer
+ * @param  buffer_length          : length of output buffer
+ * @retval size_t                 : length of publish control packet, fail = 0;
+ */
+size_t mqtt_publish_prepared(mqtt_publish_template_t *publish_template, const void *publish_message, size_t publish_message_length,
+		                     uint16_t message_id, uint8_t *buffer, size_t buffer_length);
 
 
 
 /*
  * @brief  Configures mqtt PUBREL message structure.
  * @param  *client         : pointer to mqtt client structure (mqtt_client_t).
+ * @param  message_id      : message ID of publish message, (from PUBREC)
  * @retval size_t          : Length of publish release message.
  */
-size_t mqtt_publish_release(mqtt_client_t *client);
+size_t mqtt_publish_release(mqtt_client_t *client, uint16_t message_id);
+
+
+
+/*
+ * @brief  Encodes PUBREL message into buffer, (appended to outgoing stream by caller).
+ * @param  *buffer         : output buffer
+ * @param  buffer_length   : length of output buffer, (MQTT_PUBREL_LENGTH or more)
+ * @param  message_id      : message ID of publish message, (from PUBREC)
+ * @retval size_t          : Length of publish release message, fail = 0
+ */
+size_t mqtt_publish_release_encode(uint8_t *buffer, size_t buffer_length, uint16_t message_id);
 
 
 
@@ -410,14 +803,85 @@ size_t mqtt_subscribe(mqtt_client_t *client, char *subscribe_topic, mqtt_qos_t s
 
 
 /*
- * @brief  Read MQTT PUBLISH message
- * @param  *client           : pointer to mqtt client structure (mqtt_client_t).
- * @param  *subscribe_topic  : subscribe topic name received from the broker
- * @param  *received_message : message received from topic subscribed to
- * @param  *message_status   : pointer to message status.
- * @retval size_t            : length of received message, fail = 0;
+ * @brief  Returns length of SUBSCRIBE list packet, buffer of mqtt_subscribe_many() is sized with it.
+ * @param  *entries       : array of subscribe entries
+ * @param  entry_count    : number of subscribe entries
+ * @retval size_t         : length of subscribe control packet, fail (invalid list) = 0;
+ */
+size_t mqtt_subscribe_many_length(mqtt_subscribe_entry_t *entries, size_t entry_count);
+
+
+
+/*
+ * @brief  Encodes SUBSCRIBE control packet with list of topic filters into one buffer,
+ *         broker answers with one SUBACK holding a return code for each entry.
+ * @param  *entries       : array of subscribe entries
+ * @param  entry_count    : number of subscribe entries
+ * @param  *message_id    : pointer to the message id variable, incremented for the packet
+ * @param  *buffer        : output buffer, (mqtt_subscribe_many_length() bytes)
+ * @param  buffer_length  : length of output buffer
+ * @retval size_t         : length of subscribe control packet, fail = 0;
+ */
+size_t mqtt_subscribe_many(mqtt_subscribe_entry_t *entries, size_t entry_count, uint16_t *message_id, uint8_t *buffer, size_t buffer_length);
+
+
+
+/*
+ * @brief  Returns length of UNSUBSCRIBE list packet, buffer of mqtt_unsubscribe_many() is sized with it.
+ * @param  **topics       : array of topic filters
+ * @param  topic_count    : number of topic filters
+ * @retval size_t         : length of unsubscribe control packet, fail (invalid list) = 0;
+ */
+size_t mqtt_unsubscribe_many_length(char **topics, size_t topic_count);
+
+
+
+/*
+ * @brief  Encodes UNSUBSCRIBE control packet with list of topic filters into one buffer.
+ * @param  **topics       : array of topic filters
+ * @param  topic_count    : number of topic filters
+ * @param  *message_id    : pointer to the message id variable, incremented for the packet
+ * @param  *buffer        : output buffer, (mqtt_unsubscribe_many_length() bytes)
+ * @param  buffer_length  : length of output buffer
+ * @retval size_t         : length of unsubscribe control packet, fail = 0;
+ */
+size_t mqtt_unsubscribe_many(char **topics, size_t topic_count, uint16_t *message_id, uint8_t *buffer, size_t buffer_length);
+
+
+
+/*
+ * @brief  Parses SUBACK return codes into subscribe entries, (same order as SUBSCRIBE list).
+ * @param  *packet       : pointer to decoded SUBACK packet
+ * @param  *entries      : array of subscribe entries sent in SUBSCRIBE, return_code is updated
+ * @param  entry_count   : number of subscribe entries
+ * @param  *message_id   : pointer to message ID of SUBACK
+ * @retval int8_t        : 1 = Success, -1 = Error or return code count does not match entry count
+ */
+int8_t mqtt_suback_parse(mqtt_packet_t *packet, mqtt_subscribe_entry_t *entries, size_t entry_count, uint16_t *message_id);
+
+
+
+/*
+ * @brief  Read MQTT PUBLISH message, lengths are taken from Remaining Length field so
+ *         binary messages are copied as is, (terminated when received_message_size allows).
+ * @param  *client                : pointer to mqtt client structure (mqtt_client_t).
+ * @param  *subscribe_topic       : subscribe topic name received from the broker, (MQTT_TOPIC_LENGTH + 1 bytes)
+ * @param  *received_message      : message received from topic subscribed to
+ * @param  received_message_size  : size of received message buffer
+ * @param  *message_status        : pointer to message status.
+ * @retval size_t                 : length of received message, fail = 0;
+ */
+size_t mqtt_read_publish(mqtt_client_t  *client, char *subscribed_topic, char *received_message, size_t received_message_size, uint8_t *message_status);
+
+
+
+/*
+ * @brief  Parses decoded PUBLISH packet without copying, topic and message point into the packet.
+ * @param  *packet  : pointer to decoded PUBLISH packet
+ * @param  *view    : pointer to mqtt publish view structure (mqtt_publish_view_t).
+ * @retval int8_t   : 1 = Success, -1 = Error or malformed packet
  */
-size_t mqtt_read_publish(mqtt_client_t  *client, char *subscribed_topic, char *received_message, uint8_t *message_status);
+int8_t mqtt_publish_parse(mqtt_packet_t *packet, mqtt_publish_view_t *view);
 
 
 
@@ -430,4 +894,222 @@ size_t mqtt_pingreq(mqtt_client_t *client);
 
 
 
+/*
+ * @brief  Initializes incremental input stream decoder.
+ * @param  *decoder       : pointer to mqtt decoder structure (mqtt_decoder_t).
+ * @param  *buffer        : decoder buffer, holds partial and complete packets
+ * @param  buffer_length  : length of decoder buffer, (minimum MQTT_MAX_FIXED_HEADER_LENGTH)
+ * @retval int8_t         : 1 = Success, -1 = Error
+ */
+int8_t mqtt_decoder_init(mqtt_decoder_t *decoder, uint8_t *buffer, size_t buffer_length);
+
+
+
+/*
+ * @brief  Returns free space of decoder buffer for reading input stream directly into it,
+ *         (packets returned by mqtt_decoder_next() are not valid after this call).
+ * @param  *decoder      : pointer to mqtt decoder structure (mqtt_decoder_t).
+ * @param  *free_length  : pointer to length of free space
+ * @retval uint8_t*      : pointer to free space, fail = NULL
+ */
+uint8_t *mqtt_decoder_buffer(mqtt_decoder_t *decoder, size_t *free_length);
+
+
+
+/*
+ * @brief  Adds bytes read into free space of decoder buffer to the input stream.
+ * @param  *decoder : pointer to mqtt decoder structure (mqtt_decoder_t).
+ * @param  length   : number of bytes read into buffer returned by mqtt_decoder_buffer()
+ * @retval int8_t   : 1 = Success, -1 = Error
+ */
+int8_t mqtt_decoder_commit(mqtt_decoder_t *decoder, size_t length);
+
+
+
+/*
+ * @brief  Copies bytes of input stream into the decoder,
+ *         (packets returned by mqtt_decoder_next() are not valid after this call).
+ * @param  *decoder : pointer to mqtt decoder structure (mqtt_decoder_t).
+ * @param  *data    : input stream bytes, any chunk size
+ * @param  length   : number of input stream bytes
+ * @retval size_t   : number of bytes copied into decoder
+ */
+size_t mqtt_decoder_feed(mqtt_decoder_t *decoder, const void *data, size_t length);
+
+
+
+/*
+ * @brief  Returns next complete control packet from the input stream.
+ * @param  *decoder : pointer to mqtt decoder structure (mqtt_decoder_t).
+ * @param  *packet  : pointer to mqtt packet structure, points into decoder buffer
+ * @retval int8_t   : 1 = packet decoded, 0 = more bytes needed, -1 = malformed or packet larger than buffer
+ */
+int8_t mqtt_decoder_next(mqtt_decoder_t *decoder, mqtt_packet_t *packet);
+
+
+
+
+/*
+ * @brief  Initializes in-flight message table.
+ * @param  *inflight_table : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @retval int8_t          : 1 = Success, -1 = Error
+ */
+int8_t mqtt_inflight_init(mqtt_inflight_t *inflight_table);
+
+
+
+/*
+ * @brief  Allocates next free message ID and adds message to in-flight table,
+ *         IDs wrap around from 65535 to 1 and IDs still in-flight are skipped.
+ * @param  *inflight_table : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @param  state           : in-flight state of message
+ * @param  qos             : quality of service of message, acknowledgments of other flow are ignored
+ * @param  timestamp       : time of send
+ * @param  *buffer         : buffer holding the control packet, (NULL if not kept)
+ * @param  buffer_length   : length of control packet in buffer
+ * @retval uint16_t        : message ID, fail (table full) = 0
+ */
+uint16_t mqtt_inflight_acquire(mqtt_inflight_t *inflight_table, mqtt_inflight_state_t state, mqtt_qos_t qos, uint32_t timestamp,
+		                       void *buffer, size_t buffer_length);
+
+
+
+/*
+ * @brief  Returns slot index of in-flight message.
+ * @param  *inflight_table : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @param  message_id      : message ID
+ * @retval int16_t         : slot index, -1 = message ID not in-flight
+ */
+int16_t mqtt_inflight_find(mqtt_inflight_t *inflight_table, uint16_t message_id);
+
+
+
+/*
+ * @brief  Returns message ID of first in-flight message in state, (slot order, not send order).
+ * @param  *inflight_table : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @param  state           : in-flight state
+ * @retval uint16_t        : message ID, 0 = no message in state
+ */
+uint16_t mqtt_inflight_first(mqtt_inflight_t *inflight_table, mqtt_inflight_state_t state);
+
+
+
+/*
+ * @brief  Updates state and timestamp of in-flight message.
+ * @param  *inflight_table : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @param  message_id      : message ID
+ * @param  state           : new in-flight state of message
+ * @param  timestamp       : time of send
+ * @retval int8_t          : 1 = Success, -1 = message ID not in-flight
+ */
+int8_t mqtt_inflight_update(mqtt_inflight_t *inflight_table, uint16_t message_id, mqtt_inflight_state_t state, uint32_t timestamp);
+
+
+
+/*
+ * @brief  Removes message from in-flight table, message ID can be allocated again.
+ * @param  *inflight_table : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @param  message_id      : message ID
+ * @retval int8_t          : 1 = Success, -1 = message ID not in-flight
+ */
+int8_t mqtt_inflight_release(mqtt_inflight_t *inflight_table, uint16_t message_id);
+
+
+
+/*
+ * @brief  Configures send window, maximum number of unacknowledged messages.
+ * @param  *inflight_table : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @param  window_size     : send window size, (1 to MQTT_INFLIGHT_SLOTS)
+ * @retval int8_t          : 1 = Success, -1 = Error
+ */
+int8_t mqtt_inflight_window(mqtt_inflight_t *inflight_table, uint16_t window_size);
+
+
+
+/*
+ * @brief  Returns number of messages that can be sent before the send window is full.
+ * @param  *inflight_table : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @retval uint16_t        : free space in send window, 0 = window full
+ */
+uint16_t mqtt_inflight_available(mqtt_inflight_t *inflight_table);
+
+
+
+/*
+ * @brief  Configures completion and barrier callbacks of in-flight table.
+ * @param  *inflight_table    : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @param  complete_callback  : called for each acknowledged message, (NULL for none)
+ * @param  barrier_callback   : called when pending barrier is reached, (NULL for none)
+ * @param  *context           : user context passed to callbacks
+ * @retval int8_t             : 1 = Success, -1 = Error
+ */
+int8_t mqtt_inflight_callbacks(mqtt_inflight_t *inflight_table, mqtt_complete_callback_t complete_callback,
+		                       mqtt_barrier_callback_t barrier_callback, void *context);
+
+
+
+/*
+ * @brief  Places barrier after the last message sent, barrier callback is called when
+ *         all messages sent before it are acknowledged, (replaces previous pending barrier).
+ * @param  *inflight_table : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @retval uint32_t        : barrier value for mqtt_inflight_barrier_done()
+ */
+uint32_t mqtt_inflight_barrier(mqtt_inflight_t *inflight_table);
+
+
+
+/*
+ * @brief  Checks if all messages sent before barrier are acknowledged.
+ * @param  *inflight_table : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @param  barrier         : barrier value from mqtt_inflight_barrier()
+ * @retval int8_t          : 1 = barrier reached, 0 = messages still in-flight, -1 = Error
+ */
+int8_t mqtt_inflight_barrier_done(mqtt_inflight_t *inflight_table, uint32_t barrier);
+
+
+
+/*
+ * @brief  Matches PUBACK message to in-flight qos 1 publish and releases its message ID,
+ *         acknowledgments can arrive in any order.
+ * @param  *inflight_table : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @param  *packet         : pointer to decoded PUBACK packet
+ * @retval int8_t          : 1 = message acknowledged, 0 = message ID not in-flight, -1 = Error
+ */
+int8_t mqtt_inflight_ack(mqtt_inflight_t *inflight_table, mqtt_packet_t *packet);
+
+
+
+/*
+ * @brief  Runs publish acknowledgment flows of qos 1 and qos 2 messages, each message ID
+ *         moves through its own state so any number of exchanges are in progress at once.
+ *         PUBACK, PUBCOMP : message is completed and its message ID released.
+ *         PUBREC          : PUBREL is appended to output buffer at *output_used, (sent again on
+ *                           duplicate PUBREC), caller writes output buffer when convenient.
+ * @param  *inflight_table : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @param  *packet         : pointer to decoded PUBACK, PUBREC or PUBCOMP packet
+ * @param  timestamp       : time of PUBREL send, user defined units
+ * @param  *output         : buffer PUBREL messages are appended to
+ * @param  output_length   : length of output buffer
+ * @param  *output_used    : used length of output buffer, updated on append
+ * @retval int8_t          : 1 = packet handled, 0 = message ID not in-flight (ignored),
+ *                           -1 = Error or output buffer full, (packet not consumed, flush output and retry)
+ */
+int8_t mqtt_inflight_process(mqtt_inflight_t *inflight_table, mqtt_packet_t *packet, uint32_t timestamp,
+		                     uint8_t *output, size_t output_length, size_t *output_used);
+
+
+
+/*
+ * @brief  Rolls back all in-flight messages, (connection refused or closed before acknowledgment).
+ *         Requeue callback is called for each message in send order, then the table is emptied,
+ *         window, callbacks and message ID counter are kept.
+ * @param  *inflight_table   : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @param  requeue_callback  : called for each rolled back message, (NULL for none)
+ * @param  *context          : user context passed to requeue callback
+ * @retval uint16_t          : number of messages rolled back
+ */
+uint16_t mqtt_inflight_rollback(mqtt_inflight_t *inflight_table, mqtt_complete_callback_t requeue_callback, void *context);
+
+
+
 #endif /* MQQT_CLIENT_H_ */
@@ -54,6 +54,37 @@
 #define GCC     1
 
 
+/* @brief API feature defines */
+#define IOVEC_SUPPORT           ENABLE    /*!< Use POSIX struct iovec (sys/uio.h) for scatter-gather encoders */
+#define EVENT_LOOP_MAX_EVENTS   16        /*!< Ready events handled per event loop run, (epoll_wait batch)   */
+#define TIMER_WHEEL_LEVELS      4         /*!< Levels of 64 slot timer wheel, 4 levels = 4.6 hours at 1 ms  */
+#define URING_QUEUE_DEPTH       256       /*!< io_uring submission queue entries, power of 2                 */
+#define URING_BUFFER_COUNT      256       /*!< io_uring receive buffers in provided buffer ring, power of 2  */
+#define URING_BUFFER_SIZE       2048      /*!< Size of each io_uring receive buffer                          */
+#define URING_MAX_FILES         1024      /*!< io_uring registered file table size, (connections per ring)   */
+#define OUTPUT_BUFFER_SIZE      16384     /*!< Per client output buffer, packets are coalesced into one write */
+#define OUTPUT_FLUSH_DEADLINE   200       /*!< Default output flush deadline in microseconds, 0 = no delay   */
+#define OUTPUT_DEFAULT_MSS      1460      /*!< Flush size when socket MSS is not known                       */
+#define OUTPUT_HIGH_WATER       (OUTPUT_BUFFER_SIZE * 3 / 4)  /*!< Pending bytes at which producers are told to wait   */
+#define OUTPUT_LOW_WATER        (OUTPUT_BUFFER_SIZE / 4)      /*!< Pending bytes at which producers may queue again  */
+#define SESSION_RECEIVE_SLOTS   32        /*!< Qos 2 messages received per session between PUBREC and PUBREL   */
+#define MANAGER_BLOCK_SIZE      4096      /*!< Pooled buffer of managed sessions, limits received packet length */
+#define MANAGER_POLL_BUDGET     64        /*!< Packets handled per managed session before next ready session  */
+#define CACHE_LINE_SIZE         64        /*!< Alignment of ring indices written by different threads          */
+#define SHARD_MAX_PRODUCERS     64        /*!< Threads that can submit to sharded runtime, (shards included)   */
+#define SHARD_RING_ENTRIES      256       /*!< Entries of each producer to shard ring, power of 2              */
+#define SHARD_ENTRY_SIZE        512       /*!< Size of ring entry, limits topic and message of submitted publish */
+#define SHARD_PARKED_ENTRIES    256       /*!< Commands of sessions with full output or send window, per shard  */
+#define PUBLISH_QUEUE_CELLS     64        /*!< Default cells of multi producer publish queue, power of 2       */
+#define PUBLISH_QUEUE_CELL_SIZE 256       /*!< Default publish queue cell size, limits topic and message        */
+#define PUBLISH_QUEUE_TOPIC     256       /*!< Queued topic with NUL, owner copies topic out of shared cell     */
+#define INGEST_QUEUE_CELLS      256       /*!< Cells of shared memory ingest queue, power of 2                 */
+#define INGEST_QUEUE_CELL_SIZE  (PUBLISH_MESSAGE_LENGTH + 128)  /*!< Ingest cell, full message with topic  */
+#define SOCKET_BUSY_POLL_US     50        /*!< Busy poll time of low-latency socket profile, microseconds      */
+#define SOCKET_BULK_BUFFER      1048576   /*!< Socket send and receive buffer of throughput profile, bytes     */
+#define SOCKET_BULK_DEADLINE    2000      /*!< Output flush deadline of throughput profile, microseconds       */
+
+
 /* @brief MQTT defines */
 #define FIXED_HEADER_LENGTH     2         /*!< Size of MQTT Fixed Header                                    */
 #define PROTOCOL_NAME_LENGTH    6         /*!< Size of MQTT Protocol                                        */
@@ -64,6 +95,8 @@
 #define PASSWORD_LENGTH         10        /*!< MQTT passwords size, variable can be changed by user         */
 #define TOPIC_LENGTH            30        /*!< MQTT topic length size, variable can be changed by user      */
 #define MESSAGE_LENGTH          100       /*!< MQTT message/payload length, variable can be changed by user */
+#define PUBLISH_MESSAGE_LENGTH  4096      /*!< MQTT publish payload length, can be changed by user (max 268435455) */
 #define MQTT_DEFAULT_KEEPALIVE  60
+#define INFLIGHT_TABLE_SIZE     64        /*!< Number of in-flight qos 1 and 2 messages per client, power of 2 */
 
 #endif /* INC_MQTT_CONFIGS_H_ */
@@ -0,0 +1,181 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_event_loop.h
+ * @author  Aditya Mall,
+ * @brief   MQTT client event loop API Header File
+ *
+ *  Info
+ *          Event loop API Header File, (Linux epoll)
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall, MIT License </center></h2>
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019 Aditya Mall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+#ifndef MQTT_EVENT_LOOP_H_
+#define MQTT_EVENT_LOOP_H_
+
+/*
+ * Standard Header and API Header files
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include "mqtt_configs.h"
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                            Macro Defines                                   */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* @brief Event flags of event sources */
+#define MQTT_EVENT_READ     0x01  /*!< Socket is readable, (or closed by peer)           */
+#define MQTT_EVENT_WRITE    0x02  /*!< Socket is writable                                */
+#define MQTT_EVENT_ERROR    0x04  /*!< Socket error or hang up, always reported          */
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                      Data Structures and Typedefs                          */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* @brief Event callback, called from mqtt_event_loop_run() with ready events of source */
+typedef void (*mqtt_event_callback_t)(void *context, int fd, uint8_t events);
+
+
+
+/* @brief Event source, storage owned by user and must stay valid while registered */
+typedef struct mqtt_event_source
+{
+	int                    fd;        /*!< Registered file descriptor                         */
+	uint8_t                events;    /*!< Registered event flags (MQTT_EVENT_*)              */
+	uint8_t                revents;   /*!< Ready event flags of last mqtt_event_loop_run()     */
+	mqtt_event_callback_t  callback;  /*!< Called on ready events, (NULL to only set revents)  */
+	void                  *context;   /*!< User context passed to callback                    */
+
+}mqtt_event_source_t;
+
+
+
+/* @brief Event loop structure */
+typedef struct mqtt_event_loop
+{
+	int      epoll_fd;        /*!< epoll instance file descriptor                            */
+	uint16_t source_count;    /*!< Number of registered sources                              */
+	void    *dispatch;        /*!< Ready events being dispatched, NULL = outside of run      */
+	int      dispatch_next;   /*!< First ready event whose callback is not called yet        */
+	int      dispatch_count;  /*!< Number of ready events being dispatched                   */
+
+}mqtt_event_loop_t;
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                              API Functions                                 */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Creates event loop.
+ * @param  *loop  : pointer to event loop structure (mqtt_event_loop_t).
+ * @retval int8_t : 1 = Success, -1 = Error
+ */
+int8_t mqtt_event_loop_init(mqtt_event_loop_t *loop);
+
+
+
+/*
+ * @brief  Registers file descriptor with event loop, (level triggered).
+ * @param  *loop     : pointer to event loop structure (mqtt_event_loop_t).
+ * @param  *source   : pointer to event source storage, (owned by user)
+ * @param  fd        : file descriptor, (non blocking socket)
+ * @param  events    : event flags to wait for (MQTT_EVENT_READ | MQTT_EVENT_WRITE)
+ * @param  callback  : called on ready events, (NULL for none)
+ * @param  *context  : user context passed to callback
+ * @retval int8_t    : 1 = Success, -1 = Error
+ */
+int8_t mqtt_event_loop_add(mqtt_event_loop_t *loop, mqtt_event_source_t *source, int fd, uint8_t events,
+		                   mqtt_event_callback_t callback, void *context);
+
+
+
+/*
+ * @brief  Changes event flags of registered source, (e.g. wait for write only while output is pending).
+ * @param  *loop    : pointer to event loop structure (mqtt_event_loop_t).
+ * @param  *source  : pointer to registered event source
+ * @param  events   : new event flags
+ * @retval int8_t   : 1 = Success, -1 = Error
+ */
+int8_t mqtt_event_loop_modify(mqtt_event_loop_t *loop, mqtt_event_source_t *source, uint8_t events);
+
+
+
+/*
+ * @brief  Removes source from event loop, file descriptor is not closed. Callback of removed source
+ *         is not called from events still pending in current run, so callbacks may remove and free
+ *         other sources.
+ * @param  *loop    : pointer to event loop structure (mqtt_event_loop_t).
+ * @param  *source  : pointer to registered event source
+ * @retval int8_t   : 1 = Success, -1 = Error
+ */
+int8_t mqtt_event_loop_remove(mqtt_event_loop_t *loop, mqtt_event_source_t *source);
+
+
+
+/*
+ * @brief  Sleeps until a registered source is ready or timeout expires, then calls callbacks
+ *         of ready sources, no CPU is used while waiting. Must not be called from a callback.
+ * @param  *loop       : pointer to event loop structure (mqtt_event_loop_t).
+ * @param  timeout_ms  : timeout in milliseconds, (-1 to wait forever, 0 to poll)
+ * @retval int         : number of ready sources, 0 = timeout expired or interrupted, -1 = Error
+ */
+int mqtt_event_loop_run(mqtt_event_loop_t *loop, int timeout_ms);
+
+
+
+/*
+ * @brief  Closes event loop, registered file descriptors are not closed.
+ * @param  *loop  : pointer to event loop structure (mqtt_event_loop_t).
+ * @retval int8_t : 1 = Success, -1 = Error
+ */
+int8_t mqtt_event_loop_close(mqtt_event_loop_t *loop);
+
+
+
+#endif /* MQTT_EVENT_LOOP_H_ */
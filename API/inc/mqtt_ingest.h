@@ -0,0 +1,150 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_ingest.h
+ * @author  Aditya Mall,
+ * @brief   MQTT client shared memory ingest queue API Header File
+ *
+ *  Info
+ *          Ingest queue API Header File, (Linux memfd, unix domain socket)
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall, MIT License </center></h2>
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019 Aditya Mall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+
+
+#ifndef MQTT_INGEST_H_
+#define MQTT_INGEST_H_
+
+/*
+ * Standard Header and API Header files
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include "mqtt_queue.h"
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                            Macro Defines                                   */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* @brief Longest unix socket path, (sun_path) */
+#define MQTT_INGEST_PATH_LENGTH  108
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                      Data Structures and Typedefs                          */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* @brief Publish queue on memfd segment, shared by owner and producer processes */
+typedef struct mqtt_ingest
+{
+	mqtt_queue_t  queue;                          /*!< Queue on shared segment                           */
+	void         *segment;                        /*!< Mapping of segment                                */
+	size_t        segment_size;                   /*!< Size of mapping                                   */
+	int           memfd;                          /*!< Segment descriptor, (owner)                       */
+	int           listen_fd;                      /*!< Unix socket producers attach through, (owner)     */
+	uint32_t      attached;                       /*!< Producers given segment, (owner)                  */
+	char          path[MQTT_INGEST_PATH_LENGTH];  /*!< Unix socket path, removed by close, (owner)       */
+
+}mqtt_ingest_t;
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                              API Functions                                 */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Creates memfd segment with publish queue and listens on unix socket for producers, (owner).
+ * @param  *ingest       : pointer to ingest structure (mqtt_ingest_t).
+ * @param  *path         : unix socket path, existing socket is replaced, (EEXIST = path is not a socket)
+ * @param  cell_size     : size of one cell, multiple of 4, limits topic and message length
+ * @param  cell_count    : number of cells, power of 2
+ * @param  *group        : notification group of owner, its eventfd is doorbell of producers
+ * @retval int8_t        : 1 = Success, -1 = Error (errno is set)
+ */
+int8_t mqtt_ingest_open(mqtt_ingest_t *ingest, const char *path, uint32_t cell_size, uint32_t cell_count, mqtt_notify_t *group);
+
+
+
+/*
+ * @brief  Returns listening socket, readable when producers wait to attach, (owner).
+ * @param  *ingest   : pointer to ingest structure (mqtt_ingest_t).
+ * @retval int       : descriptor, -1 = Error
+ */
+int mqtt_ingest_fd(mqtt_ingest_t *ingest);
+
+
+
+/*
+ * @brief  Gives segment and doorbell to waiting producers of same user as owner, (owner, does not block).
+ * @param  *ingest   : pointer to ingest structure (mqtt_ingest_t).
+ * @retval int       : producers attached, -1 = Error (errno is set)
+ */
+int mqtt_ingest_accept(mqtt_ingest_t *ingest);
+
+
+
+/*
+ * @brief  Maps queue of owner listening on path, publishes are then queued with mqtt_enqueue_publish()
+ *         on ingest->queue without system calls, (doorbell is written only when owner sleeps).
+ * @param  *ingest   : pointer to ingest structure (mqtt_ingest_t).
+ * @param  *path     : unix socket path of owner
+ * @retval int8_t    : 1 = Success, -1 = Error (errno is set)
+ */
+int8_t mqtt_ingest_connect(mqtt_ingest_t *ingest, const char *path);
+
+
+
+/*
+ * @brief  Unmaps segment and closes descriptors, owner also removes unix socket path.
+ * @param  *ingest   : pointer to ingest structure (mqtt_ingest_t).
+ * @retval int8_t    : 1 = Success, -1 = Error
+ */
+int8_t mqtt_ingest_close(mqtt_ingest_t *ingest);
+
+
+
+#endif /* MQTT_INGEST_H_ */
@@ -0,0 +1,190 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_manager.h
+ * @author  Aditya Mall,
+ * @brief   MQTT client connection manager API Header File
+ *
+ *  Info
+ *          Connection manager API Header File
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall, MIT License </center></h2>
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019 Aditya Mall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+
+#ifndef MQTT_MANAGER_H_
+#define MQTT_MANAGER_H_
+
+/*
+ * Standard Header and API Header files
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include "mqtt_event_loop.h"
+#include "mqtt_session.h"
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                      Data Structures and Typedefs                          */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* @brief Forward declaration of manager structure for slot */
+struct mqtt_manager;
+
+
+
+/* @brief Session slot of manager, holds no buffers while session is idle */
+typedef struct mqtt_manager_slot
+{
+	mqtt_session_t             session;  /*!< Session, first member, slot is found from session pointer  */
+	mqtt_event_source_t        source;   /*!< Socket event source                                        */
+	struct mqtt_manager       *manager;  /*!< Owning manager, NULL = slot is free                        */
+	struct mqtt_manager_slot  *next;     /*!< Next slot of free list or ready list                       */
+	void                      *context;  /*!< User context passed to event callback                      */
+	uint8_t                    ready;    /*!< Slot is in ready list                                      */
+
+}mqtt_manager_slot_t;
+
+
+
+/* @brief Connection manager, sessions of one thread on one event loop with shared buffers and timers */
+typedef struct mqtt_manager
+{
+	mqtt_event_loop_t        loop;          /*!< Event loop of all session sockets                     */
+	mqtt_timer_wheel_t       wheel;         /*!< Keep alive timers of all sessions                     */
+	mqtt_session_callback_t  callback;      /*!< Event callback of all sessions                        */
+	mqtt_manager_slot_t     *slots;         /*!< Session slots                                         */
+	mqtt_manager_slot_t     *free_slots;    /*!< Released slots                                        */
+	mqtt_manager_slot_t     *ready_head;    /*!< Sessions to be serviced by next run                   */
+	mqtt_manager_slot_t     *ready_tail;    /*!< Last session of ready list                            */
+	uint8_t                 *receive;       /*!< Receive buffer shared by sessions                     */
+	uint8_t                 *blocks;        /*!< Buffer pool, output and partially received packets    */
+	void                    *free_blocks;   /*!< Released buffers                                      */
+	mqtt_inflight_t         *tables;        /*!< In-flight table pool, (qos 1, 2 publish)              */
+	void                    *free_tables;   /*!< Released in-flight tables                             */
+	uint32_t                 slot_count;    /*!< Number of slots                                       */
+	uint32_t                 slot_next;     /*!< First never used slot, later slots are not touched    */
+	uint32_t                 block_count;   /*!< Number of pooled buffers                              */
+	uint32_t                 block_next;    /*!< First never used buffer                               */
+	uint32_t                 table_count;   /*!< Number of pooled in-flight tables                     */
+	uint32_t                 table_next;    /*!< First never used in-flight table                      */
+	uint32_t                 session_count; /*!< Open sessions                                         */
+	uint32_t                 block_lent;    /*!< Buffers lent to sessions                              */
+	uint32_t                 block_peak;    /*!< Most buffers lent at once                             */
+	uint32_t                 table_lent;    /*!< In-flight tables lent to sessions                     */
+	uint32_t                 table_peak;    /*!< Most in-flight tables lent at once                    */
+
+}mqtt_manager_t;
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                              API Functions                                 */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Allocates session slots and pools of manager, (MANAGER_BLOCK_SIZE buffers).
+ * @param  *manager      : pointer to manager structure (mqtt_manager_t).
+ * @param  slot_count    : most open sessions
+ * @param  block_count   : pooled buffers, most sessions with pending output or partial input
+ * @param  table_count   : pooled in-flight tables, most sessions with qos 1, 2 publish in flight
+ * @param  callback      : event callback of all sessions, context of session is given
+ * @retval int8_t        : 1 = Success, -1 = Error (errno is set)
+ */
+int8_t mqtt_manager_init(mqtt_manager_t *manager, uint32_t slot_count, uint32_t block_count, uint32_t table_count,
+		                 mqtt_session_callback_t callback);
+
+
+
+/*
+ * @brief  Opens session of connected socket, socket is owned and closed by manager.
+ * @param  *manager     : pointer to manager structure (mqtt_manager_t).
+ * @param  descriptor   : connected socket descriptor, (non blocking)
+ * @param  *context     : user context passed to event callback
+ * @retval mqtt_session_t* : session, buffers are attached for mqtt_session_connect(),
+ *                           NULL = Error (errno is set, ENOBUFS = no free slot or buffer)
+ */
+mqtt_session_t *mqtt_manager_open(mqtt_manager_t *manager, int descriptor, void *context);
+
+
+
+/*
+ * @brief  Attaches buffer and in-flight table to session, call before queuing with mqtt_session_*()
+ *         functions outside callback of that session. Session is written by next run.
+ * @param  *manager   : pointer to manager structure (mqtt_manager_t).
+ * @param  *session   : session of manager
+ * @param  inflight   : 1 = in-flight table is attached for qos 1, 2 publish
+ * @retval int8_t     : 1 = Success, -1 = Error (errno is set, ENOBUFS = pool empty)
+ */
+int8_t mqtt_manager_lease(mqtt_manager_t *manager, mqtt_session_t *session, uint8_t inflight);
+
+
+
+/*
+ * @brief  Closes session without DISCONNECT, slot and socket are released by next run.
+ * @param  *manager   : pointer to manager structure (mqtt_manager_t).
+ * @param  *session   : session of manager
+ * @retval int8_t     : 1 = Success, -1 = Error
+ */
+int8_t mqtt_manager_close(mqtt_manager_t *manager, mqtt_session_t *session);
+
+
+
+/*
+ * @brief  Waits for socket events or keep alive timers and services ready sessions, buffers of
+ *         idle sessions are returned to pools.
+ * @param  *manager    : pointer to manager structure (mqtt_manager_t).
+ * @param  timeout_ms  : longest wait, (-1 = until event or timer, 0 = no wait)
+ * @retval int         : number of sessions serviced, -1 = Error
+ */
+int mqtt_manager_run(mqtt_manager_t *manager, int timeout_ms);
+
+
+
+/*
+ * @brief  Closes all session sockets and releases memory of manager.
+ * @param  *manager   : pointer to manager structure (mqtt_manager_t).
+ * @retval int8_t     : 1 = Success, -1 = Error
+ */
+int8_t mqtt_manager_free(mqtt_manager_t *manager);
+
+
+
+#endif /* MQTT_MANAGER_H_ */
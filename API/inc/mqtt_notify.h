@@ -0,0 +1,178 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_notify.h
+ * @author  Aditya Mall,
+ * @brief   MQTT client notification group API Header File
+ *
+ *  Info
+ *          Notification group API Header File, (Linux eventfd, timerfd)
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall, MIT License </center></h2>
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019 Aditya Mall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+
+#ifndef MQTT_NOTIFY_H_
+#define MQTT_NOTIFY_H_
+
+/*
+ * Standard Header and API Header files
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include "mqtt_event_loop.h"
+#include "mqtt_session.h"
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                      Data Structures and Typedefs                          */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* @brief Session registered in notification group, storage owned by user */
+typedef struct mqtt_notify_member
+{
+	mqtt_event_source_t         source;   /*!< Socket event source of session             */
+	mqtt_session_t             *session;  /*!< Session polled when source or timer fires  */
+	struct mqtt_notify_member  *next;     /*!< Next member of group                        */
+
+}mqtt_notify_member_t;
+
+
+
+/* @brief Notification group, one pollable descriptor for sessions, timers and wake ups */
+typedef struct mqtt_notify
+{
+	mqtt_event_loop_t     loop;           /*!< epoll instance, readable when group has work       */
+	mqtt_event_source_t   timer_source;   /*!< timerfd, armed at next session deadline             */
+	mqtt_event_source_t   signal_source;  /*!< eventfd, wakes group from mqtt_notify_signal()      */
+	mqtt_notify_member_t *members;        /*!< Registered sessions                                 */
+	uint32_t              timer_deadline; /*!< Time timer is armed for                             */
+	uint8_t               timer_armed;    /*!< Timer is armed                                      */
+
+}mqtt_notify_t;
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                              API Functions                                 */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Creates notification group, (epoll instance with timerfd and eventfd).
+ * @param  *group  : pointer to notification group (mqtt_notify_t).
+ * @retval int8_t  : 1 = Success, -1 = Error (errno is set)
+ */
+int8_t mqtt_notify_init(mqtt_notify_t *group);
+
+
+
+/*
+ * @brief  Adds session to group, socket of session is watched by group descriptor.
+ * @param  *group    : pointer to notification group (mqtt_notify_t).
+ * @param  *member   : member storage, valid while session is in group
+ * @param  *session  : initialized session
+ * @retval int8_t    : 1 = Success, -1 = Error (errno is set)
+ */
+int8_t mqtt_notify_add(mqtt_notify_t *group, mqtt_notify_member_t *member, mqtt_session_t *session);
+
+
+
+/*
+ * @brief  Removes session from group, (closed sessions are removed by dispatch).
+ * @param  *group   : pointer to notification group (mqtt_notify_t).
+ * @param  *member  : member of session
+ * @retval int8_t   : 1 = Success, -1 = Error
+ */
+int8_t mqtt_notify_remove(mqtt_notify_t *group, mqtt_notify_member_t *member);
+
+
+
+/*
+ * @brief  Returns descriptor of group for foreign event loop, readable when dispatch has work.
+ * @param  *group  : pointer to notification group (mqtt_notify_t).
+ * @retval int     : pollable descriptor, -1 = Error
+ */
+int mqtt_notify_fd(mqtt_notify_t *group);
+
+
+
+/*
+ * @brief  Returns time until earliest session deadline, (keep alive or output flush).
+ * @param  *group  : pointer to notification group (mqtt_notify_t).
+ * @param  now     : current time, from mqtt_timer_now()
+ * @retval int     : milliseconds, -1 = no deadline
+ */
+int mqtt_notify_next_deadline(mqtt_notify_t *group, uint32_t now);
+
+
+
+/*
+ * @brief  Makes group descriptor readable, call after queuing messages outside dispatch
+ *         so their output deadline is armed.
+ * @param  *group  : pointer to notification group (mqtt_notify_t).
+ * @retval int8_t  : 1 = Success, -1 = Error
+ */
+int8_t mqtt_notify_signal(mqtt_notify_t *group);
+
+
+
+/*
+ * @brief  Polls sessions that have input, write space or expired deadline, call when group
+ *         descriptor is readable. Session events and batched completions are given to session
+ *         callbacks from here, timer is armed at next deadline.
+ * @param  *group   : pointer to notification group (mqtt_notify_t).
+ * @param  now      : current time, from mqtt_timer_now()
+ * @param  budget   : most packets handled per session, (0 = no limit)
+ * @retval int      : number of packets handled, -1 = Error
+ */
+int mqtt_notify_dispatch(mqtt_notify_t *group, uint32_t now, uint16_t budget);
+
+
+
+/*
+ * @brief  Closes group descriptors, sessions and their sockets are not closed.
+ * @param  *group  : pointer to notification group (mqtt_notify_t).
+ * @retval int8_t  : 1 = Success, -1 = Error
+ */
+int8_t mqtt_notify_close(mqtt_notify_t *group);
+
+
+
+#endif /* MQTT_NOTIFY_H_ */
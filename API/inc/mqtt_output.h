@@ -0,0 +1,254 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_output.h
+ * @author  Aditya Mall,
+ * @brief   MQTT client output buffer API Header File
+ *
+ *  Info
+ *          Output buffer API Header File
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall, MIT License </center></h2>
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019 Aditya Mall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+#ifndef MQTT_OUTPUT_H_
+#define MQTT_OUTPUT_H_
+
+/*
+ * Standard Header and API Header files
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include "mqtt_client.h"
+#include "mqtt_event_loop.h"
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                      Data Structures and Typedefs                          */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* @brief Output write function, same as POSIX write() */
+typedef ssize_t (*mqtt_output_write_t)(int descriptor, const void *buffer, size_t length);
+
+
+
+/* @brief Per client output buffer, encoded packets are collected and sent with one write */
+typedef struct mqtt_output
+{
+	uint8_t              *buffer;         /*!< Output buffer, owned by user                        */
+	size_t                buffer_size;    /*!< Size of output buffer                               */
+	size_t                offset;         /*!< Start of unsent data                                */
+	size_t                length;         /*!< End of queued data                                  */
+	size_t                flush_size;     /*!< Pending size flushed at once, (socket MSS)          */
+	uint32_t              deadline_us;    /*!< Longest time data waits in buffer, 0 = no delay     */
+	uint64_t              queued_time;    /*!< Time oldest unsent data was queued, microseconds    */
+	int                   descriptor;     /*!< Socket descriptor                                   */
+	mqtt_output_write_t   write;          /*!< Write function                                      */
+
+	/* Backpressure */
+	size_t                high_water;     /*!< Pending bytes at which producers are told to wait   */
+	size_t                low_water;      /*!< Pending bytes at which producers may queue again    */
+	uint8_t               stalled;        /*!< Socket send buffer full, resumed on write event     */
+	uint8_t               blocked;        /*!< Producers should wait, (between high and low water) */
+	uint8_t               corked;         /*!< Socket has TCP_CORK set, flush pushes partial segment */
+
+	/* Statistics */
+	uint64_t              packet_count;   /*!< Number of packets queued                            */
+	uint64_t              write_count;    /*!< Number of write calls                               */
+	uint64_t              byte_count;     /*!< Number of bytes written                             */
+	uint64_t              stall_count;    /*!< Number of times socket send buffer was full         */
+	uint64_t              blocked_count;  /*!< Number of times producers were told to wait         */
+	size_t                peak_pending;   /*!< Largest amount of unsent data                       */
+	uint64_t              push_count;     /*!< Number of partial segments pushed from corked socket */
+
+}mqtt_output_t;
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                              API Functions                                 */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Initializes output buffer, flush size is taken from socket MSS, (high water on corked socket).
+ * @param  *output        : pointer to output structure (mqtt_output_t).
+ * @param  *buffer        : output buffer, (OUTPUT_BUFFER_SIZE)
+ * @param  buffer_size    : size of output buffer
+ * @param  descriptor     : connected socket descriptor
+ * @param  write          : write function, (write() or transport write)
+ * @param  deadline_us    : longest time data waits in buffer, (0 = flush every packet)
+ * @retval int8_t         : 1 = Success, -1 = Error
+ */
+int8_t mqtt_output_init(mqtt_output_t *output, uint8_t *buffer, size_t buffer_size, int descriptor,
+		                mqtt_output_write_t write, uint32_t deadline_us);
+
+
+
+/*
+ * @brief  Replaces buffer of empty output, idle outputs can return their buffer to a shared pool.
+ *         Flush size is kept from init.
+ * @param  *output        : pointer to output structure (mqtt_output_t).
+ * @param  *buffer        : output buffer, (NULL = no buffer, nothing can be queued)
+ * @param  buffer_size    : size of output buffer
+ * @retval int8_t         : 1 = Success, -1 = Error (errno is set, EBUSY = data pending)
+ */
+int8_t mqtt_output_attach(mqtt_output_t *output, uint8_t *buffer, size_t buffer_size);
+
+
+
+/*
+ * @brief  Drops unsent data of closed connection, output is empty and not stalled afterwards.
+ * @param  *output   : pointer to output structure (mqtt_output_t).
+ * @retval int8_t    : 1 = Success, -1 = Error
+ */
+int8_t mqtt_output_discard(mqtt_output_t *output);
+
+
+
+/*
+ * @brief  Reserves space at end of queued data, packet is encoded in place and queued with
+ *         mqtt_output_commit(). Packet larger than output buffer can never be queued.
+ * @param  *output   : pointer to output structure (mqtt_output_t).
+ * @param  length    : length of packet
+ * @retval uint8_t*  : space for packet, NULL = Error (errno is set, EAGAIN = would block,
+ *                     EMSGSIZE = packet is larger than output buffer, ENOBUFS = no buffer attached)
+ */
+uint8_t *mqtt_output_reserve(mqtt_output_t *output, size_t length);
+
+
+
+/*
+ * @brief  Queues packet encoded in space from mqtt_output_reserve(), flushed like mqtt_output_queue().
+ * @param  *output        : pointer to output structure (mqtt_output_t).
+ * @param  length         : length of encoded packets, (at most reserved length)
+ * @param  packet_count   : number of packets, for statistics
+ * @param  now_us         : current time, from mqtt_timer_now_us()
+ * @retval ssize_t        : length queued, -1 = Error (errno is set), nothing is queued on error
+ */
+ssize_t mqtt_output_commit(mqtt_output_t *output, size_t length, uint16_t packet_count, uint64_t now_us);
+
+
+
+/*
+ * @brief  Queues encoded packet, buffer is flushed when pending data reaches flush size or
+ *         deadline is 0, packet buffer can be reused on return.
+ * @param  *output   : pointer to output structure (mqtt_output_t).
+ * @param  *packet   : encoded packet
+ * @param  length    : length of packet
+ * @param  now_us    : current time, from mqtt_timer_now_us()
+ * @retval ssize_t   : length queued, -1 = Error (errno is set, EAGAIN = would block), nothing is queued on error
+ */
+ssize_t mqtt_output_queue(mqtt_output_t *output, const void *packet, size_t length, uint64_t now_us);
+
+
+
+/*
+ * @brief  Queues scatter-gather packets, (e.g. PUBLISH burst from mqtt_publish_iov() or mqtt_publish_batch_iov()).
+ * @param  *output        : pointer to output structure (mqtt_output_t).
+ * @param  *vector        : IO vector array
+ * @param  count          : number of IO vectors
+ * @param  packet_count   : number of packets in vector, for statistics
+ * @param  now_us         : current time, from mqtt_timer_now_us()
+ * @retval ssize_t        : length queued, -1 = Error (errno is set, EAGAIN = would block), nothing is queued on error
+ */
+ssize_t mqtt_output_queue_vector(mqtt_output_t *output, const mqtt_iovec_t *vector, int count,
+		                         uint16_t packet_count, uint64_t now_us);
+
+
+
+/*
+ * @brief  Writes pending data, partially written data is resumed from its offset by next flush.
+ *         Corked socket sends its last partial segment once buffer is drained.
+ * @param  *output   : pointer to output structure (mqtt_output_t).
+ * @retval ssize_t   : bytes written, -1 = Error (errno is set, EAGAIN = stalled), pending data is kept
+ */
+ssize_t mqtt_output_flush(mqtt_output_t *output);
+
+
+
+/*
+ * @brief  Flushes output buffer if deadline of oldest pending data expired.
+ * @param  *output   : pointer to output structure (mqtt_output_t).
+ * @param  now_us    : current time, from mqtt_timer_now_us()
+ * @retval int8_t    : 1 = flushed, 0 = not due, -1 = Error
+ */
+int8_t mqtt_output_poll(mqtt_output_t *output, uint64_t now_us);
+
+
+
+/*
+ * @brief  Returns time until output buffer must be flushed, for event loop timeout.
+ * @param  *output   : pointer to output structure (mqtt_output_t).
+ * @param  now_us    : current time, from mqtt_timer_now_us()
+ * @retval int32_t   : microseconds to deadline, 0 = due now, -1 = nothing pending or stalled
+ */
+int32_t mqtt_output_next_deadline(mqtt_output_t *output, uint64_t now_us);
+
+
+
+/*
+ * @brief  Returns size of unsent data.
+ * @param  *output   : pointer to output structure (mqtt_output_t).
+ * @retval size_t    : pending bytes
+ */
+size_t mqtt_output_pending(mqtt_output_t *output);
+
+
+
+/*
+ * @brief  Returns whether producers may queue more packets, "would block" signal for application.
+ * @param  *output   : pointer to output structure (mqtt_output_t).
+ * @retval int8_t    : 1 = writable, 0 = would block (pending data above high water), -1 = Error
+ */
+int8_t mqtt_output_writable(mqtt_output_t *output);
+
+
+
+/*
+ * @brief  Returns event loop events needed by output buffer, write event while socket is stalled.
+ * @param  *output   : pointer to output structure (mqtt_output_t).
+ * @retval uint8_t   : MQTT_EVENT_WRITE = flush on write event, 0 = no write event needed
+ */
+uint8_t mqtt_output_events(mqtt_output_t *output);
+
+
+
+#endif /* MQTT_OUTPUT_H_ */
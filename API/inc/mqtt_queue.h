@@ -0,0 +1,199 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_queue.h
+ * @author  Aditya Mall,
+ * @brief   MQTT client multi producer publish queue API Header File
+ *
+ *  Info
+ *          Lock free publish queue API Header File, (GCC atomics)
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall, MIT License </center></h2>
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019 Aditya Mall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+
+
+#ifndef MQTT_QUEUE_H_
+#define MQTT_QUEUE_H_
+
+/*
+ * Standard Header and API Header files
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include "mqtt_session.h"
+#include "mqtt_notify.h"
+#include "mqtt_ring.h"
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                            Macro Defines                                   */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* @brief Marks initialized queue storage */
+#define MQTT_QUEUE_MAGIC  0x4d515131U
+
+
+/* @brief Storage size of queue with cell_count cells of cell_size bytes */
+#define MQTT_QUEUE_STORAGE_SIZE(cell_size, cell_count)  (sizeof(mqtt_queue_ring_t) + (size_t)(cell_size) * (cell_count))
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                      Data Structures and Typedefs                          */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* @brief Queued publish, topic and message follow cell up to entry size */
+typedef struct mqtt_queue_cell
+{
+	uint32_t  sequence;         /*!< Position cell is ready for, (written by producer and consumer)  */
+	uint8_t   qos;              /*!< Publish qos                                                     */
+	uint8_t   retain;           /*!< Publish retain flag                                             */
+	uint16_t  topic_length;     /*!< Length of topic, (NUL follows topic)                            */
+	uint32_t  message_length;   /*!< Length of message, (follows topic NUL)                          */
+	uint8_t   data[];           /*!< Topic and message                                               */
+
+}mqtt_queue_cell_t;
+
+
+
+/* @brief Shared state of queue at start of storage, no pointers, (storage can be mapped by several processes) */
+typedef struct mqtt_queue_ring
+{
+	uint32_t  magic;                              /*!< MQTT_QUEUE_MAGIC once initialized              */
+	uint32_t  cell_size;                          /*!< Size of one cell                               */
+	uint32_t  cell_count;                         /*!< Number of cells                                */
+	uint32_t  enqueue_position MQTT_RING_ALIGNED; /*!< Next cell claimed by producers                 */
+	uint32_t  rejected;                           /*!< Publishes refused because queue was full       */
+	uint32_t  dequeue_position MQTT_RING_ALIGNED; /*!< Next cell published by owner                   */
+	uint32_t  dropped;                            /*!< Publishes refused by session, (owner)          */
+	uint32_t  armed MQTT_RING_ALIGNED;            /*!< Owner may sleep, first producer rings doorbell */
+	uint8_t   cells[] MQTT_RING_ALIGNED;          /*!< Cells                                          */
+
+}mqtt_queue_ring_t;
+
+
+
+/* @brief Bounded lock free publish queue, many producer threads and one connection owner */
+typedef struct mqtt_queue
+{
+	mqtt_queue_ring_t  *ring;       /*!< Shared state and cells, user storage           */
+	uint32_t            cell_size;  /*!< Size of one cell                               */
+	uint32_t            mask;       /*!< Number of cells - 1                            */
+	int                 doorbell;   /*!< eventfd written to wake owner, -1 = none       */
+	mqtt_notify_t      *group;      /*!< Group of owner, NULL for attached producers    */
+
+}mqtt_queue_t;
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                              API Functions                                 */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Initializes publish queue on user storage of MQTT_QUEUE_STORAGE_SIZE(cell_size, cell_count) bytes.
+ * @param  *queue       : pointer to queue structure (mqtt_queue_t).
+ * @param  *storage     : queue storage, aligned to CACHE_LINE_SIZE
+ * @param  cell_size    : size of one cell, multiple of 4, limits topic and message length
+ * @param  cell_count   : number of cells, power of 2
+ * @param  *group       : notification group of owner, signaled when owner waits on empty queue, (NULL = none)
+ * @retval int8_t       : 1 = Success, -1 = Error
+ */
+int8_t mqtt_queue_init(mqtt_queue_t *queue, void *storage, uint32_t cell_size, uint32_t cell_count, mqtt_notify_t *group);
+
+
+
+/*
+ * @brief  Attaches producer to queue initialized by other process, (shared memory mapping of its storage).
+ * @param  *queue          : pointer to queue structure (mqtt_queue_t).
+ * @param  *storage        : mapped queue storage
+ * @param  storage_size    : size of mapping
+ * @param  doorbell        : eventfd of owner notification group, (mqtt_notify_t signal), -1 = none
+ * @retval int8_t          : 1 = Success, -1 = Error (errno is set, EINVAL = storage is not a queue)
+ */
+int8_t mqtt_queue_attach(mqtt_queue_t *queue, void *storage, size_t storage_size, int doorbell);
+
+
+
+/*
+ * @brief  Queues publish from any thread, never blocks. Topic and message are copied.
+ * @param  *queue            : pointer to queue structure (mqtt_queue_t).
+ * @param  *topic            : publish topic
+ * @param  *message          : message, (binary safe)
+ * @param  message_length    : length of message
+ * @param  qos               : quality of service value
+ * @param  retain            : MQTT_MESSAGE_RETAIN or MQTT_MESSAGE_NO_RETAIN
+ * @retval int8_t            : 1 = Success, -1 = Error (errno is set, EAGAIN = queue full,
+ *                             EMSGSIZE = topic and message do not fit cell, or topic is
+ *                             longer than PUBLISH_QUEUE_TOPIC)
+ */
+int8_t mqtt_enqueue_publish(mqtt_queue_t *queue, const char *topic, const void *message, size_t message_length,
+		                    mqtt_qos_t qos, uint8_t retain);
+
+
+
+/*
+ * @brief  Publishes queued messages on session in order, call from thread owning session. Stops at
+ *         full output buffer or send window, (message stays queued), rearms wake up once queue is empty.
+ *         Group is signaled after messages are queued on session, so their output deadline is armed.
+ * @param  *queue     : pointer to queue structure (mqtt_queue_t).
+ * @param  *session   : pointer to session structure (mqtt_session_t).
+ * @param  now        : current time, from mqtt_timer_now()
+ * @param  budget     : most messages published, (0 = no limit)
+ * @retval int32_t    : messages published, -1 = Error (errno is set, ENOTCONN = session closed)
+ */
+int32_t mqtt_queue_drain(mqtt_queue_t *queue, mqtt_session_t *session, uint32_t now, uint32_t budget);
+
+
+
+/*
+ * @brief  Returns number of queued messages, (exact only for owner thread with no producers running).
+ * @param  *queue      : pointer to queue structure (mqtt_queue_t).
+ * @retval uint32_t    : number of messages
+ */
+uint32_t mqtt_queue_count(mqtt_queue_t *queue);
+
+
+
+#endif /* MQTT_QUEUE_H_ */
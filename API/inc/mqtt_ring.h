@@ -0,0 +1,159 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_ring.h
+ * @author  Aditya Mall,
+ * @brief   MQTT client single producer, single consumer ring API Header File
+ *
+ *  Info
+ *          Lock free ring API Header File, (GCC atomics)
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall, MIT License </center></h2>
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019 Aditya Mall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+
+#ifndef MQTT_RING_H_
+#define MQTT_RING_H_
+
+/*
+ * Standard Header and API Header files
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include "mqtt_configs.h"
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                            Macro Defines                                   */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* @brief Indices written by different threads are kept on separate cache lines */
+#if GCC
+#define MQTT_RING_ALIGNED  __attribute__((aligned(CACHE_LINE_SIZE)))
+#else
+#define MQTT_RING_ALIGNED
+#endif
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                      Data Structures and Typedefs                          */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* @brief Lock free ring of fixed size entries, one producer thread and one consumer thread */
+typedef struct mqtt_ring
+{
+	uint32_t  head MQTT_RING_ALIGNED;     /*!< Entries written, (producer)                          */
+	uint32_t  tail_cache;                 /*!< Producer copy of tail, read again when ring is full  */
+	uint32_t  tail MQTT_RING_ALIGNED;     /*!< Entries read, (consumer)                             */
+	uint32_t  head_cache;                 /*!< Consumer copy of head, read again when ring is empty */
+	uint8_t  *entries MQTT_RING_ALIGNED;  /*!< Entry storage, owned by user                         */
+	uint32_t  entry_size;                 /*!< Size of one entry                                    */
+	uint32_t  mask;                       /*!< Number of entries - 1                                */
+
+}mqtt_ring_t;
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                              API Functions                                 */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Initializes ring on user storage of entry_size * entry_count bytes.
+ * @param  *ring         : pointer to ring structure (mqtt_ring_t).
+ * @param  *storage      : entry storage
+ * @param  entry_size    : size of one entry
+ * @param  entry_count   : number of entries, power of 2
+ * @retval int8_t        : 1 = Success, -1 = Error
+ */
+int8_t mqtt_ring_init(mqtt_ring_t *ring, void *storage, uint32_t entry_size, uint32_t entry_count);
+
+
+
+/*
+ * @brief  Returns free entry to be written by producer, entry is given to consumer by commit.
+ * @param  *ring   : pointer to ring structure (mqtt_ring_t).
+ * @retval void*   : entry, NULL = ring full
+ */
+void *mqtt_ring_reserve(mqtt_ring_t *ring);
+
+
+
+/*
+ * @brief  Gives entry returned by mqtt_ring_reserve() to consumer, (producer).
+ * @param  *ring   : pointer to ring structure (mqtt_ring_t).
+ * @retval None
+ */
+void mqtt_ring_commit(mqtt_ring_t *ring);
+
+
+
+/*
+ * @brief  Returns oldest entry without removing it, (consumer).
+ * @param  *ring   : pointer to ring structure (mqtt_ring_t).
+ * @retval void*   : entry, NULL = ring empty
+ */
+void *mqtt_ring_peek(mqtt_ring_t *ring);
+
+
+
+/*
+ * @brief  Removes entry returned by mqtt_ring_peek(), entry can be reused by producer, (consumer).
+ * @param  *ring   : pointer to ring structure (mqtt_ring_t).
+ * @retval None
+ */
+void mqtt_ring_release(mqtt_ring_t *ring);
+
+
+
+/*
+ * @brief  Returns number of entries in ring, (exact only for consumer or producer thread).
+ * @param  *ring      : pointer to ring structure (mqtt_ring_t).
+ * @retval uint32_t   : number of entries
+ */
+uint32_t mqtt_ring_count(mqtt_ring_t *ring);
+
+
+
+#endif /* MQTT_RING_H_ */
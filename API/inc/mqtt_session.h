@@ -0,0 +1,331 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_session.h
+ * @author  Aditya Mall,
+ * @brief   MQTT client session engine API Header File
+ *
+ *  Info
+ *          Session engine API Header File
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall, MIT License </center></h2>
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019 Aditya Mall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+#ifndef MQTT_SESSION_H_
+#define MQTT_SESSION_H_
+
+/*
+ * Standard Header and API Header files
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include "mqtt_client.h"
+#include "mqtt_output.h"
+#include "mqtt_timer.h"
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                      Data Structures and Typedefs                          */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* @brief Session connection states */
+typedef enum mqtt_session_states
+{
+	MQTT_SESSION_IDLE       = 0,  /*!< CONNECT not sent                              */
+	MQTT_SESSION_CONNECTING = 1,  /*!< CONNECT sent, waiting for CONNACK             */
+	MQTT_SESSION_CONNECTED  = 2,  /*!< CONNACK accepted                              */
+	MQTT_SESSION_CLOSING    = 3,  /*!< DISCONNECT queued, closed once it is written  */
+	MQTT_SESSION_CLOSED     = 4   /*!< Connection closed, socket can be closed       */
+
+}mqtt_session_state_t;
+
+
+
+/* @brief Session events, given to event callback from mqtt_client_poll() */
+typedef enum mqtt_session_event_types
+{
+	MQTT_SESSION_EVENT_CONNECTED    = 1,  /*!< CONNACK accepted                                        */
+	MQTT_SESSION_EVENT_REFUSED      = 2,  /*!< CONNACK refused, return code is set                     */
+	MQTT_SESSION_EVENT_PUBLISHED    = 3,  /*!< Qos 1, 2 publish acknowledged, message ID is set        */
+	MQTT_SESSION_EVENT_MESSAGE      = 4,  /*!< PUBLISH received, publish view is set                   */
+	MQTT_SESSION_EVENT_SUBSCRIBED   = 5,  /*!< SUBACK received, packet is set for mqtt_suback_parse()  */
+	MQTT_SESSION_EVENT_UNSUBSCRIBED = 6,  /*!< UNSUBACK received, message ID is set                    */
+	MQTT_SESSION_EVENT_PINGRESP     = 7,  /*!< PINGRESP received                                       */
+	MQTT_SESSION_EVENT_CLOSED       = 8,  /*!< Session closed, error is set, (0 = DISCONNECT written)  */
+	MQTT_SESSION_EVENT_COMPLETED    = 9,  /*!< Batch of acknowledged qos 1, 2 publish, IDs are set     */
+	MQTT_SESSION_EVENT_KEEPALIVE    = 10  /*!< Keep alive expired on timer wheel, session must be polled */
+
+}mqtt_session_event_type_t;
+
+
+
+/* @brief Session event, pointers are valid during event callback only */
+typedef struct mqtt_session_event
+{
+	mqtt_session_event_type_t type;          /*!< Event type                                          */
+	uint16_t                  message_id;    /*!< Message ID of acknowledged or received packet       */
+	uint8_t                   return_code;   /*!< CONNACK return code                                 */
+	int                       error;         /*!< errno of closed session, ETIMEDOUT = no PINGRESP    */
+	mqtt_packet_t            *packet;        /*!< Received control packet, (NULL for closed session)  */
+	mqtt_publish_view_t      *publish;       /*!< Received PUBLISH message, (message event only)      */
+	const uint16_t           *message_ids;   /*!< Acknowledged message IDs, (completed event only)    */
+	uint16_t                  message_count; /*!< Number of acknowledged message IDs                  */
+
+}mqtt_session_event_t;
+
+
+
+/* @brief Forward declaration of session structure for callback typedef */
+struct mqtt_session;
+
+
+
+/* @brief Session event callback, called from mqtt_client_poll() */
+typedef void (*mqtt_session_callback_t)(void *context, struct mqtt_session *session, const mqtt_session_event_t *event);
+
+/* @brief Session read function, same as POSIX read(), must not block */
+typedef ssize_t (*mqtt_session_read_t)(int descriptor, void *buffer, size_t length);
+
+
+
+/* @brief MQTT client session, protocol state machine of one connection, storage owned by user */
+typedef struct mqtt_session
+{
+	mqtt_session_state_t     state;             /*!< Connection state                                  */
+	int                      descriptor;        /*!< Socket descriptor                                 */
+	mqtt_session_read_t      read;              /*!< Read function, (NULL = input given with feed)     */
+	mqtt_decoder_t           decoder;           /*!< Input stream decoder                              */
+	mqtt_output_t            output;            /*!< Output buffer                                     */
+	mqtt_inflight_t         *inflight_table;    /*!< In-flight table of qos 1, 2 publish, (optional)   */
+	mqtt_timer_wheel_t      *wheel;             /*!< Timer wheel of keep alive, (optional, shareable)  */
+	mqtt_keepalive_t         keepalive;         /*!< Keep alive timer                                  */
+	uint16_t                 next_message_id;   /*!< Message ID of SUBSCRIBE, UNSUBSCRIBE without table */
+	uint8_t                  ping_due;          /*!< Keep alive expired, PINGREQ is sent by poll       */
+	uint8_t                  ping_sent;         /*!< PINGREQ sent, waiting for PINGRESP                */
+	uint8_t                  pubrel_pending;    /*!< PUBREL did not fit output, queued by next poll    */
+	uint16_t                *completed_ids;     /*!< Batch of acknowledged message IDs, (optional)     */
+	uint16_t                 completed_count;   /*!< Message IDs in batch                              */
+	uint16_t                 completed_size;    /*!< Capacity of batch                                 */
+	uint16_t                 received_ids[SESSION_RECEIVE_SLOTS]; /*!< Qos 2 messages given, waiting for PUBREL */
+	uint16_t                 received_count;    /*!< Message IDs in received set                       */
+	mqtt_session_callback_t  callback;          /*!< Event callback                                    */
+	void                    *context;           /*!< User context passed to event callback             */
+
+}mqtt_session_t;
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                              API Functions                                 */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Initializes session of connected socket, buffers and tables are owned by user.
+ * @param  *session        : pointer to session structure (mqtt_session_t).
+ * @param  descriptor      : connected socket descriptor, (non blocking)
+ * @param  read            : read function, (read() or NULL when input is given with mqtt_session_feed())
+ * @param  write           : write function, (write() or transport write)
+ * @param  *input_buffer   : input stream buffer, limits largest received packet
+ * @param  input_length    : length of input stream buffer
+ * @param  *output_buffer  : output buffer, (OUTPUT_BUFFER_SIZE)
+ * @param  output_length   : length of output buffer
+ * @param  *inflight_table : in-flight table for qos 1, 2 publish, (NULL for qos 0 only)
+ * @param  *wheel          : timer wheel of keep alive, (NULL for no keep alive)
+ * @param  callback        : event callback
+ * @param  *context        : user context passed to event callback
+ * @retval int8_t          : 1 = Success, -1 = Error
+ */
+int8_t mqtt_session_init(mqtt_session_t *session, int descriptor, mqtt_session_read_t read, mqtt_output_write_t write,
+		                 uint8_t *input_buffer, size_t input_length, uint8_t *output_buffer, size_t output_length,
+		                 mqtt_inflight_t *inflight_table, mqtt_timer_wheel_t *wheel, mqtt_session_callback_t callback, void *context);
+
+
+
+/*
+ * @brief  Gives acknowledged qos 1, 2 publish as one completed event per poll instead of a
+ *         published event each, batch is given early when it is full.
+ * @param  *session  : pointer to session structure (mqtt_session_t).
+ * @param  *ids      : message ID storage of batch, (NULL = published event per message)
+ * @param  size      : number of message IDs batch holds
+ * @retval int8_t    : 1 = Success, -1 = Error
+ */
+int8_t mqtt_session_batch(mqtt_session_t *session, uint16_t *ids, uint16_t size);
+
+
+
+/*
+ * @brief  Attaches or detaches in-flight table, tables can be shared by sessions that have
+ *         no qos 1, 2 publish in flight.
+ * @param  *session        : pointer to session structure (mqtt_session_t).
+ * @param  *inflight_table : in-flight table, (NULL = detach, qos 0 only)
+ * @retval int8_t          : 1 = Success, -1 = Error (errno is set, EBUSY = messages in flight)
+ */
+int8_t mqtt_session_inflight(mqtt_session_t *session, mqtt_inflight_t *inflight_table);
+
+
+
+/*
+ * @brief  Queues CONNECT message and starts keep alive.
+ * @param  *session        : pointer to session structure (mqtt_session_t).
+ * @param  *client_name    : client ID
+ * @param  *user_name      : user name, (NULL for none)
+ * @param  *password       : password, (NULL for none)
+ * @param  keep_alive_time : keep alive time in seconds, (0 = disabled)
+ * @param  clean_session   : MQTT_CLEAN_SESSION or 0
+ * @param  now             : current time, from mqtt_timer_now()
+ * @retval int8_t          : 1 = Success, -1 = Error
+ */
+int8_t mqtt_session_connect(mqtt_session_t *session, char *client_name, char *user_name, char *password,
+		                    uint16_t keep_alive_time, uint8_t clean_session, uint32_t now);
+
+
+
+/*
+ * @brief  Queues PUBLISH message, qos 1, 2 messages are completed with published event.
+ * @param  *session        : pointer to session structure (mqtt_session_t).
+ * @param  *topic          : publish topic
+ * @param  *message        : message, (binary safe)
+ * @param  message_length  : length of message
+ * @param  qos             : quality of service value
+ * @param  retain          : MQTT_MESSAGE_RETAIN or MQTT_MESSAGE_NO_RETAIN
+ * @param  now             : current time, from mqtt_timer_now()
+ * @retval int32_t         : message ID, 0 = qos 0 message queued,
+ *                           -1 = Error (errno is set, EAGAIN = send window full or output would block)
+ */
+int32_t mqtt_session_publish(mqtt_session_t *session, char *topic, const void *message, size_t message_length,
+		                     mqtt_qos_t qos, uint8_t retain, uint32_t now);
+
+
+
+/*
+ * @brief  Queues SUBSCRIBE message of topic filter list, completed with subscribed event.
+ *         Message ID is taken from in-flight table, it is not used by a publish until SUBACK.
+ *         Whole packet must fit output buffer, (OUTPUT_BUFFER_SIZE, MANAGER_BLOCK_SIZE on managed session).
+ * @param  *session      : pointer to session structure (mqtt_session_t).
+ * @param  *entries      : topic filter list
+ * @param  entry_count   : number of topic filters
+ * @param  now           : current time, from mqtt_timer_now()
+ * @retval int32_t       : message ID, -1 = Error (errno is set, EAGAIN = send window or output full,
+ *                         EMSGSIZE = packet is larger than output buffer, EINVAL = invalid filter list)
+ */
+int32_t mqtt_session_subscribe(mqtt_session_t *session, mqtt_subscribe_entry_t *entries, size_t entry_count, uint32_t now);
+
+
+
+/*
+ * @brief  Queues UNSUBSCRIBE message of topic filter list, completed with unsubscribed event.
+ *         Message ID is taken from in-flight table, it is not used by a publish until UNSUBACK.
+ *         Whole packet must fit output buffer, (OUTPUT_BUFFER_SIZE, MANAGER_BLOCK_SIZE on managed session).
+ * @param  *session      : pointer to session structure (mqtt_session_t).
+ * @param  **topics      : topic filter list
+ * @param  topic_count   : number of topic filters
+ * @param  now           : current time, from mqtt_timer_now()
+ * @retval int32_t       : message ID, -1 = Error (errno is set, EAGAIN = send window or output full,
+ *                         EMSGSIZE = packet is larger than output buffer, EINVAL = invalid filter list)
+ */
+int32_t mqtt_session_unsubscribe(mqtt_session_t *session, char **topics, size_t topic_count, uint32_t now);
+
+
+
+/*
+ * @brief  Queues DISCONNECT message, session is closed by poll once output is written.
+ * @param  *session  : pointer to session structure (mqtt_session_t).
+ * @param  now       : current time, from mqtt_timer_now()
+ * @retval int8_t    : 1 = Success, -1 = Error
+ */
+int8_t mqtt_session_disconnect(mqtt_session_t *session, uint32_t now);
+
+
+
+/*
+ * @brief  Closes session without DISCONNECT, closed event is given with error.
+ * @param  *session  : pointer to session structure (mqtt_session_t).
+ * @param  error     : errno given with closed event
+ * @retval int8_t    : 1 = Success, -1 = Error
+ */
+int8_t mqtt_session_abort(mqtt_session_t *session, int error);
+
+
+
+/*
+ * @brief  Copies received bytes into session input, (when session has no read function).
+ * @param  *session  : pointer to session structure (mqtt_session_t).
+ * @param  *data     : received bytes
+ * @param  length    : number of bytes
+ * @retval size_t    : number of bytes taken, rest is given again after next poll
+ */
+size_t mqtt_session_feed(mqtt_session_t *session, const void *data, size_t length);
+
+
+
+/*
+ * @brief  Runs session state machine without blocking, received packets are handled and their
+ *         events given to callback, acknowledgments and PINGREQ are queued and output is flushed.
+ * @param  *session  : pointer to session structure (mqtt_session_t).
+ * @param  now       : current time, from mqtt_timer_now()
+ * @param  budget    : most packets handled in this call, (0 = no limit)
+ * @retval int       : number of packets handled, (equal to budget = more input may be pending),
+ *                     -1 = Error
+ */
+int mqtt_client_poll(mqtt_session_t *session, uint32_t now, uint16_t budget);
+
+
+
+/*
+ * @brief  Returns time until session must be polled again, for event loop timeout.
+ * @param  *session  : pointer to session structure (mqtt_session_t).
+ * @param  now       : current time, from mqtt_timer_now()
+ * @retval int       : milliseconds, -1 = no timeout
+ */
+int mqtt_session_next_timeout(mqtt_session_t *session, uint32_t now);
+
+
+
+/*
+ * @brief  Returns event loop events session waits for, write event while output is stalled.
+ * @param  *session  : pointer to session structure (mqtt_session_t).
+ * @retval uint8_t   : MQTT_EVENT_READ with MQTT_EVENT_WRITE when output is stalled
+ */
+uint8_t mqtt_session_events(mqtt_session_t *session);
+
+
+
+#endif /* MQTT_SESSION_H_ */
@@ -0,0 +1,278 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_shard.h
+ * @author  Aditya Mall,
+ * @brief   MQTT client sharded runtime API Header File
+ *
+ *  Info
+ *          Sharded runtime API Header File, (POSIX threads)
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall, MIT License </center></h2>
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019 Aditya Mall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+
+#ifndef MQTT_SHARD_H_
+#define MQTT_SHARD_H_
+
+/*
+ * Standard Header and API Header files
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "mqtt_manager.h"
+#include "mqtt_ring.h"
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                      Data Structures and Typedefs                          */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* @brief Commands submitted to shards */
+typedef enum mqtt_shard_commands
+{
+	MQTT_SHARD_OPEN       = 1,  /*!< Open session of connected socket and send CONNECT  */
+	MQTT_SHARD_PUBLISH    = 2,  /*!< Publish on session                                 */
+	MQTT_SHARD_DISCONNECT = 3   /*!< Send DISCONNECT, session is closed once written    */
+
+}mqtt_shard_command_t;
+
+
+
+/* @brief Ring entry of submitted command, topic and message follow entry up to SHARD_ENTRY_SIZE */
+typedef struct mqtt_shard_entry
+{
+	uint8_t   command;                          /*!< Command, (mqtt_shard_command_t)          */
+	uint8_t   qos;                              /*!< Publish qos                              */
+	uint8_t   retain;                           /*!< Publish retain flag                      */
+	uint16_t  keep_alive_time;                  /*!< Keep alive of opened session, seconds    */
+	uint16_t  topic_length;                     /*!< Length of topic, (NUL follows topic)     */
+	uint16_t  message_length;                   /*!< Length of message, (follows topic NUL)   */
+	int       descriptor;                       /*!< Socket of opened session                 */
+	void     *context;                          /*!< User context of opened session           */
+	char      client_id[CLIENT_ID_LENGTH + 1];  /*!< Client ID, routes command to shard       */
+	uint8_t   data[];                           /*!< Topic and message                        */
+
+}mqtt_shard_entry_t;
+
+
+
+/* @brief Forward declaration of runtime structure for shard */
+struct mqtt_shards;
+
+
+
+/* @brief Session of shard, found by client ID */
+typedef struct mqtt_shard_session
+{
+	char                 client_id[CLIENT_ID_LENGTH + 1];  /*!< Client ID, empty = unused entry           */
+	mqtt_session_t      *session;                          /*!< Session, NULL with client ID = removed    */
+	void                *context;                          /*!< User context passed to event callback     */
+	struct mqtt_shard   *shard;                            /*!< Shard owning session                      */
+	uint16_t             parked_head;                      /*!< First parked command, 0 = none            */
+	uint16_t             parked_tail;                      /*!< Last parked command                       */
+
+}mqtt_shard_session_t;
+
+
+
+/* @brief One shard, thread pinned to one CPU running a connection manager */
+typedef struct mqtt_shard
+{
+	mqtt_manager_t         manager;        /*!< Sessions of shard                                     */
+	struct mqtt_shards    *shards;         /*!< Runtime of shard                                      */
+	mqtt_shard_session_t  *sessions;       /*!< Client ID table, open addressing                      */
+	uint32_t               session_mask;   /*!< Client ID table size - 1                              */
+	uint8_t               *parked;         /*!< Parked commands, (SHARD_PARKED_ENTRIES entries)       */
+	uint16_t              *parked_next;    /*!< Next parked command of session or free list, 0 = none */
+	uint16_t               parked_free;    /*!< First free parked command, (index + 1), 0 = none      */
+	mqtt_shard_session_t **parked_list;    /*!< Sessions with parked commands, retried every pass     */
+	uint16_t               parked_count;   /*!< Sessions on parked list                               */
+	pthread_t              thread;         /*!< Shard thread                                          */
+	mqtt_event_source_t    doorbell;       /*!< eventfd, wakes shard thread sleeping in event loop    */
+	uint32_t               sleeping;       /*!< Shard may sleep, first producer rings doorbell        */
+	uint16_t               index;          /*!< Shard index                                           */
+	int                    producer;       /*!< Producer of shard thread, (hand off to other shards)  */
+	int                    cpu;            /*!< CPU of shard thread, -1 = not pinned                  */
+	uint64_t               executed;       /*!< Commands executed                                     */
+	uint64_t               deferred;       /*!< Commands parked or retried, (session can not send)    */
+	uint64_t               dropped;        /*!< Commands of unknown or closed sessions                */
+
+}mqtt_shard_t;
+
+
+
+/* @brief Submitting thread, one ring to each shard */
+typedef struct mqtt_shard_producer
+{
+	mqtt_ring_t  *rings;    /*!< Rings indexed by shard, NULL = producer not ready  */
+	uint8_t      *storage;  /*!< Ring entries                                       */
+
+}mqtt_shard_producer_t;
+
+
+
+/* @brief Sharded runtime, sessions are assigned to shards by hash of client ID */
+typedef struct mqtt_shards
+{
+	mqtt_shard_t            *shard;                          /*!< Shards                                    */
+	uint16_t                 shard_count;                    /*!< Number of shards                          */
+	mqtt_shard_producer_t    producers[SHARD_MAX_PRODUCERS]; /*!< Producers, written once by registration   */
+	uint32_t                 producer_count;                 /*!< Registered producers                      */
+	mqtt_session_callback_t  callback;                       /*!< Event callback, called on shard threads   */
+	uint16_t                 running;                        /*!< Started shard threads, joined by stop     */
+	uint8_t                  stop;                           /*!< Shard threads exit                        */
+
+}mqtt_shards_t;
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                              API Functions                                 */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Creates shards, each with connection manager and producer for hand off between shards.
+ * @param  *shards       : pointer to runtime structure (mqtt_shards_t).
+ * @param  shard_count   : number of shards, (one per CPU)
+ * @param  slot_count    : most sessions of each shard
+ * @param  block_count   : pooled buffers of each shard
+ * @param  table_count   : pooled in-flight tables of each shard
+ * @param  callback      : event callback, called on shard thread of session
+ * @retval int8_t        : 1 = Success, -1 = Error (errno is set)
+ */
+int8_t mqtt_shard_init(mqtt_shards_t *shards, uint16_t shard_count, uint32_t slot_count, uint32_t block_count,
+		               uint32_t table_count, mqtt_session_callback_t callback);
+
+
+
+/*
+ * @brief  Starts shard threads, shard i is pinned to CPU (first_cpu + i) modulo online CPUs.
+ * @param  *shards     : pointer to runtime structure (mqtt_shards_t).
+ * @param  first_cpu   : CPU of first shard, (-1 = threads are not pinned)
+ * @retval int8_t      : 1 = Success, -1 = Error (errno is set, threads already started are joined)
+ */
+int8_t mqtt_shard_start(mqtt_shards_t *shards, int first_cpu);
+
+
+
+/*
+ * @brief  Registers calling thread as producer, every submitting thread needs its own producer.
+ * @param  *shards   : pointer to runtime structure (mqtt_shards_t).
+ * @retval int       : producer, -1 = Error (errno is set, ENOBUFS = SHARD_MAX_PRODUCERS reached)
+ */
+int mqtt_shard_producer(mqtt_shards_t *shards);
+
+
+
+/*
+ * @brief  Returns shard owning client ID, (FNV-1a hash).
+ * @param  *shards      : pointer to runtime structure (mqtt_shards_t).
+ * @param  *client_id   : client ID
+ * @retval uint16_t     : shard index
+ */
+uint16_t mqtt_shard_route(mqtt_shards_t *shards, const char *client_id);
+
+
+
+/*
+ * @brief  Submits session of connected socket to owning shard, socket is closed by shard.
+ * @param  *shards          : pointer to runtime structure (mqtt_shards_t).
+ * @param  producer         : producer of calling thread
+ * @param  *client_id       : client ID, (CLIENT_ID_LENGTH)
+ * @param  descriptor       : connected socket descriptor, (non blocking)
+ * @param  keep_alive_time  : keep alive time in seconds
+ * @param  *context         : user context passed to event callback
+ * @retval int8_t           : 1 = Success, -1 = Error (errno is set, EAGAIN = ring full)
+ */
+int8_t mqtt_shard_open(mqtt_shards_t *shards, int producer, const char *client_id, int descriptor,
+		               uint16_t keep_alive_time, void *context);
+
+
+
+/*
+ * @brief  Submits publish to shard owning client ID, never blocks. Topic and message are copied.
+ * @param  *shards          : pointer to runtime structure (mqtt_shards_t).
+ * @param  producer         : producer of calling thread
+ * @param  *client_id       : client ID of publishing session
+ * @param  *topic           : publish topic
+ * @param  *message         : message, (binary safe)
+ * @param  message_length   : length of message
+ * @param  qos              : quality of service value
+ * @param  retain           : MQTT_MESSAGE_RETAIN or MQTT_MESSAGE_NO_RETAIN
+ * @retval int8_t           : 1 = Success, -1 = Error (errno is set, EAGAIN = ring full,
+ *                            EMSGSIZE = topic and message do not fit SHARD_ENTRY_SIZE)
+ */
+int8_t mqtt_shard_publish(mqtt_shards_t *shards, int producer, const char *client_id, const char *topic,
+		                  const void *message, size_t message_length, mqtt_qos_t qos, uint8_t retain);
+
+
+
+/*
+ * @brief  Submits DISCONNECT of session to owning shard.
+ * @param  *shards       : pointer to runtime structure (mqtt_shards_t).
+ * @param  producer      : producer of calling thread
+ * @param  *client_id    : client ID of session
+ * @retval int8_t        : 1 = Success, -1 = Error (errno is set, EAGAIN = ring full)
+ */
+int8_t mqtt_shard_disconnect(mqtt_shards_t *shards, int producer, const char *client_id);
+
+
+
+/*
+ * @brief  Stops and joins shard threads, submitted commands not yet executed are dropped.
+ * @param  *shards   : pointer to runtime structure (mqtt_shards_t).
+ * @retval int8_t    : 1 = Success, -1 = Error (doorbell could not be written, threads are still joined)
+ */
+int8_t mqtt_shard_stop(mqtt_shards_t *shards);
+
+
+
+/*
+ * @brief  Closes sessions and releases memory of stopped runtime.
+ * @param  *shards   : pointer to runtime structure (mqtt_shards_t).
+ * @retval int8_t    : 1 = Success, -1 = Error
+ */
+int8_t mqtt_shard_free(mqtt_shards_t *shards);
+
+
+
+#endif /* MQTT_SHARD_H_ */
@@ -0,0 +1,153 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_socket.h
+ * @author  Aditya Mall,
+ * @brief   MQTT client socket options API Header File
+ *
+ *  Info
+ *          Socket tuning API Header File, (Linux TCP options)
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall, MIT License </center></h2>
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019 Aditya Mall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+
+
+#ifndef MQTT_SOCKET_H_
+#define MQTT_SOCKET_H_
+
+/*
+ * Standard Header and API Header files
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include "mqtt_configs.h"
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                      Data Structures and Typedefs                          */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* @brief Option bits of refused options */
+typedef enum mqtt_socket_option_bits
+{
+	MQTT_SOCKET_NO_DELAY         = 0x01,  /*!< TCP_NODELAY              */
+	MQTT_SOCKET_QUICK_ACK        = 0x02,  /*!< TCP_QUICKACK             */
+	MQTT_SOCKET_CORK             = 0x04,  /*!< TCP_CORK                 */
+	MQTT_SOCKET_SEND_BUFFER      = 0x08,  /*!< SO_SNDBUF                */
+	MQTT_SOCKET_RECEIVE_BUFFER   = 0x10,  /*!< SO_RCVBUF                */
+	MQTT_SOCKET_BUSY_POLL        = 0x20,  /*!< SO_BUSY_POLL             */
+	MQTT_SOCKET_BUSY_POLL_BUDGET = 0x40,  /*!< SO_BUSY_POLL_BUDGET      */
+	MQTT_SOCKET_USER_TIMEOUT     = 0x80   /*!< TCP_USER_TIMEOUT         */
+
+}mqtt_socket_option_t;
+
+
+
+/* @brief Socket options of connection, -1 = kernel default is kept */
+typedef struct mqtt_socket_options
+{
+	int8_t   no_delay;          /*!< 1 = segments are sent without Nagle delay                          */
+	int8_t   quick_ack;         /*!< 1 = ACKs are not delayed, (kept by mqtt_socket_read_quickack())     */
+	int8_t   cork;              /*!< 1 = only full segments are sent, output pushes rest at each flush   */
+	int32_t  send_buffer;       /*!< Socket send buffer, bytes                                          */
+	int32_t  receive_buffer;    /*!< Socket receive buffer, bytes, (set before connect for window scale) */
+	int32_t  busy_poll;         /*!< Time blocking reads spin on device queue, microseconds              */
+	int32_t  busy_poll_budget;  /*!< Packets handled per busy poll                                      */
+	int32_t  user_timeout;      /*!< Time unacknowledged data may wait before connection is dropped, ms */
+	int32_t  flush_deadline;    /*!< Output flush deadline, microseconds, (applied by user to output)    */
+	uint8_t  failed;            /*!< Options refused by kernel, (mqtt_socket_option_t bits)             */
+
+}mqtt_socket_options_t;
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                              API Functions                                 */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Sets all options to kernel default.
+ * @param  *options  : pointer to socket options structure (mqtt_socket_options_t).
+ * @retval int8_t    : 1 = Success, -1 = Error
+ */
+int8_t mqtt_socket_options_init(mqtt_socket_options_t *options);
+
+
+
+/*
+ * @brief  Fills options that are not set with named profile, options set before take precedence.
+ *         "low-latency"  : TCP_NODELAY, TCP_QUICKACK, busy poll SOCKET_BUSY_POLL_US, no flush deadline
+ *         "throughput"   : SOCKET_BULK_BUFFER socket buffers, TCP_CORK, flush deadline SOCKET_BULK_DEADLINE
+ *         "default"      : kernel defaults
+ * @param  *options  : pointer to socket options structure (mqtt_socket_options_t).
+ * @param  *profile  : profile name
+ * @retval int8_t    : 1 = Success, -1 = Error (errno is set, EINVAL = unknown profile)
+ */
+int8_t mqtt_socket_profile(mqtt_socket_options_t *options, const char *profile);
+
+
+
+/*
+ * @brief  Applies options to socket, call before connect. TCP options are skipped on other sockets.
+ *         Every option is tried, refused options are marked in options->failed.
+ * @param  descriptor  : socket descriptor
+ * @param  *options    : pointer to socket options structure (mqtt_socket_options_t).
+ * @retval int8_t      : 1 = Success, -1 = Error (errno of first refused option is set,
+ *                       EPERM = busy poll above net.core.busy_poll needs CAP_NET_ADMIN)
+ */
+int8_t mqtt_socket_apply(int descriptor, mqtt_socket_options_t *options);
+
+
+
+/*
+ * @brief  Reads socket and sets TCP_QUICKACK again, kernel clears it once it changes ACK mode.
+ *         Same as POSIX read(), can replace read of session or transport.
+ * @param  descriptor  : socket descriptor
+ * @param  *buffer     : read buffer
+ * @param  length      : size of read buffer
+ * @retval ssize_t     : bytes read, 0 = connection closed, -1 = Error (errno is set)
+ */
+ssize_t mqtt_socket_read_quickack(int descriptor, void *buffer, size_t length);
+
+
+
+#endif /* MQTT_SOCKET_H_ */
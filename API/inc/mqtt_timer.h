@@ -0,0 +1,276 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_timer.h
+ * @author  Aditya Mall,
+ * @brief   MQTT client timer wheel API Header File
+ *
+ *  Info
+ *          Timer API Header File, (POSIX CLOCK_MONOTONIC)
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall, MIT License </center></h2>
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019 Aditya Mall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+#ifndef MQTT_TIMER_H_
+#define MQTT_TIMER_H_
+
+/*
+ * Standard Header and API Header files
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include "mqtt_configs.h"
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                            Macro Defines                                   */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* @brief Defines for timer wheel, 1 millisecond tick */
+#define MQTT_TIMER_LEVELS      TIMER_WHEEL_LEVELS                                 /*!< Number of wheel levels, mqtt_configs.h    */
+#define MQTT_TIMER_SLOT_BITS   6                                                  /*!< Slot index bits of each level             */
+#define MQTT_TIMER_SLOTS       (1U << MQTT_TIMER_SLOT_BITS)                       /*!< Number of slots of each level             */
+#define MQTT_TIMER_SLOT_MASK   (MQTT_TIMER_SLOTS - 1)                             /*!< Mask for slot index                       */
+#define MQTT_TIMER_RANGE       (1UL << (MQTT_TIMER_SLOT_BITS * MQTT_TIMER_LEVELS)) /*!< Longest timeout placed directly, (ms)     */
+
+#if MQTT_TIMER_LEVELS < 1 || MQTT_TIMER_LEVELS > 5
+#error "TIMER_WHEEL_LEVELS must be between 1 and 5"
+#endif
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                      Data Structures and Typedefs                          */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* @brief Forward declaration of timer structure for callback typedef */
+struct mqtt_timer;
+
+
+
+/* @brief Timer expiry callback, called from mqtt_timer_advance(), timer can be started again */
+typedef void (*mqtt_timer_callback_t)(struct mqtt_timer *timer, void *context, uint32_t now);
+
+
+
+/* @brief Timer structure, storage owned by user and must stay valid while pending */
+typedef struct mqtt_timer
+{
+	struct mqtt_timer      *next;      /*!< Next timer of wheel slot                      */
+	struct mqtt_timer     **link;      /*!< Pointer to previous next pointer, NULL = idle */
+	uint32_t                expires;   /*!< Expiry time, monotonic milliseconds           */
+	uint8_t                 level;     /*!< Wheel level of timer                          */
+	mqtt_timer_callback_t   callback;  /*!< Called on expiry                              */
+	void                   *context;   /*!< User context passed to callback               */
+
+}mqtt_timer_t;
+
+
+
+/* @brief Hierarchical timer wheel, any number of timers of any number of clients */
+typedef struct mqtt_timer_wheel
+{
+	mqtt_timer_t *slot[MQTT_TIMER_LEVELS][MQTT_TIMER_SLOTS];  /*!< Timer lists of each level and slot */
+	uint32_t      level_count[MQTT_TIMER_LEVELS];             /*!< Pending timers of each level       */
+	uint32_t      count;                                      /*!< Pending timers of wheel            */
+	uint32_t      time;                                       /*!< Next tick to be processed          */
+
+}mqtt_timer_wheel_t;
+
+
+
+/* @brief Keep alive of one client, PINGREQ is sent only when no other message was sent for interval */
+typedef struct mqtt_keepalive
+{
+	mqtt_timer_t           timer;          /*!< Keep alive timer                          */
+	mqtt_timer_wheel_t    *wheel;          /*!< Timer wheel of keep alive timer           */
+	uint32_t               interval;       /*!< Keep alive interval, milliseconds         */
+	uint32_t               last_sent;      /*!< Time of last message sent to broker       */
+	uint32_t               suppressed;     /*!< Number of PINGREQ skipped due to traffic  */
+	mqtt_timer_callback_t  ping_callback;  /*!< Called when PINGREQ is to be sent         */
+	void                  *context;        /*!< User context passed to ping callback      */
+
+}mqtt_keepalive_t;
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                              API Functions                                 */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Returns monotonic time, (CLOCK_MONOTONIC, wall time unaffected by clock changes).
+ * @param  None
+ * @retval uint32_t : time in milliseconds, wraps every 49 days
+ */
+uint32_t mqtt_timer_now(void);
+
+
+
+/*
+ * @brief  Returns monotonic time with microsecond resolution, (CLOCK_MONOTONIC).
+ * @param  None
+ * @retval uint64_t : time in microseconds
+ */
+uint64_t mqtt_timer_now_us(void);
+
+
+
+/*
+ * @brief  Initializes timer wheel.
+ * @param  *wheel : pointer to timer wheel structure (mqtt_timer_wheel_t).
+ * @param  now    : current time, from mqtt_timer_now()
+ * @retval int8_t : 1 = Success, -1 = Error
+ */
+int8_t mqtt_timer_wheel_init(mqtt_timer_wheel_t *wheel, uint32_t now);
+
+
+
+/*
+ * @brief  Initializes timer, timer is idle.
+ * @param  *timer    : pointer to timer structure (mqtt_timer_t).
+ * @param  callback  : called on expiry
+ * @param  *context  : user context passed to callback
+ * @retval int8_t    : 1 = Success, -1 = Error
+ */
+int8_t mqtt_timer_init(mqtt_timer_t *timer, mqtt_timer_callback_t callback, void *context);
+
+
+
+/*
+ * @brief  Starts timer, pending timer is moved to new expiry time, O(1).
+ * @param  *wheel   : pointer to timer wheel structure (mqtt_timer_wheel_t).
+ * @param  *timer   : pointer to timer structure (mqtt_timer_t).
+ * @param  expires  : expiry time, monotonic milliseconds, (time in past expires on next advance)
+ * @retval int8_t   : 1 = Success, -1 = Error
+ */
+int8_t mqtt_timer_start(mqtt_timer_wheel_t *wheel, mqtt_timer_t *timer, uint32_t expires);
+
+
+
+/*
+ * @brief  Stops timer, idle timer is ignored, O(1).
+ * @param  *wheel  : pointer to timer wheel structure (mqtt_timer_wheel_t).
+ * @param  *timer  : pointer to timer structure (mqtt_timer_t).
+ * @retval int8_t  : 1 = Success, -1 = Error
+ */
+int8_t mqtt_timer_stop(mqtt_timer_wheel_t *wheel, mqtt_timer_t *timer);
+
+
+
+/*
+ * @brief  Checks if timer is pending.
+ * @param  *timer  : pointer to timer structure (mqtt_timer_t).
+ * @retval int8_t  : 1 = pending, 0 = idle
+ */
+int8_t mqtt_timer_pending(mqtt_timer_t *timer);
+
+
+
+/*
+ * @brief  Runs callbacks of all timers expired up to now, idle time between timers is skipped.
+ * @param  *wheel   : pointer to timer wheel structure (mqtt_timer_wheel_t).
+ * @param  now      : current time, from mqtt_timer_now()
+ * @retval uint32_t : number of expired timers
+ */
+uint32_t mqtt_timer_advance(mqtt_timer_wheel_t *wheel, uint32_t now);
+
+
+
+/*
+ * @brief  Returns time until wheel needs next advance, timeout for mqtt_event_loop_run().
+ * @param  *wheel  : pointer to timer wheel structure (mqtt_timer_wheel_t).
+ * @param  now     : current time, from mqtt_timer_now()
+ * @retval int     : milliseconds to next advance, -1 = no timer pending, (wait forever)
+ */
+int mqtt_timer_next_timeout(mqtt_timer_wheel_t *wheel, uint32_t now);
+
+
+
+/*
+ * @brief  Returns exponential backoff delay of reconnect attempt, base * 2^attempt up to maximum.
+ * @param  attempt   : number of failed attempts
+ * @param  base_ms   : delay of first attempt, milliseconds
+ * @param  max_ms    : maximum delay, milliseconds
+ * @retval uint32_t  : delay in milliseconds
+ */
+uint32_t mqtt_timer_backoff(uint8_t attempt, uint32_t base_ms, uint32_t max_ms);
+
+
+
+/*
+ * @brief  Starts keep alive of client, ping callback is called when interval passes without
+ *         any message sent, (PINGREQ is not sent on busy connections).
+ * @param  *wheel          : pointer to timer wheel structure (mqtt_timer_wheel_t).
+ * @param  *keepalive      : pointer to keep alive structure (mqtt_keepalive_t).
+ * @param  interval_ms     : keep alive interval in milliseconds, (0 = keep alive disabled)
+ * @param  now             : current time, from mqtt_timer_now()
+ * @param  ping_callback   : called when PINGREQ is to be sent
+ * @param  *context        : user context passed to ping callback
+ * @retval int8_t          : 1 = Success, -1 = Error
+ */
+int8_t mqtt_keepalive_start(mqtt_timer_wheel_t *wheel, mqtt_keepalive_t *keepalive, uint32_t interval_ms,
+		                    uint32_t now, mqtt_timer_callback_t ping_callback, void *context);
+
+
+
+/*
+ * @brief  Records message sent to broker, only updates time stamp, timer is not moved.
+ * @param  *keepalive  : pointer to keep alive structure (mqtt_keepalive_t).
+ * @param  now         : current time, from mqtt_timer_now()
+ * @retval None
+ */
+void mqtt_keepalive_sent(mqtt_keepalive_t *keepalive, uint32_t now);
+
+
+
+/*
+ * @brief  Stops keep alive of client.
+ * @param  *keepalive  : pointer to keep alive structure (mqtt_keepalive_t).
+ * @retval int8_t      : 1 = Success, -1 = Error
+ */
+int8_t mqtt_keepalive_stop(mqtt_keepalive_t *keepalive);
+
+
+
+#endif /* MQTT_TIMER_H_ */
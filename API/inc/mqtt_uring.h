@@ -0,0 +1,258 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_uring.h
+ * @author  Aditya Mall,
+ * @brief   MQTT client io_uring transport API Header File
+ *
+ *  Info
+ *          io_uring API Header File, (Linux 6.0 or later, no liburing)
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall, MIT License </center></h2>
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019 Aditya Mall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+#ifndef MQTT_URING_H_
+#define MQTT_URING_H_
+
+/*
+ * Standard Header and API Header files
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <linux/io_uring.h>
+#include "mqtt_client.h"
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                            Macro Defines                                   */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* @brief Defines for io_uring transport */
+#define MQTT_URING_BUFFER_GROUP   0                          /*!< Buffer group ID of receive buffer ring           */
+#define MQTT_URING_NO_BUFFER      0xFFFF                     /*!< Buffer ID of completion without receive buffer    */
+
+#if (URING_BUFFER_COUNT & (URING_BUFFER_COUNT - 1)) || URING_BUFFER_COUNT > 32768
+#error "URING_BUFFER_COUNT must be a power of 2, not more than 32768"
+#endif
+
+#if URING_MAX_FILES % 64
+#error "URING_MAX_FILES must be a multiple of 64"
+#endif
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                      Data Structures and Typedefs                          */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* @brief io_uring instance, submission and completion rings are shared with kernel */
+typedef struct mqtt_uring
+{
+	int                      ring_fd;         /*!< io_uring file descriptor                              */
+
+	/* Submission queue */
+	uint32_t                *sq_head;         /*!< Kernel consumed head                                  */
+	uint32_t                *sq_tail;         /*!< Shared tail, written on submit                        */
+	uint32_t                *sq_array;        /*!< Index array of submission queue                       */
+	struct io_uring_sqe     *sqes;            /*!< Submission queue entries                              */
+	uint32_t                 sq_mask;         /*!< Submission queue index mask                           */
+	uint32_t                 sq_entries;      /*!< Submission queue size                                 */
+	uint32_t                 sq_local_tail;   /*!< Tail of queued entries, not yet visible to kernel     */
+
+	/* Completion queue */
+	uint32_t                *cq_head;         /*!< Shared head, written after completion is read         */
+	uint32_t                *cq_tail;         /*!< Kernel produced tail                                  */
+	struct io_uring_cqe     *cqes;            /*!< Completion queue entries                              */
+	uint32_t                 cq_mask;         /*!< Completion queue index mask                           */
+
+	/* Provided receive buffers */
+	struct io_uring_buf_ring *buffer_ring;    /*!< Buffer ring shared with kernel                        */
+	uint8_t                  *buffers;        /*!< URING_BUFFER_COUNT buffers of URING_BUFFER_SIZE       */
+	uint16_t                  buffer_tail;    /*!< Tail of buffer ring                                   */
+
+	/* Mappings, released on close */
+	void                    *ring_memory;     /*!< Submission and completion ring mapping                */
+	size_t                   ring_size;       /*!< Size of ring mapping                                  */
+	size_t                   sqes_size;       /*!< Size of submission queue entry mapping                */
+	size_t                   buffer_size;     /*!< Size of buffer ring and buffers mapping               */
+
+	/* Registered files */
+	uint64_t                 file_map[URING_MAX_FILES / 64];  /*!< Used fixed file indexes, one bit each */
+	uint32_t                 file_count;      /*!< Registered files                                      */
+
+	/* Statistics */
+	uint64_t                 enter_calls;     /*!< Number of io_uring_enter system calls                 */
+	uint64_t                 submitted;       /*!< Number of submitted entries                           */
+	uint64_t                 completed;       /*!< Number of reaped completions                          */
+
+}mqtt_uring_t;
+
+
+
+/* @brief Completion of queued operation */
+typedef struct mqtt_uring_completion
+{
+	uint64_t  user_data;  /*!< User data of operation                                           */
+	int32_t   result;     /*!< Bytes transferred, or negative errno                             */
+	uint8_t   more;       /*!< 1 = multishot receive stays armed, 0 = operation finished        */
+	uint16_t  buffer_id;  /*!< Receive buffer ID, MQTT_URING_NO_BUFFER if none                  */
+	uint8_t  *buffer;     /*!< Received data, valid until mqtt_uring_buffer_release()           */
+
+}mqtt_uring_completion_t;
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                              API Functions                                 */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Creates io_uring with provided receive buffer ring and sparse registered file table.
+ * @param  *ring   : pointer to io_uring structure (mqtt_uring_t).
+ * @retval int8_t  : 1 = Success, -1 = Error (errno is set)
+ */
+int8_t mqtt_uring_init(mqtt_uring_t *ring);
+
+
+
+/*
+ * @brief  Registers socket in fixed file table, operations use index instead of descriptor.
+ * @param  *ring   : pointer to io_uring structure (mqtt_uring_t).
+ * @param  fd      : socket file descriptor
+ * @retval int     : fixed file index, -1 = Error
+ */
+int mqtt_uring_register_fd(mqtt_uring_t *ring, int fd);
+
+
+
+/*
+ * @brief  Removes socket from fixed file table, descriptor is not closed.
+ * @param  *ring        : pointer to io_uring structure (mqtt_uring_t).
+ * @param  file_index   : fixed file index from mqtt_uring_register_fd()
+ * @retval int8_t       : 1 = Success, -1 = Error
+ */
+int8_t mqtt_uring_unregister_fd(mqtt_uring_t *ring, int file_index);
+
+
+
+/*
+ * @brief  Queues multishot receive, each arriving chunk completes into a provided buffer
+ *         without submitting again, (re-queue when completion has more = 0).
+ * @param  *ring        : pointer to io_uring structure (mqtt_uring_t).
+ * @param  file_index   : fixed file index
+ * @param  user_data    : returned with each completion
+ * @retval int8_t       : 1 = Success, -1 = Submission queue full
+ */
+int8_t mqtt_uring_recv(mqtt_uring_t *ring, int file_index, uint64_t user_data);
+
+
+
+/*
+ * @brief  Queues send of buffer, buffer must stay valid until completion.
+ * @param  *ring        : pointer to io_uring structure (mqtt_uring_t).
+ * @param  file_index   : fixed file index
+ * @param  *buffer      : data to send
+ * @param  length       : length of data
+ * @param  user_data    : returned with completion
+ * @retval int8_t       : 1 = Success, -1 = Submission queue full
+ */
+int8_t mqtt_uring_send(mqtt_uring_t *ring, int file_index, const void *buffer, size_t length, uint64_t user_data);
+
+
+
+/*
+ * @brief  Queues scatter-gather write, (e.g. PUBLISH burst from mqtt_publish_iov() or mqtt_publish_batch_iov()),
+ *         vector array and buffers must stay valid until completion.
+ * @param  *ring        : pointer to io_uring structure (mqtt_uring_t).
+ * @param  file_index   : fixed file index
+ * @param  *vector      : IO vector array
+ * @param  count        : number of IO vectors
+ * @param  user_data    : returned with completion
+ * @retval int8_t       : 1 = Success, -1 = Submission queue full
+ */
+int8_t mqtt_uring_writev(mqtt_uring_t *ring, int file_index, const mqtt_iovec_t *vector, int count, uint64_t user_data);
+
+
+
+/*
+ * @brief  Submits all queued operations and optionally waits for completions, one system call
+ *         for any number of operations and connections.
+ * @param  *ring        : pointer to io_uring structure (mqtt_uring_t).
+ * @param  wait_count   : completions to wait for, (0 = do not wait)
+ * @param  timeout_ms   : wait timeout in milliseconds, (-1 = wait forever)
+ * @retval int          : number of submitted operations, -1 = Error (errno is set, ETIME on time out)
+ */
+int mqtt_uring_submit(mqtt_uring_t *ring, uint32_t wait_count, int timeout_ms);
+
+
+
+/*
+ * @brief  Reads next completion from completion queue, no system call.
+ * @param  *ring        : pointer to io_uring structure (mqtt_uring_t).
+ * @param  *completion  : pointer to completion structure (mqtt_uring_completion_t).
+ * @retval int8_t       : 1 = completion read, 0 = completion queue empty, -1 = Error
+ */
+int8_t mqtt_uring_complete(mqtt_uring_t *ring, mqtt_uring_completion_t *completion);
+
+
+
+/*
+ * @brief  Returns receive buffer to buffer ring once its data is consumed.
+ * @param  *ring        : pointer to io_uring structure (mqtt_uring_t).
+ * @param  buffer_id    : buffer ID of receive completion
+ * @retval int8_t       : 1 = Success, -1 = Error
+ */
+int8_t mqtt_uring_buffer_release(mqtt_uring_t *ring, uint16_t buffer_id);
+
+
+
+/*
+ * @brief  Closes io_uring and releases its mappings, registered descriptors are not closed.
+ * @param  *ring   : pointer to io_uring structure (mqtt_uring_t).
+ * @retval int8_t  : 1 = Success, -1 = Error
+ */
+int8_t mqtt_uring_close(mqtt_uring_t *ring);
+
+
+
+#endif /* MQTT_URING_H_ */
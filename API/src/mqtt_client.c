@@ -92,35 +92,254 @@ typedef enum function_return_codes
 
 
 
+/* @brief Reserved flags of fixed header byte for each message type, PUBLISH flags are set by caller */
+static const uint8_t mqtt_fixed_header_flags[16] =
+{
+	[MQTT_PUBREL_MESSAGE]      = MQTT_QOS_ATLEAST_ONCE << MQTT_HEADER_QOS_SHIFT,
+	[MQTT_SUBSCRIBE_MESSAGE]   = MQTT_QOS_ATLEAST_ONCE << MQTT_HEADER_QOS_SHIFT,
+	[MQTT_UNSUBSCRIBE_MESSAGE] = MQTT_QOS_ATLEAST_ONCE << MQTT_HEADER_QOS_SHIFT,
+};
+
+
+
 /*
- * @brief  static function to convert to network byte order for mqtt packets
+ * @brief  static function to write 16 bit value in network byte order, (any alignment and host byte order)
+ * @param  *buffer  : pointer to 2 byte field
  * @param  value    : value in host byte order format
- * @retval uint16_t : value network byte order format
+ * @retval None
  */
-static uint16_t mqtt_htons(uint16_t value)
+static void mqtt_put_u16(void *buffer, uint16_t value)
 {
-	value  = ((value & 0xFF00) >> 8) + ((value & 0x00FF) << 8);
+	uint8_t *field = buffer;
 
-	return value;
+	field[0] = (uint8_t)(value >> 8);
+	field[1] = (uint8_t)(value & 0xFF);
 }
 
 
 
 /*
- * @brief  static function to convert from network byte order to host for mqtt packets
- * @param  value    : value in network byte order format
+ * @brief  static function to read 16 bit value in network byte order, (any alignment and host byte order)
+ * @param  *buffer  : pointer to 2 byte field
  * @retval uint16_t : value host byte order format
  */
-static uint16_t mqtt_ntohs(uint16_t value)
+static uint16_t mqtt_get_u16(const void *buffer)
+{
+	const uint8_t *field = buffer;
+
+	return (uint16_t)((field[0] << 8) | field[1]);
+}
+
+
+
+/*
+ * @brief  Returns first byte of fixed header, reserved flags of message type are taken from table.
+ * @param  message_type   : MQTT control packet type
+ * @param  message_qos    : Quality of service value, (PUBLISH only)
+ * @param  message_retain : Enable retain for message retention at broker, (PUBLISH only)
+ * @retval uint8_t        : fixed header byte, fail = 0
+ */
+uint8_t mqtt_fixed_header_byte(uint8_t message_type, mqtt_qos_t message_qos, uint8_t message_retain)
+{
+	uint8_t control = 0;
+
+	if(message_type == 0 || message_type > MQTT_DISCONNECT_MESSAGE)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	control = (uint8_t)((message_type << MQTT_HEADER_TYPE_SHIFT) | mqtt_fixed_header_flags[message_type]);
+
+	if(message_type == MQTT_PUBLISH_MESSAGE)
+	{
+		control |= (uint8_t)((message_qos << MQTT_HEADER_QOS_SHIFT) & MQTT_HEADER_QOS_MASK);
+
+		if(message_retain)
+		{
+			control |= MQTT_HEADER_RETAIN_FLAG;
+		}
+	}
+
+	return control;
+}
+
+
+
+/*
+ * @brief  Encodes Remaining Length field of fixed header (1 to 4 bytes).
+ * @param  *buffer          : pointer to the buffer, (minimum MQTT_REMAINING_LENGTH_MAX_SIZE bytes)
+ * @param  remaining_length : length of variable header and payload
+ * @retval uint8_t          : number of bytes encoded, fail = 0
+ */
+uint8_t mqtt_encode_remaining_length(uint8_t *buffer, uint32_t remaining_length)
+{
+	uint8_t encoded_byte = 0;
+	uint8_t length_size  = 0;
+
+	if(buffer == NULL || remaining_length > MQTT_MAX_REMAINING_LENGTH)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	/* 7 bits of length per byte, MSB set if more bytes follow */
+	do
+	{
+		encoded_byte      = remaining_length % 128;
+		remaining_length  = remaining_length / 128;
+
+		if(remaining_length > 0)
+		{
+			encoded_byte |= 0x80;
+		}
+
+		buffer[length_size++] = encoded_byte;
+
+	}while(remaining_length > 0);
+
+	return length_size;
+}
+
+
+
+/*
+ * @brief  Decodes Remaining Length field of fixed header.
+ * @param  *buffer           : pointer to the first byte of Remaining Length field
+ * @param  buffer_length     : number of bytes available in buffer
+ * @param  *remaining_length : pointer to decoded Remaining Length value
+ * @retval int8_t            : number of bytes decoded, 0 = incomplete field, -1 = malformed field
+ */
+int8_t mqtt_decode_remaining_length(const uint8_t *buffer, size_t buffer_length, uint32_t *remaining_length)
+{
+	uint32_t multiplier  = 1;
+	uint32_t value       = 0;
+	uint8_t  length_size = 0;
+
+	if(buffer == NULL || remaining_length == NULL)
+	{
+		return FUNC_OPTS_ERROR;
+	}
+
+	do
+	{
+		/* Field continues past the available bytes */
+		if(length_size == buffer_length)
+		{
+			return MAIN_FUNC_ERROR;
+		}
+
+		/* Field longer than 4 bytes is malformed */
+		if(length_size == MQTT_REMAINING_LENGTH_MAX_SIZE)
+		{
+			return FUNC_OPTS_ERROR;
+		}
+
+		value      += (buffer[length_size] & 0x7F) * multiplier;
+		multiplier *= 128;
+
+	}while(buffer[length_size++] & 0x80);
+
+	*remaining_length = value;
+
+	return length_size;
+}
+
+
+
+/*
+ * @brief  Returns number of bytes needed to encode Remaining Length field.
+ * @param  remaining_length : length of variable header and payload
+ * @retval uint8_t          : size of Remaining Length field, fail = 0
+ */
+uint8_t mqtt_remaining_length_size(uint32_t remaining_length)
+{
+	uint8_t length_size = 0;
+
+	if(remaining_length < 128)
+		length_size = 1;
+
+	else if(remaining_length < 16384)
+		length_size = 2;
+
+	else if(remaining_length < 2097152)
+		length_size = 3;
+
+	else if(remaining_length <= MQTT_MAX_REMAINING_LENGTH)
+		length_size = 4;
+
+	return length_size;
+}
+
+
+
+/*
+ * @brief  static function to increment message ID, message ID 0 is skipped on wrap around
+ * @param  *message_id : pointer to the message id variable
+ * @retval uint16_t    : next message ID
+ */
+static uint16_t mqtt_next_message_id(uint16_t *message_id)
+{
+	*message_id = *message_id + 1;
+
+	if(*message_id == 0)
+	{
+		*message_id = 1;
+	}
+
+	return *message_id;
+}
+
+
+
+/*
+ * @brief  static function to write the Remaining Length of a control packet built in place,
+ *         variable header and payload are moved up when the field needs more than one byte.
+ * @param  *fixed_header    : pointer to fixed header at the start of control packet
+ * @param  remaining_length : length of variable header and payload
+ * @retval size_t           : length of control packet
+ */
+static size_t mqtt_set_remaining_length(mqtt_header_t *fixed_header, uint32_t remaining_length)
 {
-	value  = ((value & 0xFF00) >> 8) + ((value & 0x00FF) << 8);
+	uint8_t  length_field[MQTT_REMAINING_LENGTH_MAX_SIZE];
+	uint8_t  length_size = 0;
+	uint8_t *packet      = (uint8_t*)fixed_header;
+
+	length_size = mqtt_encode_remaining_length(length_field, remaining_length);
 
-	return value;
+	if(length_size > 1)
+	{
+		memmove(packet + 1 + length_size, packet + FIXED_HEADER_LENGTH, remaining_length);
+	}
+
+	memcpy(packet + 1, length_field, length_size);
+
+	return (size_t)(1 + length_size + remaining_length);
 }
 
 
 
 
+/*
+ * @brief  Initializes mqtt client structure, must be called before other client functions.
+ * @param  *client         : pointer to mqtt client structure (mqtt_client_t).
+ * @param  *inflight_table : pointer to in-flight table for message IDs of qos > 0 publish, (NULL for none)
+ * @retval int8_t          : 1 = Success, -1 = Error
+ */
+int8_t mqtt_client_init(mqtt_client_t *client, mqtt_inflight_t *inflight_table)
+{
+	if(client == NULL)
+	{
+		return FUNC_OPTS_ERROR;
+	}
+
+	memset(client, 0, sizeof(mqtt_client_t));
+
+	client->inflight_table = inflight_table;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
 /*
  * @brief  Configures mqtt client user name and password.
  * @param  *client   : pointer to mqtt client structure (mqtt_client_t).
@@ -131,33 +350,34 @@ static uint16_t mqtt_ntohs(uint16_t value)
 int8_t mqtt_client_username_passwd(mqtt_client_t *client, char *user_name, char *password)
 {
 
-	uint8_t user_name_length = 0;
-	uint8_t password_length  = 0;
-	int8_t  func_retval      = 0;
-
-	user_name_length = strlen(user_name);
-	password_length  = strlen(password);
+	size_t user_name_length = 0;
+	size_t password_length  = 0;
+	int8_t func_retval      = 0;
 
 	/* check if user name is not null */
 	if( client == NULL || user_name == NULL  || password == NULL)
 	{
-		func_retval = FUNC_OPTS_ERROR;
+		return FUNC_OPTS_ERROR;
 	}
+
+	user_name_length = strlen(user_name);
+	password_length  = strlen(password);
+
 	/* check if user name and password doesn't exceed defined length, if yes return 0 */
-	else if( user_name_length > USER_NAME_LENGTH || password_length > PASSWORD_LENGTH)
+	if( user_name_length > USER_NAME_LENGTH || password_length > PASSWORD_LENGTH)
 	{
-		return FUNC_OPTS_ERROR;
+		func_retval = FUNC_OPTS_ERROR;
 	}
 	else
 	{
-		client->connect_msg->connect_flags.user_name_flag = ENABLE;
-		client->connect_msg->connect_flags.password_flag  = ENABLE;
+		client->connect_msg->connect_flags |= MQTT_CONNECT_FLAG_USER_NAME | MQTT_CONNECT_FLAG_PASSWORD;
 
-		client->connect_msg->payload_options.user_name_length = mqtt_htons(user_name_length);
-		strcpy(client->connect_msg->payload_options.user_name, user_name);
+		/* Lengths are kept with the fields, connect message copies them without scanning */
+		mqtt_put_u16(&client->connect_msg->payload_options.user_name_length, (uint16_t)user_name_length);
+		memcpy(client->connect_msg->payload_options.user_name, user_name, user_name_length);
 
-		client->connect_msg->payload_options.password_length  = mqtt_htons(password_length);
-		strcpy(client->connect_msg->payload_options.password, password);
+		mqtt_put_u16(&client->connect_msg->payload_options.password_length, (uint16_t)password_length);
+		memcpy(client->connect_msg->payload_options.password, password, password_length);
 
 		func_retval = FUNC_OPTS_SUCCESS;
 	}
@@ -186,20 +406,19 @@ int8_t mqtt_connect_options(mqtt_client_t *client, uint8_t session, uint8_t reta
 	}
 	else
 	{
-		client->connect_msg->connect_flags.clean_session = session;
+		/* Keep user name and password flags, will flag is not enabled (will topic not supported) */
+		client->connect_msg->connect_flags &= (MQTT_CONNECT_FLAG_USER_NAME | MQTT_CONNECT_FLAG_PASSWORD);
 
-		/* Enable will flag and if qos and retain are enabled by user */
-		if(message_qos || retain)
+		if(session)
 		{
-			client->connect_msg->connect_flags.will_qos    = message_qos;
-			client->connect_msg->connect_flags.will_retain = retain;
-			client->connect_msg->connect_flags.will_flag   = DISABLE;
+			client->connect_msg->connect_flags |= MQTT_CONNECT_FLAG_CLEAN_SESSION;
 		}
-		else
+
+		client->connect_msg->connect_flags |= (uint8_t)((message_qos << MQTT_CONNECT_WILL_QOS_SHIFT) & MQTT_CONNECT_WILL_QOS_MASK);
+
+		if(retain)
 		{
-			client->connect_msg->connect_flags.will_qos    = message_qos;
-			client->connect_msg->connect_flags.will_retain = retain;
-			client->connect_msg->connect_flags.will_flag   = DISABLE;
+			client->connect_msg->connect_flags |= MQTT_CONNECT_FLAG_WILL_RETAIN;
 		}
 
 		func_retval = message_qos;
@@ -219,11 +438,11 @@ int8_t mqtt_connect_options(mqtt_client_t *client, uint8_t session, uint8_t reta
  */
 size_t mqtt_connect(mqtt_client_t *client, char *client_name, int16_t keep_alive_time)
 {
-	size_t  message_length     = 0;
-	uint8_t client_name_length = 0;
-	uint8_t user_name_length   = 0;
-	uint8_t password_length    = 0;
-	uint8_t payload_index      = 0;
+	size_t   message_length     = 0;
+	size_t   client_name_length = 0;
+	uint16_t user_name_length   = 0;
+	uint16_t password_length    = 0;
+	size_t   payload_index      = 0;
 
 	size_t func_retval;
 
@@ -242,44 +461,51 @@ size_t mqtt_connect(mqtt_client_t *client, char *client_name, int16_t keep_alive
 		}
 
 		/* Fill mqtt  connect structure */
-		client->connect_msg->fixed_header.message_type  = MQTT_CONNECT_MESSAGE;
+		client->connect_msg->fixed_header.control = mqtt_fixed_header_byte(MQTT_CONNECT_MESSAGE, MQTT_QOS_FIRE_FORGET, 0);
 
-		client->connect_msg->protocol_name_length = mqtt_htons(PROTOCOL_NAME_LENGTH);
+		mqtt_put_u16(&client->connect_msg->protocol_name_length, PROTOCOL_NAME_LENGTH);
 		strcpy(client->connect_msg->protocol_name, PROTOCOL_NAME);
 
 		client->connect_msg->protocol_version = MQTT_PROTOCOL_VERSION;
 
-		client->connect_msg->keep_alive_value = mqtt_htons(keep_alive_time);
+		mqtt_put_u16(&client->connect_msg->keep_alive_value, (uint16_t)keep_alive_time);
 
 
 		/*
 		 * @brief Populate payload message fields as per available payload options,
 		 *        and append the index of payload array as per options.
 		 */
-		if(client->connect_msg->connect_flags.user_name_flag)
+		if(client->connect_msg->connect_flags & MQTT_CONNECT_FLAG_USER_NAME)
 		{
 			/* Configure client ID and length */
-			client->connect_msg->message_payload[0] = 0;
-			client->connect_msg->message_payload[1] = client_name_length;
-			strncpy(client->connect_msg->message_payload + CONNECT_CLIENT_ID_LENGTH_SIZE, client_name, client_name_length);
+			user_name_length = mqtt_get_u16(&client->connect_msg->payload_options.user_name_length);
+			password_length  = mqtt_get_u16(&client->connect_msg->payload_options.password_length);
+
+			/* Stored lengths are checked against their fields and connect payload, 16 bit lengths are sent whole */
+			if(user_name_length > sizeof(client->connect_msg->payload_options.user_name) ||
+			   password_length > sizeof(client->connect_msg->payload_options.password) ||
+			   CONNECT_CLIENT_ID_LENGTH_SIZE + client_name_length + CONNECT_USER_NAME_LENGTH_SIZE + user_name_length +
+			   CONNECT_PASSWORD_LENGTH_SIZE + password_length > sizeof(client->connect_msg->message_payload))
+			{
+				return MAIN_FUNC_ERROR;
+			}
 
-			user_name_length = strlen(client->connect_msg->payload_options.user_name);
-			password_length = strlen(client->connect_msg->payload_options.password);
+			/* Configure client ID and length */
+			mqtt_put_u16(client->connect_msg->message_payload, (uint16_t)client_name_length);
+			memcpy(client->connect_msg->message_payload + CONNECT_CLIENT_ID_LENGTH_SIZE, client_name, client_name_length);
 
 			/* Update index for user name and length details */
 			payload_index = CONNECT_CLIENT_ID_LENGTH_SIZE + client_name_length;
 
-			client->connect_msg->message_payload[payload_index]     = 0;
-			client->connect_msg->message_payload[payload_index + 1] = user_name_length;
-			strncpy(client->connect_msg->message_payload + payload_index + CONNECT_USER_NAME_LENGTH_SIZE, client->connect_msg->payload_options.user_name, user_name_length);
+			mqtt_put_u16(client->connect_msg->message_payload + payload_index, user_name_length);
+			memcpy(client->connect_msg->message_payload + payload_index + CONNECT_USER_NAME_LENGTH_SIZE, client->connect_msg->payload_options.user_name, user_name_length);
 
 
 			/* Update index for password and length details */
 			payload_index += CONNECT_USER_NAME_LENGTH_SIZE + user_name_length;
 
-			client->connect_msg->message_payload[payload_index]     = 0;
-			client->connect_msg->message_payload[payload_index + 1] = password_length;
-			strncpy(client->connect_msg->message_payload + payload_index + 2, client->connect_msg->payload_options.password, password_length);
+			mqtt_put_u16(client->connect_msg->message_payload + payload_index, password_length);
+			memcpy(client->connect_msg->message_payload + payload_index + CONNECT_PASSWORD_LENGTH_SIZE, client->connect_msg->payload_options.password, password_length);
 
 			/* Configure message length */
 			message_length = (size_t)(FIXED_HEADER_LENGTH + CONNECT_PROTOCOL_LENGTH_SIZE + CONNECT_PROTOCOL_NAME_SIZE + CONNECT_PROTOCOL_VERSION_SIZE + CONNECT_FLAGS_SIZE + \
@@ -290,9 +516,8 @@ size_t mqtt_connect(mqtt_client_t *client, char *client_name, int16_t keep_alive
 		else
 		{
 			/* Configure client ID and length */
-			client->connect_msg->message_payload[0] = 0;
-			client->connect_msg->message_payload[1] = client_name_length;
-			strncpy(client->connect_msg->message_payload + CONNECT_CLIENT_ID_LENGTH_SIZE, client_name, client_name_length);
+			mqtt_put_u16(client->connect_msg->message_payload, (uint16_t)client_name_length);
+			memcpy(client->connect_msg->message_payload + CONNECT_CLIENT_ID_LENGTH_SIZE, client_name, client_name_length);
 
 			/* Configure message length */
 			message_length = (size_t)(FIXED_HEADER_LENGTH + CONNECT_PROTOCOL_LENGTH_SIZE + CONNECT_PROTOCOL_NAME_SIZE + CONNECT_PROTOCOL_VERSION_SIZE + CONNECT_FLAGS_SIZE + \
@@ -300,9 +525,7 @@ size_t mqtt_connect(mqtt_client_t *client, char *client_name, int16_t keep_alive
 
 		}
 
-		client->connect_msg->fixed_header.message_length = message_length - FIXED_HEADER_LENGTH;
-
-		func_retval = message_length;
+		func_retval = mqtt_set_remaining_length(&client->connect_msg->fixed_header, message_length - FIXED_HEADER_LENGTH);
 	}
 
 	return func_retval;
@@ -317,7 +540,62 @@ size_t mqtt_connect(mqtt_client_t *client, char *client_name, int16_t keep_alive
  */
 uint8_t get_mqtt_message_type(mqtt_client_t *client)
 {
-	return client->message->message_type;
+	return MQTT_HEADER_TYPE(client->message->control);
+}
+
+
+
+/*
+ * @brief  Returns the value of Remaining Length from input buffer.
+ * @param  *client   : pointer to mqtt client structure (mqtt_client_t).
+ * @retval  uint32_t : value of Remaining Length, fail = 0
+ */
+uint32_t get_mqtt_message_length(mqtt_client_t *client)
+{
+	uint32_t remaining_length = 0;
+
+	if(client == NULL || client->message == NULL)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	if(mqtt_decode_remaining_length((uint8_t*)client->message + 1, MQTT_REMAINING_LENGTH_MAX_SIZE, &remaining_length) <= 0)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	return remaining_length;
+}
+
+
+
+/*
+ * @brief  Returns message ID of PUBACK, PUBREC, PUBREL, PUBCOMP or SUBACK message from input buffer.
+ * @param  *client   : pointer to mqtt client structure (mqtt_client_t).
+ * @retval  uint16_t : message ID, fail = 0
+ */
+uint16_t get_mqtt_message_id(mqtt_client_t *client)
+{
+	uint8_t  *packet          = NULL;
+	uint32_t remaining_length = 0;
+	int8_t   length_size      = 0;
+
+	if(client == NULL || client->message == NULL)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	packet = (uint8_t*)client->message;
+
+	length_size = mqtt_decode_remaining_length(packet + 1, MQTT_REMAINING_LENGTH_MAX_SIZE, &remaining_length);
+	if(length_size <= 0 || remaining_length < MQTT_MESSAGE_ID_OFFSET)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	packet += 1 + length_size;
+
+	return mqtt_get_u16(packet);
 }
 
 
@@ -355,15 +633,10 @@ uint8_t get_connack_status(mqtt_client_t *client)
  */
 int8_t mqtt_publish_options(mqtt_client_t *client, uint8_t message_retain, mqtt_qos_t message_qos)
 {
-	if(message_retain)
-	{
-		client->publish_msg->fixed_header.retain_flag = ENABLE;
-	}
-
 	/* Check if Quality of service value (qos) is less than reserved value (val:3) */
 	if(message_qos < MQTT_QOS_RESERVED)
 	{
-		client->publish_msg->fixed_header.qos_level = message_qos;
+		client->publish_msg->fixed_header.control = mqtt_fixed_header_byte(MQTT_PUBLISH_MESSAGE, message_qos, message_retain);
 	}
 	else
 	{
@@ -376,228 +649,1834 @@ int8_t mqtt_publish_options(mqtt_client_t *client, uint8_t message_retain, mqtt_
 
 
 /*
- * @brief  Configures mqtt PUBLISH message structure.
+ * @brief  static function to return Remaining Length of PUBLISH control packet
+ * @param  topic_length   : length of publish topic
+ * @param  message_length : length of publish message
+ * @param  message_qos    : Quality of service value
+ * @retval size_t         : Remaining Length of publish control packet
+ */
+static size_t mqtt_publish_remaining_length(size_t topic_length, size_t message_length, mqtt_qos_t message_qos)
+{
+	size_t remaining_length = 0;
+
+	remaining_length = PUBLISH_TOPIC_LENGTH_SIZE + topic_length + message_length;
+
+	if(message_qos > MQTT_QOS_FIRE_FORGET)
+	{
+		remaining_length += MQTT_MESSAGE_ID_OFFSET;
+	}
+
+	return remaining_length;
+}
+
+
+
+/*
+ * @brief  Configures mqtt PUBLISH message structure, message ID of qos > 0 publish is
+ *         allocated from in-flight table of client and returned in client->message_id.
+ *         Publish structure is retransmit buffer of the in-flight message, so next qos > 0
+ *         publish fails until it is acknowledged, (window of 1, mqtt_publish_iov() pipelines).
  * @param  *client                : pointer to mqtt client structure (mqtt_client_t).
  * @param  *publish_topic         : publish topic name
  * @param  *publish_message       : message to be published
  * @param  publish_message_length : length of publish message
  * @retval size_t                 : length of publish control packet, fail = 0;
  */
-size_t mqtt_publish(mqtt_client_t *client, char *publish_topic, char *publish_message, uint16_t publish_message_length)
+size_t mqtt_publish(mqtt_client_t *client, char *publish_topic, char *publish_message, size_t publish_message_length)
 {
 
-	uint8_t message_length         = 0;
-	uint8_t publish_topic_length   = 0;
-	uint8_t payload_index          = 0;
-
-	publish_topic_length = strlen(publish_topic);
+	size_t   message_length         = 0;
+	size_t   publish_topic_length   = 0;
+	uint16_t payload_index          = 0;
+	uint8_t  publish_qos            = 0;
+	int16_t  slot_index             = 0;
 
-	/*Check if quality of service is > 0 and accordingly adjust the length of publish message */
-	if(client->publish_msg->fixed_header.qos_level > 0)
+	if(client == NULL || publish_topic == NULL || (publish_message == NULL && publish_message_length > 0))
 	{
-		publish_message_length = MQTT_MESSAGE_ID_OFFSET;
+		return MAIN_FUNC_ERROR;
 	}
 
+	publish_topic_length = strlen(publish_topic);
+	publish_qos          = MQTT_HEADER_QOS(client->publish_msg->fixed_header.control);
+
 	/* Check for overflow condition, if topic and message length is not greater than specified length */
 	if(publish_topic_length > MQTT_TOPIC_LENGTH || publish_message_length > PUBLISH_PAYLOAD_LENGTH)
 	{
 		return MAIN_FUNC_ERROR;
 	}
 
-	/* Fill main publish structure */
-	client->publish_msg->fixed_header.message_type = MQTT_PUBLISH_MESSAGE;
-
-	client->publish_msg->topic_length = mqtt_htons(publish_topic_length);
+	/* Configure Message Length, check if packet with larger Remaining Length field fits publish structure */
+	message_length = mqtt_publish_remaining_length(publish_topic_length, publish_message_length, (mqtt_qos_t)publish_qos);
 
-
-	/* Copy message to publish pay load, insert message ID if quality of service > 0 */
-	if(client->publish_msg->fixed_header.qos_level > 0)
+	if(1 + mqtt_remaining_length_size(message_length) + message_length > sizeof(mqtt_publish_t))
 	{
+		return MAIN_FUNC_ERROR;
+	}
 
-		/* Copy topic to publish topic member */
-		strncpy(client->publish_msg->payload, publish_topic, publish_topic_length);
+	/* Allocate message ID for qos > 0, from in-flight table if configured */
+	if(publish_qos > 0)
+	{
+		if(client->inflight_table != NULL)
+		{
+			/* Publish structure still holds unacknowledged message */
+			slot_index = mqtt_inflight_find(client->inflight_table, client->message_id);
 
-		/* Update pay load index*/
-		payload_index = publish_topic_length;
+			if(slot_index >= 0 && client->inflight_table->buffer[slot_index] == client->publish_msg)
+			{
+				return MAIN_FUNC_ERROR;
+			}
 
-		/* Configure topic length */
-		client->publish_msg->payload[payload_index]     = 0;
-		client->publish_msg->payload[payload_index + 1] = 1;
+			client->message_id = mqtt_inflight_acquire(client->inflight_table, MQTT_INFLIGHT_PUBLISH_SENT, (mqtt_qos_t)publish_qos, 0, client->publish_msg, 1 + mqtt_remaining_length_size(message_length) + message_length);
+		}
+		else
+		{
+			mqtt_next_message_id(&client->message_id);
+		}
 
-		/* Copy pay-load message */
-		strcpy(client->publish_msg->payload + payload_index + MQTT_MESSAGE_ID_OFFSET, publish_message);
+		if(client->message_id == 0)
+		{
+			return MAIN_FUNC_ERROR;
+		}
 	}
-	else
+
+	/* Fill main publish structure */
+	client->publish_msg->fixed_header.control = mqtt_fixed_header_byte(MQTT_PUBLISH_MESSAGE, (mqtt_qos_t)publish_qos,
+			                                                            client->publish_msg->fixed_header.control & MQTT_HEADER_RETAIN_FLAG);
+
+	mqtt_put_u16(&client->publish_msg->topic_length, (uint16_t)publish_topic_length);
+
+	/* Copy topic to publish topic member */
+	memcpy(client->publish_msg->payload, publish_topic, publish_topic_length);
+
+	payload_index = (uint16_t)publish_topic_length;
+
+	/* Insert message ID if quality of service > 0 */
+	if(publish_qos > 0)
 	{
-		/* Copy topic to publish topic member */
-		strncpy(client->publish_msg->payload, publish_topic, publish_topic_length);
+		mqtt_put_u16(client->publish_msg->payload + payload_index, client->message_id);
 
-		strncpy(client->publish_msg->payload + publish_topic_length, publish_message, publish_message_length);
+		payload_index += MQTT_MESSAGE_ID_OFFSET;
 	}
 
-	/* Configure Message Length */
-	message_length = publish_message_length + publish_topic_length + PUBLISH_TOPIC_LENGTH_SIZE + FIXED_HEADER_LENGTH;
-
-	client->publish_msg->fixed_header.message_length = message_length - FIXED_HEADER_LENGTH;
+	/* Copy pay-load message, length driven so binary messages are sent as is */
+	if(publish_message_length > 0)
+	{
+		memcpy(client->publish_msg->payload + payload_index, publish_message, publish_message_length);
+	}
 
-	return message_length;
+	return mqtt_set_remaining_length(&client->publish_msg->fixed_header, message_length);
 }
 
 
 
 /*
- * @brief  Configures mqtt PUBREL message structure.
- * @param  *client         : pointer to mqtt client structure (mqtt_client_t).
- * @retval size_t          : Length of publish release message.
+ * @brief  static function to encode PUBLISH header, (fixed header, topic length, topic and message ID)
+ * @param  *buffer         : pointer to the header buffer
+ * @param  *publish_topic  : publish topic name
+ * @param  topic_length    : length of publish topic
+ * @param  message_length  : length of publish message
+ * @param  message_retain  : Enable retain for message retention at broker
+ * @param  message_qos     : Quality of service value
+ * @param  message_id      : message ID for qos > 0
+ * @retval size_t          : length of publish header
  */
-size_t mqtt_publish_release(mqtt_client_t *client)
+static size_t mqtt_encode_publish_header(uint8_t *buffer, const char *publish_topic, uint16_t topic_length, size_t message_length,
+		                                 uint8_t message_retain, mqtt_qos_t message_qos, uint16_t message_id)
 {
-	size_t message_length = 0;
+	size_t header_index = 0;
 
-	client->pubrel_msg->fixed_header.qos_level    = MQTT_QOS_ATLEAST_ONCE;
-	client->pubrel_msg->fixed_header.message_type = MQTT_PUBREL_MESSAGE;
+	buffer[header_index++] = mqtt_fixed_header_byte(MQTT_PUBLISH_MESSAGE, message_qos, message_retain);
 
-	client->pubrel_msg->message_id = mqtt_htons(1);
+	header_index += mqtt_encode_remaining_length(buffer + header_index, mqtt_publish_remaining_length(topic_length, message_length, message_qos));
 
-	message_length = sizeof(mqtt_pubrel_t);
+	mqtt_put_u16(buffer + header_index, topic_length);
+	header_index += PUBLISH_TOPIC_LENGTH_SIZE;
 
-	client->pubrel_msg->fixed_header.message_length = (uint8_t)(message_length - FIXED_HEADER_LENGTH);
+	memcpy(buffer + header_index, publish_topic, topic_length);
+	header_index += topic_length;
+
+	if(message_qos > MQTT_QOS_FIRE_FORGET)
+	{
+		mqtt_put_u16(buffer + header_index, message_id);
+		header_index += MQTT_MESSAGE_ID_OFFSET;
+	}
 
-	return message_length;
+	return header_index;
 }
 
 
+
 /*
- * @brief  Configures mqtt DISCONNECT message structure.
- * @param  *client         : pointer to mqtt client structure (mqtt_client_t).
- * @retval size_t          : Length of disconnect message.
+ * @brief  Returns length of PUBLISH control packet for given topic and message length.
+ * @param  topic_length   : length of publish topic
+ * @param  message_length : length of publish message
+ * @param  message_qos    : Quality of service value (0:Fire and forget, 1:At-least once, 2:Exactly once)
+ * @retval size_t         : length of publish control packet, fail = 0;
  */
-size_t mqtt_disconnect(mqtt_client_t *client)
+size_t mqtt_publish_packet_size(size_t topic_length, size_t message_length, mqtt_qos_t message_qos)
 {
+	size_t remaining_length = 0;
 
-	size_t message_length = 0;
-
-	client->disconnect_msg->fixed_header.message_type = MQTT_DISCONNECT_MESSAGE;
+	if(topic_length > UINT16_MAX || message_qos >= MQTT_QOS_RESERVED || message_length > MQTT_MAX_REMAINING_LENGTH)
+	{
+		return MAIN_FUNC_ERROR;
+	}
 
-	message_length = sizeof(mqtt_disconnect_t);
+	remaining_length = mqtt_publish_remaining_length(topic_length, message_length, message_qos);
 
-	client->disconnect_msg->fixed_header.message_length = (uint8_t)(message_length - FIXED_HEADER_LENGTH);
+	if(remaining_length > MQTT_MAX_REMAINING_LENGTH)
+	{
+		return MAIN_FUNC_ERROR;
+	}
 
-	return message_length;
+	return 1 + mqtt_remaining_length_size(remaining_length) + remaining_length;
 }
 
 
 
-
 /*
- * @brief  Configures mqtt SUBSCRIBE message structure.
- * @param  *client          : pointer to mqtt client structure (mqtt_client_t).
- * @param  *subscribe_topic : subscribe topic name
- * @param  subscribe_qos    : Quality of service value (1:At-least once, 2:Exactly once)
- * @param  *message_id      : pointer to the message id variable
- * @retval size_t           : length of subscribe control packet, fail = 0;
+ * @brief  Returns length of PUBLISH header (fixed header, topic and message ID) for given topic and message length.
+ * @param  topic_length   : length of publish topic
+ * @param  message_length : length of publish message
+ * @param  message_qos    : Quality of service value (0:Fire and forget, 1:At-least once, 2:Exactly once)
+ * @retval size_t         : length of publish header, fail = 0;
  */
-size_t mqtt_subscribe(mqtt_client_t *client, char *subscribe_topic, mqtt_qos_t subscribe_qos, uint16_t *message_id)
+size_t mqtt_publish_header_size(size_t topic_length, size_t message_length, mqtt_qos_t message_qos)
 {
+	size_t packet_size = 0;
 
-	size_t  func_retval             = 0;
-	size_t  message_length          = 0;
-	uint8_t subscribe_topic_length  = 0;
-
-	subscribe_topic_length = (uint8_t)strlen(subscribe_topic);
+	packet_size = mqtt_publish_packet_size(topic_length, message_length, message_qos);
 
-	if(client == NULL || subscribe_topic == NULL)
+	if(packet_size == 0)
 	{
-		func_retval = MAIN_FUNC_ERROR;
+		return MAIN_FUNC_ERROR;
 	}
-	else
-	{
-		client->subscribe_msg->fixed_header.message_type = MQTT_SUBSCRIBE_MESSAGE;
-		client->subscribe_msg->fixed_header.qos_level = subscribe_qos;
-
-		/* TODO Increment message id if object is same */
-		*message_id = *message_id + 1;
-
-		client->subscribe_msg->message_identifier = mqtt_htons(*message_id);
-
-		client->subscribe_msg->topic_length = mqtt_htons(subscribe_topic_length);
 
-		strncpy(client->subscribe_msg->payload, subscribe_topic, subscribe_topic_length);
-
-		client->subscribe_msg->payload[subscribe_topic_length] = subscribe_qos;
+	return packet_size - message_length;
+}
 
-		message_length = FIXED_HEADER_LENGTH + SUBSCRIBE_MESSAGE_ID_SIZE + SUBSCRIBE_TOPIC_LENGTH_SIZE + subscribe_topic_length + SUBSCRIBE_QOS_SIZE;
 
-		client->subscribe_msg->fixed_header.message_length = message_length - FIXED_HEADER_LENGTH;
 
-		func_retval = message_length;
+/*
+ * @brief  Encodes PUBLISH header into scratch buffer and io vectors pointing to header and message,
+ *         message is not copied and can be sent with writev().
+ * @param  *header_buffer         : header scratch buffer, (MQTT_PUBLISH_HEADER_LENGTH bytes for configured topic length)
+ * @param  header_buffer_length   : length of header scratch buffer
+ * @param  *publish_topic         : publish topic name
+ * @param  *publish_message       : message to be published
+ * @param  publish_message_length : length of publish message
+ * @param  message_retain         : Enable retain for message retention at broker
+ * @param  message_qos            : Quality of service value (0:Fire and forget, 1:At-least once, 2:Exactly once)
+ * @param  message_id             : message ID for qos > 0, (not used for qos 0)
+ * @param  *iov                   : pointer to io vector array, (MQTT_PUBLISH_IOV_COUNT)
+ * @retval size_t                 : length of publish control packet, fail = 0;
+ */
+size_t mqtt_publish_iov(uint8_t *header_buffer, size_t header_buffer_length, char *publish_topic, const void *publish_message, size_t publish_message_length,
+		                uint8_t message_retain, mqtt_qos_t message_qos, uint16_t message_id, mqtt_iovec_t *iov)
+{
+	size_t topic_length  = 0;
+	size_t header_length = 0;
+
+	if(header_buffer == NULL || publish_topic == NULL || iov == NULL || (publish_message == NULL && publish_message_length > 0))
+	{
+		return MAIN_FUNC_ERROR;
+	}
 
+	/* Message ID 0 is not allowed for qos > 0 */
+	if(message_qos > MQTT_QOS_FIRE_FORGET && message_id == 0)
+	{
+		return MAIN_FUNC_ERROR;
 	}
-	return func_retval;
+
+	topic_length  = strlen(publish_topic);
+	header_length = mqtt_publish_header_size(topic_length, publish_message_length, message_qos);
+
+	if(header_length == 0 || header_length > header_buffer_length)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	mqtt_encode_publish_header(header_buffer, publish_topic, (uint16_t)topic_length, publish_message_length, message_retain, message_qos, message_id);
+
+	iov[0].iov_base = header_buffer;
+	iov[0].iov_len  = header_length;
+
+	iov[1].iov_base = (void*)publish_message;
+	iov[1].iov_len  = publish_message_length;
+
+	return header_length + publish_message_length;
 }
 
 
 
 /*
- * @brief  Read MQTT PUBLISH message
- * @param  *client           : pointer to mqtt client structure (mqtt_client_t).
- * @param  *subscribe_topic  : subscribe topic name received from the broker
- * @param  *received_message : message received from topic subscribed to
- * @param  *message_status   : pointer to message status.
- * @retval size_t            : length of received message, fail = 0;
+ * @brief  Encodes batch of PUBLISH control packets back to back into one buffer,
+ *         stops at the first entry that does not fit or has bad parameters.
+ * @param  *entries        : array of publish entries, message ID of qos > 0 entries is updated
+ * @param  entry_count     : number of publish entries
+ * @param  *buffer         : output buffer
+ * @param  buffer_length   : length of output buffer
+ * @param  *message_id     : pointer to the message id variable, incremented for each qos > 0 entry
+ * @param  *encoded_length : pointer to number of bytes encoded into buffer
+ * @retval size_t          : number of entries encoded
  */
-size_t mqtt_read_publish(mqtt_client_t  *client, char *subscribed_topic, char *received_message, uint8_t *message_status)
+size_t mqtt_publish_batch(mqtt_publish_entry_t *entries, size_t entry_count, uint8_t *buffer, size_t buffer_length,
+		                  uint16_t *message_id, size_t *encoded_length)
 {
-	size_t received_message_length = 0;
-	size_t func_retval             = 0;
-	uint8_t received_topic_length  = 0;
+	size_t entry_index   = 0;
+	size_t buffer_index  = 0;
+	size_t topic_length  = 0;
+	size_t packet_length = 0;
+	size_t header_length = 0;
 
-	/* Check for error*/
-	if(client == NULL || subscribed_topic == NULL || received_message == NULL)
+	if(entries == NULL || buffer == NULL || message_id == NULL || encoded_length == NULL)
 	{
-		func_retval = MAIN_FUNC_ERROR;
+		return MAIN_FUNC_ERROR;
 	}
-	else
+
+	for(entry_index = 0; entry_index < entry_count; entry_index++)
+	{
+		if(entries[entry_index].topic == NULL || (entries[entry_index].message == NULL && entries[entry_index].message_length > 0))
+		{
+			break;
+		}
+
+		topic_length  = strlen(entries[entry_index].topic);
+		packet_length = mqtt_publish_packet_size(topic_length, entries[entry_index].message_length, entries[entry_index].qos);
+
+		if(packet_length == 0 || packet_length > buffer_length - buffer_index)
+		{
+			break;
+		}
+
+		if(entries[entry_index].qos > MQTT_QOS_FIRE_FORGET)
+		{
+			entries[entry_index].message_id = mqtt_next_message_id(message_id);
+		}
+
+		header_length = mqtt_encode_publish_header(buffer + buffer_index, entries[entry_index].topic, (uint16_t)topic_length, entries[entry_index].message_length,
+				                                   entries[entry_index].retain, entries[entry_index].qos, entries[entry_index].message_id);
+
+		if(entries[entry_index].message_length > 0)
+		{
+			memcpy(buffer + buffer_index + header_length, entries[entry_index].message, entries[entry_index].message_length);
+		}
+
+		buffer_index += packet_length;
+	}
+
+	*encoded_length = buffer_index;
+
+	return entry_index;
+}
+
+
+
+/*
+ * @brief  Encodes batch of PUBLISH headers back to back into header scratch buffer and io vectors,
+ *         two io vectors (header, message) per entry, messages are not copied.
+ *         Stops at the first entry that does not fit or has bad parameters.
+ * @param  *entries              : array of publish entries, message ID of qos > 0 entries is updated
+ * @param  entry_count           : number of publish entries
+ * @param  *header_buffer        : header scratch buffer
+ * @param  header_buffer_length  : length of header scratch buffer
+ * @param  *iov                  : pointer to io vector array
+ * @param  iov_count             : number of io vectors in array
+ * @param  *message_id           : pointer to the message id variable, incremented for each qos > 0 entry
+ * @param  *encoded_length       : pointer to total length of encoded control packets
+ * @retval size_t                : number of entries encoded, (io vectors used = 2 * entries)
+ */
+size_t mqtt_publish_batch_iov(mqtt_publish_entry_t *entries, size_t entry_count, uint8_t *header_buffer, size_t header_buffer_length,
+		                      mqtt_iovec_t *iov, size_t iov_count, uint16_t *message_id, size_t *encoded_length)
+{
+	size_t entry_index   = 0;
+	size_t header_index  = 0;
+	size_t topic_length  = 0;
+	size_t header_length = 0;
+	size_t packet_length = 0;
+	size_t total_length  = 0;
+
+	if(entries == NULL || header_buffer == NULL || iov == NULL || message_id == NULL || encoded_length == NULL)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	for(entry_index = 0; entry_index < entry_count && (entry_index + 1) * MQTT_PUBLISH_IOV_COUNT <= iov_count; entry_index++)
 	{
+		if(entries[entry_index].topic == NULL || (entries[entry_index].message == NULL && entries[entry_index].message_length > 0))
+		{
+			break;
+		}
 
-		*message_status = client->publish_msg->fixed_header.qos_level;
+		topic_length  = strlen(entries[entry_index].topic);
+		header_length = mqtt_publish_header_size(topic_length, entries[entry_index].message_length, entries[entry_index].qos);
 
-		received_topic_length = mqtt_ntohs(client->publish_msg->topic_length);
+		if(header_length == 0 || header_length > header_buffer_length - header_index)
+		{
+			break;
+		}
 
-		strncpy(subscribed_topic, client->publish_msg->payload, received_topic_length);
+		if(entries[entry_index].qos > MQTT_QOS_FIRE_FORGET)
+		{
+			entries[entry_index].message_id = mqtt_next_message_id(message_id);
+		}
 
-		strcpy(received_message, client->publish_msg->payload + received_topic_length);
+		mqtt_encode_publish_header(header_buffer + header_index, entries[entry_index].topic, (uint16_t)topic_length, entries[entry_index].message_length,
+				                   entries[entry_index].retain, entries[entry_index].qos, entries[entry_index].message_id);
 
-		received_message_length = strlen(received_message);
+		iov[entry_index * MQTT_PUBLISH_IOV_COUNT].iov_base     = header_buffer + header_index;
+		iov[entry_index * MQTT_PUBLISH_IOV_COUNT].iov_len      = header_length;
+		iov[entry_index * MQTT_PUBLISH_IOV_COUNT + 1].iov_base = (void*)entries[entry_index].message;
+		iov[entry_index * MQTT_PUBLISH_IOV_COUNT + 1].iov_len  = entries[entry_index].message_length;
 
-		func_retval = received_message_length;
+		packet_length = header_length + entries[entry_index].message_length;
 
+		header_index += header_length;
+		total_length += packet_length;
 	}
 
-	return func_retval;
+	*encoded_length = total_length;
+
+	return entry_index;
 }
 
 
 
+/*
+ * @brief  Prepares publish template, pre-encodes fixed header flags, topic length and topic.
+ * @param  *publish_template : pointer to mqtt publish template structure (mqtt_publish_template_t).
+ * @param  *publish_topic    : publish topic name, (maximum MQTT_TOPIC_LENGTH)
+ * @param  message_retain    : Enable retain for message retention at broker
+ * @param  message_qos       : Quality of service value (0:Fire and forget, 1:At-least once, 2:Exactly once)
+ * @retval int8_t            : 1 = Success, -1 = Error
+ */
+int8_t mqtt_publish_prepare(mqtt_publish_template_t *publish_template, char *publish_topic, uint8_t message_retain, mqtt_qos_t message_qos)
+{
+	size_t   topic_length = 0;
+	uint8_t *topic_field  = NULL;
+
+	if(publish_template == NULL || publish_topic == NULL || message_qos >= MQTT_QOS_RESERVED)
+	{
+		return FUNC_OPTS_ERROR;
+	}
+
+	topic_length = strlen(publish_topic);
+	if(topic_length > MQTT_TOPIC_LENGTH)
+	{
+		return FUNC_OPTS_ERROR;
+	}
+
+	publish_template->header_byte     = mqtt_fixed_header_byte(MQTT_PUBLISH_MESSAGE, message_qos, message_retain);
+	publish_template->qos             = message_qos;
+	publish_template->topic_length    = (uint16_t)topic_length;
+	publish_template->variable_length = (uint16_t)mqtt_publish_remaining_length(topic_length, 0, message_qos);
+
+	/* Topic length field follows the space reserved for largest fixed header */
+	topic_field = publish_template->header + MQTT_MAX_FIXED_HEADER_LENGTH;
+
+	mqtt_put_u16(topic_field, (uint16_t)topic_length);
+
+	memcpy(topic_field + PUBLISH_TOPIC_LENGTH_SIZE, publish_topic, topic_length);
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
 
 /*
- * @brief  Configures mqtt PINGREQUEST message structure.
+ * @brief  Patches Remaining Length and message ID into prepared publish header and fills io vectors,
+ *         header is valid until the template is used again.
+ * @param  *publish_template      : pointer to mqtt publish template structure (mqtt_publish_template_t).
+ * @param  *publish_message       : message to be published
+ * @param  publish_message_length : length of publish message
+ * @param  message_id             : message ID for qos > 0, (not used for qos 0)
+ * @param  *iov                   : pointer to io vector array, (MQTT_PUBLISH_IOV_COUNT)
+ * @retval size_t                 : length of publish control packet, fail = 0;
+ */
+size_t mqtt_publish_prepared_iov(mqtt_publish_template_t *publish_template, const void *publish_message, size_t publish_message_length,
+		                         uint16_t message_id, mqtt_iovec_t *iov)
+{
+	size_t   remaining_length = 0;
+	uint8_t  length_size      = 0;
+	uint8_t *header_start     = NULL;
+	uint8_t *message_id_field = NULL;
+
+	if(publish_template == NULL || iov == NULL || (publish_message == NULL && publish_message_length > 0))
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	if(publish_message_length > (size_t)(MQTT_MAX_REMAINING_LENGTH - publish_template->variable_length))
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	remaining_length = publish_template->variable_length + publish_message_length;
+	length_size      = mqtt_remaining_length_size(remaining_length);
+
+	/* Fixed header is written right aligned before the topic length field */
+	header_start = publish_template->header + MQTT_MAX_FIXED_HEADER_LENGTH - 1 - length_size;
+
+	header_start[0] = publish_template->header_byte;
+	mqtt_encode_remaining_length(header_start + 1, remaining_length);
+
+	if(publish_template->qos > MQTT_QOS_FIRE_FORGET)
+	{
+		if(message_id == 0)
+		{
+			return MAIN_FUNC_ERROR;
+		}
+
+		message_id_field = publish_template->header + MQTT_MAX_FIXED_HEADER_LENGTH + PUBLISH_TOPIC_LENGTH_SIZE + publish_template->topic_length;
+
+		mqtt_put_u16(message_id_field, message_id);
+	}
+
+	iov[0].iov_base = header_start;
+	iov[0].iov_len  = 1 + length_size + publish_template->variable_length;
+
+	iov[1].iov_base = (void*)publish_message;
+	iov[1].iov_len  = publish_message_length;
+
+	return iov[0].iov_len + publish_message_length;
+}
+
+
+
+/*
+ * @brief  Encodes PUBLISH control packet from prepared publish template into buffer.
+ * @param  *publish_template      : pointer to mqtt publish template structure (mqtt_publish_template_t).
+ * @param  *publish_message       : message to be published
+ * @param  publish_message_length : length of publish message
+ * @param  message_id             : message ID for qos > 0, (not used for qos 0)
+ * @param  *buffer                : output buffer
+ * @param  buffer_length          : length of output buffer
+ * @retval size_t                 : length of publish control packet, fail = 0;
+ */
+size_t mqtt_publish_prepared(mqtt_publish_template_t *publish_template, const void *publish_message, size_t publish_message_length,
+		                     uint16_t message_id, uint8_t *buffer, size_t buffer_length)
+{
+	mqtt_iovec_t publish_vector[MQTT_PUBLISH_IOV_COUNT];
+	size_t       packet_length = 0;
+
+	if(buffer == NULL)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	packet_length = mqtt_publish_prepared_iov(publish_template, publish_message, publish_message_length, message_id, publish_vector);
+
+	if(packet_length == 0 || packet_length > buffer_length)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	memcpy(buffer, publish_vector[0].iov_base, publish_vector[0].iov_len);
+	memcpy(buffer + publish_vector[0].iov_len, publish_message, publish_message_length);
+
+	return packet_length;
+}
+
+
+
+/*
+ * @brief  Configures mqtt PUBREL message structure.
  * @param  *client         : pointer to mqtt client structure (mqtt_client_t).
- * @retval size_t          : Length of pingrequest message.
+ * @param  message_id      : message ID of publish message, (from PUBREC)
+ * @retval size_t          : Length of publish release message.
  */
-size_t mqtt_pingreq(mqtt_client_t *client)
+size_t mqtt_publish_release(mqtt_client_t *client, uint16_t message_id)
+{
+	size_t message_length = 0;
+
+	client->pubrel_msg->fixed_header.control = mqtt_fixed_header_byte(MQTT_PUBREL_MESSAGE, MQTT_QOS_FIRE_FORGET, 0);
+
+	mqtt_put_u16(&client->pubrel_msg->message_id, message_id);
+
+	message_length = sizeof(mqtt_pubrel_t);
+
+	return mqtt_set_remaining_length(&client->pubrel_msg->fixed_header, message_length - FIXED_HEADER_LENGTH);
+}
+
+
+/*
+ * @brief  Encodes PUBREL message into buffer, (appended to outgoing stream by caller).
+ * @param  *buffer         : output buffer
+ * @param  buffer_length   : length of output buffer, (MQTT_PUBREL_LENGTH or more)
+ * @param  message_id      : message ID of publish message, (from PUBREC)
+ * @retval size_t          : Length of publish release message, fail = 0
+ */
+size_t mqtt_publish_release_encode(uint8_t *buffer, size_t buffer_length, uint16_t message_id)
+{
+	if(buffer == NULL || buffer_length < MQTT_PUBREL_LENGTH || message_id == 0)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	/* Remaining length is message ID only */
+	buffer[0] = mqtt_fixed_header_byte(MQTT_PUBREL_MESSAGE, MQTT_QOS_FIRE_FORGET, 0);
+	buffer[1] = MQTT_MESSAGE_ID_OFFSET;
+
+	mqtt_put_u16(buffer + 2, message_id);
+
+	return MQTT_PUBREL_LENGTH;
+}
+
+
+
+/*
+ * @brief  Configures mqtt DISCONNECT message structure.
+ * @param  *client         : pointer to mqtt client structure (mqtt_client_t).
+ * @retval size_t          : Length of disconnect message.
+ */
+size_t mqtt_disconnect(mqtt_client_t *client)
 {
 
 	size_t message_length = 0;
 
-	client->pingrequest_msg->fixed_header.message_type = MQTT_PINGREQ_MESSAGE;
+	client->disconnect_msg->fixed_header.control = mqtt_fixed_header_byte(MQTT_DISCONNECT_MESSAGE, MQTT_QOS_FIRE_FORGET, 0);
 
-	message_length = sizeof(mqtt_pingreq_t);
+	message_length = sizeof(mqtt_disconnect_t);
+
+	return mqtt_set_remaining_length(&client->disconnect_msg->fixed_header, message_length - FIXED_HEADER_LENGTH);
+}
+
+
+
+
+/*
+ * @brief  Configures mqtt SUBSCRIBE message structure.
+ * @param  *client          : pointer to mqtt client structure (mqtt_client_t).
+ * @param  *subscribe_topic : subscribe topic name
+ * @param  subscribe_qos    : Quality of service value (1:At-least once, 2:Exactly once)
+ * @param  *message_id      : pointer to the message id variable
+ * @retval size_t           : length of subscribe control packet, fail = 0;
+ */
+size_t mqtt_subscribe(mqtt_client_t *client, char *subscribe_topic, mqtt_qos_t subscribe_qos, uint16_t *message_id)
+{
+
+	size_t  func_retval             = 0;
+	size_t  message_length          = 0;
+	uint8_t subscribe_topic_length  = 0;
 
-	client->pingrequest_msg->fixed_header.message_length = (uint8_t)(message_length - FIXED_HEADER_LENGTH);
+	if(client == NULL || subscribe_topic == NULL || strlen(subscribe_topic) > MQTT_TOPIC_LENGTH)
+	{
+		func_retval = MAIN_FUNC_ERROR;
+	}
+	else
+	{
+		subscribe_topic_length = (uint8_t)strlen(subscribe_topic);
+
+		client->subscribe_msg->fixed_header.control = mqtt_fixed_header_byte(MQTT_SUBSCRIBE_MESSAGE, MQTT_QOS_FIRE_FORGET, 0);
+
+		/* TODO Increment message id if object is same */
+		*message_id = *message_id + 1;
+
+		mqtt_put_u16(&client->subscribe_msg->message_identifier, *message_id);
+
+		mqtt_put_u16(&client->subscribe_msg->topic_length, subscribe_topic_length);
+
+		memcpy(client->subscribe_msg->payload, subscribe_topic, subscribe_topic_length);
+
+		client->subscribe_msg->payload[subscribe_topic_length] = subscribe_qos;
+
+		message_length = FIXED_HEADER_LENGTH + SUBSCRIBE_MESSAGE_ID_SIZE + SUBSCRIBE_TOPIC_LENGTH_SIZE + subscribe_topic_length + SUBSCRIBE_QOS_SIZE;
+
+		func_retval = mqtt_set_remaining_length(&client->subscribe_msg->fixed_header, message_length - FIXED_HEADER_LENGTH);
+
+	}
+	return func_retval;
+}
+
+
+
+/*
+ * @brief  static function to write fixed header and message ID of SUBSCRIBE and UNSUBSCRIBE list packets
+ * @param  *buffer          : output buffer
+ * @param  buffer_length    : length of output buffer
+ * @param  message_type     : MQTT control packet type
+ * @param  remaining_length : length of variable header and payload
+ * @param  *message_id      : pointer to the message id variable, incremented for the packet
+ * @retval size_t           : length of header written, fail (packet does not fit) = 0
+ */
+static size_t mqtt_encode_topic_list_header(uint8_t *buffer, size_t buffer_length, uint8_t message_type,
+		                                    size_t remaining_length, uint16_t *message_id)
+{
+	size_t header_index = 0;
+
+	if(remaining_length > MQTT_MAX_REMAINING_LENGTH ||
+	   1 + mqtt_remaining_length_size(remaining_length) + remaining_length > buffer_length)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	buffer[header_index++] = mqtt_fixed_header_byte(message_type, MQTT_QOS_FIRE_FORGET, 0);
 
-	return message_length;
+	header_index += mqtt_encode_remaining_length(buffer + header_index, remaining_length);
+
+	mqtt_put_u16(buffer + header_index, mqtt_next_message_id(message_id));
+	header_index += MQTT_MESSAGE_ID_OFFSET;
+
+	return header_index;
+}
+
+
+
+/*
+ * @brief  static function to size Remaining Length of SUBSCRIBE list packet, entries are checked
+ * @param  *entries       : array of subscribe entries
+ * @param  entry_count    : number of subscribe entries
+ * @retval size_t         : remaining length, fail (invalid entry or empty list) = 0
+ */
+static size_t mqtt_subscribe_remaining_length(mqtt_subscribe_entry_t *entries, size_t entry_count)
+{
+	size_t remaining_length = MQTT_MESSAGE_ID_OFFSET;
+	size_t topic_length     = 0;
+	size_t entry_index      = 0;
+
+	if(entries == NULL || entry_count == 0)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	for(entry_index = 0; entry_index < entry_count; entry_index++)
+	{
+		if(entries[entry_index].topic == NULL || entries[entry_index].qos >= MQTT_QOS_RESERVED)
+		{
+			return MAIN_FUNC_ERROR;
+		}
+
+		topic_length = strlen(entries[entry_index].topic);
+		if(topic_length == 0 || topic_length > MQTT_MAX_TOPIC_FILTER)
+		{
+			return MAIN_FUNC_ERROR;
+		}
+
+		remaining_length += SUBSCRIBE_TOPIC_LENGTH_SIZE + topic_length + SUBSCRIBE_QOS_SIZE;
+	}
+
+	return remaining_length;
 }
 
 
 
+/*
+ * @brief  static function to size Remaining Length of UNSUBSCRIBE list packet, topics are checked
+ * @param  **topics       : array of topic filters
+ * @param  topic_count    : number of topic filters
+ * @retval size_t         : remaining length, fail (invalid topic or empty list) = 0
+ */
+static size_t mqtt_unsubscribe_remaining_length(char **topics, size_t topic_count)
+{
+	size_t remaining_length = MQTT_MESSAGE_ID_OFFSET;
+	size_t topic_length     = 0;
+	size_t topic_index      = 0;
+
+	if(topics == NULL || topic_count == 0)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	for(topic_index = 0; topic_index < topic_count; topic_index++)
+	{
+		if(topics[topic_index] == NULL)
+		{
+			return MAIN_FUNC_ERROR;
+		}
+
+		topic_length = strlen(topics[topic_index]);
+		if(topic_length == 0 || topic_length > MQTT_MAX_TOPIC_FILTER)
+		{
+			return MAIN_FUNC_ERROR;
+		}
+
+		remaining_length += SUBSCRIBE_TOPIC_LENGTH_SIZE + topic_length;
+	}
+
+	return remaining_length;
+}
+
+
+
+/*
+ * @brief  Returns length of SUBSCRIBE list packet, buffer of mqtt_subscribe_many() is sized with it.
+ * @param  *entries       : array of subscribe entries
+ * @param  entry_count    : number of subscribe entries
+ * @retval size_t         : length of subscribe control packet, fail (invalid list) = 0;
+ */
+size_t mqtt_subscribe_many_length(mqtt_subscribe_entry_t *entries, size_t entry_count)
+{
+	size_t remaining_length = mqtt_subscribe_remaining_length(entries, entry_count);
+
+	if(remaining_length == 0 || remaining_length > MQTT_MAX_REMAINING_LENGTH)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	return 1 + mqtt_remaining_length_size(remaining_length) + remaining_length;
+}
+
+
+
+/*
+ * @brief  Encodes SUBSCRIBE control packet with list of topic filters into one buffer,
+ *         broker answers with one SUBACK holding a return code for each entry.
+ * @param  *entries       : array of subscribe entries
+ * @param  entry_count    : number of subscribe entries
+ * @param  *message_id    : pointer to the message id variable, incremented for the packet
+ * @param  *buffer        : output buffer, (mqtt_subscribe_many_length() bytes)
+ * @param  buffer_length  : length of output buffer
+ * @retval size_t         : length of subscribe control packet, fail = 0;
+ */
+size_t mqtt_subscribe_many(mqtt_subscribe_entry_t *entries, size_t entry_count, uint16_t *message_id, uint8_t *buffer, size_t buffer_length)
+{
+	size_t remaining_length = 0;
+	size_t buffer_index     = 0;
+	size_t topic_length     = 0;
+	size_t entry_index      = 0;
+
+	if(message_id == NULL || buffer == NULL)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	/* Size packet first, Remaining Length field is written before the list */
+	remaining_length = mqtt_subscribe_remaining_length(entries, entry_count);
+	if(remaining_length == 0)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	buffer_index = mqtt_encode_topic_list_header(buffer, buffer_length, MQTT_SUBSCRIBE_MESSAGE, remaining_length, message_id);
+	if(buffer_index == 0)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	for(entry_index = 0; entry_index < entry_count; entry_index++)
+	{
+		topic_length = strlen(entries[entry_index].topic);
+
+		mqtt_put_u16(buffer + buffer_index, (uint16_t)topic_length);
+		buffer_index += SUBSCRIBE_TOPIC_LENGTH_SIZE;
+
+		memcpy(buffer + buffer_index, entries[entry_index].topic, topic_length);
+		buffer_index += topic_length;
+
+		buffer[buffer_index++] = (uint8_t)entries[entry_index].qos;
+	}
+
+	return buffer_index;
+}
+
+
+
+/*
+ * @brief  Returns length of UNSUBSCRIBE list packet, buffer of mqtt_unsubscribe_many() is sized with it.
+ * @param  **topics       : array of topic filters
+ * @param  topic_count    : number of topic filters
+ * @retval size_t         : length of unsubscribe control packet, fail (invalid list) = 0;
+ */
+size_t mqtt_unsubscribe_many_length(char **topics, size_t topic_count)
+{
+	size_t remaining_length = mqtt_unsubscribe_remaining_length(topics, topic_count);
+
+	if(remaining_length == 0 || remaining_length > MQTT_MAX_REMAINING_LENGTH)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	return 1 + mqtt_remaining_length_size(remaining_length) + remaining_length;
+}
+
+
+
+/*
+ * @brief  Encodes UNSUBSCRIBE control packet with list of topic filters into one buffer.
+ * @param  **topics       : array of topic filters
+ * @param  topic_count    : number of topic filters
+ * @param  *message_id    : pointer to the message id variable, incremented for the packet
+ * @param  *buffer        : output buffer, (mqtt_unsubscribe_many_length() bytes)
+ * @param  buffer_length  : length of output buffer
+ * @retval size_t         : length of unsubscribe control packet, fail = 0;
+ */
+size_t mqtt_unsubscribe_many(char **topics, size_t topic_count, uint16_t *message_id, uint8_t *buffer, size_t buffer_length)
+{
+	size_t remaining_length = 0;
+	size_t buffer_index     = 0;
+	size_t topic_length     = 0;
+	size_t topic_index      = 0;
+
+	if(message_id == NULL || buffer == NULL)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	remaining_length = mqtt_unsubscribe_remaining_length(topics, topic_count);
+	if(remaining_length == 0)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	buffer_index = mqtt_encode_topic_list_header(buffer, buffer_length, MQTT_UNSUBSCRIBE_MESSAGE, remaining_length, message_id);
+	if(buffer_index == 0)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	for(topic_index = 0; topic_index < topic_count; topic_index++)
+	{
+		topic_length = strlen(topics[topic_index]);
+
+		mqtt_put_u16(buffer + buffer_index, (uint16_t)topic_length);
+		buffer_index += SUBSCRIBE_TOPIC_LENGTH_SIZE;
+
+		memcpy(buffer + buffer_index, topics[topic_index], topic_length);
+		buffer_index += topic_length;
+	}
+
+	return buffer_index;
+}
+
+
+
+/*
+ * @brief  Parses SUBACK return codes into subscribe entries, (same order as SUBSCRIBE list).
+ * @param  *packet       : pointer to decoded SUBACK packet
+ * @param  *entries      : array of subscribe entries sent in SUBSCRIBE, return_code is updated
+ * @param  entry_count   : number of subscribe entries
+ * @param  *message_id   : pointer to message ID of SUBACK
+ * @retval int8_t        : 1 = Success, -1 = Error or return code count does not match entry count
+ */
+int8_t mqtt_suback_parse(mqtt_packet_t *packet, mqtt_subscribe_entry_t *entries, size_t entry_count, uint16_t *message_id)
+{
+	size_t entry_index = 0;
+
+	if(packet == NULL || entries == NULL || message_id == NULL || packet->message_type != MQTT_SUBACK_MESSAGE)
+	{
+		return FUNC_OPTS_ERROR;
+	}
+
+	/* One return code for each topic filter follows the message ID */
+	if(packet->remaining_length != MQTT_MESSAGE_ID_OFFSET + entry_count)
+	{
+		return FUNC_OPTS_ERROR;
+	}
+
+	*message_id = mqtt_get_u16(packet->body);
+
+	for(entry_index = 0; entry_index < entry_count; entry_index++)
+	{
+		entries[entry_index].return_code = packet->body[MQTT_MESSAGE_ID_OFFSET + entry_index];
+	}
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Read MQTT PUBLISH message, lengths are taken from Remaining Length field so
+ *         binary messages are copied as is, (terminated when received_message_size allows).
+ * @param  *client                : pointer to mqtt client structure (mqtt_client_t).
+ * @param  *subscribe_topic       : subscribe topic name received from the broker, (MQTT_TOPIC_LENGTH + 1 bytes)
+ * @param  *received_message      : message received from topic subscribed to
+ * @param  received_message_size  : size of received message buffer
+ * @param  *message_status        : pointer to message status.
+ * @retval size_t                 : length of received message, fail = 0;
+ */
+size_t mqtt_read_publish(mqtt_client_t  *client, char *subscribed_topic, char *received_message, size_t received_message_size, uint8_t *message_status)
+{
+	mqtt_packet_t       packet;
+	mqtt_publish_view_t view;
+	int8_t              length_size = 0;
+
+	/* Check for error*/
+	if(client == NULL || subscribed_topic == NULL || received_message == NULL || message_status == NULL)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	packet.packet = (uint8_t*)client->publish_msg;
+
+	/* Variable header starts after the 1 to 4 byte Remaining Length field */
+	length_size = mqtt_decode_remaining_length(packet.packet + 1, MQTT_REMAINING_LENGTH_MAX_SIZE, &packet.remaining_length);
+	if(length_size <= 0)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	packet.message_type  = MQTT_HEADER_TYPE(packet.packet[0]);
+	packet.flags         = packet.packet[0] & 0x0F;
+	packet.body          = packet.packet + 1 + length_size;
+	packet.packet_length = 1 + length_size + packet.remaining_length;
+
+	if(mqtt_publish_parse(&packet, &view) != FUNC_OPTS_SUCCESS || view.topic_length > MQTT_TOPIC_LENGTH || view.message_length > received_message_size)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	*message_status = view.qos;
+
+	memcpy(subscribed_topic, view.topic, view.topic_length);
+	subscribed_topic[view.topic_length] = '\0';
+
+	memcpy(received_message, view.message, view.message_length);
+	if(view.message_length < received_message_size)
+	{
+		received_message[view.message_length] = '\0';
+	}
+
+	return view.message_length;
+}
+
+
+
+/*
+ * @brief  Parses decoded PUBLISH packet without copying, topic and message point into the packet.
+ * @param  *packet  : pointer to decoded PUBLISH packet
+ * @param  *view    : pointer to mqtt publish view structure (mqtt_publish_view_t).
+ * @retval int8_t   : 1 = Success, -1 = Error or malformed packet
+ */
+int8_t mqtt_publish_parse(mqtt_packet_t *packet, mqtt_publish_view_t *view)
+{
+	size_t header_length = 0;
+
+	if(packet == NULL || view == NULL || packet->message_type != MQTT_PUBLISH_MESSAGE || packet->remaining_length < PUBLISH_TOPIC_LENGTH_SIZE)
+	{
+		return FUNC_OPTS_ERROR;
+	}
+
+	view->qos    = (mqtt_qos_t)MQTT_HEADER_QOS(packet->flags);
+	view->retain = packet->flags & MQTT_HEADER_RETAIN_FLAG;
+	view->dup    = (packet->flags & MQTT_HEADER_DUP_FLAG) ? 1 : 0;
+
+	if(view->qos == MQTT_QOS_RESERVED)
+	{
+		return FUNC_OPTS_ERROR;
+	}
+
+	view->topic_length = mqtt_get_u16(packet->body);
+	view->topic        = (const char*)packet->body + PUBLISH_TOPIC_LENGTH_SIZE;
+
+	header_length = mqtt_publish_remaining_length(view->topic_length, 0, view->qos);
+	if(header_length > packet->remaining_length)
+	{
+		return FUNC_OPTS_ERROR;
+	}
+
+	view->message_id = 0;
+	if(view->qos > MQTT_QOS_FIRE_FORGET)
+	{
+		view->message_id = mqtt_get_u16(packet->body + PUBLISH_TOPIC_LENGTH_SIZE + view->topic_length);
+	}
+
+	/* Message length comes from Remaining Length, message is not scanned */
+	view->message        = packet->body + header_length;
+	view->message_length = packet->remaining_length - header_length;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+
+/*
+ * @brief  Configures mqtt PINGREQUEST message structure.
+ * @param  *client         : pointer to mqtt client structure (mqtt_client_t).
+ * @retval size_t          : Length of pingrequest message.
+ */
+size_t mqtt_pingreq(mqtt_client_t *client)
+{
+
+	size_t message_length = 0;
+
+	client->pingrequest_msg->fixed_header.control = mqtt_fixed_header_byte(MQTT_PINGREQ_MESSAGE, MQTT_QOS_FIRE_FORGET, 0);
+
+	message_length = sizeof(mqtt_pingreq_t);
+
+	return mqtt_set_remaining_length(&client->pingrequest_msg->fixed_header, message_length - FIXED_HEADER_LENGTH);
+}
+
+
+
+/*
+ * @brief  Initializes incremental input stream decoder.
+ * @param  *decoder       : pointer to mqtt decoder structure (mqtt_decoder_t).
+ * @param  *buffer        : decoder buffer, holds partial and complete packets
+ * @param  buffer_length  : length of decoder buffer, (minimum MQTT_MAX_FIXED_HEADER_LENGTH)
+ * @retval int8_t         : 1 = Success, -1 = Error
+ */
+int8_t mqtt_decoder_init(mqtt_decoder_t *decoder, uint8_t *buffer, size_t buffer_length)
+{
+	if(decoder == NULL || buffer == NULL || buffer_length < MQTT_MAX_FIXED_HEADER_LENGTH)
+	{
+		return FUNC_OPTS_ERROR;
+	}
+
+	decoder->buffer        = buffer;
+	decoder->buffer_length = buffer_length;
+	decoder->read_index    = 0;
+	decoder->write_index   = 0;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  static function to move partial packet to the start of decoder buffer
+ * @param  *decoder : pointer to mqtt decoder structure (mqtt_decoder_t).
+ * @retval None
+ */
+static void mqtt_decoder_compact(mqtt_decoder_t *decoder)
+{
+	size_t pending_length = 0;
+
+	if(decoder->read_index == 0)
+	{
+		return;
+	}
+
+	pending_length = decoder->write_index - decoder->read_index;
+
+	if(pending_length > 0)
+	{
+		memmove(decoder->buffer, decoder->buffer + decoder->read_index, pending_length);
+	}
+
+	decoder->read_index  = 0;
+	decoder->write_index = pending_length;
+}
+
+
+
+/*
+ * @brief  Returns free space of decoder buffer for reading input stream directly into it,
+ *         (packets returned by mqtt_decoder_next() are not valid after this call).
+ * @param  *decoder      : pointer to mqtt decoder structure (mqtt_decoder_t).
+ * @param  *free_length  : pointer to length of free space
+ * @retval uint8_t*      : pointer to free space, fail = NULL
+ */
+uint8_t *mqtt_decoder_buffer(mqtt_decoder_t *decoder, size_t *free_length)
+{
+	if(decoder == NULL || free_length == NULL)
+	{
+		return NULL;
+	}
+
+	mqtt_decoder_compact(decoder);
+
+	*free_length = decoder->buffer_length - decoder->write_index;
+
+	return decoder->buffer + decoder->write_index;
+}
+
+
+
+/*
+ * @brief  Adds bytes read into free space of decoder buffer to the input stream.
+ * @param  *decoder : pointer to mqtt decoder structure (mqtt_decoder_t).
+ * @param  length   : number of bytes read into buffer returned by mqtt_decoder_buffer()
+ * @retval int8_t   : 1 = Success, -1 = Error
+ */
+int8_t mqtt_decoder_commit(mqtt_decoder_t *decoder, size_t length)
+{
+	if(decoder == NULL || length > decoder->buffer_length - decoder->write_index)
+	{
+		return FUNC_OPTS_ERROR;
+	}
+
+	decoder->write_index += length;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Copies bytes of input stream into the decoder,
+ *         (packets returned by mqtt_decoder_next() are not valid after this call).
+ * @param  *decoder : pointer to mqtt decoder structure (mqtt_decoder_t).
+ * @param  *data    : input stream bytes, any chunk size
+ * @param  length   : number of input stream bytes
+ * @retval size_t   : number of bytes copied into decoder
+ */
+size_t mqtt_decoder_feed(mqtt_decoder_t *decoder, const void *data, size_t length)
+{
+	uint8_t *free_space  = NULL;
+	size_t   free_length = 0;
+
+	if(data == NULL)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	free_space = mqtt_decoder_buffer(decoder, &free_length);
+	if(free_space == NULL)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	if(length > free_length)
+	{
+		length = free_length;
+	}
+
+	memcpy(free_space, data, length);
+
+	decoder->write_index += length;
+
+	return length;
+}
+
+
+
+/*
+ * @brief  Returns next complete control packet from the input stream.
+ * @param  *decoder : pointer to mqtt decoder structure (mqtt_decoder_t).
+ * @param  *packet  : pointer to mqtt packet structure, points into decoder buffer
+ * @retval int8_t   : 1 = packet decoded, 0 = more bytes needed, -1 = malformed or packet larger than buffer
+ */
+int8_t mqtt_decoder_next(mqtt_decoder_t *decoder, mqtt_packet_t *packet)
+{
+	uint8_t  *packet_start    = NULL;
+	size_t   pending_length   = 0;
+	size_t   packet_length    = 0;
+	uint32_t remaining_length = 0;
+	int8_t   length_size      = 0;
+
+	if(decoder == NULL || packet == NULL)
+	{
+		return FUNC_OPTS_ERROR;
+	}
+
+	packet_start   = decoder->buffer + decoder->read_index;
+	pending_length = decoder->write_index - decoder->read_index;
+
+	/* Need at least message type and one byte of Remaining Length */
+	if(pending_length < FIXED_HEADER_LENGTH)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	length_size = mqtt_decode_remaining_length(packet_start + 1, pending_length - 1, &remaining_length);
+	if(length_size <= 0)
+	{
+		return length_size;
+	}
+
+	packet_length = 1 + length_size + remaining_length;
+
+	/* Packet can never be completed in decoder buffer */
+	if(packet_length > decoder->buffer_length)
+	{
+		return FUNC_OPTS_ERROR;
+	}
+
+	if(packet_length > pending_length)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	packet->message_type     = MQTT_HEADER_TYPE(packet_start[0]);
+	packet->flags            = packet_start[0] & 0x0F;
+	packet->remaining_length = remaining_length;
+	packet->packet           = packet_start;
+	packet->body             = packet_start + 1 + length_size;
+	packet->packet_length    = packet_length;
+
+	decoder->read_index += packet_length;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Initializes in-flight message table.
+ * @param  *inflight_table : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @retval int8_t          : 1 = Success, -1 = Error
+ */
+int8_t mqtt_inflight_init(mqtt_inflight_t *inflight_table)
+{
+	if(inflight_table == NULL)
+	{
+		return FUNC_OPTS_ERROR;
+	}
+
+	memset(inflight_table, 0, sizeof(mqtt_inflight_t));
+
+	inflight_table->window_size = MQTT_INFLIGHT_SLOTS;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Returns slot index of in-flight message.
+ * @param  *inflight_table : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @param  message_id      : message ID
+ * @retval int16_t         : slot index, -1 = message ID not in-flight
+ */
+int16_t mqtt_inflight_find(mqtt_inflight_t *inflight_table, uint16_t message_id)
+{
+	uint16_t slot_index = 0;
+	uint16_t probe      = 0;
+
+	if(inflight_table == NULL || message_id == 0)
+	{
+		return FUNC_OPTS_ERROR;
+	}
+
+	/* Linear probe from home slot, message IDs are sequential so home slot is hit in the common case */
+	slot_index = message_id & MQTT_INFLIGHT_SLOT_MASK;
+
+	for(probe = 0; probe < MQTT_INFLIGHT_SLOTS; probe++)
+	{
+		if(inflight_table->message_id[slot_index] == message_id)
+		{
+			return (int16_t)slot_index;
+		}
+
+		if(inflight_table->message_id[slot_index] == 0)
+		{
+			break;
+		}
+
+		slot_index = (slot_index + 1) & MQTT_INFLIGHT_SLOT_MASK;
+	}
+
+	return FUNC_OPTS_ERROR;
+}
+
+
+
+/*
+ * @brief  Allocates next free message ID and adds message to in-flight table,
+ *         IDs wrap around from 65535 to 1 and IDs still in-flight are skipped.
+ * @param  *inflight_table : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @param  state           : in-flight state of message
+ * @param  qos             : quality of service of message, acknowledgments of other flow are ignored
+ * @param  timestamp       : time of send
+ * @param  *buffer         : buffer holding the control packet, (NULL if not kept)
+ * @param  buffer_length   : length of control packet in buffer
+ * @retval uint16_t        : message ID, fail (table full) = 0
+ */
+uint16_t mqtt_inflight_acquire(mqtt_inflight_t *inflight_table, mqtt_inflight_state_t state, mqtt_qos_t qos, uint32_t timestamp,
+		                       void *buffer, size_t buffer_length)
+{
+	uint16_t message_id = 0;
+	uint16_t slot_index = 0;
+
+	/* Send window full */
+	if(inflight_table == NULL || inflight_table->count >= inflight_table->window_size)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	/* Skip message IDs still in-flight after wrap around */
+	do
+	{
+		message_id = mqtt_next_message_id(&inflight_table->next_message_id);
+
+	}while(mqtt_inflight_find(inflight_table, message_id) >= 0);
+
+	slot_index = message_id & MQTT_INFLIGHT_SLOT_MASK;
+
+	while(inflight_table->message_id[slot_index] != 0)
+	{
+		slot_index = (slot_index + 1) & MQTT_INFLIGHT_SLOT_MASK;
+	}
+
+	inflight_table->message_id[slot_index]    = message_id;
+	inflight_table->state[slot_index]         = (uint8_t)state;
+	inflight_table->qos[slot_index]           = (uint8_t)qos;
+	inflight_table->sequence[slot_index]      = ++inflight_table->next_sequence;
+	inflight_table->timestamp[slot_index]     = timestamp;
+	inflight_table->buffer[slot_index]        = buffer;
+	inflight_table->buffer_length[slot_index] = buffer_length;
+
+	inflight_table->count++;
+
+	return message_id;
+}
+
+
+
+/*
+ * @brief  Returns message ID of first in-flight message in state, (slot order, not send order).
+ * @param  *inflight_table : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @param  state           : in-flight state
+ * @retval uint16_t        : message ID, 0 = no message in state
+ */
+uint16_t mqtt_inflight_first(mqtt_inflight_t *inflight_table, mqtt_inflight_state_t state)
+{
+	uint16_t slot_index = 0;
+
+	if(inflight_table == NULL || inflight_table->count == 0)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	for(slot_index = 0; slot_index < MQTT_INFLIGHT_SLOTS; slot_index++)
+	{
+		if(inflight_table->message_id[slot_index] != 0 && inflight_table->state[slot_index] == (uint8_t)state)
+		{
+			return inflight_table->message_id[slot_index];
+		}
+	}
+
+	return MAIN_FUNC_ERROR;
+}
+
+
+
+/*
+ * @brief  Updates state and timestamp of in-flight message.
+ * @param  *inflight_table : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @param  message_id      : message ID
+ * @param  state           : new in-flight state of message
+ * @param  timestamp       : time of send
+ * @retval int8_t          : 1 = Success, -1 = message ID not in-flight
+ */
+int8_t mqtt_inflight_update(mqtt_inflight_t *inflight_table, uint16_t message_id, mqtt_inflight_state_t state, uint32_t timestamp)
+{
+	int16_t slot_index = 0;
+
+	slot_index = mqtt_inflight_find(inflight_table, message_id);
+	if(slot_index < 0)
+	{
+		return FUNC_OPTS_ERROR;
+	}
+
+	inflight_table->state[slot_index]     = (uint8_t)state;
+	inflight_table->timestamp[slot_index] = timestamp;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Removes message from in-flight table, message ID can be allocated again.
+ * @param  *inflight_table : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @param  message_id      : message ID
+ * @retval int8_t          : 1 = Success, -1 = message ID not in-flight
+ */
+int8_t mqtt_inflight_release(mqtt_inflight_t *inflight_table, uint16_t message_id)
+{
+	int16_t  slot_index  = 0;
+	uint16_t empty_index = 0;
+	uint16_t next_index  = 0;
+	uint16_t home_index  = 0;
+
+	slot_index = mqtt_inflight_find(inflight_table, message_id);
+	if(slot_index < 0)
+	{
+		return FUNC_OPTS_ERROR;
+	}
+
+	/* Backward shift deletion, keeps probe sequences intact without tombstones */
+	empty_index = (uint16_t)slot_index;
+	next_index  = (uint16_t)slot_index;
+
+	inflight_table->message_id[empty_index] = 0;
+
+	for(;;)
+	{
+		next_index = (next_index + 1) & MQTT_INFLIGHT_SLOT_MASK;
+
+		if(inflight_table->message_id[next_index] == 0)
+		{
+			break;
+		}
+
+		home_index = inflight_table->message_id[next_index] & MQTT_INFLIGHT_SLOT_MASK;
+
+		/* Move entry back if its home slot is not cyclically between the empty slot and its slot */
+		if(((next_index - home_index) & MQTT_INFLIGHT_SLOT_MASK) >= ((next_index - empty_index) & MQTT_INFLIGHT_SLOT_MASK))
+		{
+			inflight_table->message_id[empty_index]    = inflight_table->message_id[next_index];
+			inflight_table->state[empty_index]         = inflight_table->state[next_index];
+			inflight_table->qos[empty_index]           = inflight_table->qos[next_index];
+			inflight_table->sequence[empty_index]      = inflight_table->sequence[next_index];
+			inflight_table->timestamp[empty_index]     = inflight_table->timestamp[next_index];
+			inflight_table->buffer[empty_index]        = inflight_table->buffer[next_index];
+			inflight_table->buffer_length[empty_index] = inflight_table->buffer_length[next_index];
+
+			inflight_table->message_id[next_index] = 0;
+
+			empty_index = next_index;
+		}
+	}
+
+	inflight_table->state[empty_index]         = MQTT_INFLIGHT_FREE;
+	inflight_table->qos[empty_index]           = MQTT_QOS_FIRE_FORGET;
+	inflight_table->buffer[empty_index]        = NULL;
+	inflight_table->buffer_length[empty_index] = 0;
+
+	inflight_table->count--;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Configures send window, maximum number of unacknowledged messages.
+ * @param  *inflight_table : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @param  window_size     : send window size, (1 to MQTT_INFLIGHT_SLOTS)
+ * @retval int8_t          : 1 = Success, -1 = Error
+ */
+int8_t mqtt_inflight_window(mqtt_inflight_t *inflight_table, uint16_t window_size)
+{
+	if(inflight_table == NULL || window_size == 0 || window_size > MQTT_INFLIGHT_SLOTS)
+	{
+		return FUNC_OPTS_ERROR;
+	}
+
+	inflight_table->window_size = window_size;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Returns number of messages that can be sent before the send window is full.
+ * @param  *inflight_table : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @retval uint16_t        : free space in send window, 0 = window full
+ */
+uint16_t mqtt_inflight_available(mqtt_inflight_t *inflight_table)
+{
+	if(inflight_table == NULL || inflight_table->count >= inflight_table->window_size)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	return inflight_table->window_size - inflight_table->count;
+}
+
+
+
+/*
+ * @brief  Configures completion and barrier callbacks of in-flight table.
+ * @param  *inflight_table    : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @param  complete_callback  : called for each acknowledged message, (NULL for none)
+ * @param  barrier_callback   : called when pending barrier is reached, (NULL for none)
+ * @param  *context           : user context passed to callbacks
+ * @retval int8_t             : 1 = Success, -1 = Error
+ */
+int8_t mqtt_inflight_callbacks(mqtt_inflight_t *inflight_table, mqtt_complete_callback_t complete_callback,
+		                       mqtt_barrier_callback_t barrier_callback, void *context)
+{
+	if(inflight_table == NULL)
+	{
+		return FUNC_OPTS_ERROR;
+	}
+
+	inflight_table->complete_callback = complete_callback;
+	inflight_table->barrier_callback  = barrier_callback;
+	inflight_table->callback_context  = context;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Places barrier after the last message sent, barrier callback is called when
+ *         all messages sent before it are acknowledged, (replaces previous pending barrier).
+ * @param  *inflight_table : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @retval uint32_t        : barrier value for mqtt_inflight_barrier_done()
+ */
+uint32_t mqtt_inflight_barrier(mqtt_inflight_t *inflight_table)
+{
+	if(inflight_table == NULL)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	/* Nothing in-flight, barrier is reached now */
+	if(inflight_table->count == 0)
+	{
+		if(inflight_table->barrier_callback != NULL)
+		{
+			inflight_table->barrier_callback(inflight_table->callback_context, inflight_table->next_sequence);
+		}
+
+		inflight_table->barrier = 0;
+	}
+	else
+	{
+		inflight_table->barrier = inflight_table->next_sequence;
+	}
+
+	return inflight_table->next_sequence;
+}
+
+
+
+/*
+ * @brief  Checks if all messages sent before barrier are acknowledged.
+ * @param  *inflight_table : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @param  barrier         : barrier value from mqtt_inflight_barrier()
+ * @retval int8_t          : 1 = barrier reached, 0 = messages still in-flight, -1 = Error
+ */
+int8_t mqtt_inflight_barrier_done(mqtt_inflight_t *inflight_table, uint32_t barrier)
+{
+	uint16_t slot_index = 0;
+
+	if(inflight_table == NULL)
+	{
+		return FUNC_OPTS_ERROR;
+	}
+
+	for(slot_index = 0; slot_index < MQTT_INFLIGHT_SLOTS; slot_index++)
+	{
+		/* Sequence numbers compared wrap around safe */
+		if(inflight_table->message_id[slot_index] != 0 && (int32_t)(inflight_table->sequence[slot_index] - barrier) <= 0)
+		{
+			return MAIN_FUNC_ERROR;
+		}
+	}
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  static function to call completion callback, release message and check pending barrier
+ * @param  *inflight_table : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @param  slot_index      : slot index of acknowledged message
+ * @retval None
+ */
+static void mqtt_inflight_complete(mqtt_inflight_t *inflight_table, int16_t slot_index)
+{
+	uint16_t message_id = inflight_table->message_id[slot_index];
+
+	if(inflight_table->complete_callback != NULL)
+	{
+		inflight_table->complete_callback(inflight_table->callback_context, message_id,
+				                          inflight_table->buffer[slot_index], inflight_table->buffer_length[slot_index]);
+	}
+
+	mqtt_inflight_release(inflight_table, message_id);
+
+	if(inflight_table->barrier != 0 && mqtt_inflight_barrier_done(inflight_table, inflight_table->barrier) == FUNC_OPTS_SUCCESS)
+	{
+		if(inflight_table->barrier_callback != NULL)
+		{
+			inflight_table->barrier_callback(inflight_table->callback_context, inflight_table->barrier);
+		}
+
+		inflight_table->barrier = 0;
+	}
+}
+
+
+
+/*
+ * @brief  static function to read message ID from variable header of decoded packet
+ * @param  *packet  : pointer to decoded packet
+ * @retval uint16_t : message ID, fail = 0
+ */
+static uint16_t mqtt_packet_message_id(mqtt_packet_t *packet)
+{
+	if(packet == NULL || packet->remaining_length < MQTT_MESSAGE_ID_OFFSET)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	return mqtt_get_u16(packet->body);
+}
+
+
+
+/*
+ * @brief  Matches PUBACK message to in-flight qos 1 publish and releases its message ID,
+ *         acknowledgments can arrive in any order.
+ * @param  *inflight_table : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @param  *packet         : pointer to decoded PUBACK packet
+ * @retval int8_t          : 1 = message acknowledged, 0 = message ID not in-flight, -1 = Error
+ */
+int8_t mqtt_inflight_ack(mqtt_inflight_t *inflight_table, mqtt_packet_t *packet)
+{
+	int16_t slot_index = 0;
+
+	if(inflight_table == NULL || packet == NULL || packet->message_type != MQTT_PUBACK_MESSAGE)
+	{
+		return FUNC_OPTS_ERROR;
+	}
+
+	slot_index = mqtt_inflight_find(inflight_table, mqtt_packet_message_id(packet));
+
+	/* Duplicate or unknown acknowledgment, or PUBACK of qos 2 exchange */
+	if(slot_index < 0 || inflight_table->qos[slot_index] != MQTT_QOS_ATLEAST_ONCE ||
+	   inflight_table->state[slot_index] != MQTT_INFLIGHT_PUBLISH_SENT)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	mqtt_inflight_complete(inflight_table, slot_index);
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Runs publish acknowledgment flows of qos 1 and qos 2 messages, each message ID
+ *         moves through its own state so any number of exchanges are in progress at once.
+ *         PUBACK, PUBCOMP : message is completed and its message ID released.
+ *         PUBREC          : PUBREL is appended to output buffer at *output_used, (sent again on
+ *                           duplicate PUBREC), caller writes output buffer when convenient.
+ * @param  *inflight_table : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @param  *packet         : pointer to decoded PUBACK, PUBREC or PUBCOMP packet
+ * @param  timestamp       : time of PUBREL send, user defined units
+ * @param  *output         : buffer PUBREL messages are appended to
+ * @param  output_length   : length of output buffer
+ * @param  *output_used    : used length of output buffer, updated on append
+ * @retval int8_t          : 1 = packet handled, 0 = message ID not in-flight (ignored),
+ *                           -1 = Error or output buffer full, (packet not consumed, flush output and retry)
+ */
+int8_t mqtt_inflight_process(mqtt_inflight_t *inflight_table, mqtt_packet_t *packet, uint32_t timestamp,
+		                     uint8_t *output, size_t output_length, size_t *output_used)
+{
+	int16_t  slot_index = 0;
+	uint16_t message_id = 0;
+
+	if(inflight_table == NULL || packet == NULL)
+	{
+		return FUNC_OPTS_ERROR;
+	}
+
+	message_id = mqtt_packet_message_id(packet);
+	slot_index = mqtt_inflight_find(inflight_table, message_id);
+
+	switch(packet->message_type)
+	{
+	case MQTT_PUBACK_MESSAGE:
+
+		return mqtt_inflight_ack(inflight_table, packet);
+
+	case MQTT_PUBREC_MESSAGE:
+
+		if(output == NULL || output_used == NULL)
+		{
+			return FUNC_OPTS_ERROR;
+		}
+
+		/* Unknown message ID or not a qos 2 publish, (PUBREL_SENT is a repeated PUBREC, release is sent again) */
+		if(slot_index < 0 || inflight_table->qos[slot_index] != MQTT_QOS_EXACTLY_ONCE ||
+		   (inflight_table->state[slot_index] != MQTT_INFLIGHT_PUBLISH_SENT && inflight_table->state[slot_index] != MQTT_INFLIGHT_PUBREL_SENT &&
+		    inflight_table->state[slot_index] != MQTT_INFLIGHT_PUBREC_RECEIVED))
+		{
+			return MAIN_FUNC_ERROR;
+		}
+
+		if(*output_used > output_length ||
+		   mqtt_publish_release_encode(output + *output_used, output_length - *output_used, message_id) == 0)
+		{
+			return FUNC_OPTS_ERROR;
+		}
+
+		*output_used += MQTT_PUBREL_LENGTH;
+
+		inflight_table->state[slot_index]     = MQTT_INFLIGHT_PUBREL_SENT;
+		inflight_table->timestamp[slot_index] = timestamp;
+
+		return FUNC_OPTS_SUCCESS;
+
+	case MQTT_PUBCOMP_MESSAGE:
+
+		if(slot_index < 0 || inflight_table->qos[slot_index] != MQTT_QOS_EXACTLY_ONCE ||
+		   inflight_table->state[slot_index] != MQTT_INFLIGHT_PUBREL_SENT)
+		{
+			return MAIN_FUNC_ERROR;
+		}
+
+		mqtt_inflight_complete(inflight_table, slot_index);
+
+		return FUNC_OPTS_SUCCESS;
+
+	default:
+
+		return FUNC_OPTS_ERROR;
+	}
+}
+
+
+
+/*
+ * @brief  Rolls back all in-flight messages, (connection refused or closed before acknowledgment).
+ *         Requeue callback is called for each message in send order, then the table is emptied,
+ *         window, callbacks and message ID counter are kept.
+ * @param  *inflight_table   : pointer to mqtt in-flight table structure (mqtt_inflight_t).
+ * @param  requeue_callback  : called for each rolled back message, (NULL for none)
+ * @param  *context          : user context passed to requeue callback
+ * @retval uint16_t          : number of messages rolled back
+ */
+uint16_t mqtt_inflight_rollback(mqtt_inflight_t *inflight_table, mqtt_complete_callback_t requeue_callback, void *context)
+{
+	uint16_t rollback_count = 0;
+	uint16_t slot_index     = 0;
+	int32_t  oldest_index   = 0;
+	uint32_t last_sequence  = 0;
+	uint8_t  first_message  = 1;
+
+	if(inflight_table == NULL)
+	{
+		return MAIN_FUNC_ERROR;
+	}
+
+	rollback_count = inflight_table->count;
+
+	/* Oldest message first, selection scan is fine for this rare path */
+	if(requeue_callback != NULL)
+	{
+		for(;;)
+		{
+			oldest_index = -1;
+
+			for(slot_index = 0; slot_index < MQTT_INFLIGHT_SLOTS; slot_index++)
+			{
+				if(inflight_table->message_id[slot_index] == 0 ||
+				   (first_message == 0 && (int32_t)(inflight_table->sequence[slot_index] - last_sequence) <= 0))
+				{
+					continue;
+				}
+
+				if(oldest_index < 0 || (int32_t)(inflight_table->sequence[slot_index] - inflight_table->sequence[oldest_index]) < 0)
+				{
+					oldest_index = slot_index;
+				}
+			}
+
+			if(oldest_index < 0)
+			{
+				break;
+			}
+
+			last_sequence = inflight_table->sequence[oldest_index];
+			first_message = 0;
+
+			requeue_callback(context, inflight_table->message_id[oldest_index],
+					         inflight_table->buffer[oldest_index], inflight_table->buffer_length[oldest_index]);
+		}
+	}
+
+	memset(inflight_table->message_id, 0, sizeof(inflight_table->message_id));
+	memset(inflight_table->state, MQTT_INFLIGHT_FREE, sizeof(inflight_table->state));
+	memset(inflight_table->qos, MQTT_QOS_FIRE_FORGET, sizeof(inflight_table->qos));
+	memset(inflight_table->buffer, 0, sizeof(inflight_table->buffer));
+	memset(inflight_table->buffer_length, 0, sizeof(inflight_table->buffer_length));
+
+	inflight_table->count   = 0;
+	inflight_table->barrier = 0;
+
+	return rollback_count;
+}
@@ -0,0 +1,336 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_event_loop.c
+ * @author  Aditya Mall,
+ * @brief   MQTT client event loop
+ *
+ *  Info
+ *          Event loop API Source File, (Linux epoll)
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall, MIT License </center></h2>
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019 Aditya Mall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+/*
+ * Standard Header and API Header files
+ */
+#include <mqtt_event_loop.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                  Data Structures and Defines                               */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* return codes for event loop functions */
+typedef enum function_return_codes
+{
+	FUNC_OPTS_ERROR       = -1,  /*!< */
+	FUNC_OPTS_SUCCESS     = 1,   /*!< */
+
+}return_codes_t;
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                           Private Functions                                */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Converts event flags to epoll events.
+ * @param  events   : event flags (MQTT_EVENT_*)
+ * @retval uint32_t : epoll events
+ */
+static uint32_t mqtt_event_to_epoll(uint8_t events)
+{
+	uint32_t epoll_events = 0;
+
+	if(events & MQTT_EVENT_READ)
+		epoll_events |= EPOLLIN | EPOLLRDHUP;
+
+	if(events & MQTT_EVENT_WRITE)
+		epoll_events |= EPOLLOUT;
+
+	return epoll_events;
+}
+
+
+
+/*
+ * @brief  Converts ready epoll events to event flags.
+ * @param  epoll_events : ready epoll events
+ * @retval uint8_t      : event flags (MQTT_EVENT_*)
+ */
+static uint8_t mqtt_event_from_epoll(uint32_t epoll_events)
+{
+	uint8_t events = 0;
+
+	if(epoll_events & (EPOLLIN | EPOLLRDHUP))
+		events |= MQTT_EVENT_READ;
+
+	if(epoll_events & EPOLLOUT)
+		events |= MQTT_EVENT_WRITE;
+
+	if(epoll_events & (EPOLLERR | EPOLLHUP))
+		events |= MQTT_EVENT_ERROR;
+
+	return events;
+}
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                              API Functions                                 */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Creates event loop.
+ * @param  *loop  : pointer to event loop structure (mqtt_event_loop_t).
+ * @retval int8_t : 1 = Success, -1 = Error
+ */
+int8_t mqtt_event_loop_init(mqtt_event_loop_t *loop)
+{
+	if(loop == NULL)
+		return FUNC_OPTS_ERROR;
+
+	loop->source_count   = 0;
+	loop->dispatch       = NULL;
+	loop->dispatch_next  = 0;
+	loop->dispatch_count = 0;
+
+	loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+	if(loop->epoll_fd < 0)
+		return FUNC_OPTS_ERROR;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Registers file descriptor with event loop, (level triggered).
+ * @param  *loop     : pointer to event loop structure (mqtt_event_loop_t).
+ * @param  *source   : pointer to event source storage, (owned by user)
+ * @param  fd        : file descriptor, (non blocking socket)
+ * @param  events    : event flags to wait for (MQTT_EVENT_READ | MQTT_EVENT_WRITE)
+ * @param  callback  : called on ready events, (NULL for none)
+ * @param  *context  : user context passed to callback
+ * @retval int8_t    : 1 = Success, -1 = Error
+ */
+int8_t mqtt_event_loop_add(mqtt_event_loop_t *loop, mqtt_event_source_t *source, int fd, uint8_t events,
+		                   mqtt_event_callback_t callback, void *context)
+{
+	struct epoll_event event;
+
+	if(loop == NULL || source == NULL || fd < 0)
+		return FUNC_OPTS_ERROR;
+
+	source->fd       = fd;
+	source->events   = events;
+	source->revents  = 0;
+	source->callback = callback;
+	source->context  = context;
+
+	event.events   = mqtt_event_to_epoll(events);
+	event.data.ptr = source;
+
+	if(epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)
+		return FUNC_OPTS_ERROR;
+
+	loop->source_count++;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Changes event flags of registered source, (e.g. wait for write only while output is pending).
+ * @param  *loop    : pointer to event loop structure (mqtt_event_loop_t).
+ * @param  *source  : pointer to registered event source
+ * @param  events   : new event flags
+ * @retval int8_t   : 1 = Success, -1 = Error
+ */
+int8_t mqtt_event_loop_modify(mqtt_event_loop_t *loop, mqtt_event_source_t *source, uint8_t events)
+{
+	struct epoll_event event;
+
+	if(loop == NULL || source == NULL)
+		return FUNC_OPTS_ERROR;
+
+	/* Skip system call when nothing changes */
+	if(source->events == events)
+		return FUNC_OPTS_SUCCESS;
+
+	event.events   = mqtt_event_to_epoll(events);
+	event.data.ptr = source;
+
+	if(epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, source->fd, &event) < 0)
+		return FUNC_OPTS_ERROR;
+
+	source->events = events;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Removes source from event loop, file descriptor is not closed. Callback of removed source
+ *         is not called from events still pending in current run, so callbacks may remove and free
+ *         other sources.
+ * @param  *loop    : pointer to event loop structure (mqtt_event_loop_t).
+ * @param  *source  : pointer to registered event source
+ * @retval int8_t   : 1 = Success, -1 = Error
+ */
+int8_t mqtt_event_loop_remove(mqtt_event_loop_t *loop, mqtt_event_source_t *source)
+{
+	struct epoll_event *ready_events = NULL;
+	int                 index        = 0;
+
+	if(loop == NULL || source == NULL)
+		return FUNC_OPTS_ERROR;
+
+	if(epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, source->fd, NULL) < 0)
+		return FUNC_OPTS_ERROR;
+
+	/* Source removed by callback can be freed, its pending ready events are dropped */
+	if(loop->dispatch != NULL)
+	{
+		ready_events = (struct epoll_event*)loop->dispatch;
+
+		for(index = loop->dispatch_next; index < loop->dispatch_count; index++)
+		{
+			if(ready_events[index].data.ptr == source)
+				ready_events[index].data.ptr = NULL;
+		}
+	}
+
+	loop->source_count--;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Sleeps until a registered source is ready or timeout expires, then calls callbacks
+ *         of ready sources, no CPU is used while waiting. Must not be called from a callback.
+ * @param  *loop       : pointer to event loop structure (mqtt_event_loop_t).
+ * @param  timeout_ms  : timeout in milliseconds, (-1 to wait forever, 0 to poll)
+ * @retval int         : number of ready sources, 0 = timeout expired or interrupted, -1 = Error
+ */
+int mqtt_event_loop_run(mqtt_event_loop_t *loop, int timeout_ms)
+{
+	struct epoll_event  ready_events[EVENT_LOOP_MAX_EVENTS];
+	mqtt_event_source_t *source = NULL;
+
+	int ready_count = 0;
+	int index       = 0;
+
+	if(loop == NULL)
+		return FUNC_OPTS_ERROR;
+
+	ready_count = epoll_wait(loop->epoll_fd, ready_events, EVENT_LOOP_MAX_EVENTS, timeout_ms);
+
+	if(ready_count < 0)
+	{
+		/* Signal before any event, caller checks its timers and runs again */
+		if(errno == EINTR)
+			return 0;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	/* Set ready flags of all sources first, a callback can look at other sources */
+	for(index = 0; index < ready_count; index++)
+	{
+		source = (mqtt_event_source_t*)ready_events[index].data.ptr;
+
+		source->revents = mqtt_event_from_epoll(ready_events[index].events);
+	}
+
+	loop->dispatch       = ready_events;
+	loop->dispatch_count = ready_count;
+
+	for(index = 0; index < ready_count; index++)
+	{
+		source = (mqtt_event_source_t*)ready_events[index].data.ptr;
+
+		loop->dispatch_next = index + 1;
+
+		/* Removed by earlier callback of this run */
+		if(source != NULL && source->callback != NULL)
+			source->callback(source->context, source->fd, source->revents);
+	}
+
+	loop->dispatch       = NULL;
+	loop->dispatch_next  = 0;
+	loop->dispatch_count = 0;
+
+	return ready_count;
+}
+
+
+
+/*
+ * @brief  Closes event loop, registered file descriptors are not closed.
+ * @param  *loop  : pointer to event loop structure (mqtt_event_loop_t).
+ * @retval int8_t : 1 = Success, -1 = Error
+ */
+int8_t mqtt_event_loop_close(mqtt_event_loop_t *loop)
+{
+	if(loop == NULL || loop->epoll_fd < 0)
+		return FUNC_OPTS_ERROR;
+
+	if(close(loop->epoll_fd) < 0)
+		return FUNC_OPTS_ERROR;
+
+	loop->epoll_fd     = -1;
+	loop->source_count = 0;
+
+	return FUNC_OPTS_SUCCESS;
+}
@@ -0,0 +1,523 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_ingest.c
+ * @author  Aditya Mall,
+ * @brief   MQTT client shared memory ingest queue
+ *
+ *  Info
+ *          Ingest queue API Source File, (Linux memfd, unix domain socket)
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall, MIT License </center></h2>
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019 Aditya Mall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+
+/*
+ * Standard Header and API Header files
+ */
+#define _GNU_SOURCE
+#include <mqtt_ingest.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                  Data Structures and Defines                               */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* @brief Descriptors passed to producer, segment and doorbell */
+#define INGEST_DESCRIPTORS  2
+
+
+/* return codes for ingest functions */
+typedef enum function_return_codes
+{
+	FUNC_OPTS_ERROR       = -1,  /*!< */
+	FUNC_OPTS_SUCCESS     = 1,   /*!< */
+
+}return_codes_t;
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                           Private Functions                                */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Fills unix socket address of path.
+ * @param  *address  : socket address
+ * @param  *path     : unix socket path
+ * @retval int8_t    : 1 = Success, -1 = Error (errno is set, ENAMETOOLONG = path does not fit)
+ */
+static int8_t mqtt_ingest_address(struct sockaddr_un *address, const char *path)
+{
+	if(path == NULL || path[0] == '\0' || strlen(path) >= sizeof(address->sun_path))
+	{
+		errno = (path == NULL || path[0] == '\0') ? EINVAL : ENAMETOOLONG;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	memset(address, 0, sizeof(struct sockaddr_un));
+
+	address->sun_family = AF_UNIX;
+
+	strcpy(address->sun_path, path);
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Sends segment and doorbell descriptors on connected unix socket.
+ * @param  *ingest      : pointer to ingest structure (mqtt_ingest_t).
+ * @param  descriptor   : producer connection
+ * @retval int8_t       : 1 = Success, -1 = Error (errno is set)
+ */
+static int8_t mqtt_ingest_send(mqtt_ingest_t *ingest, int descriptor)
+{
+	struct msghdr   message;
+	struct iovec    vector;
+	struct cmsghdr *control = NULL;
+	int             descriptors[INGEST_DESCRIPTORS];
+	char            tag     = 'Q';
+
+	union
+	{
+		char           buffer[CMSG_SPACE(sizeof(descriptors))];
+		struct cmsghdr align;
+	}control_buffer;
+
+	descriptors[0] = ingest->memfd;
+	descriptors[1] = ingest->queue.doorbell;
+
+	vector.iov_base = &tag;
+	vector.iov_len  = sizeof(tag);
+
+	memset(&message, 0, sizeof(message));
+	memset(&control_buffer, 0, sizeof(control_buffer));
+
+	message.msg_iov        = &vector;
+	message.msg_iovlen     = 1;
+	message.msg_control    = control_buffer.buffer;
+	message.msg_controllen = sizeof(control_buffer.buffer);
+
+	control = CMSG_FIRSTHDR(&message);
+
+	control->cmsg_level = SOL_SOCKET;
+	control->cmsg_type  = SCM_RIGHTS;
+	control->cmsg_len   = CMSG_LEN(sizeof(descriptors));
+
+	memcpy(CMSG_DATA(control), descriptors, sizeof(descriptors));
+
+	if(sendmsg(descriptor, &message, MSG_NOSIGNAL) < 0)
+		return FUNC_OPTS_ERROR;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Closes descriptors of rejected hand off message, so peer can not leak descriptors into producer.
+ * @param  *message   : received message
+ * @retval None
+ */
+static void mqtt_ingest_discard(struct msghdr *message)
+{
+	struct cmsghdr *control = NULL;
+	int             received = -1;
+	size_t          index    = 0;
+
+	for(control = CMSG_FIRSTHDR(message); control != NULL; control = CMSG_NXTHDR(message, control))
+	{
+		if(control->cmsg_level != SOL_SOCKET || control->cmsg_type != SCM_RIGHTS)
+			continue;
+
+		for(index = 0; index < (control->cmsg_len - CMSG_LEN(0)) / sizeof(int); index++)
+		{
+			memcpy(&received, CMSG_DATA(control) + index * sizeof(int), sizeof(int));
+
+			close(received);
+		}
+	}
+}
+
+
+
+/*
+ * @brief  Receives segment and doorbell descriptors from owner.
+ * @param  descriptor     : connection to owner
+ * @param  *descriptors   : received descriptors, (INGEST_DESCRIPTORS)
+ * @retval int8_t         : 1 = Success, -1 = Error (errno is set)
+ */
+static int8_t mqtt_ingest_receive(int descriptor, int *descriptors)
+{
+	struct msghdr   message;
+	struct iovec    vector;
+	struct cmsghdr *control = NULL;
+	char            tag     = 0;
+
+	union
+	{
+		char           buffer[CMSG_SPACE(sizeof(int) * INGEST_DESCRIPTORS)];
+		struct cmsghdr align;
+	}control_buffer;
+
+	vector.iov_base = &tag;
+	vector.iov_len  = sizeof(tag);
+
+	memset(&message, 0, sizeof(message));
+
+	message.msg_iov        = &vector;
+	message.msg_iovlen     = 1;
+	message.msg_control    = control_buffer.buffer;
+	message.msg_controllen = sizeof(control_buffer.buffer);
+
+	if(recvmsg(descriptor, &message, MSG_CMSG_CLOEXEC) <= 0)
+		return FUNC_OPTS_ERROR;
+
+	control = CMSG_FIRSTHDR(&message);
+
+	if(tag != 'Q' || control == NULL || control->cmsg_level != SOL_SOCKET || control->cmsg_type != SCM_RIGHTS ||
+	   control->cmsg_len != CMSG_LEN(sizeof(int) * INGEST_DESCRIPTORS) || (message.msg_flags & MSG_CTRUNC))
+	{
+		mqtt_ingest_discard(&message);
+
+		errno = EPROTO;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	memcpy(descriptors, CMSG_DATA(control), sizeof(int) * INGEST_DESCRIPTORS);
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                              API Functions                                 */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Creates memfd segment with publish queue and listens on unix socket for producers, (owner).
+ * @param  *ingest       : pointer to ingest structure (mqtt_ingest_t).
+ * @param  *path         : unix socket path, existing socket is replaced, (EEXIST = path is not a socket)
+ * @param  cell_size     : size of one cell, multiple of 4, limits topic and message length
+ * @param  cell_count    : number of cells, power of 2
+ * @param  *group        : notification group of owner, its eventfd is doorbell of producers
+ * @retval int8_t        : 1 = Success, -1 = Error (errno is set)
+ */
+int8_t mqtt_ingest_open(mqtt_ingest_t *ingest, const char *path, uint32_t cell_size, uint32_t cell_count, mqtt_notify_t *group)
+{
+	struct sockaddr_un address;
+	struct stat        path_status;
+
+	if(ingest == NULL || group == NULL || mqtt_ingest_address(&address, path) < 0)
+	{
+		if(errno != ENAMETOOLONG)
+			errno = EINVAL;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	memset(ingest, 0, sizeof(mqtt_ingest_t));
+
+	ingest->memfd          = -1;
+	ingest->listen_fd      = -1;
+	ingest->queue.doorbell = -1;
+	ingest->segment        = MAP_FAILED;
+	ingest->segment_size   = MQTT_QUEUE_STORAGE_SIZE(cell_size, cell_count);
+
+	/* Segment size is sealed, producers can not truncate it under owner */
+	ingest->memfd = memfd_create("mqtt_ingest", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+
+	if(ingest->memfd < 0 || ftruncate(ingest->memfd, (off_t)ingest->segment_size) < 0 ||
+	   fcntl(ingest->memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0)
+	{
+		mqtt_ingest_close(ingest);
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	ingest->segment = mmap(NULL, ingest->segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, ingest->memfd, 0);
+
+	if(ingest->segment == MAP_FAILED)
+	{
+		mqtt_ingest_close(ingest);
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	if(mqtt_queue_init(&ingest->queue, ingest->segment, cell_size, cell_count, group) < 0)
+	{
+		mqtt_ingest_close(ingest);
+
+		errno = EINVAL;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	ingest->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+	if(ingest->listen_fd < 0)
+	{
+		mqtt_ingest_close(ingest);
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	/* Socket left by previous owner is replaced, any other file is kept */
+	if(lstat(path, &path_status) == 0)
+	{
+		if(!S_ISSOCK(path_status.st_mode))
+		{
+			mqtt_ingest_close(ingest);
+
+			errno = EEXIST;
+
+			return FUNC_OPTS_ERROR;
+		}
+
+		unlink(path);
+	}
+
+	if(bind(ingest->listen_fd, (struct sockaddr*)&address, sizeof(address)) < 0)
+	{
+		mqtt_ingest_close(ingest);
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	strcpy(ingest->path, path);
+
+	/* Only user of owner may connect, mode is set before socket accepts connections */
+	if(chmod(path, S_IRUSR | S_IWUSR) < 0 || listen(ingest->listen_fd, SOMAXCONN) < 0)
+	{
+		mqtt_ingest_close(ingest);
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Returns listening socket, readable when producers wait to attach, (owner).
+ * @param  *ingest   : pointer to ingest structure (mqtt_ingest_t).
+ * @retval int       : descriptor, -1 = Error
+ */
+int mqtt_ingest_fd(mqtt_ingest_t *ingest)
+{
+	if(ingest == NULL)
+		return FUNC_OPTS_ERROR;
+
+	return ingest->listen_fd;
+}
+
+
+
+/*
+ * @brief  Gives segment and doorbell to waiting producers of same user as owner, (owner, does not block).
+ * @param  *ingest   : pointer to ingest structure (mqtt_ingest_t).
+ * @retval int       : producers attached, -1 = Error (errno is set)
+ */
+int mqtt_ingest_accept(mqtt_ingest_t *ingest)
+{
+	struct ucred credentials;
+	socklen_t    credentials_length = sizeof(credentials);
+	int          descriptor         = -1;
+	int          count              = 0;
+
+	if(ingest == NULL || ingest->listen_fd < 0)
+	{
+		errno = EINVAL;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	while((descriptor = accept4(ingest->listen_fd, NULL, NULL, SOCK_CLOEXEC)) >= 0)
+	{
+		/* Segment is writable, producers of other users are refused */
+		credentials_length = sizeof(credentials);
+
+		if(getsockopt(descriptor, SOL_SOCKET, SO_PEERCRED, &credentials, &credentials_length) < 0 || credentials.uid != geteuid())
+		{
+			close(descriptor);
+
+			continue;
+		}
+
+		/* Producer that went away is skipped, connection is only used for hand off */
+		if(mqtt_ingest_send(ingest, descriptor) > 0)
+		{
+			ingest->attached++;
+
+			count++;
+		}
+
+		close(descriptor);
+	}
+
+	if(errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNABORTED && errno != EINTR)
+		return FUNC_OPTS_ERROR;
+
+	return count;
+}
+
+
+
+/*
+ * @brief  Maps queue of owner listening on path, publishes are then queued with mqtt_enqueue_publish()
+ *         on ingest->queue without system calls, (doorbell is written only when owner sleeps).
+ * @param  *ingest   : pointer to ingest structure (mqtt_ingest_t).
+ * @param  *path     : unix socket path of owner
+ * @retval int8_t    : 1 = Success, -1 = Error (errno is set)
+ */
+int8_t mqtt_ingest_connect(mqtt_ingest_t *ingest, const char *path)
+{
+	struct sockaddr_un address;
+	struct stat        segment_status;
+	int                descriptors[INGEST_DESCRIPTORS] = {-1, -1};
+	int                descriptor  = -1;
+	int8_t             retval      = FUNC_OPTS_ERROR;
+
+	if(ingest == NULL || mqtt_ingest_address(&address, path) < 0)
+	{
+		if(errno != ENAMETOOLONG)
+			errno = EINVAL;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	memset(ingest, 0, sizeof(mqtt_ingest_t));
+
+	ingest->memfd          = -1;
+	ingest->listen_fd      = -1;
+	ingest->queue.doorbell = -1;
+	ingest->segment        = MAP_FAILED;
+
+	descriptor = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+	if(descriptor < 0 || connect(descriptor, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+	   mqtt_ingest_receive(descriptor, descriptors) < 0)
+	{
+		if(descriptor >= 0)
+			close(descriptor);
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	close(descriptor);
+
+	if(fstat(descriptors[0], &segment_status) == 0 && segment_status.st_size > 0)
+	{
+		ingest->segment_size = (size_t)segment_status.st_size;
+		ingest->segment      = mmap(NULL, ingest->segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptors[0], 0);
+	}
+
+	/* Mapping keeps segment, descriptor is not needed by producer */
+	close(descriptors[0]);
+
+	ingest->queue.doorbell = descriptors[1];
+
+	if(ingest->segment != MAP_FAILED)
+		retval = mqtt_queue_attach(&ingest->queue, ingest->segment, ingest->segment_size, descriptors[1]);
+
+	if(retval < 0)
+	{
+		mqtt_ingest_close(ingest);
+
+		errno = EPROTO;
+	}
+
+	return retval;
+}
+
+
+
+/*
+ * @brief  Unmaps segment and closes descriptors, owner also removes unix socket path.
+ * @param  *ingest   : pointer to ingest structure (mqtt_ingest_t).
+ * @retval int8_t    : 1 = Success, -1 = Error
+ */
+int8_t mqtt_ingest_close(mqtt_ingest_t *ingest)
+{
+	if(ingest == NULL)
+		return FUNC_OPTS_ERROR;
+
+	if(ingest->segment != MAP_FAILED && ingest->segment != NULL)
+		munmap(ingest->segment, ingest->segment_size);
+
+	if(ingest->memfd >= 0)
+		close(ingest->memfd);
+
+	if(ingest->listen_fd >= 0)
+		close(ingest->listen_fd);
+
+	/* Doorbell of producer was received from owner, owner doorbell belongs to its group */
+	if(ingest->queue.group == NULL && ingest->queue.doorbell >= 0)
+		close(ingest->queue.doorbell);
+
+	if(ingest->path[0] != '\0')
+		unlink(ingest->path);
+
+	memset(ingest, 0, sizeof(mqtt_ingest_t));
+
+	ingest->memfd          = -1;
+	ingest->listen_fd      = -1;
+	ingest->queue.doorbell = -1;
+
+	return FUNC_OPTS_SUCCESS;
+}
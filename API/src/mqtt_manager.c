@@ -0,0 +1,707 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_manager.c
+ * @author  Aditya Mall,
+ * @brief   MQTT client connection manager
+ *
+ *  Info
+ *          Connection manager API Source File
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall, MIT License </center></h2>
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019 Aditya Mall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+
+/*
+ * Standard Header and API Header files
+ */
+#include <mqtt_manager.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                  Data Structures and Defines                               */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* return codes for manager functions */
+typedef enum function_return_codes
+{
+	FUNC_OPTS_ERROR       = -1,  /*!< */
+	FUNC_OPTS_SUCCESS     = 1,   /*!< */
+
+}return_codes_t;
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                           Private Functions                                */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Takes item from pool, released items first, then never used items.
+ * @param  **free_list  : list of released items, linked through first bytes of item
+ * @param  *pool        : pool memory
+ * @param  item_size    : size of item
+ * @param  *next        : index of first never used item
+ * @param  count        : number of items in pool
+ * @retval void*        : item, NULL = pool empty
+ */
+static void *mqtt_manager_take(void **free_list, uint8_t *pool, size_t item_size, uint32_t *next, uint32_t count)
+{
+	void *item = *free_list;
+
+	if(item != NULL)
+	{
+		memcpy(free_list, item, sizeof(void*));
+
+		return item;
+	}
+
+	/* Pages of never used items are not touched */
+	if(*next == count)
+		return NULL;
+
+	return pool + (size_t)(*next)++ * item_size;
+}
+
+
+
+/*
+ * @brief  Returns item to pool.
+ * @param  **free_list  : list of released items
+ * @param  *item        : released item
+ * @retval None
+ */
+static void mqtt_manager_give(void **free_list, void *item)
+{
+	memcpy(item, free_list, sizeof(void*));
+
+	*free_list = item;
+}
+
+
+
+/*
+ * @brief  Takes buffer from pool.
+ * @param  *manager  : pointer to manager structure (mqtt_manager_t).
+ * @retval uint8_t*  : buffer of MANAGER_BLOCK_SIZE, NULL = pool empty (errno is set)
+ */
+static uint8_t *mqtt_manager_block(mqtt_manager_t *manager)
+{
+	uint8_t *block = mqtt_manager_take(&manager->free_blocks, manager->blocks, MANAGER_BLOCK_SIZE,
+			                           &manager->block_next, manager->block_count);
+
+	if(block == NULL)
+	{
+		errno = ENOBUFS;
+
+		return NULL;
+	}
+
+	if(++manager->block_lent > manager->block_peak)
+		manager->block_peak = manager->block_lent;
+
+	return block;
+}
+
+
+
+/*
+ * @brief  Returns buffer to pool.
+ * @param  *manager  : pointer to manager structure (mqtt_manager_t).
+ * @param  *block    : buffer taken with mqtt_manager_block()
+ * @retval None
+ */
+static void mqtt_manager_unblock(mqtt_manager_t *manager, uint8_t *block)
+{
+	mqtt_manager_give(&manager->free_blocks, block);
+
+	manager->block_lent--;
+}
+
+
+
+/*
+ * @brief  Adds slot to end of ready list, slot is in list once.
+ * @param  *manager  : pointer to manager structure (mqtt_manager_t).
+ * @param  *slot     : session slot
+ * @retval None
+ */
+static void mqtt_manager_ready(mqtt_manager_t *manager, mqtt_manager_slot_t *slot)
+{
+	if(slot->ready)
+		return;
+
+	slot->ready = 1;
+	slot->next  = NULL;
+
+	if(manager->ready_tail != NULL)
+		manager->ready_tail->next = slot;
+	else
+		manager->ready_head = slot;
+
+	manager->ready_tail = slot;
+}
+
+
+
+/*
+ * @brief  Session event callback of all slots, keep alive makes slot ready, other events go to user.
+ * @param  *context  : session slot
+ * @param  *session  : session of slot
+ * @param  *event    : session event
+ * @retval None
+ */
+static void mqtt_manager_event(void *context, mqtt_session_t *session, const mqtt_session_event_t *event)
+{
+	mqtt_manager_slot_t *slot = (mqtt_manager_slot_t*)context;
+
+	if(event->type == MQTT_SESSION_EVENT_KEEPALIVE)
+	{
+		mqtt_manager_ready(slot->manager, slot);
+
+		return;
+	}
+
+	if(slot->manager->callback != NULL)
+		slot->manager->callback(slot->context, session, event);
+}
+
+
+
+/*
+ * @brief  Event loop callback of session sockets, makes slot ready.
+ * @param  *context  : session slot
+ * @param  fd        : socket descriptor
+ * @param  events    : ready events
+ * @retval None
+ */
+static void mqtt_manager_socket(void *context, int fd, uint8_t events)
+{
+	mqtt_manager_slot_t *slot = (mqtt_manager_slot_t*)context;
+
+	(void)fd;
+	(void)events;
+
+	mqtt_manager_ready(slot->manager, slot);
+}
+
+
+
+/*
+ * @brief  Attaches pooled buffer to output of session.
+ * @param  *manager  : pointer to manager structure (mqtt_manager_t).
+ * @param  *session  : session of manager
+ * @retval int8_t    : 1 = Success, -1 = Error (errno is set, ENOBUFS = pool empty)
+ */
+static int8_t mqtt_manager_attach(mqtt_manager_t *manager, mqtt_session_t *session)
+{
+	uint8_t *block = NULL;
+
+	if(session->output.buffer != NULL)
+		return FUNC_OPTS_SUCCESS;
+
+	block = mqtt_manager_block(manager);
+	if(block == NULL)
+		return FUNC_OPTS_ERROR;
+
+	mqtt_output_attach(&session->output, block, MANAGER_BLOCK_SIZE);
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Returns buffers and in-flight table of idle session to pools.
+ * @param  *manager  : pointer to manager structure (mqtt_manager_t).
+ * @param  *session  : session of manager
+ * @retval None
+ */
+static void mqtt_manager_detach(mqtt_manager_t *manager, mqtt_session_t *session)
+{
+	mqtt_inflight_t *table  = session->inflight_table;
+	uint8_t         *buffer = session->output.buffer;
+
+	if(buffer != NULL && mqtt_output_attach(&session->output, NULL, 0) > 0)
+		mqtt_manager_unblock(manager, buffer);
+
+	/* Decoder of decoded input goes back to shared receive buffer */
+	buffer = session->decoder.buffer;
+
+	if(buffer != manager->receive && session->decoder.read_index == session->decoder.write_index)
+	{
+		mqtt_decoder_init(&session->decoder, manager->receive, MANAGER_BLOCK_SIZE);
+
+		mqtt_manager_unblock(manager, buffer);
+	}
+
+	if(table != NULL && mqtt_session_inflight(session, NULL) > 0)
+	{
+		mqtt_manager_give(&manager->free_tables, table);
+
+		manager->table_lent--;
+	}
+}
+
+
+
+/*
+ * @brief  Moves partial packet out of shared receive buffer into pooled buffer of session.
+ * @param  *manager  : pointer to manager structure (mqtt_manager_t).
+ * @param  *session  : session of manager
+ * @retval int8_t    : 1 = Success, -1 = Error (errno is set, ENOBUFS = pool empty)
+ */
+static int8_t mqtt_manager_keep(mqtt_manager_t *manager, mqtt_session_t *session)
+{
+	mqtt_decoder_t *decoder = &session->decoder;
+	uint8_t        *block   = NULL;
+	size_t          offset  = decoder->read_index;
+	size_t          length  = decoder->write_index - decoder->read_index;
+
+	if(decoder->buffer != manager->receive || length == 0)
+		return FUNC_OPTS_SUCCESS;
+
+	block = mqtt_manager_block(manager);
+	if(block == NULL)
+		return FUNC_OPTS_ERROR;
+
+	mqtt_decoder_init(decoder, block, MANAGER_BLOCK_SIZE);
+	mqtt_decoder_feed(decoder, manager->receive + offset, length);
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Releases slot of closed session, socket is closed and buffers are returned.
+ * @param  *manager  : pointer to manager structure (mqtt_manager_t).
+ * @param  *slot     : session slot
+ * @retval None
+ */
+static void mqtt_manager_release(mqtt_manager_t *manager, mqtt_manager_slot_t *slot)
+{
+	mqtt_session_t *session = &slot->session;
+
+	mqtt_event_loop_remove(&manager->loop, &slot->source);
+
+	close(session->descriptor);
+
+	/* Unsent output, in-flight messages and undecoded input are dropped with session */
+	mqtt_output_discard(&session->output);
+
+	if(session->inflight_table != NULL)
+		mqtt_inflight_rollback(session->inflight_table, NULL, NULL);
+
+	mqtt_decoder_init(&session->decoder, session->decoder.buffer, session->decoder.buffer_length);
+
+	mqtt_manager_detach(manager, session);
+
+	slot->manager = NULL;
+	slot->next    = manager->free_slots;
+
+	manager->free_slots = slot;
+	manager->session_count--;
+}
+
+
+
+/*
+ * @brief  Polls session of ready slot, output is written and unused buffers are returned.
+ * @param  *manager  : pointer to manager structure (mqtt_manager_t).
+ * @param  *slot     : session slot
+ * @param  now       : current time, from mqtt_timer_now()
+ * @retval None
+ */
+static void mqtt_manager_service(mqtt_manager_t *manager, mqtt_manager_slot_t *slot, uint32_t now)
+{
+	mqtt_session_t *session = &slot->session;
+	int             count   = 0;
+
+	if(session->state != MQTT_SESSION_CLOSED)
+	{
+		/* Pool empty, slot is tried again by next run */
+		if(mqtt_manager_attach(manager, session) < 0)
+		{
+			mqtt_manager_ready(manager, slot);
+
+			return;
+		}
+
+		/* Shared receive buffer holds no input of other sessions */
+		if(session->decoder.buffer == manager->receive)
+			mqtt_decoder_init(&session->decoder, manager->receive, MANAGER_BLOCK_SIZE);
+
+		count = mqtt_client_poll(session, now, MANAGER_POLL_BUDGET);
+
+		/* Decoder may hold more packets */
+		if(count == MANAGER_POLL_BUDGET)
+			mqtt_manager_ready(manager, slot);
+
+		if(session->state != MQTT_SESSION_CLOSED && mqtt_manager_keep(manager, session) < 0)
+			mqtt_session_abort(session, ENOBUFS);
+
+		/* Packets of this poll are written together */
+		if(session->state != MQTT_SESSION_CLOSED && !session->output.stalled && mqtt_output_pending(&session->output) > 0 &&
+		   mqtt_output_flush(&session->output) < 0 && errno != EAGAIN)
+			mqtt_session_abort(session, errno);
+	}
+
+	/* Slot made ready again from its own callbacks is released when it is serviced */
+	if(session->state == MQTT_SESSION_CLOSED)
+	{
+		if(!slot->ready)
+			mqtt_manager_release(manager, slot);
+
+		return;
+	}
+
+	mqtt_manager_detach(manager, session);
+
+	mqtt_event_loop_modify(&manager->loop, &slot->source, mqtt_session_events(session));
+}
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                              API Functions                                 */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Allocates session slots and pools of manager, (MANAGER_BLOCK_SIZE buffers).
+ * @param  *manager      : pointer to manager structure (mqtt_manager_t).
+ * @param  slot_count    : most open sessions
+ * @param  block_count   : pooled buffers, most sessions with pending output or partial input
+ * @param  table_count   : pooled in-flight tables, most sessions with qos 1, 2 publish in flight
+ * @param  callback      : event callback of all sessions, context of session is given
+ * @retval int8_t        : 1 = Success, -1 = Error (errno is set)
+ */
+int8_t mqtt_manager_init(mqtt_manager_t *manager, uint32_t slot_count, uint32_t block_count, uint32_t table_count,
+		                 mqtt_session_callback_t callback)
+{
+	if(manager == NULL || slot_count == 0 || block_count == 0)
+	{
+		errno = EINVAL;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	memset(manager, 0, sizeof(mqtt_manager_t));
+
+	manager->callback    = callback;
+	manager->slot_count  = slot_count;
+	manager->block_count = block_count;
+	manager->table_count = table_count;
+
+	/* Untouched pages of pools are not backed by memory until used */
+	manager->slots   = malloc((size_t)slot_count * sizeof(mqtt_manager_slot_t));
+	manager->receive = malloc((size_t)(block_count + 1) * MANAGER_BLOCK_SIZE);
+	manager->tables  = (table_count > 0) ? malloc((size_t)table_count * sizeof(mqtt_inflight_t)) : NULL;
+
+	if(manager->slots == NULL || manager->receive == NULL || (table_count > 0 && manager->tables == NULL) ||
+	   mqtt_event_loop_init(&manager->loop) < 0)
+	{
+		free(manager->slots);
+		free(manager->receive);
+		free(manager->tables);
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	manager->blocks = manager->receive + MANAGER_BLOCK_SIZE;
+
+	mqtt_timer_wheel_init(&manager->wheel, mqtt_timer_now());
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Opens session of connected socket, socket is owned and closed by manager.
+ * @param  *manager     : pointer to manager structure (mqtt_manager_t).
+ * @param  descriptor   : connected socket descriptor, (non blocking)
+ * @param  *context     : user context passed to event callback
+ * @retval mqtt_session_t* : session, buffers are attached for mqtt_session_connect(),
+ *                           NULL = Error (errno is set, ENOBUFS = no free slot or buffer)
+ */
+mqtt_session_t *mqtt_manager_open(mqtt_manager_t *manager, int descriptor, void *context)
+{
+	mqtt_manager_slot_t *slot  = NULL;
+	uint8_t             *block = NULL;
+
+	if(manager == NULL || descriptor < 0)
+	{
+		errno = EINVAL;
+
+		return NULL;
+	}
+
+	if(manager->free_slots != NULL)
+	{
+		slot = manager->free_slots;
+
+		manager->free_slots = slot->next;
+	}
+	else if(manager->slot_next < manager->slot_count)
+	{
+		slot = &manager->slots[manager->slot_next++];
+	}
+	else
+	{
+		errno = ENOBUFS;
+
+		return NULL;
+	}
+
+	block = mqtt_manager_block(manager);
+
+	if(block == NULL ||
+	   mqtt_session_init(&slot->session, descriptor, read, write, manager->receive, MANAGER_BLOCK_SIZE, block, MANAGER_BLOCK_SIZE,
+			             NULL, &manager->wheel, mqtt_manager_event, slot) < 0 ||
+	   mqtt_event_loop_add(&manager->loop, &slot->source, descriptor, MQTT_EVENT_READ, mqtt_manager_socket, slot) < 0)
+	{
+		if(block != NULL)
+			mqtt_manager_unblock(manager, block);
+
+		slot->next = manager->free_slots;
+
+		manager->free_slots = slot;
+
+		return NULL;
+	}
+
+	slot->manager = manager;
+	slot->context = context;
+	slot->ready   = 0;
+
+	manager->session_count++;
+
+	/* Buffer is returned by next run when nothing is queued */
+	mqtt_manager_ready(manager, slot);
+
+	return &slot->session;
+}
+
+
+
+/*
+ * @brief  Attaches buffer and in-flight table to session, call before queuing with mqtt_session_*()
+ *         functions outside callback of that session. Session is written by next run.
+ * @param  *manager   : pointer to manager structure (mqtt_manager_t).
+ * @param  *session   : session of manager
+ * @param  inflight   : 1 = in-flight table is attached for qos 1, 2 publish
+ * @retval int8_t     : 1 = Success, -1 = Error (errno is set, ENOBUFS = pool empty)
+ */
+int8_t mqtt_manager_lease(mqtt_manager_t *manager, mqtt_session_t *session, uint8_t inflight)
+{
+	mqtt_manager_slot_t *slot  = (mqtt_manager_slot_t*)session;
+	mqtt_inflight_t     *table = NULL;
+
+	if(manager == NULL || session == NULL || slot->manager != manager || session->state == MQTT_SESSION_CLOSED)
+	{
+		errno = EINVAL;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	if(mqtt_manager_attach(manager, session) < 0)
+		return FUNC_OPTS_ERROR;
+
+	mqtt_manager_ready(manager, slot);
+
+	if(!inflight || session->inflight_table != NULL)
+		return FUNC_OPTS_SUCCESS;
+
+	table = mqtt_manager_take(&manager->free_tables, (uint8_t*)manager->tables, sizeof(mqtt_inflight_t),
+			                  &manager->table_next, manager->table_count);
+	if(table == NULL)
+	{
+		errno = ENOBUFS;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	if(++manager->table_lent > manager->table_peak)
+		manager->table_peak = manager->table_lent;
+
+	mqtt_inflight_init(table);
+
+	return mqtt_session_inflight(session, table);
+}
+
+
+
+/*
+ * @brief  Closes session without DISCONNECT, slot and socket are released by next run.
+ * @param  *manager   : pointer to manager structure (mqtt_manager_t).
+ * @param  *session   : session of manager
+ * @retval int8_t     : 1 = Success, -1 = Error
+ */
+int8_t mqtt_manager_close(mqtt_manager_t *manager, mqtt_session_t *session)
+{
+	mqtt_manager_slot_t *slot = (mqtt_manager_slot_t*)session;
+
+	if(manager == NULL || session == NULL || slot->manager != manager)
+		return FUNC_OPTS_ERROR;
+
+	mqtt_session_abort(session, ECONNABORTED);
+
+	mqtt_manager_ready(manager, slot);
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Waits for socket events or keep alive timers and services ready sessions, buffers of
+ *         idle sessions are returned to pools.
+ * @param  *manager    : pointer to manager structure (mqtt_manager_t).
+ * @param  timeout_ms  : longest wait, (-1 = until event or timer, 0 = no wait)
+ * @retval int         : number of sessions serviced, -1 = Error
+ */
+int mqtt_manager_run(mqtt_manager_t *manager, int timeout_ms)
+{
+	mqtt_manager_slot_t *slot = NULL;
+	mqtt_manager_slot_t *last = NULL;
+
+	int      ready_count   = 0;
+	int      service_count = 0;
+	int      timer_timeout = 0;
+	uint32_t batch_count   = 0;
+	uint32_t now           = 0;
+
+	if(manager == NULL)
+		return FUNC_OPTS_ERROR;
+
+	/* Ready sessions are serviced without waiting, else wait until next keep alive */
+	if(manager->ready_head != NULL)
+	{
+		timeout_ms = 0;
+	}
+	else
+	{
+		timer_timeout = mqtt_timer_next_timeout(&manager->wheel, mqtt_timer_now());
+
+		if(timer_timeout >= 0 && (timeout_ms < 0 || timer_timeout < timeout_ms))
+			timeout_ms = timer_timeout;
+	}
+
+	ready_count = mqtt_event_loop_run(&manager->loop, timeout_ms);
+
+	/* More sockets ready than one event loop batch, epoll returns ready sockets round robin
+	 * and sockets stay ready until read, so batches are bounded by number of sessions */
+	for(batch_count = manager->session_count / EVENT_LOOP_MAX_EVENTS; ready_count == EVENT_LOOP_MAX_EVENTS && batch_count > 0; batch_count--)
+		ready_count = mqtt_event_loop_run(&manager->loop, 0);
+
+	if(ready_count < 0)
+		return FUNC_OPTS_ERROR;
+
+	now = mqtt_timer_now();
+
+	/* Expired keep alive timers make their slots ready */
+	mqtt_timer_advance(&manager->wheel, now);
+
+	/* Slots made ready while servicing are serviced by next run */
+	last = manager->ready_tail;
+
+	while(last != NULL && manager->ready_head != NULL)
+	{
+		slot = manager->ready_head;
+
+		manager->ready_head = slot->next;
+
+		if(manager->ready_head == NULL)
+			manager->ready_tail = NULL;
+
+		slot->ready = 0;
+
+		mqtt_manager_service(manager, slot, now);
+
+		service_count++;
+
+		if(slot == last)
+			break;
+	}
+
+	return service_count;
+}
+
+
+
+/*
+ * @brief  Closes all session sockets and releases memory of manager.
+ * @param  *manager   : pointer to manager structure (mqtt_manager_t).
+ * @retval int8_t     : 1 = Success, -1 = Error
+ */
+int8_t mqtt_manager_free(mqtt_manager_t *manager)
+{
+	uint32_t index = 0;
+
+	if(manager == NULL || manager->slots == NULL)
+		return FUNC_OPTS_ERROR;
+
+	for(index = 0; index < manager->slot_next; index++)
+	{
+		if(manager->slots[index].manager == manager)
+			close(manager->slots[index].session.descriptor);
+	}
+
+	mqtt_event_loop_close(&manager->loop);
+
+	free(manager->slots);
+	free(manager->receive);
+	free(manager->tables);
+
+	manager->slots   = NULL;
+	manager->receive = NULL;
+	manager->blocks  = NULL;
+	manager->tables  = NULL;
+
+	return FUNC_OPTS_SUCCESS;
+}
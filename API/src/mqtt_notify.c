@@ -0,0 +1,408 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_notify.c
+ * @author  Aditya Mall,
+ * @brief   MQTT client notification group
+ *
+ *  Info
+ *          Notification group API Source File, (Linux eventfd, timerfd)
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall, MIT License </center></h2>
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019 Aditya Mall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+
+/*
+ * Standard Header and API Header files
+ */
+#include <mqtt_notify.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                  Data Structures and Defines                               */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* return codes for notification group functions */
+typedef enum function_return_codes
+{
+	FUNC_OPTS_ERROR       = -1,  /*!< */
+	FUNC_OPTS_SUCCESS     = 1,   /*!< */
+
+}return_codes_t;
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                           Private Functions                                */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Clears readable state of timerfd or eventfd.
+ * @param  *source  : event source of descriptor
+ * @retval None
+ */
+static void mqtt_notify_drain(mqtt_event_source_t *source)
+{
+	uint64_t counter = 0;
+
+	if(source->revents == 0)
+		return;
+
+	source->revents = 0;
+
+	/* Non blocking, EAGAIN when already drained */
+	if(read(source->fd, &counter, sizeof(counter)) < 0)
+		return;
+}
+
+
+
+/*
+ * @brief  Arms timer of group at next session deadline, system call is skipped when unchanged.
+ * @param  *group    : pointer to notification group (mqtt_notify_t).
+ * @param  now       : current time, from mqtt_timer_now()
+ * @param  timeout   : milliseconds until next deadline, -1 = no deadline, 0 = due now
+ * @retval int8_t    : 1 = Success, -1 = Error
+ */
+static int8_t mqtt_notify_arm(mqtt_notify_t *group, uint32_t now, int timeout)
+{
+	struct itimerspec timer_value;
+
+	/* Zero value disarms timerfd, due work is signalled instead */
+	if(timeout == 0)
+		return mqtt_notify_signal(group);
+
+	if(timeout < 0 && group->timer_armed == 0)
+		return FUNC_OPTS_SUCCESS;
+
+	if(timeout > 0 && group->timer_armed && group->timer_deadline == now + (uint32_t)timeout)
+		return FUNC_OPTS_SUCCESS;
+
+	memset(&timer_value, 0, sizeof(timer_value));
+
+	if(timeout > 0)
+	{
+		timer_value.it_value.tv_sec  = timeout / 1000;
+		timer_value.it_value.tv_nsec = (long)(timeout % 1000) * 1000000L;
+	}
+
+	if(timerfd_settime(group->timer_source.fd, 0, &timer_value, NULL) < 0)
+		return FUNC_OPTS_ERROR;
+
+	group->timer_armed    = (timeout > 0);
+	group->timer_deadline = now + (uint32_t)timeout;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                              API Functions                                 */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Creates notification group, (epoll instance with timerfd and eventfd).
+ * @param  *group  : pointer to notification group (mqtt_notify_t).
+ * @retval int8_t  : 1 = Success, -1 = Error (errno is set)
+ */
+int8_t mqtt_notify_init(mqtt_notify_t *group)
+{
+	int timer_fd  = -1;
+	int signal_fd = -1;
+
+	if(group == NULL)
+		return FUNC_OPTS_ERROR;
+
+	memset(group, 0, sizeof(mqtt_notify_t));
+
+	if(mqtt_event_loop_init(&group->loop) < 0)
+		return FUNC_OPTS_ERROR;
+
+	timer_fd  = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	signal_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	if(timer_fd < 0 || signal_fd < 0 ||
+	   mqtt_event_loop_add(&group->loop, &group->timer_source, timer_fd, MQTT_EVENT_READ, NULL, NULL) < 0 ||
+	   mqtt_event_loop_add(&group->loop, &group->signal_source, signal_fd, MQTT_EVENT_READ, NULL, NULL) < 0)
+	{
+		if(timer_fd >= 0)
+			close(timer_fd);
+
+		if(signal_fd >= 0)
+			close(signal_fd);
+
+		mqtt_event_loop_close(&group->loop);
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Adds session to group, socket of session is watched by group descriptor.
+ * @param  *group    : pointer to notification group (mqtt_notify_t).
+ * @param  *member   : member storage, valid while session is in group
+ * @param  *session  : initialized session
+ * @retval int8_t    : 1 = Success, -1 = Error (errno is set)
+ */
+int8_t mqtt_notify_add(mqtt_notify_t *group, mqtt_notify_member_t *member, mqtt_session_t *session)
+{
+	if(group == NULL || member == NULL || session == NULL)
+		return FUNC_OPTS_ERROR;
+
+	if(mqtt_event_loop_add(&group->loop, &member->source, session->descriptor, mqtt_session_events(session), NULL, NULL) < 0)
+		return FUNC_OPTS_ERROR;
+
+	member->session = session;
+	member->next    = group->members;
+
+	group->members = member;
+
+	/* Output queued before add, (CONNECT) is flushed by first dispatch */
+	return mqtt_notify_signal(group);
+}
+
+
+
+/*
+ * @brief  Removes session from group, (closed sessions are removed by dispatch).
+ * @param  *group   : pointer to notification group (mqtt_notify_t).
+ * @param  *member  : member of session
+ * @retval int8_t   : 1 = Success, -1 = Error
+ */
+int8_t mqtt_notify_remove(mqtt_notify_t *group, mqtt_notify_member_t *member)
+{
+	mqtt_notify_member_t **link = NULL;
+
+	if(group == NULL || member == NULL)
+		return FUNC_OPTS_ERROR;
+
+	for(link = &group->members; *link != NULL && *link != member; link = &(*link)->next);
+
+	if(*link == NULL)
+		return FUNC_OPTS_ERROR;
+
+	*link = member->next;
+
+	return mqtt_event_loop_remove(&group->loop, &member->source);
+}
+
+
+
+/*
+ * @brief  Returns descriptor of group for foreign event loop, readable when dispatch has work.
+ * @param  *group  : pointer to notification group (mqtt_notify_t).
+ * @retval int     : pollable descriptor, -1 = Error
+ */
+int mqtt_notify_fd(mqtt_notify_t *group)
+{
+	if(group == NULL)
+		return FUNC_OPTS_ERROR;
+
+	return group->loop.epoll_fd;
+}
+
+
+
+/*
+ * @brief  Returns time until earliest session deadline, (keep alive or output flush).
+ * @param  *group  : pointer to notification group (mqtt_notify_t).
+ * @param  now     : current time, from mqtt_timer_now()
+ * @retval int     : milliseconds, -1 = no deadline
+ */
+int mqtt_notify_next_deadline(mqtt_notify_t *group, uint32_t now)
+{
+	mqtt_notify_member_t *member = NULL;
+
+	int timeout        = -1;
+	int member_timeout = 0;
+
+	if(group == NULL)
+		return -1;
+
+	for(member = group->members; member != NULL; member = member->next)
+	{
+		member_timeout = mqtt_session_next_timeout(member->session, now);
+
+		if(member_timeout >= 0 && (timeout < 0 || member_timeout < timeout))
+			timeout = member_timeout;
+	}
+
+	return timeout;
+}
+
+
+
+/*
+ * @brief  Makes group descriptor readable, call after queuing messages outside dispatch
+ *         so their output deadline is armed.
+ * @param  *group  : pointer to notification group (mqtt_notify_t).
+ * @retval int8_t  : 1 = Success, -1 = Error
+ */
+int8_t mqtt_notify_signal(mqtt_notify_t *group)
+{
+	uint64_t counter = 1;
+
+	if(group == NULL)
+		return FUNC_OPTS_ERROR;
+
+	/* Counter overflow (EAGAIN) still leaves descriptor readable */
+	if(write(group->signal_source.fd, &counter, sizeof(counter)) < 0 && errno != EAGAIN)
+		return FUNC_OPTS_ERROR;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Polls sessions that have input, write space or expired deadline, call when group
+ *         descriptor is readable. Session events and batched completions are given to session
+ *         callbacks from here, timer is armed at next deadline.
+ * @param  *group   : pointer to notification group (mqtt_notify_t).
+ * @param  now      : current time, from mqtt_timer_now()
+ * @param  budget   : most packets handled per session, (0 = no limit)
+ * @retval int      : number of packets handled, -1 = Error
+ */
+int mqtt_notify_dispatch(mqtt_notify_t *group, uint32_t now, uint16_t budget)
+{
+	mqtt_notify_member_t  *member = NULL;
+	mqtt_notify_member_t **link   = NULL;
+
+	int work_count     = 0;
+	int poll_count     = 0;
+	int timeout        = -1;
+	int member_timeout = 0;
+
+	if(group == NULL)
+		return FUNC_OPTS_ERROR;
+
+	/* Ready flags of sources, group descriptor stays readable while more sources are ready */
+	if(mqtt_event_loop_run(&group->loop, 0) < 0)
+		return FUNC_OPTS_ERROR;
+
+	if(group->timer_source.revents)
+		group->timer_armed = 0;
+
+	mqtt_notify_drain(&group->timer_source);
+	mqtt_notify_drain(&group->signal_source);
+
+	/* Sessions with events or due deadline */
+	for(member = group->members; member != NULL; member = member->next)
+	{
+		if(member->source.revents == 0 && mqtt_session_next_timeout(member->session, now) != 0)
+			continue;
+
+		member->source.revents = 0;
+
+		poll_count = mqtt_client_poll(member->session, now, budget);
+
+		/* Decoder may hold more packets, socket is not readable again for them */
+		if(budget != 0 && poll_count == budget)
+			timeout = 0;
+
+		if(poll_count > 0)
+			work_count += poll_count;
+	}
+
+	/* Second pass, a shared timer wheel may have expired timers of sessions polled earlier */
+	for(link = &group->members; *link != NULL;)
+	{
+		member = *link;
+
+		if(member->session->state == MQTT_SESSION_CLOSED)
+		{
+			*link = member->next;
+
+			/* Socket may be closed from closed event already */
+			mqtt_event_loop_remove(&group->loop, &member->source);
+
+			continue;
+		}
+
+		mqtt_event_loop_modify(&group->loop, &member->source, mqtt_session_events(member->session));
+
+		member_timeout = mqtt_session_next_timeout(member->session, now);
+
+		if(member_timeout >= 0 && (timeout < 0 || member_timeout < timeout))
+			timeout = member_timeout;
+
+		link = &member->next;
+	}
+
+	if(mqtt_notify_arm(group, now, timeout) < 0)
+		return FUNC_OPTS_ERROR;
+
+	return work_count;
+}
+
+
+
+/*
+ * @brief  Closes group descriptors, sessions and their sockets are not closed.
+ * @param  *group  : pointer to notification group (mqtt_notify_t).
+ * @retval int8_t  : 1 = Success, -1 = Error
+ */
+int8_t mqtt_notify_close(mqtt_notify_t *group)
+{
+	if(group == NULL)
+		return FUNC_OPTS_ERROR;
+
+	close(group->timer_source.fd);
+	close(group->signal_source.fd);
+
+	group->members     = NULL;
+	group->timer_armed = 0;
+
+	return mqtt_event_loop_close(&group->loop);
+}
@@ -0,0 +1,598 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_output.c
+ * @author  Aditya Mall,
+ * @brief   MQTT client output buffer
+ *
+ *  Info
+ *          Output buffer API Source File
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall, MIT License </center></h2>
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019 Aditya Mall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+/*
+ * Standard Header and API Header files
+ */
+#include <mqtt_output.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                  Data Structures and Defines                               */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* return codes for output buffer functions */
+typedef enum function_return_codes
+{
+	FUNC_OPTS_ERROR       = -1,  /*!< */
+	FUNC_OPTS_SUCCESS     = 1,   /*!< */
+
+}return_codes_t;
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                           Private Functions                                */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Updates would block state and queue growth statistics, (high and low water hysteresis).
+ * @param  *output   : pointer to output structure (mqtt_output_t).
+ * @retval None
+ */
+static void mqtt_output_update(mqtt_output_t *output)
+{
+	size_t pending = output->length - output->offset;
+
+	if(pending > output->peak_pending)
+		output->peak_pending = pending;
+
+	if(!output->blocked && pending >= output->high_water)
+	{
+		output->blocked = 1;
+		output->blocked_count++;
+	}
+	else if(output->blocked && pending <= output->low_water)
+	{
+		output->blocked = 0;
+	}
+}
+
+
+
+/*
+ * @brief  Writes pending data, corked socket keeps last partial segment until it is pushed.
+ * @param  *output   : pointer to output structure (mqtt_output_t).
+ * @retval ssize_t   : bytes written, -1 = Error (errno is set, EAGAIN = stalled), pending data is kept
+ */
+static ssize_t mqtt_output_send(mqtt_output_t *output)
+{
+	ssize_t write_count   = 0;
+	ssize_t written_total = 0;
+
+	while(output->offset < output->length)
+	{
+		write_count = output->write(output->descriptor, output->buffer + output->offset, output->length - output->offset);
+
+		output->write_count++;
+
+		if(write_count < 0)
+		{
+			if(errno == EINTR)
+				continue;
+
+			break;
+		}
+
+		output->offset      += (size_t)write_count;
+		output->byte_count  += (size_t)write_count;
+		written_total       += write_count;
+	}
+
+	/* Socket send buffer full, rest is written on write event */
+	output->stalled = (write_count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+
+	if(output->stalled)
+	{
+		output->stall_count++;
+	}
+	else if(output->offset == output->length)
+	{
+		output->offset = 0;
+		output->length = 0;
+	}
+
+	mqtt_output_update(output);
+
+	if(write_count < 0 && written_total == 0)
+		return FUNC_OPTS_ERROR;
+
+	return written_total;
+}
+
+
+
+/*
+ * @brief  Makes room for data, written data is dropped from start of buffer and flushed if needed.
+ * @param  *output   : pointer to output structure (mqtt_output_t).
+ * @param  length    : length of data to be queued
+ * @retval int8_t    : 1 = data fits, -1 = Error (errno is set, EAGAIN = socket send buffer full)
+ */
+static int8_t mqtt_output_room(mqtt_output_t *output, size_t length)
+{
+	if(length > output->buffer_size)
+	{
+		errno = EMSGSIZE;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	if(output->buffer_size - output->length >= length)
+		return FUNC_OPTS_SUCCESS;
+
+	/* Stalled socket is written only on write event, more data follows so corked socket is not pushed */
+	if(!output->stalled && mqtt_output_send(output) < 0 && errno != EAGAIN)
+		return FUNC_OPTS_ERROR;
+
+	/* Partially written data moves to start of buffer */
+	if(output->offset > 0 && output->buffer_size - output->length < length)
+	{
+		memmove(output->buffer, output->buffer + output->offset, output->length - output->offset);
+
+		output->length -= output->offset;
+		output->offset  = 0;
+	}
+
+	/* Producers are told to wait until output drains below low water */
+	if(output->buffer_size - output->length < length)
+	{
+		if(!output->blocked)
+		{
+			output->blocked = 1;
+			output->blocked_count++;
+		}
+
+		errno = EAGAIN;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Flushes buffer once pending data reaches flush size, or at once without deadline.
+ * @param  *output   : pointer to output structure (mqtt_output_t).
+ * @retval int8_t    : 1 = Success, -1 = Error (errno is set)
+ */
+static int8_t mqtt_output_queued(mqtt_output_t *output)
+{
+	if(output->stalled || (output->deadline_us != 0 && output->length - output->offset < output->flush_size))
+	{
+		mqtt_output_update(output);
+
+		return FUNC_OPTS_SUCCESS;
+	}
+
+	/* Send buffer full, data stays queued */
+	if(mqtt_output_flush(output) < 0 && errno != EAGAIN)
+		return FUNC_OPTS_ERROR;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                              API Functions                                 */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Initializes output buffer, flush size is taken from socket MSS, (high water on corked socket).
+ * @param  *output        : pointer to output structure (mqtt_output_t).
+ * @param  *buffer        : output buffer, (OUTPUT_BUFFER_SIZE)
+ * @param  buffer_size    : size of output buffer
+ * @param  descriptor     : connected socket descriptor
+ * @param  write          : write function, (write() or transport write)
+ * @param  deadline_us    : longest time data waits in buffer, (0 = flush every packet)
+ * @retval int8_t         : 1 = Success, -1 = Error
+ */
+int8_t mqtt_output_init(mqtt_output_t *output, uint8_t *buffer, size_t buffer_size, int descriptor,
+		                mqtt_output_write_t write, uint32_t deadline_us)
+{
+	int       segment_size   = 0;
+	int       cork           = 0;
+	socklen_t segment_length = sizeof(segment_size);
+	socklen_t cork_length    = sizeof(cork);
+
+	if(output == NULL || buffer == NULL || buffer_size == 0 || write == NULL)
+		return FUNC_OPTS_ERROR;
+
+	memset(output, 0, sizeof(mqtt_output_t));
+
+	output->buffer      = buffer;
+	output->buffer_size = buffer_size;
+	output->descriptor  = descriptor;
+	output->write       = write;
+	output->deadline_us = deadline_us;
+	output->high_water  = (OUTPUT_HIGH_WATER < buffer_size) ? OUTPUT_HIGH_WATER : buffer_size;
+	output->low_water   = (OUTPUT_LOW_WATER < output->high_water) ? OUTPUT_LOW_WATER : output->high_water / 2;
+
+	/* One full segment per write, loopback reports large MSS */
+	if(getsockopt(descriptor, IPPROTO_TCP, TCP_MAXSEG, &segment_size, &segment_length) < 0 || segment_size <= 0)
+		segment_size = OUTPUT_DEFAULT_MSS;
+
+	/* Segment is written before producers are told to wait, (loopback MSS is larger than buffer) */
+	output->flush_size = ((size_t)segment_size < output->high_water) ? (size_t)segment_size : output->high_water;
+
+	/* Corked socket sends full segments only, output batches up to high water between pushes */
+	if(getsockopt(descriptor, IPPROTO_TCP, TCP_CORK, &cork, &cork_length) == 0 && cork != 0)
+	{
+		output->corked     = 1;
+		output->flush_size = output->high_water;
+	}
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Replaces buffer of empty output, idle outputs can return their buffer to a shared pool.
+ *         Flush size is kept from init.
+ * @param  *output        : pointer to output structure (mqtt_output_t).
+ * @param  *buffer        : output buffer, (NULL = no buffer, nothing can be queued)
+ * @param  buffer_size    : size of output buffer
+ * @retval int8_t         : 1 = Success, -1 = Error (errno is set, EBUSY = data pending)
+ */
+int8_t mqtt_output_attach(mqtt_output_t *output, uint8_t *buffer, size_t buffer_size)
+{
+	if(output == NULL || (buffer == NULL && buffer_size != 0))
+		return FUNC_OPTS_ERROR;
+
+	/* Pending and stalled data stays in current buffer */
+	if(output->length > 0)
+	{
+		errno = EBUSY;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	output->buffer      = buffer;
+	output->buffer_size = buffer_size;
+	output->offset      = 0;
+	output->blocked     = 0;
+	output->high_water  = (OUTPUT_HIGH_WATER < buffer_size) ? OUTPUT_HIGH_WATER : buffer_size;
+	output->low_water   = (OUTPUT_LOW_WATER < output->high_water) ? OUTPUT_LOW_WATER : output->high_water / 2;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Drops unsent data of closed connection, output is empty and not stalled afterwards.
+ * @param  *output   : pointer to output structure (mqtt_output_t).
+ * @retval int8_t    : 1 = Success, -1 = Error
+ */
+int8_t mqtt_output_discard(mqtt_output_t *output)
+{
+	if(output == NULL)
+		return FUNC_OPTS_ERROR;
+
+	output->offset      = 0;
+	output->length      = 0;
+	output->queued_time = 0;
+	output->stalled     = 0;
+	output->blocked     = 0;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Reserves space at end of queued data, packet is encoded in place and queued with
+ *         mqtt_output_commit(). Packet larger than output buffer can never be queued.
+ * @param  *output   : pointer to output structure (mqtt_output_t).
+ * @param  length    : length of packet
+ * @retval uint8_t*  : space for packet, NULL = Error (errno is set, EAGAIN = would block,
+ *                     EMSGSIZE = packet is larger than output buffer, ENOBUFS = no buffer attached)
+ */
+uint8_t *mqtt_output_reserve(mqtt_output_t *output, size_t length)
+{
+	if(output == NULL)
+	{
+		errno = EINVAL;
+
+		return NULL;
+	}
+
+	/* Idle output returned its buffer to pool */
+	if(output->buffer == NULL)
+	{
+		errno = ENOBUFS;
+
+		return NULL;
+	}
+
+	if(mqtt_output_room(output, length) < 0)
+		return NULL;
+
+	return output->buffer + output->length;
+}
+
+
+
+/*
+ * @brief  Queues packet encoded in space from mqtt_output_reserve(), flushed like mqtt_output_queue().
+ * @param  *output        : pointer to output structure (mqtt_output_t).
+ * @param  length         : length of encoded packets, (at most reserved length)
+ * @param  packet_count   : number of packets, for statistics
+ * @param  now_us         : current time, from mqtt_timer_now_us()
+ * @retval ssize_t        : length queued, -1 = Error (errno is set), nothing is queued on error
+ */
+ssize_t mqtt_output_commit(mqtt_output_t *output, size_t length, uint16_t packet_count, uint64_t now_us)
+{
+	if(output == NULL || length > output->buffer_size - output->length)
+	{
+		errno = EINVAL;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	if(output->length == output->offset)
+		output->queued_time = now_us;
+
+	output->length       += length;
+	output->packet_count += packet_count;
+
+	/* Failed flush wrote nothing, packet is taken back so caller can release its state */
+	if(mqtt_output_queued(output) < 0)
+	{
+		output->length       -= length;
+		output->packet_count -= packet_count;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	return (ssize_t)length;
+}
+
+
+
+/*
+ * @brief  Queues encoded packet, buffer is flushed when pending data reaches flush size or
+ *         deadline is 0, packet buffer can be reused on return.
+ * @param  *output   : pointer to output structure (mqtt_output_t).
+ * @param  *packet   : encoded packet
+ * @param  length    : length of packet
+ * @param  now_us    : current time, from mqtt_timer_now_us()
+ * @retval ssize_t   : length queued, -1 = Error (errno is set, EAGAIN = would block), nothing is queued on error
+ */
+ssize_t mqtt_output_queue(mqtt_output_t *output, const void *packet, size_t length, uint64_t now_us)
+{
+	uint8_t *space = NULL;
+
+	if(output == NULL || packet == NULL)
+		return FUNC_OPTS_ERROR;
+
+	space = mqtt_output_reserve(output, length);
+	if(space == NULL)
+		return FUNC_OPTS_ERROR;
+
+	memcpy(space, packet, length);
+
+	return mqtt_output_commit(output, length, 1, now_us);
+}
+
+
+
+/*
+ * @brief  Queues scatter-gather packets, (e.g. PUBLISH burst from mqtt_publish_iov() or mqtt_publish_batch_iov()).
+ * @param  *output        : pointer to output structure (mqtt_output_t).
+ * @param  *vector        : IO vector array
+ * @param  count          : number of IO vectors
+ * @param  packet_count   : number of packets in vector, for statistics
+ * @param  now_us         : current time, from mqtt_timer_now_us()
+ * @retval ssize_t        : length queued, -1 = Error (errno is set, EAGAIN = would block), nothing is queued on error
+ */
+ssize_t mqtt_output_queue_vector(mqtt_output_t *output, const mqtt_iovec_t *vector, int count,
+		                         uint16_t packet_count, uint64_t now_us)
+{
+	uint8_t *space        = NULL;
+	size_t   total_length = 0;
+	size_t   space_index  = 0;
+	int      index        = 0;
+
+	if(output == NULL || vector == NULL || count <= 0)
+		return FUNC_OPTS_ERROR;
+
+	for(index = 0; index < count; index++)
+		total_length += vector[index].iov_len;
+
+	/* Vector is queued whole or not at all */
+	space = mqtt_output_reserve(output, total_length);
+	if(space == NULL)
+		return FUNC_OPTS_ERROR;
+
+	for(index = 0; index < count; index++)
+	{
+		memcpy(space + space_index, vector[index].iov_base, vector[index].iov_len);
+
+		space_index += vector[index].iov_len;
+	}
+
+	return mqtt_output_commit(output, total_length, packet_count, now_us);
+}
+
+
+
+/*
+ * @brief  Writes pending data, partially written data is resumed from its offset by next flush.
+ *         Corked socket sends its last partial segment once buffer is drained.
+ * @param  *output   : pointer to output structure (mqtt_output_t).
+ * @retval ssize_t   : bytes written, -1 = Error (errno is set, EAGAIN = stalled), pending data is kept
+ */
+ssize_t mqtt_output_flush(mqtt_output_t *output)
+{
+	ssize_t written_total = 0;
+	int     cork          = 0;
+
+	if(output == NULL)
+		return FUNC_OPTS_ERROR;
+
+	written_total = mqtt_output_send(output);
+
+	/* Uncork pushes partial segment, kernel would hold it up to 200 ms */
+	if(output->corked && written_total > 0 && output->length == 0)
+	{
+		setsockopt(output->descriptor, IPPROTO_TCP, TCP_CORK, &cork, sizeof(cork));
+
+		cork = 1;
+		setsockopt(output->descriptor, IPPROTO_TCP, TCP_CORK, &cork, sizeof(cork));
+
+		output->push_count++;
+	}
+
+	return written_total;
+}
+
+
+
+/*
+ * @brief  Flushes output buffer if deadline of oldest pending data expired.
+ * @param  *output   : pointer to output structure (mqtt_output_t).
+ * @param  now_us    : current time, from mqtt_timer_now_us()
+ * @retval int8_t    : 1 = flushed, 0 = not due, -1 = Error
+ */
+int8_t mqtt_output_poll(mqtt_output_t *output, uint64_t now_us)
+{
+	if(output == NULL)
+		return FUNC_OPTS_ERROR;
+
+	/* Stalled socket is written on write event */
+	if(output->offset == output->length || output->stalled || now_us - output->queued_time < output->deadline_us)
+		return 0;
+
+	if(mqtt_output_flush(output) < 0 && errno != EAGAIN)
+		return FUNC_OPTS_ERROR;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Returns time until output buffer must be flushed, for event loop timeout.
+ * @param  *output   : pointer to output structure (mqtt_output_t).
+ * @param  now_us    : current time, from mqtt_timer_now_us()
+ * @retval int32_t   : microseconds to deadline, 0 = due now, -1 = nothing pending or stalled
+ */
+int32_t mqtt_output_next_deadline(mqtt_output_t *output, uint64_t now_us)
+{
+	uint64_t elapsed = 0;
+
+	if(output == NULL || output->offset == output->length || output->stalled)
+		return -1;
+
+	elapsed = now_us - output->queued_time;
+
+	if(elapsed >= output->deadline_us)
+		return 0;
+
+	return (int32_t)(output->deadline_us - elapsed);
+}
+
+
+
+/*
+ * @brief  Returns size of unsent data.
+ * @param  *output   : pointer to output structure (mqtt_output_t).
+ * @retval size_t    : pending bytes
+ */
+size_t mqtt_output_pending(mqtt_output_t *output)
+{
+	if(output == NULL)
+		return 0;
+
+	return output->length - output->offset;
+}
+
+
+
+/*
+ * @brief  Returns whether producers may queue more packets, "would block" signal for application.
+ * @param  *output   : pointer to output structure (mqtt_output_t).
+ * @retval int8_t    : 1 = writable, 0 = would block (pending data above high water), -1 = Error
+ */
+int8_t mqtt_output_writable(mqtt_output_t *output)
+{
+	if(output == NULL)
+		return FUNC_OPTS_ERROR;
+
+	return output->blocked ? 0 : 1;
+}
+
+
+
+/*
+ * @brief  Returns event loop events needed by output buffer, write event while socket is stalled.
+ * @param  *output   : pointer to output structure (mqtt_output_t).
+ * @retval uint8_t   : MQTT_EVENT_WRITE = flush on write event, 0 = no write event needed
+ */
+uint8_t mqtt_output_events(mqtt_output_t *output)
+{
+	if(output == NULL || !output->stalled)
+		return 0;
+
+	return MQTT_EVENT_WRITE;
+}
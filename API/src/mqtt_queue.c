@@ -0,0 +1,390 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_queue.c
+ * @author  Aditya Mall,
+ * @brief   MQTT client multi producer publish queue
+ *
+ *  Info
+ *          Lock free publish queue API Source File, (GCC atomics)
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall, MIT License </center></h2>
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019 Aditya Mall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+
+/*
+ * Standard Header and API Header files
+ */
+#include <mqtt_queue.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                  Data Structures and Defines                               */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* @brief Cell sequence and positions, written by producer threads and owner */
+#if GCC
+#define QUEUE_LOAD_RELAXED(pointer)          __atomic_load_n((pointer), __ATOMIC_RELAXED)
+#define QUEUE_LOAD_ACQUIRE(pointer)          __atomic_load_n((pointer), __ATOMIC_ACQUIRE)
+#define QUEUE_STORE_RELEASE(pointer, value)  __atomic_store_n((pointer), (value), __ATOMIC_RELEASE)
+#define QUEUE_CLAIM(pointer, expected, value) \
+	__atomic_compare_exchange_n((pointer), (expected), (value), 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#define QUEUE_EXCHANGE(pointer, value)       __atomic_exchange_n((pointer), (value), __ATOMIC_SEQ_CST)
+#define QUEUE_FETCH_ADD(pointer, value)      __atomic_fetch_add((pointer), (value), __ATOMIC_RELAXED)
+#define QUEUE_FENCE()                        __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+
+/* @brief Cell at position */
+#define QUEUE_CELL(queue, position)  ((mqtt_queue_cell_t*)((queue)->ring->cells + (size_t)((position) & (queue)->mask) * (queue)->cell_size))
+
+
+/* return codes for queue functions */
+typedef enum function_return_codes
+{
+	FUNC_OPTS_ERROR       = -1,  /*!< */
+	FUNC_OPTS_SUCCESS     = 1,   /*!< */
+
+}return_codes_t;
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                              API Functions                                 */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Initializes publish queue on user storage of MQTT_QUEUE_STORAGE_SIZE(cell_size, cell_count) bytes.
+ * @param  *queue       : pointer to queue structure (mqtt_queue_t).
+ * @param  *storage     : queue storage, aligned to CACHE_LINE_SIZE
+ * @param  cell_size    : size of one cell, multiple of 4, limits topic and message length
+ * @param  cell_count   : number of cells, power of 2
+ * @param  *group       : notification group of owner, signaled when owner waits on empty queue, (NULL = none)
+ * @retval int8_t       : 1 = Success, -1 = Error
+ */
+int8_t mqtt_queue_init(mqtt_queue_t *queue, void *storage, uint32_t cell_size, uint32_t cell_count, mqtt_notify_t *group)
+{
+	uint32_t position = 0;
+
+	if(queue == NULL || storage == NULL || ((uintptr_t)storage & (CACHE_LINE_SIZE - 1)) ||
+	   cell_size <= sizeof(mqtt_queue_cell_t) || (cell_size & 3) || cell_count < 2 || (cell_count & (cell_count - 1)))
+	{
+		return FUNC_OPTS_ERROR;
+	}
+
+	memset(storage, 0, sizeof(mqtt_queue_ring_t));
+
+	queue->ring      = (mqtt_queue_ring_t*)storage;
+	queue->cell_size = cell_size;
+	queue->mask      = cell_count - 1;
+	queue->group     = group;
+	queue->doorbell  = (group != NULL) ? group->signal_source.fd : -1;
+
+	queue->ring->cell_size  = cell_size;
+	queue->ring->cell_count = cell_count;
+	queue->ring->armed      = (group != NULL);
+
+	/* Cell at position n is free for producer when its sequence is n */
+	for(position = 0; position < cell_count; position++)
+		QUEUE_CELL(queue, position)->sequence = position;
+
+	/* Producers of other processes check magic before using storage */
+	QUEUE_STORE_RELEASE(&queue->ring->magic, MQTT_QUEUE_MAGIC);
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Attaches producer to queue initialized by other process, (shared memory mapping of its storage).
+ * @param  *queue          : pointer to queue structure (mqtt_queue_t).
+ * @param  *storage        : mapped queue storage
+ * @param  storage_size    : size of mapping
+ * @param  doorbell        : eventfd of owner notification group, (mqtt_notify_t signal), -1 = none
+ * @retval int8_t          : 1 = Success, -1 = Error (errno is set, EINVAL = storage is not a queue)
+ */
+int8_t mqtt_queue_attach(mqtt_queue_t *queue, void *storage, size_t storage_size, int doorbell)
+{
+	mqtt_queue_ring_t *ring = (mqtt_queue_ring_t*)storage;
+
+	if(queue == NULL || storage == NULL || storage_size < sizeof(mqtt_queue_ring_t) ||
+	   QUEUE_LOAD_ACQUIRE(&ring->magic) != MQTT_QUEUE_MAGIC)
+	{
+		errno = EINVAL;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	/* Geometry is copied once, cells never reach past mapping */
+	if(ring->cell_size <= sizeof(mqtt_queue_cell_t) || (ring->cell_size & 3) || ring->cell_count < 2 ||
+	   (ring->cell_count & (ring->cell_count - 1)) || MQTT_QUEUE_STORAGE_SIZE(ring->cell_size, ring->cell_count) > storage_size)
+	{
+		errno = EINVAL;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	queue->ring      = ring;
+	queue->cell_size = ring->cell_size;
+	queue->mask      = ring->cell_count - 1;
+	queue->group     = NULL;
+	queue->doorbell  = doorbell;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Queues publish from any thread, never blocks. Topic and message are copied.
+ * @param  *queue            : pointer to queue structure (mqtt_queue_t).
+ * @param  *topic            : publish topic
+ * @param  *message          : message, (binary safe)
+ * @param  message_length    : length of message
+ * @param  qos               : quality of service value
+ * @param  retain            : MQTT_MESSAGE_RETAIN or MQTT_MESSAGE_NO_RETAIN
+ * @retval int8_t            : 1 = Success, -1 = Error (errno is set, EAGAIN = queue full,
+ *                             EMSGSIZE = topic and message do not fit cell, or topic is
+ *                             longer than PUBLISH_QUEUE_TOPIC)
+ */
+int8_t mqtt_enqueue_publish(mqtt_queue_t *queue, const char *topic, const void *message, size_t message_length,
+		                    mqtt_qos_t qos, uint8_t retain)
+{
+	mqtt_queue_cell_t *cell         = NULL;
+	size_t             topic_length = 0;
+	uint64_t           counter      = 1;
+	uint32_t           position     = 0;
+	int32_t            distance     = 0;
+
+	if(queue == NULL || queue->ring == NULL || topic == NULL || (message == NULL && message_length > 0))
+	{
+		errno = EINVAL;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	topic_length = strlen(topic);
+
+	if(topic_length >= PUBLISH_QUEUE_TOPIC || topic_length + 1 + message_length > queue->cell_size - sizeof(mqtt_queue_cell_t))
+	{
+		errno = EMSGSIZE;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	position = QUEUE_LOAD_RELAXED(&queue->ring->enqueue_position);
+
+	/* Claim cell, producers that lose the race retry at the position they observed */
+	for(;;)
+	{
+		cell     = QUEUE_CELL(queue, position);
+		distance = (int32_t)(QUEUE_LOAD_ACQUIRE(&cell->sequence) - position);
+
+		if(distance == 0)
+		{
+			if(QUEUE_CLAIM(&queue->ring->enqueue_position, &position, position + 1))
+				break;
+		}
+		else if(distance < 0)
+		{
+			/* Cell of previous round not yet published by owner */
+			QUEUE_FETCH_ADD(&queue->ring->rejected, 1);
+
+			errno = EAGAIN;
+
+			return FUNC_OPTS_ERROR;
+		}
+		else
+		{
+			position = QUEUE_LOAD_RELAXED(&queue->ring->enqueue_position);
+		}
+	}
+
+	cell->qos            = (uint8_t)qos;
+	cell->retain         = retain;
+	cell->topic_length   = (uint16_t)topic_length;
+	cell->message_length = (uint32_t)message_length;
+
+	memcpy(cell->data, topic, topic_length + 1);
+	memcpy(cell->data + topic_length + 1, message, message_length);
+
+	QUEUE_STORE_RELEASE(&cell->sequence, position + 1);
+
+	/* Pairs with arming in mqtt_queue_drain(), owner either sees cell or is signaled */
+	QUEUE_FENCE();
+
+	if(queue->doorbell >= 0 && QUEUE_LOAD_RELAXED(&queue->ring->armed) && QUEUE_EXCHANGE(&queue->ring->armed, 0))
+	{
+		/* Counter overflow (EAGAIN) still leaves doorbell readable */
+		if(write(queue->doorbell, &counter, sizeof(counter)) < 0 && errno != EAGAIN)
+			return FUNC_OPTS_ERROR;
+	}
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Publishes queued messages on session in order, call from thread owning session. Stops at
+ *         full output buffer or send window, (message stays queued), rearms wake up once queue is empty.
+ *         Group is signaled after messages are queued on session, so their output deadline is armed.
+ * @param  *queue     : pointer to queue structure (mqtt_queue_t).
+ * @param  *session   : pointer to session structure (mqtt_session_t).
+ * @param  now        : current time, from mqtt_timer_now()
+ * @param  budget     : most messages published, (0 = no limit)
+ * @retval int32_t    : messages published, -1 = Error (errno is set, ENOTCONN = session closed)
+ */
+int32_t mqtt_queue_drain(mqtt_queue_t *queue, mqtt_session_t *session, uint32_t now, uint32_t budget)
+{
+	mqtt_queue_cell_t *cell           = NULL;
+	uint32_t           position       = 0;
+	int32_t            published      = 0;
+	uint16_t           topic_length   = 0;
+	uint32_t           message_length = 0;
+	uint8_t            qos            = 0;
+	uint8_t            retain         = 0;
+	char               topic[PUBLISH_QUEUE_TOPIC];
+
+	if(queue == NULL || session == NULL)
+	{
+		errno = EINVAL;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	if(session->state == MQTT_SESSION_CLOSED)
+	{
+		errno = ENOTCONN;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	/* Messages wait for CONNACK */
+	if(session->state != MQTT_SESSION_CONNECTED)
+		return 0;
+
+	position = queue->ring->dequeue_position;
+
+	for(;;)
+	{
+		cell = QUEUE_CELL(queue, position);
+
+		if(QUEUE_LOAD_ACQUIRE(&cell->sequence) != position + 1)
+		{
+			if(queue->doorbell < 0 || queue->ring->armed)
+				break;
+
+			/* Queue empty, arm wake up and look again for cell published before arming */
+			QUEUE_EXCHANGE(&queue->ring->armed, 1);
+
+			if(QUEUE_LOAD_ACQUIRE(&cell->sequence) != position + 1)
+				break;
+
+			QUEUE_EXCHANGE(&queue->ring->armed, 0);
+		}
+
+		if(budget > 0 && (uint32_t)published == budget)
+			break;
+
+		/* Cells written by other processes are read once, producer rewriting cell cannot pass check */
+		topic_length   = QUEUE_LOAD_RELAXED(&cell->topic_length);
+		message_length = QUEUE_LOAD_RELAXED(&cell->message_length);
+		qos            = QUEUE_LOAD_RELAXED(&cell->qos);
+		retain         = QUEUE_LOAD_RELAXED(&cell->retain);
+
+		if(topic_length >= PUBLISH_QUEUE_TOPIC || qos > MQTT_QOS_EXACTLY_ONCE ||
+		   topic_length + 1 + (size_t)message_length > queue->cell_size - sizeof(mqtt_queue_cell_t))
+		{
+			queue->ring->dropped++;
+		}
+		else
+		{
+			/* Topic is copied, NUL in cell can be rewritten too */
+			memcpy(topic, cell->data, topic_length);
+			topic[topic_length] = '\0';
+
+			if(mqtt_session_publish(session, topic, cell->data + topic_length + 1, message_length, (mqtt_qos_t)qos, retain, now) < 0)
+			{
+				/* Output or send window full, owner drains again once session can send */
+				if(errno == EAGAIN)
+					break;
+
+				queue->ring->dropped++;
+			}
+			else
+			{
+				published++;
+			}
+		}
+
+		/* Cell is free for producers of next round */
+		QUEUE_STORE_RELEASE(&cell->sequence, position + queue->mask + 1);
+
+		position++;
+
+		QUEUE_STORE_RELEASE(&queue->ring->dequeue_position, position);
+	}
+
+	if(published > 0 && queue->group != NULL && mqtt_notify_signal(queue->group) < 0)
+		return FUNC_OPTS_ERROR;
+
+	return published;
+}
+
+
+
+/*
+ * @brief  Returns number of queued messages, (exact only for owner thread with no producers running).
+ * @param  *queue      : pointer to queue structure (mqtt_queue_t).
+ * @retval uint32_t    : number of messages
+ */
+uint32_t mqtt_queue_count(mqtt_queue_t *queue)
+{
+	if(queue == NULL || queue->ring == NULL)
+		return 0;
+
+	return QUEUE_LOAD_RELAXED(&queue->ring->enqueue_position) - QUEUE_LOAD_RELAXED(&queue->ring->dequeue_position);
+}
@@ -0,0 +1,192 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_ring.c
+ * @author  Aditya Mall,
+ * @brief   MQTT client single producer, single consumer ring
+ *
+ *  Info
+ *          Lock free ring API Source File, (GCC atomics)
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall, MIT License </center></h2>
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019 Aditya Mall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+
+/*
+ * Standard Header and API Header files
+ */
+#include <mqtt_ring.h>
+#include <stdint.h>
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                  Data Structures and Defines                               */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* @brief Index access, other side of ring is written by other thread */
+#if GCC
+#define RING_LOAD_ACQUIRE(pointer)          __atomic_load_n((pointer), __ATOMIC_ACQUIRE)
+#define RING_STORE_RELEASE(pointer, value)  __atomic_store_n((pointer), (value), __ATOMIC_RELEASE)
+#endif
+
+
+/* return codes for ring functions */
+typedef enum function_return_codes
+{
+	FUNC_OPTS_ERROR       = -1,  /*!< */
+	FUNC_OPTS_SUCCESS     = 1,   /*!< */
+
+}return_codes_t;
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                              API Functions                                 */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Initializes ring on user storage of entry_size * entry_count bytes.
+ * @param  *ring         : pointer to ring structure (mqtt_ring_t).
+ * @param  *storage      : entry storage
+ * @param  entry_size    : size of one entry
+ * @param  entry_count   : number of entries, power of 2
+ * @retval int8_t        : 1 = Success, -1 = Error
+ */
+int8_t mqtt_ring_init(mqtt_ring_t *ring, void *storage, uint32_t entry_size, uint32_t entry_count)
+{
+	if(ring == NULL || storage == NULL || entry_size == 0 || entry_count == 0 || (entry_count & (entry_count - 1)) != 0)
+		return FUNC_OPTS_ERROR;
+
+	ring->head       = 0;
+	ring->tail       = 0;
+	ring->tail_cache = 0;
+	ring->head_cache = 0;
+	ring->entries    = (uint8_t*)storage;
+	ring->entry_size = entry_size;
+	ring->mask       = entry_count - 1;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Returns free entry to be written by producer, entry is given to consumer by commit.
+ * @param  *ring   : pointer to ring structure (mqtt_ring_t).
+ * @retval void*   : entry, NULL = ring full
+ */
+void *mqtt_ring_reserve(mqtt_ring_t *ring)
+{
+	uint32_t head = ring->head;
+
+	/* Shared tail is read only when cached copy says ring is full */
+	if(head - ring->tail_cache > ring->mask)
+	{
+		ring->tail_cache = RING_LOAD_ACQUIRE(&ring->tail);
+
+		if(head - ring->tail_cache > ring->mask)
+			return NULL;
+	}
+
+	return ring->entries + (size_t)(head & ring->mask) * ring->entry_size;
+}
+
+
+
+/*
+ * @brief  Gives entry returned by mqtt_ring_reserve() to consumer, (producer).
+ * @param  *ring   : pointer to ring structure (mqtt_ring_t).
+ * @retval None
+ */
+void mqtt_ring_commit(mqtt_ring_t *ring)
+{
+	/* Entry is written before consumer sees new head */
+	RING_STORE_RELEASE(&ring->head, ring->head + 1);
+}
+
+
+
+/*
+ * @brief  Returns oldest entry without removing it, (consumer).
+ * @param  *ring   : pointer to ring structure (mqtt_ring_t).
+ * @retval void*   : entry, NULL = ring empty
+ */
+void *mqtt_ring_peek(mqtt_ring_t *ring)
+{
+	uint32_t tail = ring->tail;
+
+	if(tail == ring->head_cache)
+	{
+		ring->head_cache = RING_LOAD_ACQUIRE(&ring->head);
+
+		if(tail == ring->head_cache)
+			return NULL;
+	}
+
+	return ring->entries + (size_t)(tail & ring->mask) * ring->entry_size;
+}
+
+
+
+/*
+ * @brief  Removes entry returned by mqtt_ring_peek(), entry can be reused by producer, (consumer).
+ * @param  *ring   : pointer to ring structure (mqtt_ring_t).
+ * @retval None
+ */
+void mqtt_ring_release(mqtt_ring_t *ring)
+{
+	/* Entry is read before producer can write it again */
+	RING_STORE_RELEASE(&ring->tail, ring->tail + 1);
+}
+
+
+
+/*
+ * @brief  Returns number of entries in ring, (exact only for consumer or producer thread).
+ * @param  *ring      : pointer to ring structure (mqtt_ring_t).
+ * @retval uint32_t   : number of entries
+ */
+uint32_t mqtt_ring_count(mqtt_ring_t *ring)
+{
+	if(ring == NULL)
+		return 0;
+
+	return RING_LOAD_ACQUIRE(&ring->head) - RING_LOAD_ACQUIRE(&ring->tail);
+}
@@ -0,0 +1,1132 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_session.c
+ * @author  Aditya Mall,
+ * @brief   MQTT client session engine
+ *
+ *  Info
+ *          Session engine API Source File
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall, MIT License </center></h2>
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019 Aditya Mall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+/*
+ * Standard Header and API Header files
+ */
+#include <mqtt_session.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                  Data Structures and Defines                               */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* return codes for session functions */
+typedef enum function_return_codes
+{
+	FUNC_OPTS_ERROR       = -1,  /*!< */
+	FUNC_OPTS_SUCCESS     = 1,   /*!< */
+
+}return_codes_t;
+
+
+/* Length of acknowledgment packets, (PUBACK, PUBREC, PUBCOMP, PINGREQ, DISCONNECT are shorter) */
+#define SESSION_ACK_LENGTH  4
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                           Private Functions                                */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Gives event to session event callback.
+ * @param  *session  : pointer to session structure (mqtt_session_t).
+ * @param  type      : event type
+ * @param  *packet   : received control packet, (NULL for none)
+ * @param  message_id: message ID of event
+ * @retval None
+ */
+static void mqtt_session_notify(mqtt_session_t *session, mqtt_session_event_type_t type, mqtt_packet_t *packet, uint16_t message_id)
+{
+	mqtt_session_event_t event;
+
+	if(session->callback == NULL)
+		return;
+
+	memset(&event, 0, sizeof(event));
+
+	event.type       = type;
+	event.packet     = packet;
+	event.message_id = message_id;
+
+	session->callback(session->context, session, &event);
+}
+
+
+
+/*
+ * @brief  Gives batch of acknowledged qos 1, 2 publish as one completed event.
+ * @param  *session  : pointer to session structure (mqtt_session_t).
+ * @retval None
+ */
+static void mqtt_session_completed(mqtt_session_t *session)
+{
+	mqtt_session_event_t event;
+
+	if(session->completed_count == 0)
+		return;
+
+	memset(&event, 0, sizeof(event));
+
+	event.type          = MQTT_SESSION_EVENT_COMPLETED;
+	event.message_ids   = session->completed_ids;
+	event.message_count = session->completed_count;
+
+	/* Batch is reused by acknowledgments handled from callback */
+	session->completed_count = 0;
+
+	if(session->callback != NULL)
+		session->callback(session->context, session, &event);
+}
+
+
+
+/*
+ * @brief  Closes session and gives closed event, keep alive is stopped.
+ * @param  *session  : pointer to session structure (mqtt_session_t).
+ * @param  error     : errno of close reason, 0 = DISCONNECT written
+ * @retval None
+ */
+static void mqtt_session_close(mqtt_session_t *session, int error)
+{
+	mqtt_session_event_t event;
+
+	if(session->state == MQTT_SESSION_CLOSED)
+		return;
+
+	session->state = MQTT_SESSION_CLOSED;
+
+	/* Acknowledgments received before close are given first */
+	mqtt_session_completed(session);
+
+	if(session->wheel != NULL)
+		mqtt_keepalive_stop(&session->keepalive);
+
+	if(session->callback == NULL)
+		return;
+
+	memset(&event, 0, sizeof(event));
+
+	event.type  = MQTT_SESSION_EVENT_CLOSED;
+	event.error = error;
+
+	session->callback(session->context, session, &event);
+}
+
+
+
+/*
+ * @brief  Queues control packet and records it for keep alive.
+ * @param  *session  : pointer to session structure (mqtt_session_t).
+ * @param  *packet   : encoded control packet
+ * @param  length    : length of packet
+ * @param  now       : current time, from mqtt_timer_now()
+ * @retval int8_t    : 1 = Success, -1 = Error (errno is set)
+ */
+static int8_t mqtt_session_queue(mqtt_session_t *session, const void *packet, size_t length, uint32_t now)
+{
+	if(mqtt_output_queue(&session->output, packet, length, (uint64_t)now * 1000U) < 0)
+		return FUNC_OPTS_ERROR;
+
+	if(session->wheel != NULL)
+		mqtt_keepalive_sent(&session->keepalive, now);
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Queues packet encoded in space reserved from output buffer, keep alive timer is restarted.
+ * @param  *session  : pointer to session structure (mqtt_session_t).
+ * @param  length    : length of encoded packet
+ * @param  now       : current time, from mqtt_timer_now()
+ * @retval int8_t    : 1 = Success, -1 = Error (errno is set)
+ */
+static int8_t mqtt_session_commit(mqtt_session_t *session, size_t length, uint32_t now)
+{
+	if(mqtt_output_commit(&session->output, length, 1, (uint64_t)now * 1000U) < 0)
+		return FUNC_OPTS_ERROR;
+
+	if(session->wheel != NULL)
+		mqtt_keepalive_sent(&session->keepalive, now);
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Queues acknowledgment packet of received message, (PUBACK, PUBREC, PUBCOMP).
+ * @param  *session    : pointer to session structure (mqtt_session_t).
+ * @param  type        : message type
+ * @param  message_id  : message ID of acknowledged message
+ * @param  now         : current time, from mqtt_timer_now()
+ * @retval int8_t      : 1 = Success, -1 = Error
+ */
+static int8_t mqtt_session_ack(mqtt_session_t *session, uint8_t type, uint16_t message_id, uint32_t now)
+{
+	uint8_t packet[SESSION_ACK_LENGTH];
+
+	packet[0] = mqtt_fixed_header_byte(type, MQTT_QOS_FIRE_FORGET, 0);
+	packet[1] = 2;
+	packet[2] = (uint8_t)(message_id >> 8);
+	packet[3] = (uint8_t)(message_id & 0xFF);
+
+	return mqtt_session_queue(session, packet, sizeof(packet), now);
+}
+
+
+
+/*
+ * @brief  Returns position of received qos 2 message ID, (between PUBREC and PUBREL).
+ * @param  *session    : pointer to session structure (mqtt_session_t).
+ * @param  message_id  : message ID of received PUBLISH
+ * @retval int         : index in received set, -1 = not received
+ */
+static int mqtt_session_received(mqtt_session_t *session, uint16_t message_id)
+{
+	int index = 0;
+
+	for(index = 0; index < session->received_count; index++)
+	{
+		if(session->received_ids[index] == message_id)
+			return index;
+	}
+
+	return FUNC_OPTS_ERROR;
+}
+
+
+
+/*
+ * @brief  Takes message ID of SUBSCRIBE or UNSUBSCRIBE from in-flight table, so no publish in
+ *         flight has the same ID, next encoded request uses it from session->next_message_id.
+ * @param  *session  : pointer to session structure (mqtt_session_t).
+ * @param  now       : current time, from mqtt_timer_now()
+ * @retval int8_t    : 1 = Success, -1 = Error (errno is set, EAGAIN = send window full)
+ */
+static int8_t mqtt_session_request(mqtt_session_t *session, uint32_t now)
+{
+	uint16_t message_id = 0;
+
+	/* Qos 0 only session has no publish IDs to collide with */
+	if(session->inflight_table == NULL)
+		return FUNC_OPTS_SUCCESS;
+
+	message_id = mqtt_inflight_acquire(session->inflight_table, MQTT_INFLIGHT_REQUEST_SENT, MQTT_QOS_FIRE_FORGET, now, NULL, 0);
+	if(message_id == 0)
+	{
+		errno = EAGAIN;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	/* Encoder increments to acquired ID */
+	session->next_message_id = message_id - 1;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Releases message ID of acknowledged or failed SUBSCRIBE, UNSUBSCRIBE.
+ * @param  *session    : pointer to session structure (mqtt_session_t).
+ * @param  message_id  : message ID of request
+ * @retval None
+ */
+static void mqtt_session_request_done(mqtt_session_t *session, uint16_t message_id)
+{
+	int16_t slot_index = 0;
+
+	if(session->inflight_table == NULL)
+		return;
+
+	slot_index = mqtt_inflight_find(session->inflight_table, message_id);
+
+	if(slot_index >= 0 && session->inflight_table->state[slot_index] == MQTT_INFLIGHT_REQUEST_SENT)
+		mqtt_inflight_release(session->inflight_table, message_id);
+}
+
+
+
+/*
+ * @brief  Returns message ID of acknowledgment packet.
+ * @param  *packet  : decoded control packet
+ * @retval uint16_t : message ID, 0 = malformed packet
+ */
+static uint16_t mqtt_session_packet_id(mqtt_packet_t *packet)
+{
+	if(packet->remaining_length < 2)
+		return 0;
+
+	return (uint16_t)((packet->body[0] << 8) | packet->body[1]);
+}
+
+
+
+/*
+ * @brief  In-flight completion callback, qos 1, 2 publish is given to user as published event
+ *         or added to completed batch.
+ * @param  *context        : session
+ * @param  message_id      : message ID of acknowledged publish
+ * @param  *buffer         : not used
+ * @param  buffer_length   : not used
+ * @retval None
+ */
+static void mqtt_session_published(void *context, uint16_t message_id, void *buffer, size_t buffer_length)
+{
+	mqtt_session_t *session = (mqtt_session_t*)context;
+
+	(void)buffer;
+	(void)buffer_length;
+
+	if(session->completed_ids == NULL)
+	{
+		mqtt_session_notify(session, MQTT_SESSION_EVENT_PUBLISHED, NULL, message_id);
+
+		return;
+	}
+
+	session->completed_ids[session->completed_count++] = message_id;
+
+	if(session->completed_count == session->completed_size)
+		mqtt_session_completed(session);
+}
+
+
+
+/*
+ * @brief  Keep alive timer callback, PINGREQ is sent by next poll, keep alive event tells owner
+ *         of session to poll it.
+ * @param  *timer    : keep alive timer
+ * @param  *context  : session
+ * @param  now       : expiry time
+ * @retval None
+ */
+static void mqtt_session_ping(mqtt_timer_t *timer, void *context, uint32_t now)
+{
+	(void)timer;
+	(void)now;
+
+	((mqtt_session_t*)context)->ping_due = 1;
+
+	/* Timer wheel shared by sessions is advanced outside poll of this session */
+	mqtt_session_notify((mqtt_session_t*)context, MQTT_SESSION_EVENT_KEEPALIVE, NULL, 0);
+}
+
+
+
+/*
+ * @brief  Queues PUBREL of qos 2 exchanges whose PUBREL did not fit output.
+ * @param  *session  : pointer to session structure (mqtt_session_t).
+ * @param  now       : current time, from mqtt_timer_now()
+ * @retval None
+ */
+static void mqtt_session_release(mqtt_session_t *session, uint32_t now)
+{
+	uint8_t  pubrel[MQTT_PUBREL_LENGTH];
+	uint16_t message_id = 0;
+
+	while((message_id = mqtt_inflight_first(session->inflight_table, MQTT_INFLIGHT_PUBREC_RECEIVED)) != 0)
+	{
+		if(mqtt_publish_release_encode(pubrel, sizeof(pubrel), message_id) == 0 ||
+		   mqtt_session_queue(session, pubrel, sizeof(pubrel), now) < 0)
+			return;
+
+		mqtt_inflight_update(session->inflight_table, message_id, MQTT_INFLIGHT_PUBREL_SENT, now);
+	}
+
+	session->pubrel_pending = 0;
+}
+
+
+
+/*
+ * @brief  Handles received control packet, gives its event and queues acknowledgment.
+ * @param  *session  : pointer to session structure (mqtt_session_t).
+ * @param  *packet   : decoded control packet
+ * @param  now       : current time, from mqtt_timer_now()
+ * @retval int8_t    : 1 = Success, -1 = Error (session closed)
+ */
+static int8_t mqtt_session_dispatch(mqtt_session_t *session, mqtt_packet_t *packet, uint32_t now)
+{
+	mqtt_session_event_t event;
+	mqtt_publish_view_t  publish;
+
+	uint8_t pubrel[MQTT_PUBREL_LENGTH];
+	size_t  pubrel_length = 0;
+	int     index         = 0;
+
+	switch(packet->message_type)
+	{
+
+	case MQTT_CONNACK_MESSAGE:
+
+		if(session->state != MQTT_SESSION_CONNECTING || packet->remaining_length < 2)
+			break;
+
+		/* Return code follows reserved byte */
+		if(packet->body[1] != MQTT_CONNECTION_ACCEPTED)
+		{
+			memset(&event, 0, sizeof(event));
+
+			event.type        = MQTT_SESSION_EVENT_REFUSED;
+			event.return_code = packet->body[1];
+			event.packet      = packet;
+
+			if(session->callback != NULL)
+				session->callback(session->context, session, &event);
+
+			mqtt_session_close(session, ECONNREFUSED);
+
+			return FUNC_OPTS_ERROR;
+		}
+
+		session->state = MQTT_SESSION_CONNECTED;
+
+		mqtt_session_notify(session, MQTT_SESSION_EVENT_CONNECTED, packet, 0);
+
+		break;
+
+
+	case MQTT_PUBLISH_MESSAGE:
+
+		if(mqtt_publish_parse(packet, &publish) < 0)
+		{
+			mqtt_session_close(session, EPROTO);
+
+			return FUNC_OPTS_ERROR;
+		}
+
+		if(publish.qos == MQTT_QOS_ATLEAST_ONCE)
+		{
+			mqtt_session_ack(session, MQTT_PUBACK_MESSAGE, publish.message_id, now);
+		}
+		else if(publish.qos == MQTT_QOS_EXACTLY_ONCE)
+		{
+			/* Qos 2 message is given once, repeated PUBLISH before PUBREL only gets PUBREC again */
+			if(mqtt_session_received(session, publish.message_id) >= 0)
+			{
+				mqtt_session_ack(session, MQTT_PUBREC_MESSAGE, publish.message_id, now);
+
+				break;
+			}
+
+			/* Received set full, message is not acknowledged and broker sends it again */
+			if(session->received_count == SESSION_RECEIVE_SLOTS)
+				break;
+
+			if(mqtt_session_ack(session, MQTT_PUBREC_MESSAGE, publish.message_id, now) < 0)
+				break;
+
+			session->received_ids[session->received_count++] = publish.message_id;
+		}
+
+		memset(&event, 0, sizeof(event));
+
+		event.type       = MQTT_SESSION_EVENT_MESSAGE;
+		event.message_id = publish.message_id;
+		event.packet     = packet;
+		event.publish    = &publish;
+
+		if(session->callback != NULL)
+			session->callback(session->context, session, &event);
+
+		break;
+
+
+	case MQTT_PUBACK_MESSAGE:
+	case MQTT_PUBREC_MESSAGE:
+	case MQTT_PUBCOMP_MESSAGE:
+
+		if(session->inflight_table == NULL)
+			break;
+
+		/* Published events are given by in-flight completion callback */
+		mqtt_inflight_process(session->inflight_table, packet, now, pubrel, sizeof(pubrel), &pubrel_length);
+
+		/* Slot is PUBREL_SENT already, PUBREL that does not fit is queued again by poll */
+		if(pubrel_length > 0 && mqtt_session_queue(session, pubrel, pubrel_length, now) < 0)
+		{
+			mqtt_inflight_update(session->inflight_table, mqtt_session_packet_id(packet), MQTT_INFLIGHT_PUBREC_RECEIVED, now);
+
+			session->pubrel_pending = 1;
+		}
+
+		break;
+
+
+	case MQTT_PUBREL_MESSAGE:
+
+		/* PUBCOMP is sent for unknown IDs too, broker may repeat PUBREL after PUBCOMP was lost */
+		if(mqtt_session_ack(session, MQTT_PUBCOMP_MESSAGE, mqtt_session_packet_id(packet), now) < 0)
+			break;
+
+		index = mqtt_session_received(session, mqtt_session_packet_id(packet));
+		if(index >= 0)
+			session->received_ids[index] = session->received_ids[--session->received_count];
+
+		break;
+
+
+	case MQTT_SUBACK_MESSAGE:
+
+		mqtt_session_request_done(session, mqtt_session_packet_id(packet));
+
+		mqtt_session_notify(session, MQTT_SESSION_EVENT_SUBSCRIBED, packet, mqtt_session_packet_id(packet));
+
+		break;
+
+
+	case MQTT_UNSUBACK_MESSAGE:
+
+		mqtt_session_request_done(session, mqtt_session_packet_id(packet));
+
+		mqtt_session_notify(session, MQTT_SESSION_EVENT_UNSUBSCRIBED, packet, mqtt_session_packet_id(packet));
+
+		break;
+
+
+	case MQTT_PINRESP_MESSAGE:
+
+		session->ping_sent = 0;
+
+		mqtt_session_notify(session, MQTT_SESSION_EVENT_PINGRESP, packet, 0);
+
+		break;
+
+
+	default:
+		break;
+
+	}
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                              API Functions                                 */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Initializes session of connected socket, buffers and tables are owned by user.
+ * @param  *session        : pointer to session structure (mqtt_session_t).
+ * @param  descriptor      : connected socket descriptor, (non blocking)
+ * @param  read            : read function, (read() or NULL when input is given with mqtt_session_feed())
+ * @param  write           : write function, (write() or transport write)
+ * @param  *input_buffer   : input stream buffer, limits largest received packet
+ * @param  input_length    : length of input stream buffer
+ * @param  *output_buffer  : output buffer, (OUTPUT_BUFFER_SIZE)
+ * @param  output_length   : length of output buffer
+ * @param  *inflight_table : in-flight table for qos 1, 2 publish, (NULL for qos 0 only)
+ * @param  *wheel          : timer wheel of keep alive, (NULL for no keep alive)
+ * @param  callback        : event callback
+ * @param  *context        : user context passed to event callback
+ * @retval int8_t          : 1 = Success, -1 = Error
+ */
+int8_t mqtt_session_init(mqtt_session_t *session, int descriptor, mqtt_session_read_t read, mqtt_output_write_t write,
+		                 uint8_t *input_buffer, size_t input_length, uint8_t *output_buffer, size_t output_length,
+		                 mqtt_inflight_t *inflight_table, mqtt_timer_wheel_t *wheel, mqtt_session_callback_t callback, void *context)
+{
+	if(session == NULL)
+		return FUNC_OPTS_ERROR;
+
+	memset(session, 0, sizeof(mqtt_session_t));
+
+	if(mqtt_decoder_init(&session->decoder, input_buffer, input_length) < 0 ||
+	   mqtt_output_init(&session->output, output_buffer, output_length, descriptor, write, OUTPUT_FLUSH_DEADLINE) < 0)
+		return FUNC_OPTS_ERROR;
+
+	session->state          = MQTT_SESSION_IDLE;
+	session->descriptor     = descriptor;
+	session->read           = read;
+	session->inflight_table = inflight_table;
+	session->wheel          = wheel;
+	session->callback       = callback;
+	session->context        = context;
+
+	/* Acknowledged qos 1, 2 publish is given as published event */
+	if(inflight_table != NULL)
+		mqtt_inflight_callbacks(inflight_table, mqtt_session_published, NULL, session);
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Gives acknowledged qos 1, 2 publish as one completed event per poll instead of a
+ *         published event each, batch is given early when it is full.
+ * @param  *session  : pointer to session structure (mqtt_session_t).
+ * @param  *ids      : message ID storage of batch, (NULL = published event per message)
+ * @param  size      : number of message IDs batch holds
+ * @retval int8_t    : 1 = Success, -1 = Error
+ */
+int8_t mqtt_session_batch(mqtt_session_t *session, uint16_t *ids, uint16_t size)
+{
+	if(session == NULL || (ids != NULL && size == 0))
+		return FUNC_OPTS_ERROR;
+
+	/* Pending batch is given before storage changes */
+	mqtt_session_completed(session);
+
+	session->completed_ids  = ids;
+	session->completed_size = size;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Attaches or detaches in-flight table, tables can be shared by sessions that have
+ *         no qos 1, 2 publish in flight.
+ * @param  *session        : pointer to session structure (mqtt_session_t).
+ * @param  *inflight_table : in-flight table, (NULL = detach, qos 0 only)
+ * @retval int8_t          : 1 = Success, -1 = Error (errno is set, EBUSY = messages in flight)
+ */
+int8_t mqtt_session_inflight(mqtt_session_t *session, mqtt_inflight_t *inflight_table)
+{
+	if(session == NULL)
+		return FUNC_OPTS_ERROR;
+
+	if(session->inflight_table != NULL && session->inflight_table->count > 0)
+	{
+		errno = EBUSY;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	session->inflight_table = inflight_table;
+
+	if(inflight_table != NULL)
+		mqtt_inflight_callbacks(inflight_table, mqtt_session_published, NULL, session);
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Queues CONNECT message and starts keep alive.
+ * @param  *session        : pointer to session structure (mqtt_session_t).
+ * @param  *client_name    : client ID
+ * @param  *user_name      : user name, (NULL for none)
+ * @param  *password       : password, (NULL for none)
+ * @param  keep_alive_time : keep alive time in seconds, (0 = disabled)
+ * @param  clean_session   : MQTT_CLEAN_SESSION or 0
+ * @param  now             : current time, from mqtt_timer_now()
+ * @retval int8_t          : 1 = Success, -1 = Error
+ */
+int8_t mqtt_session_connect(mqtt_session_t *session, char *client_name, char *user_name, char *password,
+		                    uint16_t keep_alive_time, uint8_t clean_session, uint32_t now)
+{
+	mqtt_client_t  client;
+	mqtt_connect_t message;
+	size_t         message_length = 0;
+
+	if(session == NULL || client_name == NULL || session->state != MQTT_SESSION_IDLE)
+		return FUNC_OPTS_ERROR;
+
+	/* CONNECT is built with client message encoders */
+	memset(&message, 0, sizeof(message));
+
+	mqtt_client_init(&client, NULL);
+
+	client.connect_msg = &message;
+
+	if(user_name != NULL && password != NULL && mqtt_client_username_passwd(&client, user_name, password) < 0)
+		return FUNC_OPTS_ERROR;
+
+	if(mqtt_connect_options(&client, clean_session, MQTT_MESSAGE_NO_RETAIN, MQTT_QOS_FIRE_FORGET) < 0)
+		return FUNC_OPTS_ERROR;
+
+	message_length = mqtt_connect(&client, client_name, (int16_t)keep_alive_time);
+	if(message_length == 0 || message_length > sizeof(message))
+		return FUNC_OPTS_ERROR;
+
+	if(mqtt_session_queue(session, &message, message_length, now) < 0)
+		return FUNC_OPTS_ERROR;
+
+	session->state = MQTT_SESSION_CONNECTING;
+
+	if(session->wheel != NULL && keep_alive_time > 0)
+		mqtt_keepalive_start(session->wheel, &session->keepalive, keep_alive_time * 1000U, now, mqtt_session_ping, session);
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Queues PUBLISH message, qos 1, 2 messages are completed with published event.
+ * @param  *session        : pointer to session structure (mqtt_session_t).
+ * @param  *topic          : publish topic
+ * @param  *message        : message, (binary safe)
+ * @param  message_length  : length of message
+ * @param  qos             : quality of service value
+ * @param  retain          : MQTT_MESSAGE_RETAIN or MQTT_MESSAGE_NO_RETAIN
+ * @param  now             : current time, from mqtt_timer_now()
+ * @retval int32_t         : message ID, 0 = qos 0 message queued,
+ *                           -1 = Error (errno is set, EAGAIN = send window full or output would block)
+ */
+int32_t mqtt_session_publish(mqtt_session_t *session, char *topic, const void *message, size_t message_length,
+		                     mqtt_qos_t qos, uint8_t retain, uint32_t now)
+{
+	uint8_t      header[MQTT_PUBLISH_HEADER_LENGTH];
+	mqtt_iovec_t vector[MQTT_PUBLISH_IOV_COUNT];
+	uint16_t     message_id = 0;
+
+	if(session == NULL || qos >= MQTT_QOS_RESERVED || (qos != MQTT_QOS_FIRE_FORGET && session->inflight_table == NULL))
+	{
+		errno = EINVAL;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	if(session->state != MQTT_SESSION_CONNECTED)
+	{
+		errno = ENOTCONN;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	/* Producer waits for output to drain */
+	if(mqtt_output_writable(&session->output) != 1)
+	{
+		errno = EAGAIN;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	if(qos != MQTT_QOS_FIRE_FORGET)
+	{
+		message_id = mqtt_inflight_acquire(session->inflight_table, MQTT_INFLIGHT_PUBLISH_SENT, qos, now, NULL, 0);
+		if(message_id == 0)
+		{
+			errno = EAGAIN;
+
+			return FUNC_OPTS_ERROR;
+		}
+	}
+
+	if(mqtt_publish_iov(header, sizeof(header), topic, message, message_length, retain, qos, message_id, vector) == 0)
+	{
+		if(message_id != 0)
+			mqtt_inflight_release(session->inflight_table, message_id);
+
+		errno = EINVAL;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	if(mqtt_output_queue_vector(&session->output, vector, MQTT_PUBLISH_IOV_COUNT, 1, (uint64_t)now * 1000U) < 0)
+	{
+		if(message_id != 0)
+			mqtt_inflight_release(session->inflight_table, message_id);
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	if(session->wheel != NULL)
+		mqtt_keepalive_sent(&session->keepalive, now);
+
+	return message_id;
+}
+
+
+
+/*
+ * @brief  Queues SUBSCRIBE message of topic filter list, completed with subscribed event.
+ * @param  *session      : pointer to session structure (mqtt_session_t).
+ * @param  *entries      : topic filter list
+ * @param  entry_count   : number of topic filters
+ * @param  now           : current time, from mqtt_timer_now()
+ * @retval int32_t       : message ID, -1 = Error (errno is set)
+ */
+int32_t mqtt_session_subscribe(mqtt_session_t *session, mqtt_subscribe_entry_t *entries, size_t entry_count, uint32_t now)
+{
+	uint8_t *message        = NULL;
+	size_t   message_length = 0;
+
+	if(session == NULL || session->state == MQTT_SESSION_IDLE || session->state >= MQTT_SESSION_CLOSING)
+	{
+		errno = ENOTCONN;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	/* Long filter lists are sized first and encoded straight into output buffer */
+	message_length = mqtt_subscribe_many_length(entries, entry_count);
+	if(message_length == 0)
+	{
+		errno = EINVAL;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	if(mqtt_session_request(session, now) < 0)
+		return FUNC_OPTS_ERROR;
+
+	message = mqtt_output_reserve(&session->output, message_length);
+	if(message == NULL)
+	{
+		mqtt_session_request_done(session, (uint16_t)(session->next_message_id + 1));
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	mqtt_subscribe_many(entries, entry_count, &session->next_message_id, message, message_length);
+
+	if(mqtt_session_commit(session, message_length, now) < 0)
+	{
+		mqtt_session_request_done(session, session->next_message_id);
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	return session->next_message_id;
+}
+
+
+
+/*
+ * @brief  Queues UNSUBSCRIBE message of topic filter list, completed with unsubscribed event.
+ * @param  *session      : pointer to session structure (mqtt_session_t).
+ * @param  **topics      : topic filter list
+ * @param  topic_count   : number of topic filters
+ * @param  now           : current time, from mqtt_timer_now()
+ * @retval int32_t       : message ID, -1 = Error (errno is set)
+ */
+int32_t mqtt_session_unsubscribe(mqtt_session_t *session, char **topics, size_t topic_count, uint32_t now)
+{
+	uint8_t *message        = NULL;
+	size_t   message_length = 0;
+
+	if(session == NULL || session->state == MQTT_SESSION_IDLE || session->state >= MQTT_SESSION_CLOSING)
+	{
+		errno = ENOTCONN;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	/* Long filter lists are sized first and encoded straight into output buffer */
+	message_length = mqtt_unsubscribe_many_length(topics, topic_count);
+	if(message_length == 0)
+	{
+		errno = EINVAL;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	if(mqtt_session_request(session, now) < 0)
+		return FUNC_OPTS_ERROR;
+
+	message = mqtt_output_reserve(&session->output, message_length);
+	if(message == NULL)
+	{
+		mqtt_session_request_done(session, (uint16_t)(session->next_message_id + 1));
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	mqtt_unsubscribe_many(topics, topic_count, &session->next_message_id, message, message_length);
+
+	if(mqtt_session_commit(session, message_length, now) < 0)
+	{
+		mqtt_session_request_done(session, session->next_message_id);
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	return session->next_message_id;
+}
+
+
+
+/*
+ * @brief  Queues DISCONNECT message, session is closed by poll once output is written.
+ * @param  *session  : pointer to session structure (mqtt_session_t).
+ * @param  now       : current time, from mqtt_timer_now()
+ * @retval int8_t    : 1 = Success, -1 = Error
+ */
+int8_t mqtt_session_disconnect(mqtt_session_t *session, uint32_t now)
+{
+	uint8_t message[FIXED_HEADER_LENGTH];
+
+	if(session == NULL || session->state == MQTT_SESSION_IDLE || session->state >= MQTT_SESSION_CLOSING)
+		return FUNC_OPTS_ERROR;
+
+	message[0] = mqtt_fixed_header_byte(MQTT_DISCONNECT_MESSAGE, MQTT_QOS_FIRE_FORGET, 0);
+	message[1] = 0;
+
+	if(mqtt_session_queue(session, message, sizeof(message), now) < 0)
+		return FUNC_OPTS_ERROR;
+
+	session->state = MQTT_SESSION_CLOSING;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Closes session without DISCONNECT, closed event is given with error.
+ * @param  *session  : pointer to session structure (mqtt_session_t).
+ * @param  error     : errno given with closed event
+ * @retval int8_t    : 1 = Success, -1 = Error
+ */
+int8_t mqtt_session_abort(mqtt_session_t *session, int error)
+{
+	if(session == NULL || session->state == MQTT_SESSION_CLOSED)
+		return FUNC_OPTS_ERROR;
+
+	mqtt_session_close(session, error);
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Copies received bytes into session input, (when session has no read function).
+ * @param  *session  : pointer to session structure (mqtt_session_t).
+ * @param  *data     : received bytes
+ * @param  length    : number of bytes
+ * @retval size_t    : number of bytes taken, rest is given again after next poll
+ */
+size_t mqtt_session_feed(mqtt_session_t *session, const void *data, size_t length)
+{
+	if(session == NULL || data == NULL)
+		return 0;
+
+	return mqtt_decoder_feed(&session->decoder, data, length);
+}
+
+
+
+/*
+ * @brief  Runs session state machine without blocking, received packets are handled and their
+ *         events given to callback, acknowledgments and PINGREQ are queued and output is flushed.
+ * @param  *session  : pointer to session structure (mqtt_session_t).
+ * @param  now       : current time, from mqtt_timer_now()
+ * @param  budget    : most packets handled in this call, (0 = no limit)
+ * @retval int       : number of packets handled, (equal to budget = more input may be pending),
+ *                     -1 = Error
+ */
+int mqtt_client_poll(mqtt_session_t *session, uint32_t now, uint16_t budget)
+{
+	mqtt_packet_t packet;
+	uint8_t       message[FIXED_HEADER_LENGTH];
+	uint8_t      *read_pointer = NULL;
+	size_t        read_length  = 0;
+	ssize_t       read_count   = 0;
+	int8_t        retval       = 0;
+	int           work_count   = 0;
+
+	if(session == NULL)
+		return FUNC_OPTS_ERROR;
+
+	if(session->state == MQTT_SESSION_IDLE || session->state == MQTT_SESSION_CLOSED)
+		return 0;
+
+	/* Keep alive timer sets ping due */
+	if(session->wheel != NULL)
+		mqtt_timer_advance(session->wheel, now);
+
+	if(session->ping_due)
+	{
+		session->ping_due = 0;
+
+		/* Broker did not answer last PINGREQ within keep alive time */
+		if(session->ping_sent)
+		{
+			mqtt_session_close(session, ETIMEDOUT);
+
+			return work_count;
+		}
+
+		message[0] = mqtt_fixed_header_byte(MQTT_PINGREQ_MESSAGE, MQTT_QOS_FIRE_FORGET, 0);
+		message[1] = 0;
+
+		if(mqtt_output_queue(&session->output, message, sizeof(message), (uint64_t)now * 1000U) > 0)
+			session->ping_sent = 1;
+	}
+
+	/* Received packets, stops while output has no room for acknowledgment */
+	while(session->state != MQTT_SESSION_CLOSED && (budget == 0 || work_count < budget) &&
+		  session->output.buffer_size - mqtt_output_pending(&session->output) >= SESSION_ACK_LENGTH)
+	{
+		retval = mqtt_decoder_next(&session->decoder, &packet);
+		if(retval < 0)
+		{
+			mqtt_session_close(session, EPROTO);
+
+			break;
+		}
+
+		if(retval == 0)
+		{
+			if(session->read == NULL)
+				break;
+
+			read_pointer = mqtt_decoder_buffer(&session->decoder, &read_length);
+
+			read_count = session->read(session->descriptor, read_pointer, read_length);
+
+			if(read_count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+				break;
+
+			/* Socket closed by broker or read error */
+			if(read_count <= 0)
+			{
+				mqtt_session_close(session, (read_count == 0) ? ECONNRESET : errno);
+
+				break;
+			}
+
+			mqtt_decoder_commit(&session->decoder, (size_t)read_count);
+
+			continue;
+		}
+
+		mqtt_session_dispatch(session, &packet, now);
+
+		work_count++;
+	}
+
+	if(session->state == MQTT_SESSION_CLOSED)
+		return work_count;
+
+	mqtt_session_completed(session);
+
+	/* Stalled output is resumed on write event, else written at flush size or deadline */
+	if(session->output.stalled || session->state == MQTT_SESSION_CLOSING)
+	{
+		if(mqtt_output_flush(&session->output) < 0 && errno != EAGAIN)
+			mqtt_session_close(session, errno);
+	}
+	else if(mqtt_output_poll(&session->output, (uint64_t)now * 1000U) < 0)
+	{
+		mqtt_session_close(session, errno);
+	}
+
+	/* PUBREL is queued once output has room again, (after write event) */
+	if(session->pubrel_pending && session->inflight_table != NULL && session->state != MQTT_SESSION_CLOSED)
+		mqtt_session_release(session, now);
+
+	/* DISCONNECT written */
+	if(session->state == MQTT_SESSION_CLOSING && mqtt_output_pending(&session->output) == 0)
+		mqtt_session_close(session, 0);
+
+	return work_count;
+}
+
+
+
+/*
+ * @brief  Returns time until session must be polled again, for event loop timeout.
+ * @param  *session  : pointer to session structure (mqtt_session_t).
+ * @param  now       : current time, from mqtt_timer_now()
+ * @retval int       : milliseconds, -1 = no timeout
+ */
+int mqtt_session_next_timeout(mqtt_session_t *session, uint32_t now)
+{
+	int     timeout  = -1;
+	int32_t deadline = 0;
+
+	if(session == NULL || session->state == MQTT_SESSION_CLOSED)
+		return -1;
+
+	/* Set by timer of shared wheel advanced from other session, pending PUBREL waits for write event only when stalled */
+	if(session->ping_due || (session->pubrel_pending && !session->output.stalled))
+		return 0;
+
+	if(session->wheel != NULL)
+		timeout = mqtt_timer_next_timeout(session->wheel, now);
+
+	/* Output deadline, rounded up to whole milliseconds */
+	deadline = mqtt_output_next_deadline(&session->output, (uint64_t)now * 1000U);
+	if(deadline >= 0)
+	{
+		deadline = (deadline + 999) / 1000;
+
+		if(timeout < 0 || deadline < timeout)
+			timeout = deadline;
+	}
+
+	return timeout;
+}
+
+
+
+/*
+ * @brief  Returns event loop events session waits for, write event while output is stalled.
+ * @param  *session  : pointer to session structure (mqtt_session_t).
+ * @retval uint8_t   : MQTT_EVENT_READ with MQTT_EVENT_WRITE when output is stalled
+ */
+uint8_t mqtt_session_events(mqtt_session_t *session)
+{
+	if(session == NULL)
+		return 0;
+
+	return MQTT_EVENT_READ | mqtt_output_events(&session->output);
+}
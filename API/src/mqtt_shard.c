@@ -0,0 +1,1059 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_shard.c
+ * @author  Aditya Mall,
+ * @brief   MQTT client sharded runtime
+ *
+ *  Info
+ *          Sharded runtime API Source File, (POSIX threads, GCC atomics)
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall, MIT License </center></h2>
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019 Aditya Mall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+
+/*
+ * Standard Header and API Header files
+ */
+#define _GNU_SOURCE
+#include <mqtt_shard.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                  Data Structures and Defines                               */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* @brief Fields shared between producer threads and shard threads */
+#if GCC
+#define SHARD_LOAD_ACQUIRE(pointer)          __atomic_load_n((pointer), __ATOMIC_ACQUIRE)
+#define SHARD_STORE_RELEASE(pointer, value)  __atomic_store_n((pointer), (value), __ATOMIC_RELEASE)
+#define SHARD_EXCHANGE(pointer, value)       __atomic_exchange_n((pointer), (value), __ATOMIC_SEQ_CST)
+#define SHARD_FETCH_ADD(pointer, value)      __atomic_fetch_add((pointer), (value), __ATOMIC_SEQ_CST)
+#define SHARD_FENCE()                        __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+
+/* @brief Space for topic and message in ring entry */
+#define SHARD_DATA_LENGTH  (SHARD_ENTRY_SIZE - sizeof(mqtt_shard_entry_t))
+
+
+/* @brief Parked command of shard, parked is index + 1 */
+#define SHARD_PARKED(shard, number)  ((mqtt_shard_entry_t*)((shard)->parked + (size_t)((number) - 1) * SHARD_ENTRY_SIZE))
+
+
+/* return codes for shard functions */
+typedef enum function_return_codes
+{
+	FUNC_OPTS_ERROR       = -1,  /*!< */
+	FUNC_OPTS_SUCCESS     = 1,   /*!< */
+
+}return_codes_t;
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                           Private Functions                                */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Returns FNV-1a hash of client ID.
+ * @param  *client_id   : client ID
+ * @retval uint32_t     : hash
+ */
+static uint32_t mqtt_shard_hash(const char *client_id)
+{
+	uint32_t hash  = 2166136261U;
+	uint8_t  index = 0;
+
+	for(index = 0; index < CLIENT_ID_LENGTH && client_id[index] != '\0'; index++)
+	{
+		hash ^= (uint8_t)client_id[index];
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+
+
+/*
+ * @brief  Returns client ID table entry of client ID, (linear probing).
+ * @param  *shard       : pointer to shard structure (mqtt_shard_t).
+ * @param  *client_id   : client ID
+ * @param  insert       : 1 = free or removed entry is returned when client ID is not found
+ * @retval mqtt_shard_session_t* : entry, NULL = not found
+ */
+static mqtt_shard_session_t *mqtt_shard_find(mqtt_shard_t *shard, const char *client_id, uint8_t insert)
+{
+	mqtt_shard_session_t *entry   = NULL;
+	mqtt_shard_session_t *removed = NULL;
+	uint32_t              index   = 0;
+	uint32_t              probe   = 0;
+
+	/* Low bits of hash also select shard, high bits are folded in */
+	index = mqtt_shard_hash(client_id);
+	index ^= index >> 16;
+
+	for(probe = 0; probe <= shard->session_mask; probe++)
+	{
+		entry = &shard->sessions[(index + probe) & shard->session_mask];
+
+		if(entry->client_id[0] == '\0')
+			break;
+
+		if(entry->session == NULL)
+		{
+			if(removed == NULL)
+				removed = entry;
+
+			continue;
+		}
+
+		if(strncmp(entry->client_id, client_id, CLIENT_ID_LENGTH) == 0)
+			return insert ? NULL : entry;
+	}
+
+	if(!insert)
+		return NULL;
+
+	return (removed != NULL) ? removed : (entry->client_id[0] == '\0') ? entry : NULL;
+}
+
+
+
+/*
+ * @brief  Session event callback of shard sessions, closed session is removed from client ID table.
+ * @param  *context  : client ID table entry
+ * @param  *session  : session
+ * @param  *event    : session event
+ * @retval None
+ */
+static void mqtt_shard_event(void *context, mqtt_session_t *session, const mqtt_session_event_t *event)
+{
+	mqtt_shard_session_t *entry = (mqtt_shard_session_t*)context;
+
+	if(entry->shard->shards->callback != NULL)
+		entry->shard->shards->callback(entry->context, session, event);
+
+	if(event->type == MQTT_SESSION_EVENT_CLOSED)
+		entry->session = NULL;
+}
+
+
+
+/*
+ * @brief  Event loop callback of doorbell, clears eventfd.
+ * @param  *context  : shard
+ * @param  fd        : eventfd
+ * @param  events    : ready events
+ * @retval None
+ */
+static void mqtt_shard_doorbell(void *context, int fd, uint8_t events)
+{
+	uint64_t counter = 0;
+
+	(void)context;
+	(void)events;
+
+	if(read(fd, &counter, sizeof(counter)) < 0)
+		return;
+}
+
+
+
+/*
+ * @brief  Parks copy of command that session can not run now, behind earlier parked commands of session.
+ * @param  *shard    : pointer to shard structure (mqtt_shard_t).
+ * @param  *record   : client ID table entry of session
+ * @param  *entry    : ring entry
+ * @retval int8_t    : 1 = Success, -1 = Error (all parked entries in use)
+ */
+static int8_t mqtt_shard_park(mqtt_shard_t *shard, mqtt_shard_session_t *record, mqtt_shard_entry_t *entry)
+{
+	uint16_t parked = shard->parked_free;
+
+	if(parked == 0)
+		return FUNC_OPTS_ERROR;
+
+	shard->parked_free = shard->parked_next[parked - 1];
+
+	memcpy(SHARD_PARKED(shard, parked), entry, sizeof(mqtt_shard_entry_t) + entry->topic_length + 1 + entry->message_length);
+
+	shard->parked_next[parked - 1] = 0;
+
+	if(record->parked_head == 0)
+	{
+		record->parked_head = parked;
+
+		shard->parked_list[shard->parked_count++] = record;
+	}
+	else
+	{
+		shard->parked_next[record->parked_tail - 1] = parked;
+	}
+
+	record->parked_tail = parked;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Returns first parked command of session to free list.
+ * @param  *shard    : pointer to shard structure (mqtt_shard_t).
+ * @param  *record   : client ID table entry of session
+ * @retval None
+ */
+static void mqtt_shard_unpark(mqtt_shard_t *shard, mqtt_shard_session_t *record)
+{
+	uint16_t parked = record->parked_head;
+
+	record->parked_head = shard->parked_next[parked - 1];
+
+	shard->parked_next[parked - 1] = shard->parked_free;
+	shard->parked_free             = parked;
+}
+
+
+
+/*
+ * @brief  Drops parked commands of closed session before its table entry is used again.
+ * @param  *shard    : pointer to shard structure (mqtt_shard_t).
+ * @param  *record   : client ID table entry
+ * @retval None
+ */
+static void mqtt_shard_discard(mqtt_shard_t *shard, mqtt_shard_session_t *record)
+{
+	uint16_t index = 0;
+
+	if(record->parked_head == 0)
+		return;
+
+	while(record->parked_head != 0)
+	{
+		mqtt_shard_unpark(shard, record);
+
+		shard->dropped++;
+	}
+
+	for(index = 0; index < shard->parked_count; index++)
+	{
+		if(shard->parked_list[index] == record)
+		{
+			shard->parked_list[index] = shard->parked_list[--shard->parked_count];
+
+			break;
+		}
+	}
+}
+
+
+
+/*
+ * @brief  Executes submitted command on shard thread.
+ * @param  *shard    : pointer to shard structure (mqtt_shard_t).
+ * @param  *record   : client ID table entry, (free entry for MQTT_SHARD_OPEN), NULL = unknown session
+ * @param  *entry    : ring entry or parked command
+ * @param  now       : current time, from mqtt_timer_now()
+ * @retval int8_t    : 1 = done, (executed or dropped), 0 = retry later, session can not send now
+ */
+static int8_t mqtt_shard_execute(mqtt_shard_t *shard, mqtt_shard_session_t *record, mqtt_shard_entry_t *entry, uint32_t now)
+{
+	mqtt_session_t *session = NULL;
+
+	if(record == NULL)
+	{
+		if(entry->command == MQTT_SHARD_OPEN)
+			close(entry->descriptor);
+
+		shard->dropped++;
+
+		return 1;
+	}
+
+	switch(entry->command)
+	{
+
+	case MQTT_SHARD_OPEN:
+
+		/* Commands parked for previous session of table entry are not run on new one */
+		mqtt_shard_discard(shard, record);
+
+		/* Table entry is used only once session is open */
+		session = mqtt_manager_open(&shard->manager, entry->descriptor, record);
+		if(session == NULL)
+		{
+			close(entry->descriptor);
+
+			shard->dropped++;
+
+			return 1;
+		}
+
+		memcpy(record->client_id, entry->client_id, sizeof(record->client_id));
+
+		record->session = session;
+		record->context = entry->context;
+		record->shard   = shard;
+
+		if(mqtt_session_connect(session, record->client_id, NULL, NULL, entry->keep_alive_time, MQTT_CLEAN_SESSION, now) < 0)
+			mqtt_manager_close(&shard->manager, session);
+
+		break;
+
+
+	case MQTT_SHARD_PUBLISH:
+
+		session = record->session;
+
+		if(mqtt_manager_lease(&shard->manager, session, entry->qos != MQTT_QOS_FIRE_FORGET) < 0)
+			return (errno == ENOBUFS) ? 0 : 1;
+
+		if(mqtt_session_publish(session, (char*)entry->data, entry->data + entry->topic_length + 1, entry->message_length,
+				                (mqtt_qos_t)entry->qos, entry->retain, now) < 0)
+		{
+			/* Output or send window full, or CONNACK not yet received */
+			if(errno == EAGAIN || (errno == ENOTCONN && session->state == MQTT_SESSION_CONNECTING))
+				return 0;
+
+			shard->dropped++;
+
+			return 1;
+		}
+
+		break;
+
+
+	case MQTT_SHARD_DISCONNECT:
+
+		session = record->session;
+
+		if(mqtt_manager_lease(&shard->manager, session, 0) < 0)
+			return (errno == ENOBUFS) ? 0 : 1;
+
+		mqtt_session_disconnect(session, now);
+
+		break;
+
+
+	default:
+
+		shard->dropped++;
+
+		return 1;
+
+	}
+
+	shard->executed++;
+
+	return 1;
+}
+
+
+
+/*
+ * @brief  Runs parked commands of sessions in order, until session can not send again.
+ * @param  *shard   : pointer to shard structure (mqtt_shard_t).
+ * @param  now      : current time, from mqtt_timer_now()
+ * @retval None
+ */
+static void mqtt_shard_resume(mqtt_shard_t *shard, uint32_t now)
+{
+	mqtt_shard_session_t *record = NULL;
+	uint16_t              index  = 0;
+
+	while(index < shard->parked_count)
+	{
+		record = shard->parked_list[index];
+
+		while(record->parked_head != 0)
+		{
+			/* Session closed while its commands were parked */
+			if(record->session == NULL)
+			{
+				mqtt_shard_unpark(shard, record);
+
+				shard->dropped++;
+
+				continue;
+			}
+
+			if(mqtt_shard_execute(shard, record, SHARD_PARKED(shard, record->parked_head), now) == 0)
+				break;
+
+			mqtt_shard_unpark(shard, record);
+		}
+
+		if(record->parked_head == 0)
+			shard->parked_list[index] = shard->parked_list[--shard->parked_count];
+		else
+			index++;
+	}
+}
+
+
+
+/*
+ * @brief  Executes commands of all producer rings of shard, command of session that can not send is
+ *         parked, so one slow session does not hold commands of other sessions in same ring.
+ * @param  *shard   : pointer to shard structure (mqtt_shard_t).
+ * @param  *waiting : set to 1 when a ring that was not stalled has entries left
+ * @retval uint64_t : bit mask of producers whose oldest command is retried later, (all parked entries in use)
+ */
+static uint64_t mqtt_shard_drain(mqtt_shard_t *shard, uint8_t *waiting)
+{
+	mqtt_shards_t        *shards  = shard->shards;
+	mqtt_ring_t          *rings   = NULL;
+	mqtt_ring_t          *ring    = NULL;
+	mqtt_shard_entry_t   *entry   = NULL;
+	mqtt_shard_session_t *record  = NULL;
+	int8_t                done    = 0;
+	uint64_t              stalled = 0;
+	uint32_t              count   = 0;
+	uint32_t              budget  = 0;
+	uint32_t              index   = 0;
+	uint32_t              now     = mqtt_timer_now();
+
+	count = SHARD_LOAD_ACQUIRE(&shards->producer_count);
+	if(count > SHARD_MAX_PRODUCERS)
+		count = SHARD_MAX_PRODUCERS;
+
+	*waiting = 0;
+
+	/* Parked commands are older than ring entries of their sessions */
+	mqtt_shard_resume(shard, now);
+
+	for(index = 0; index < count; index++)
+	{
+		rings = SHARD_LOAD_ACQUIRE(&shards->producers[index].rings);
+		if(rings == NULL)
+			continue;
+
+		ring = &rings[shard->index];
+
+		/* One ring length per pass, network is serviced between passes */
+		for(budget = SHARD_RING_ENTRIES; budget > 0 && (entry = mqtt_ring_peek(ring)) != NULL; budget--)
+		{
+			record = mqtt_shard_find(shard, entry->client_id, entry->command == MQTT_SHARD_OPEN);
+
+			/* Session with parked commands keeps its order, later commands are parked behind them */
+			if(record != NULL && record->parked_head != 0 && entry->command != MQTT_SHARD_OPEN)
+				done = 0;
+			else
+				done = mqtt_shard_execute(shard, record, entry, now);
+
+			if(done == 0)
+			{
+				shard->deferred++;
+
+				if(mqtt_shard_park(shard, record, entry) < 0)
+				{
+					stalled |= (uint64_t)1 << index;
+
+					break;
+				}
+			}
+
+			mqtt_ring_release(ring);
+		}
+
+		if(budget == 0)
+			*waiting = 1;
+	}
+
+	return stalled;
+}
+
+
+
+/*
+ * @brief  Returns whether producer rings have commands that can run now.
+ * @param  *shard    : pointer to shard structure (mqtt_shard_t).
+ * @param  stalled   : producers whose oldest command waits for session
+ * @retval uint8_t   : 1 = commands pending
+ */
+static uint8_t mqtt_shard_pending(mqtt_shard_t *shard, uint64_t stalled)
+{
+	mqtt_shards_t *shards = shard->shards;
+	mqtt_ring_t   *rings  = NULL;
+	uint32_t       count  = 0;
+	uint32_t       index  = 0;
+
+	count = SHARD_LOAD_ACQUIRE(&shards->producer_count);
+	if(count > SHARD_MAX_PRODUCERS)
+		count = SHARD_MAX_PRODUCERS;
+
+	for(index = 0; index < count; index++)
+	{
+		rings = SHARD_LOAD_ACQUIRE(&shards->producers[index].rings);
+
+		if(rings != NULL && !(stalled & ((uint64_t)1 << index)) && mqtt_ring_peek(&rings[shard->index]) != NULL)
+			return 1;
+	}
+
+	return 0;
+}
+
+
+
+/*
+ * @brief  Shard thread, executes submitted commands and runs connection manager.
+ * @param  *argument : shard
+ * @retval void*     : NULL
+ */
+static void *mqtt_shard_thread(void *argument)
+{
+	mqtt_shard_t  *shard   = (mqtt_shard_t*)argument;
+	uint64_t       stalled = 0;
+	uint8_t        waiting = 0;
+	int            timeout = 0;
+
+	while(!SHARD_LOAD_ACQUIRE(&shard->shards->stop))
+	{
+		stalled = mqtt_shard_drain(shard, &waiting);
+
+		/* Producers ring doorbell only after flag is set, rings are checked again after it */
+		SHARD_EXCHANGE(&shard->sleeping, 1);
+
+		timeout = (waiting || mqtt_shard_pending(shard, stalled)) ? 0 : -1;
+
+		mqtt_manager_run(&shard->manager, timeout);
+
+		SHARD_STORE_RELEASE(&shard->sleeping, 0);
+	}
+
+	return NULL;
+}
+
+
+
+/*
+ * @brief  Reserves ring entry of producer to owning shard of client ID.
+ * @param  *shards      : pointer to runtime structure (mqtt_shards_t).
+ * @param  producer     : producer of calling thread
+ * @param  *client_id   : client ID
+ * @param  **shard      : owning shard
+ * @retval mqtt_shard_entry_t* : entry, NULL = Error (errno is set, EAGAIN = ring full)
+ */
+static mqtt_shard_entry_t *mqtt_shard_reserve(mqtt_shards_t *shards, int producer, const char *client_id, mqtt_shard_t **shard)
+{
+	mqtt_shard_entry_t *entry = NULL;
+	mqtt_ring_t        *rings = NULL;
+
+	if(shards == NULL || client_id == NULL || producer < 0 || producer >= SHARD_MAX_PRODUCERS ||
+	   (rings = shards->producers[producer].rings) == NULL || strlen(client_id) > CLIENT_ID_LENGTH)
+	{
+		errno = EINVAL;
+
+		return NULL;
+	}
+
+	*shard = &shards->shard[mqtt_shard_route(shards, client_id)];
+
+	entry = mqtt_ring_reserve(&rings[(*shard)->index]);
+	if(entry == NULL)
+	{
+		errno = EAGAIN;
+
+		return NULL;
+	}
+
+	memset(entry, 0, sizeof(mqtt_shard_entry_t));
+
+	strncpy(entry->client_id, client_id, CLIENT_ID_LENGTH);
+
+	return entry;
+}
+
+
+
+/*
+ * @brief  Commits ring entry and wakes shard if it sleeps.
+ * @param  *shards      : pointer to runtime structure (mqtt_shards_t).
+ * @param  producer     : producer of calling thread
+ * @param  *shard       : owning shard
+ * @retval int8_t       : 1 = Success, -1 = Error
+ */
+static int8_t mqtt_shard_commit(mqtt_shards_t *shards, int producer, mqtt_shard_t *shard)
+{
+	uint64_t counter = 1;
+
+	mqtt_ring_commit(&shards->producers[producer].rings[shard->index]);
+
+	/* Pairs with flag exchange of shard thread, one of both sees the other */
+	SHARD_FENCE();
+
+	if(SHARD_LOAD_ACQUIRE(&shard->sleeping) && SHARD_EXCHANGE(&shard->sleeping, 0))
+	{
+		if(write(shard->doorbell.fd, &counter, sizeof(counter)) < 0 && errno != EAGAIN)
+			return FUNC_OPTS_ERROR;
+	}
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                              API Functions                                 */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Creates shards, each with connection manager and producer for hand off between shards.
+ * @param  *shards       : pointer to runtime structure (mqtt_shards_t).
+ * @param  shard_count   : number of shards, (one per CPU)
+ * @param  slot_count    : most sessions of each shard
+ * @param  block_count   : pooled buffers of each shard
+ * @param  table_count   : pooled in-flight tables of each shard
+ * @param  callback      : event callback, called on shard thread of session
+ * @retval int8_t        : 1 = Success, -1 = Error (errno is set)
+ */
+int8_t mqtt_shard_init(mqtt_shards_t *shards, uint16_t shard_count, uint32_t slot_count, uint32_t block_count,
+		               uint32_t table_count, mqtt_session_callback_t callback)
+{
+	mqtt_shard_t *shard      = NULL;
+	uint32_t      table_size = 1;
+	uint16_t      index      = 0;
+	uint16_t      parked     = 0;
+	int           doorbell   = -1;
+
+	if(shards == NULL || shard_count == 0)
+	{
+		errno = EINVAL;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	memset(shards, 0, sizeof(mqtt_shards_t));
+
+	shards->callback = callback;
+	shards->shard    = calloc(shard_count, sizeof(mqtt_shard_t));
+
+	if(shards->shard == NULL)
+		return FUNC_OPTS_ERROR;
+
+	/* Client ID table at most half full */
+	while(table_size < slot_count * 2)
+		table_size <<= 1;
+
+	for(index = 0; index < shard_count; index++)
+	{
+		shard = &shards->shard[index];
+
+		shard->shards       = shards;
+		shard->index        = index;
+		shard->cpu          = -1;
+		shard->session_mask = table_size - 1;
+		shard->sessions     = calloc(table_size, sizeof(mqtt_shard_session_t));
+		shard->parked       = malloc((size_t)SHARD_PARKED_ENTRIES * SHARD_ENTRY_SIZE);
+		shard->parked_next  = calloc(SHARD_PARKED_ENTRIES, sizeof(uint16_t));
+		shard->parked_list  = calloc(SHARD_PARKED_ENTRIES, sizeof(mqtt_shard_session_t*));
+
+		if(shard->sessions == NULL || shard->parked == NULL || shard->parked_next == NULL || shard->parked_list == NULL ||
+		   mqtt_manager_init(&shard->manager, slot_count, block_count, table_count, mqtt_shard_event) < 0)
+		{
+			/* Shard is not counted yet, free only walks counted shards, (failed manager frees itself) */
+			free(shard->sessions);
+			free(shard->parked);
+			free(shard->parked_next);
+			free(shard->parked_list);
+
+			break;
+		}
+
+		/* Free list of parked commands, (index + 1, 0 ends list) */
+		for(parked = 1; parked < SHARD_PARKED_ENTRIES; parked++)
+			shard->parked_next[parked - 1] = parked + 1;
+
+		shard->parked_free = 1;
+
+		shards->shard_count++;
+
+		doorbell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+		if(doorbell < 0 || mqtt_event_loop_add(&shard->manager.loop, &shard->doorbell, doorbell, MQTT_EVENT_READ,
+				                               mqtt_shard_doorbell, shard) < 0)
+		{
+			if(doorbell >= 0)
+				close(doorbell);
+
+			shard->doorbell.fd = -1;
+
+			break;
+		}
+	}
+
+	if(index < shard_count)
+	{
+		mqtt_shard_free(shards);
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	/* Shard threads hand off to other shards through their own producer */
+	for(index = 0; index < shard_count; index++)
+	{
+		shards->shard[index].producer = mqtt_shard_producer(shards);
+
+		if(shards->shard[index].producer < 0)
+		{
+			mqtt_shard_free(shards);
+
+			return FUNC_OPTS_ERROR;
+		}
+	}
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Starts shard threads, shard i is pinned to CPU (first_cpu + i) modulo online CPUs.
+ * @param  *shards     : pointer to runtime structure (mqtt_shards_t).
+ * @param  first_cpu   : CPU of first shard, (-1 = threads are not pinned)
+ * @retval int8_t      : 1 = Success, -1 = Error (errno is set, threads already started are joined)
+ */
+int8_t mqtt_shard_start(mqtt_shards_t *shards, int first_cpu)
+{
+	mqtt_shard_t *shard     = NULL;
+	cpu_set_t     cpu_set;
+	long          cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+	uint16_t      index     = 0;
+	int           retval    = 0;
+
+	if(shards == NULL || shards->running > 0)
+	{
+		errno = EINVAL;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	SHARD_STORE_RELEASE(&shards->stop, 0);
+
+	for(index = 0; index < shards->shard_count; index++)
+	{
+		shard = &shards->shard[index];
+
+		retval = pthread_create(&shard->thread, NULL, mqtt_shard_thread, shard);
+		if(retval != 0)
+		{
+			/* Runtime is left stopped, shards that already run exit */
+			mqtt_shard_stop(shards);
+
+			errno = retval;
+
+			return FUNC_OPTS_ERROR;
+		}
+
+		shards->running++;
+
+		if(first_cpu < 0 || cpu_count <= 0)
+			continue;
+
+		/* Restricted CPU sets (containers) leave thread unpinned */
+		CPU_ZERO(&cpu_set);
+		CPU_SET((first_cpu + index) % cpu_count, &cpu_set);
+
+		if(pthread_setaffinity_np(shard->thread, sizeof(cpu_set), &cpu_set) == 0)
+			shard->cpu = (int)((first_cpu + index) % cpu_count);
+	}
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Registers calling thread as producer, every submitting thread needs its own producer.
+ * @param  *shards   : pointer to runtime structure (mqtt_shards_t).
+ * @retval int       : producer, -1 = Error (errno is set, ENOBUFS = SHARD_MAX_PRODUCERS reached)
+ */
+int mqtt_shard_producer(mqtt_shards_t *shards)
+{
+	mqtt_shard_producer_t *producer = NULL;
+	mqtt_ring_t           *rings    = NULL;
+	uint32_t               index    = 0;
+	uint16_t               shard    = 0;
+
+	if(shards == NULL)
+	{
+		errno = EINVAL;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	index = SHARD_FETCH_ADD(&shards->producer_count, 1);
+	if(index >= SHARD_MAX_PRODUCERS)
+	{
+		errno = ENOBUFS;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	producer = &shards->producers[index];
+
+	rings             = aligned_alloc(CACHE_LINE_SIZE, shards->shard_count * sizeof(mqtt_ring_t));
+	producer->storage = malloc((size_t)shards->shard_count * SHARD_RING_ENTRIES * SHARD_ENTRY_SIZE);
+
+	if(rings == NULL || producer->storage == NULL)
+	{
+		free(rings);
+		free(producer->storage);
+
+		producer->storage = NULL;
+
+		errno = ENOMEM;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	for(shard = 0; shard < shards->shard_count; shard++)
+		mqtt_ring_init(&rings[shard], producer->storage + (size_t)shard * SHARD_RING_ENTRIES * SHARD_ENTRY_SIZE,
+				       SHARD_ENTRY_SIZE, SHARD_RING_ENTRIES);
+
+	/* Shards see producer once its rings are initialized */
+	SHARD_STORE_RELEASE(&producer->rings, rings);
+
+	return (int)index;
+}
+
+
+
+/*
+ * @brief  Returns shard owning client ID.
+ * @param  *shards      : pointer to runtime structure (mqtt_shards_t).
+ * @param  *client_id   : client ID
+ * @retval uint16_t     : shard index
+ */
+uint16_t mqtt_shard_route(mqtt_shards_t *shards, const char *client_id)
+{
+	return (uint16_t)(mqtt_shard_hash(client_id) % shards->shard_count);
+}
+
+
+
+/*
+ * @brief  Submits session of connected socket to owning shard, socket is closed by shard.
+ * @param  *shards          : pointer to runtime structure (mqtt_shards_t).
+ * @param  producer         : producer of calling thread
+ * @param  *client_id       : client ID, (CLIENT_ID_LENGTH)
+ * @param  descriptor       : connected socket descriptor, (non blocking)
+ * @param  keep_alive_time  : keep alive time in seconds
+ * @param  *context         : user context passed to event callback
+ * @retval int8_t           : 1 = Success, -1 = Error (errno is set, EAGAIN = ring full)
+ */
+int8_t mqtt_shard_open(mqtt_shards_t *shards, int producer, const char *client_id, int descriptor,
+		               uint16_t keep_alive_time, void *context)
+{
+	mqtt_shard_entry_t *entry = NULL;
+	mqtt_shard_t       *shard = NULL;
+
+	entry = mqtt_shard_reserve(shards, producer, client_id, &shard);
+	if(entry == NULL)
+		return FUNC_OPTS_ERROR;
+
+	entry->command         = MQTT_SHARD_OPEN;
+	entry->descriptor      = descriptor;
+	entry->keep_alive_time = keep_alive_time;
+	entry->context         = context;
+
+	return mqtt_shard_commit(shards, producer, shard);
+}
+
+
+
+/*
+ * @brief  Submits publish to shard owning client ID, never blocks. Topic and message are copied.
+ * @param  *shards          : pointer to runtime structure (mqtt_shards_t).
+ * @param  producer         : producer of calling thread
+ * @param  *client_id       : client ID of publishing session
+ * @param  *topic           : publish topic
+ * @param  *message         : message, (binary safe)
+ * @param  message_length   : length of message
+ * @param  qos              : quality of service value
+ * @param  retain           : MQTT_MESSAGE_RETAIN or MQTT_MESSAGE_NO_RETAIN
+ * @retval int8_t           : 1 = Success, -1 = Error (errno is set, EAGAIN = ring full,
+ *                            EMSGSIZE = topic and message do not fit SHARD_ENTRY_SIZE)
+ */
+int8_t mqtt_shard_publish(mqtt_shards_t *shards, int producer, const char *client_id, const char *topic,
+		                  const void *message, size_t message_length, mqtt_qos_t qos, uint8_t retain)
+{
+	mqtt_shard_entry_t *entry        = NULL;
+	mqtt_shard_t       *shard        = NULL;
+	size_t              topic_length = 0;
+
+	if(topic == NULL || (message == NULL && message_length > 0))
+	{
+		errno = EINVAL;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	topic_length = strlen(topic);
+
+	if(topic_length + 1 + message_length > SHARD_DATA_LENGTH)
+	{
+		errno = EMSGSIZE;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	entry = mqtt_shard_reserve(shards, producer, client_id, &shard);
+	if(entry == NULL)
+		return FUNC_OPTS_ERROR;
+
+	entry->command        = MQTT_SHARD_PUBLISH;
+	entry->qos            = (uint8_t)qos;
+	entry->retain         = retain;
+	entry->topic_length   = (uint16_t)topic_length;
+	entry->message_length = (uint16_t)message_length;
+
+	memcpy(entry->data, topic, topic_length + 1);
+	memcpy(entry->data + topic_length + 1, message, message_length);
+
+	return mqtt_shard_commit(shards, producer, shard);
+}
+
+
+
+/*
+ * @brief  Submits DISCONNECT of session to owning shard.
+ * @param  *shards       : pointer to runtime structure (mqtt_shards_t).
+ * @param  producer      : producer of calling thread
+ * @param  *client_id    : client ID of session
+ * @retval int8_t        : 1 = Success, -1 = Error (errno is set, EAGAIN = ring full)
+ */
+int8_t mqtt_shard_disconnect(mqtt_shards_t *shards, int producer, const char *client_id)
+{
+	mqtt_shard_entry_t *entry = NULL;
+	mqtt_shard_t       *shard = NULL;
+
+	entry = mqtt_shard_reserve(shards, producer, client_id, &shard);
+	if(entry == NULL)
+		return FUNC_OPTS_ERROR;
+
+	entry->command = MQTT_SHARD_DISCONNECT;
+
+	return mqtt_shard_commit(shards, producer, shard);
+}
+
+
+
+/*
+ * @brief  Stops and joins shard threads, submitted commands not yet executed are dropped.
+ * @param  *shards   : pointer to runtime structure (mqtt_shards_t).
+ * @retval int8_t    : 1 = Success, -1 = Error (doorbell could not be written, threads are still joined)
+ */
+int8_t mqtt_shard_stop(mqtt_shards_t *shards)
+{
+	uint64_t counter = 1;
+	uint16_t index   = 0;
+	int8_t   retval  = FUNC_OPTS_SUCCESS;
+
+	if(shards == NULL)
+		return FUNC_OPTS_ERROR;
+
+	SHARD_STORE_RELEASE(&shards->stop, 1);
+
+	/* All shards are woken before first join, one failed doorbell does not leave others running */
+	for(index = 0; index < shards->running; index++)
+	{
+		if(write(shards->shard[index].doorbell.fd, &counter, sizeof(counter)) < 0 && errno != EAGAIN)
+			retval = FUNC_OPTS_ERROR;
+	}
+
+	for(index = 0; index < shards->running; index++)
+		pthread_join(shards->shard[index].thread, NULL);
+
+	shards->running = 0;
+
+	return retval;
+}
+
+
+
+/*
+ * @brief  Closes sessions and releases memory of stopped runtime.
+ * @param  *shards   : pointer to runtime structure (mqtt_shards_t).
+ * @retval int8_t    : 1 = Success, -1 = Error
+ */
+int8_t mqtt_shard_free(mqtt_shards_t *shards)
+{
+	uint32_t index = 0;
+
+	if(shards == NULL || shards->shard == NULL)
+		return FUNC_OPTS_ERROR;
+
+	for(index = 0; index < shards->shard_count; index++)
+	{
+		if(shards->shard[index].doorbell.fd > 0)
+			close(shards->shard[index].doorbell.fd);
+
+		mqtt_manager_free(&shards->shard[index].manager);
+
+		free(shards->shard[index].sessions);
+		free(shards->shard[index].parked);
+		free(shards->shard[index].parked_next);
+		free(shards->shard[index].parked_list);
+	}
+
+	for(index = 0; index < SHARD_MAX_PRODUCERS && index < shards->producer_count; index++)
+	{
+		free(shards->producers[index].rings);
+		free(shards->producers[index].storage);
+	}
+
+	free(shards->shard);
+
+	memset(shards, 0, sizeof(mqtt_shards_t));
+
+	return FUNC_OPTS_SUCCESS;
+}
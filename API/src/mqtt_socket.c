@@ -0,0 +1,285 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_socket.c
+ * @author  Aditya Mall,
+ * @brief   MQTT client socket options
+ *
+ *  Info
+ *          Socket tuning API Source File, (Linux TCP options)
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall, MIT License </center></h2>
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019 Aditya Mall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+
+
+/*
+ * Standard Header and API Header files
+ */
+#include <mqtt_socket.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                  Data Structures and Defines                               */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* return codes for socket functions */
+typedef enum function_return_codes
+{
+	FUNC_OPTS_ERROR       = -1,  /*!< */
+	FUNC_OPTS_SUCCESS     = 1,   /*!< */
+
+}return_codes_t;
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                           Private Functions                                */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Sets one option when value is not kernel default, refused option is marked in options->failed.
+ * @param  descriptor  : socket descriptor
+ * @param  *options    : pointer to socket options structure (mqtt_socket_options_t).
+ * @param  level       : option level, (SOL_SOCKET, IPPROTO_TCP)
+ * @param  name        : option name
+ * @param  value       : option value, -1 = kernel default
+ * @param  option_bit  : option bit (mqtt_socket_option_t)
+ * @param  *error      : first errno, kept when already set
+ * @retval None
+ */
+static void mqtt_socket_set(int descriptor, mqtt_socket_options_t *options, int level, int name, int32_t value, uint8_t option_bit, int *error)
+{
+	int option_value = value;
+
+	if(value < 0)
+		return;
+
+	if(setsockopt(descriptor, level, name, &option_value, sizeof(option_value)) == 0)
+		return;
+
+	options->failed |= option_bit;
+
+	if(*error == 0)
+		*error = errno;
+}
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                              API Functions                                 */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Sets all options to kernel default.
+ * @param  *options  : pointer to socket options structure (mqtt_socket_options_t).
+ * @retval int8_t    : 1 = Success, -1 = Error
+ */
+int8_t mqtt_socket_options_init(mqtt_socket_options_t *options)
+{
+	if(options == NULL)
+		return FUNC_OPTS_ERROR;
+
+	options->no_delay         = -1;
+	options->quick_ack        = -1;
+	options->cork             = -1;
+	options->send_buffer      = -1;
+	options->receive_buffer   = -1;
+	options->busy_poll        = -1;
+	options->busy_poll_budget = -1;
+	options->user_timeout     = -1;
+	options->flush_deadline   = -1;
+	options->failed           = 0;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Fills options that are not set with named profile, options set before take precedence.
+ *         "low-latency"  : TCP_NODELAY, TCP_QUICKACK, busy poll SOCKET_BUSY_POLL_US, no flush deadline
+ *         "throughput"   : SOCKET_BULK_BUFFER socket buffers, TCP_CORK, flush deadline SOCKET_BULK_DEADLINE
+ *         "default"      : kernel defaults
+ * @param  *options  : pointer to socket options structure (mqtt_socket_options_t).
+ * @param  *profile  : profile name
+ * @retval int8_t    : 1 = Success, -1 = Error (errno is set, EINVAL = unknown profile)
+ */
+int8_t mqtt_socket_profile(mqtt_socket_options_t *options, const char *profile)
+{
+	if(options == NULL || profile == NULL)
+	{
+		errno = EINVAL;
+		return FUNC_OPTS_ERROR;
+	}
+
+	if(strcmp(profile, "low-latency") == 0)
+	{
+		/* Small packets leave at once and both sides ACK at once, reads spin before sleeping */
+		if(options->no_delay < 0)
+			options->no_delay = 1;
+
+		if(options->quick_ack < 0)
+			options->quick_ack = 1;
+
+		if(options->cork < 0)
+			options->cork = 0;
+
+		if(options->busy_poll < 0)
+			options->busy_poll = SOCKET_BUSY_POLL_US;
+
+		if(options->flush_deadline < 0)
+			options->flush_deadline = 0;
+	}
+	else if(strcmp(profile, "throughput") == 0)
+	{
+		/* Large windows, kernel sends only full segments and output batches up to deadline */
+		if(options->send_buffer < 0)
+			options->send_buffer = SOCKET_BULK_BUFFER;
+
+		if(options->receive_buffer < 0)
+			options->receive_buffer = SOCKET_BULK_BUFFER;
+
+		if(options->cork < 0)
+			options->cork = 1;
+
+		if(options->flush_deadline < 0)
+			options->flush_deadline = SOCKET_BULK_DEADLINE;
+	}
+	else if(strcmp(profile, "default") != 0)
+	{
+		errno = EINVAL;
+		return FUNC_OPTS_ERROR;
+	}
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Applies options to socket, call before connect. TCP options are skipped on other sockets.
+ *         Every option is tried, refused options are marked in options->failed.
+ * @param  descriptor  : socket descriptor
+ * @param  *options    : pointer to socket options structure (mqtt_socket_options_t).
+ * @retval int8_t      : 1 = Success, -1 = Error (errno of first refused option is set,
+ *                       EPERM = busy poll above net.core.busy_poll needs CAP_NET_ADMIN)
+ */
+int8_t mqtt_socket_apply(int descriptor, mqtt_socket_options_t *options)
+{
+	int protocol = 0;
+	int error    = 0;
+
+	socklen_t length = sizeof(protocol);
+
+	if(descriptor < 0 || options == NULL)
+	{
+		errno = EINVAL;
+		return FUNC_OPTS_ERROR;
+	}
+
+	options->failed = 0;
+
+	/* Buffers are set first, receive buffer decides window scale sent in SYN */
+	mqtt_socket_set(descriptor, options, SOL_SOCKET, SO_SNDBUF, options->send_buffer, MQTT_SOCKET_SEND_BUFFER, &error);
+	mqtt_socket_set(descriptor, options, SOL_SOCKET, SO_RCVBUF, options->receive_buffer, MQTT_SOCKET_RECEIVE_BUFFER, &error);
+
+#ifdef SO_BUSY_POLL
+	mqtt_socket_set(descriptor, options, SOL_SOCKET, SO_BUSY_POLL, options->busy_poll, MQTT_SOCKET_BUSY_POLL, &error);
+#else
+	mqtt_socket_set(descriptor, options, SOL_SOCKET, -1, options->busy_poll, MQTT_SOCKET_BUSY_POLL, &error);
+#endif
+
+#ifdef SO_BUSY_POLL_BUDGET
+	mqtt_socket_set(descriptor, options, SOL_SOCKET, SO_BUSY_POLL_BUDGET, options->busy_poll_budget, MQTT_SOCKET_BUSY_POLL_BUDGET, &error);
+#else
+	mqtt_socket_set(descriptor, options, SOL_SOCKET, -1, options->busy_poll_budget, MQTT_SOCKET_BUSY_POLL_BUDGET, &error);
+#endif
+
+	/* TCP options are left out on unix domain sockets */
+	if(getsockopt(descriptor, SOL_SOCKET, SO_PROTOCOL, &protocol, &length) == 0 && protocol == IPPROTO_TCP)
+	{
+		mqtt_socket_set(descriptor, options, IPPROTO_TCP, TCP_NODELAY, options->no_delay, MQTT_SOCKET_NO_DELAY, &error);
+		mqtt_socket_set(descriptor, options, IPPROTO_TCP, TCP_QUICKACK, options->quick_ack, MQTT_SOCKET_QUICK_ACK, &error);
+		mqtt_socket_set(descriptor, options, IPPROTO_TCP, TCP_CORK, options->cork, MQTT_SOCKET_CORK, &error);
+		mqtt_socket_set(descriptor, options, IPPROTO_TCP, TCP_USER_TIMEOUT, options->user_timeout, MQTT_SOCKET_USER_TIMEOUT, &error);
+	}
+
+	if(error != 0)
+	{
+		errno = error;
+		return FUNC_OPTS_ERROR;
+	}
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Reads socket and sets TCP_QUICKACK again, kernel clears it once it changes ACK mode.
+ *         Same as POSIX read(), can replace read of session or transport.
+ * @param  descriptor  : socket descriptor
+ * @param  *buffer     : read buffer
+ * @param  length      : size of read buffer
+ * @retval ssize_t     : bytes read, 0 = connection closed, -1 = Error (errno is set)
+ */
+ssize_t mqtt_socket_read_quickack(int descriptor, void *buffer, size_t length)
+{
+	int     quick_ack = 1;
+	ssize_t count     = 0;
+
+	count = read(descriptor, buffer, length);
+
+	/* ACK of read data is sent now, errno of read is kept */
+	if(count > 0)
+		setsockopt(descriptor, IPPROTO_TCP, TCP_QUICKACK, &quick_ack, sizeof(quick_ack));
+
+	return count;
+}
@@ -0,0 +1,543 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_timer.c
+ * @author  Aditya Mall,
+ * @brief   MQTT client timer wheel
+ *
+ *  Info
+ *          Timer API Source File, (POSIX CLOCK_MONOTONIC)
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall, MIT License </center></h2>
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019 Aditya Mall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+/*
+ * Standard Header and API Header files
+ */
+#include <mqtt_timer.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                  Data Structures and Defines                               */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* @brief Span of one slot of level in ticks */
+#define MQTT_TIMER_LEVEL_SPAN(level)  (1UL << (MQTT_TIMER_SLOT_BITS * (level)))
+
+
+/* return codes for timer functions */
+typedef enum function_return_codes
+{
+	FUNC_OPTS_ERROR       = -1,  /*!< */
+	FUNC_OPTS_SUCCESS     = 1,   /*!< */
+
+}return_codes_t;
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                           Private Functions                                */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Inserts timer into wheel slot of its expiry time, relative to wheel time.
+ * @param  *wheel  : pointer to timer wheel structure (mqtt_timer_wheel_t).
+ * @param  *timer  : pointer to idle timer structure (mqtt_timer_t).
+ * @retval None
+ */
+static void mqtt_timer_place(mqtt_timer_wheel_t *wheel, mqtt_timer_t *timer)
+{
+	uint32_t expires = timer->expires;
+	uint32_t delta   = expires - wheel->time;
+	uint8_t  level   = 0;
+	uint8_t  index   = 0;
+
+	/* Already expired, run on next tick */
+	if((int32_t)delta < 0)
+	{
+		delta   = 0;
+		expires = wheel->time;
+	}
+
+	/* Beyond wheel range, park in top level, placed again on cascade */
+	if(delta >= MQTT_TIMER_RANGE)
+	{
+		delta   = MQTT_TIMER_RANGE - 1;
+		expires = wheel->time + delta;
+	}
+
+	while(delta >= MQTT_TIMER_LEVEL_SPAN(level + 1))
+		level++;
+
+	index = (expires >> (MQTT_TIMER_SLOT_BITS * level)) & MQTT_TIMER_SLOT_MASK;
+
+	timer->level = level;
+	timer->next  = wheel->slot[level][index];
+	timer->link  = &wheel->slot[level][index];
+
+	if(timer->next != NULL)
+		timer->next->link = &timer->next;
+
+	wheel->slot[level][index] = timer;
+
+	wheel->level_count[level]++;
+	wheel->count++;
+}
+
+
+
+/*
+ * @brief  Removes pending timer from its wheel slot.
+ * @param  *wheel  : pointer to timer wheel structure (mqtt_timer_wheel_t).
+ * @param  *timer  : pointer to pending timer structure (mqtt_timer_t).
+ * @retval None
+ */
+static void mqtt_timer_unlink(mqtt_timer_wheel_t *wheel, mqtt_timer_t *timer)
+{
+	*timer->link = timer->next;
+
+	if(timer->next != NULL)
+		timer->next->link = timer->link;
+
+	timer->next = NULL;
+	timer->link = NULL;
+
+	wheel->level_count[timer->level]--;
+	wheel->count--;
+}
+
+
+
+/*
+ * @brief  Sets wheel time and moves timers of higher levels down, when time is a slot boundary.
+ * @param  *wheel  : pointer to timer wheel structure (mqtt_timer_wheel_t).
+ * @param  time    : new wheel time
+ * @retval None
+ */
+static void mqtt_timer_cascade(mqtt_timer_wheel_t *wheel, uint32_t time)
+{
+	mqtt_timer_t *timer = NULL;
+
+	uint8_t level = 0;
+	uint8_t index = 0;
+
+	wheel->time = time;
+
+	/* Highest level boundary first, its timers can land in lower levels cascaded next */
+	for(level = MQTT_TIMER_LEVELS - 1; level > 0; level--)
+	{
+		if((time & (MQTT_TIMER_LEVEL_SPAN(level) - 1)) != 0 || wheel->level_count[level] == 0)
+			continue;
+
+		index = (time >> (MQTT_TIMER_SLOT_BITS * level)) & MQTT_TIMER_SLOT_MASK;
+
+		while( (timer = wheel->slot[level][index]) != NULL )
+		{
+			mqtt_timer_unlink(wheel, timer);
+			mqtt_timer_place(wheel, timer);
+		}
+	}
+}
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                              API Functions                                 */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Returns monotonic time, (CLOCK_MONOTONIC, wall time unaffected by clock changes).
+ * @param  None
+ * @retval uint32_t : time in milliseconds, wraps every 49 days
+ */
+uint32_t mqtt_timer_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint32_t)now.tv_sec * 1000U + (uint32_t)(now.tv_nsec / 1000000);
+}
+
+
+
+/*
+ * @brief  Returns monotonic time with microsecond resolution, (CLOCK_MONOTONIC).
+ * @param  None
+ * @retval uint64_t : time in microseconds
+ */
+uint64_t mqtt_timer_now_us(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * 1000000U + (uint64_t)(now.tv_nsec / 1000);
+}
+
+
+
+/*
+ * @brief  Initializes timer wheel.
+ * @param  *wheel : pointer to timer wheel structure (mqtt_timer_wheel_t).
+ * @param  now    : current time, from mqtt_timer_now()
+ * @retval int8_t : 1 = Success, -1 = Error
+ */
+int8_t mqtt_timer_wheel_init(mqtt_timer_wheel_t *wheel, uint32_t now)
+{
+	if(wheel == NULL)
+		return FUNC_OPTS_ERROR;
+
+	memset(wheel, 0, sizeof(mqtt_timer_wheel_t));
+
+	wheel->time = now;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Initializes timer, timer is idle.
+ * @param  *timer    : pointer to timer structure (mqtt_timer_t).
+ * @param  callback  : called on expiry
+ * @param  *context  : user context passed to callback
+ * @retval int8_t    : 1 = Success, -1 = Error
+ */
+int8_t mqtt_timer_init(mqtt_timer_t *timer, mqtt_timer_callback_t callback, void *context)
+{
+	if(timer == NULL || callback == NULL)
+		return FUNC_OPTS_ERROR;
+
+	memset(timer, 0, sizeof(mqtt_timer_t));
+
+	timer->callback = callback;
+	timer->context  = context;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Starts timer, pending timer is moved to new expiry time, O(1).
+ * @param  *wheel   : pointer to timer wheel structure (mqtt_timer_wheel_t).
+ * @param  *timer   : pointer to timer structure (mqtt_timer_t).
+ * @param  expires  : expiry time, monotonic milliseconds, (time in past expires on next advance)
+ * @retval int8_t   : 1 = Success, -1 = Error
+ */
+int8_t mqtt_timer_start(mqtt_timer_wheel_t *wheel, mqtt_timer_t *timer, uint32_t expires)
+{
+	if(wheel == NULL || timer == NULL)
+		return FUNC_OPTS_ERROR;
+
+	if(timer->link != NULL)
+		mqtt_timer_unlink(wheel, timer);
+
+	timer->expires = expires;
+
+	mqtt_timer_place(wheel, timer);
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Stops timer, idle timer is ignored, O(1).
+ * @param  *wheel  : pointer to timer wheel structure (mqtt_timer_wheel_t).
+ * @param  *timer  : pointer to timer structure (mqtt_timer_t).
+ * @retval int8_t  : 1 = Success, -1 = Error
+ */
+int8_t mqtt_timer_stop(mqtt_timer_wheel_t *wheel, mqtt_timer_t *timer)
+{
+	if(wheel == NULL || timer == NULL)
+		return FUNC_OPTS_ERROR;
+
+	if(timer->link != NULL)
+		mqtt_timer_unlink(wheel, timer);
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Checks if timer is pending.
+ * @param  *timer  : pointer to timer structure (mqtt_timer_t).
+ * @retval int8_t  : 1 = pending, 0 = idle
+ */
+int8_t mqtt_timer_pending(mqtt_timer_t *timer)
+{
+	return (timer != NULL && timer->link != NULL);
+}
+
+
+
+/*
+ * @brief  Runs callbacks of all timers expired up to now, idle time between timers is skipped.
+ * @param  *wheel   : pointer to timer wheel structure (mqtt_timer_wheel_t).
+ * @param  now      : current time, from mqtt_timer_now()
+ * @retval uint32_t : number of expired timers
+ */
+uint32_t mqtt_timer_advance(mqtt_timer_wheel_t *wheel, uint32_t now)
+{
+	mqtt_timer_t *timer   = NULL;
+	mqtt_timer_t *expired = NULL;
+
+	uint32_t expired_count = 0;
+	uint32_t next_time     = 0;
+	uint8_t  level         = 0;
+
+	if(wheel == NULL)
+		return 0;
+
+	while((int32_t)(now - wheel->time) >= 0)
+	{
+		if(wheel->count == 0)
+		{
+			wheel->time = now + 1;
+
+			break;
+		}
+
+		/* Lower levels empty, nothing expires before next slot boundary of lowest used level */
+		for(level = 0; wheel->level_count[level] == 0; level++);
+
+		if(level > 0)
+		{
+			next_time = (wheel->time | (MQTT_TIMER_LEVEL_SPAN(level) - 1)) + 1;
+
+			if((int32_t)(next_time - now) > 1)
+			{
+				wheel->time = now + 1;
+
+				break;
+			}
+
+			mqtt_timer_cascade(wheel, next_time);
+
+			continue;
+		}
+
+		/* Detach expired slot, wheel time is moved first so callbacks can start timers again */
+		expired = wheel->slot[0][wheel->time & MQTT_TIMER_SLOT_MASK];
+
+		wheel->slot[0][wheel->time & MQTT_TIMER_SLOT_MASK] = NULL;
+
+		if(expired != NULL)
+			expired->link = &expired;
+
+		mqtt_timer_cascade(wheel, wheel->time + 1);
+
+		while( (timer = expired) != NULL )
+		{
+			mqtt_timer_unlink(wheel, timer);
+
+			expired_count++;
+
+			timer->callback(timer, timer->context, now);
+		}
+	}
+
+	return expired_count;
+}
+
+
+
+/*
+ * @brief  Returns time until wheel needs next advance, timeout for mqtt_event_loop_run().
+ * @param  *wheel  : pointer to timer wheel structure (mqtt_timer_wheel_t).
+ * @param  now     : current time, from mqtt_timer_now()
+ * @retval int     : milliseconds to next advance, -1 = no timer pending, (wait forever)
+ */
+int mqtt_timer_next_timeout(mqtt_timer_wheel_t *wheel, uint32_t now)
+{
+	uint32_t next_time = 0;
+	uint32_t cascade   = 0;
+	uint32_t offset    = 0;
+	uint8_t  level     = 0;
+
+	if(wheel == NULL || wheel->count == 0)
+		return -1;
+
+	next_time = wheel->time + MQTT_TIMER_RANGE;
+
+	if(wheel->level_count[0] > 0)
+	{
+		for(offset = 0; wheel->slot[0][(wheel->time + offset) & MQTT_TIMER_SLOT_MASK] == NULL; offset++);
+
+		next_time = wheel->time + offset;
+	}
+
+	/* Wake at cascade of lowest used higher level, timers are placed exactly from there */
+	for(level = 1; level < MQTT_TIMER_LEVELS && wheel->level_count[level] == 0; level++);
+
+	if(level < MQTT_TIMER_LEVELS)
+	{
+		cascade = (wheel->time | (MQTT_TIMER_LEVEL_SPAN(level) - 1)) + 1;
+
+		if((int32_t)(cascade - next_time) < 0)
+			next_time = cascade;
+	}
+
+	if((int32_t)(next_time - now) <= 0)
+		return 0;
+
+	return (int)(next_time - now);
+}
+
+
+
+/*
+ * @brief  Returns exponential backoff delay of reconnect attempt, base * 2^attempt up to maximum.
+ * @param  attempt   : number of failed attempts
+ * @param  base_ms   : delay of first attempt, milliseconds
+ * @param  max_ms    : maximum delay, milliseconds
+ * @retval uint32_t  : delay in milliseconds
+ */
+uint32_t mqtt_timer_backoff(uint8_t attempt, uint32_t base_ms, uint32_t max_ms)
+{
+	uint32_t delay = base_ms;
+
+	while(attempt-- > 0 && delay < max_ms)
+		delay <<= 1;
+
+	return (delay > max_ms) ? max_ms : delay;
+}
+
+
+
+/*
+ * @brief  Keep alive timer callback, PINGREQ is skipped if message was sent during interval.
+ * @param  *timer    : pointer to keep alive timer
+ * @param  *context  : pointer to keep alive structure (mqtt_keepalive_t).
+ * @param  now       : current time
+ * @retval None
+ */
+static void mqtt_keepalive_expired(mqtt_timer_t *timer, void *context, uint32_t now)
+{
+	mqtt_keepalive_t *keepalive = (mqtt_keepalive_t*)context;
+
+	/* Connection was busy, keep alive already reset by traffic */
+	if(now - keepalive->last_sent < keepalive->interval)
+	{
+		keepalive->suppressed++;
+
+		mqtt_timer_start(keepalive->wheel, timer, keepalive->last_sent + keepalive->interval);
+
+		return;
+	}
+
+	keepalive->last_sent = now;
+
+	mqtt_timer_start(keepalive->wheel, timer, now + keepalive->interval);
+
+	keepalive->ping_callback(timer, keepalive->context, now);
+}
+
+
+
+/*
+ * @brief  Starts keep alive of client, ping callback is called when interval passes without
+ *         any message sent, (PINGREQ is not sent on busy connections).
+ * @param  *wheel          : pointer to timer wheel structure (mqtt_timer_wheel_t).
+ * @param  *keepalive      : pointer to keep alive structure (mqtt_keepalive_t).
+ * @param  interval_ms     : keep alive interval in milliseconds, (0 = keep alive disabled)
+ * @param  now             : current time, from mqtt_timer_now()
+ * @param  ping_callback   : called when PINGREQ is to be sent
+ * @param  *context        : user context passed to ping callback
+ * @retval int8_t          : 1 = Success, -1 = Error
+ */
+int8_t mqtt_keepalive_start(mqtt_timer_wheel_t *wheel, mqtt_keepalive_t *keepalive, uint32_t interval_ms,
+		                    uint32_t now, mqtt_timer_callback_t ping_callback, void *context)
+{
+	if(wheel == NULL || keepalive == NULL || ping_callback == NULL)
+		return FUNC_OPTS_ERROR;
+
+	mqtt_timer_init(&keepalive->timer, mqtt_keepalive_expired, keepalive);
+
+	keepalive->wheel         = wheel;
+	keepalive->interval      = interval_ms;
+	keepalive->last_sent     = now;
+	keepalive->suppressed    = 0;
+	keepalive->ping_callback = ping_callback;
+	keepalive->context       = context;
+
+	if(interval_ms == 0)
+		return FUNC_OPTS_SUCCESS;
+
+	return mqtt_timer_start(wheel, &keepalive->timer, now + interval_ms);
+}
+
+
+
+/*
+ * @brief  Records message sent to broker, only updates time stamp, timer is not moved.
+ * @param  *keepalive  : pointer to keep alive structure (mqtt_keepalive_t).
+ * @param  now         : current time, from mqtt_timer_now()
+ * @retval None
+ */
+void mqtt_keepalive_sent(mqtt_keepalive_t *keepalive, uint32_t now)
+{
+	if(keepalive != NULL)
+		keepalive->last_sent = now;
+}
+
+
+
+/*
+ * @brief  Stops keep alive of client.
+ * @param  *keepalive  : pointer to keep alive structure (mqtt_keepalive_t).
+ * @retval int8_t      : 1 = Success, -1 = Error
+ */
+int8_t mqtt_keepalive_stop(mqtt_keepalive_t *keepalive)
+{
+	if(keepalive == NULL)
+		return FUNC_OPTS_ERROR;
+
+	return mqtt_timer_stop(keepalive->wheel, &keepalive->timer);
+}
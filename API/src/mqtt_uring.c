@@ -0,0 +1,584 @@
+/**
+ ******************************************************************************
+ * @file    mqtt_uring.c
+ * @author  Aditya Mall,
+ * @brief   MQTT client io_uring transport
+ *
+ *  Info
+ *          io_uring API Source File, (Linux 6.0 or later, no liburing)
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall, MIT License </center></h2>
+ *
+ * MIT License
+ *
+ * Copyright (c) 2019 Aditya Mall
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+/*
+ * Standard Header and API Header files
+ */
+#include <mqtt_uring.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                  Data Structures and Defines                               */
+/*                                                                            */
+/******************************************************************************/
+
+
+/* @brief Size of buffer ring entries, rounded up to page size */
+#define URING_BUFFER_RING_SIZE  ((URING_BUFFER_COUNT * sizeof(struct io_uring_buf) + 4095) & ~(size_t)4095)
+
+
+/* @brief Shared ring index access, kernel reads and writes the other side */
+#if GCC
+#define URING_LOAD_ACQUIRE(pointer)          __atomic_load_n((pointer), __ATOMIC_ACQUIRE)
+#define URING_STORE_RELEASE(pointer, value)  __atomic_store_n((pointer), (value), __ATOMIC_RELEASE)
+#endif
+
+
+/* return codes for io_uring functions */
+typedef enum function_return_codes
+{
+	FUNC_OPTS_ERROR       = -1,  /*!< */
+	FUNC_OPTS_SUCCESS     = 1,   /*!< */
+
+}return_codes_t;
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                           Private Functions                                */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Returns next free submission queue entry, entry is cleared.
+ * @param  *ring  : pointer to io_uring structure (mqtt_uring_t).
+ * @retval struct io_uring_sqe* : submission queue entry, NULL = queue full
+ */
+static struct io_uring_sqe* mqtt_uring_get_sqe(mqtt_uring_t *ring)
+{
+	struct io_uring_sqe *sqe = NULL;
+
+	uint32_t index = 0;
+
+	if(ring->sq_local_tail - URING_LOAD_ACQUIRE(ring->sq_head) >= ring->sq_entries)
+		return NULL;
+
+	index = ring->sq_local_tail & ring->sq_mask;
+	sqe   = &ring->sqes[index];
+
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+
+	ring->sq_array[index] = index;
+	ring->sq_local_tail++;
+
+	return sqe;
+}
+
+
+
+/*
+ * @brief  Updates one entry of registered file table.
+ * @param  *ring    : pointer to io_uring structure (mqtt_uring_t).
+ * @param  offset   : file table index
+ * @param  *fd      : file descriptor, (-1 to clear)
+ * @retval int      : 1 = Success, -1 = Error
+ */
+static int mqtt_uring_update_file(mqtt_uring_t *ring, uint32_t offset, int32_t *fd)
+{
+	struct io_uring_files_update update;
+
+	memset(&update, 0, sizeof(update));
+
+	update.offset = offset;
+	update.fds    = (uint64_t)(uintptr_t)fd;
+
+	if(syscall(__NR_io_uring_register, ring->ring_fd, IORING_REGISTER_FILES_UPDATE, &update, 1) != 1)
+		return FUNC_OPTS_ERROR;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                              API Functions                                 */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Creates io_uring with provided receive buffer ring and sparse registered file table.
+ * @param  *ring   : pointer to io_uring structure (mqtt_uring_t).
+ * @retval int8_t  : 1 = Success, -1 = Error (errno is set)
+ */
+int8_t mqtt_uring_init(mqtt_uring_t *ring)
+{
+	struct io_uring_params       params;
+	struct io_uring_buf_reg      buffer_register;
+	struct io_uring_rsrc_register file_register;
+
+	uint8_t *sq_ring  = NULL;
+	uint8_t *cq_ring  = NULL;
+	size_t   cq_size  = 0;
+	uint16_t index    = 0;
+
+	if(ring == NULL)
+		return FUNC_OPTS_ERROR;
+
+	memset(ring, 0, sizeof(mqtt_uring_t));
+	memset(&params, 0, sizeof(params));
+
+	/* Task work runs on next system call of this thread, no interrupts of running FSM,
+	 * completion queue is larger as each multishot receive posts many completions */
+	params.flags      = IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN | IORING_SETUP_CQSIZE;
+	params.cq_entries = URING_QUEUE_DEPTH * 4;
+
+	ring->ring_fd = (int)syscall(__NR_io_uring_setup, URING_QUEUE_DEPTH, &params);
+
+	if(ring->ring_fd < 0)
+		return FUNC_OPTS_ERROR;
+
+	/* Single mapping of both rings and wait time out, (Linux 5.11) */
+	if(!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG))
+	{
+		mqtt_uring_close(ring);
+
+		errno = ENOSYS;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	ring->ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	cq_size         = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+	if(cq_size > ring->ring_size)
+		ring->ring_size = cq_size;
+
+	ring->ring_memory = mmap(NULL, ring->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			                 ring->ring_fd, IORING_OFF_SQ_RING);
+
+	ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			          ring->ring_fd, IORING_OFF_SQES);
+
+	if(ring->ring_memory == MAP_FAILED || ring->sqes == MAP_FAILED)
+	{
+		mqtt_uring_close(ring);
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	sq_ring = (uint8_t*)ring->ring_memory;
+	cq_ring = (uint8_t*)ring->ring_memory;
+
+	ring->sq_head       = (uint32_t*)(sq_ring + params.sq_off.head);
+	ring->sq_tail       = (uint32_t*)(sq_ring + params.sq_off.tail);
+	ring->sq_array      = (uint32_t*)(sq_ring + params.sq_off.array);
+	ring->sq_mask       = *(uint32_t*)(sq_ring + params.sq_off.ring_mask);
+	ring->sq_entries    = params.sq_entries;
+	ring->sq_local_tail = *ring->sq_tail;
+
+	ring->cq_head = (uint32_t*)(cq_ring + params.cq_off.head);
+	ring->cq_tail = (uint32_t*)(cq_ring + params.cq_off.tail);
+	ring->cqes    = (struct io_uring_cqe*)(cq_ring + params.cq_off.cqes);
+	ring->cq_mask = *(uint32_t*)(cq_ring + params.cq_off.ring_mask);
+
+	/* Buffer ring followed by receive buffers, one anonymous mapping */
+	ring->buffer_size = URING_BUFFER_RING_SIZE + (size_t)URING_BUFFER_COUNT * URING_BUFFER_SIZE;
+
+	ring->buffer_ring = mmap(NULL, ring->buffer_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if(ring->buffer_ring == MAP_FAILED)
+	{
+		ring->buffer_ring = NULL;
+
+		mqtt_uring_close(ring);
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	ring->buffers = (uint8_t*)ring->buffer_ring + URING_BUFFER_RING_SIZE;
+
+	memset(&buffer_register, 0, sizeof(buffer_register));
+
+	buffer_register.ring_addr    = (uint64_t)(uintptr_t)ring->buffer_ring;
+	buffer_register.ring_entries = URING_BUFFER_COUNT;
+	buffer_register.bgid         = MQTT_URING_BUFFER_GROUP;
+
+	memset(&file_register, 0, sizeof(file_register));
+
+	file_register.nr    = URING_MAX_FILES;
+	file_register.flags = IORING_RSRC_REGISTER_SPARSE;
+
+	if(syscall(__NR_io_uring_register, ring->ring_fd, IORING_REGISTER_PBUF_RING, &buffer_register, 1) < 0 ||
+	   syscall(__NR_io_uring_register, ring->ring_fd, IORING_REGISTER_FILES2, &file_register, sizeof(file_register)) < 0)
+	{
+		mqtt_uring_close(ring);
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	/* All receive buffers are available to kernel */
+	for(index = 0; index < URING_BUFFER_COUNT; index++)
+	{
+		mqtt_uring_buffer_release(ring, index);
+	}
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Registers socket in fixed file table, operations use index instead of descriptor.
+ * @param  *ring   : pointer to io_uring structure (mqtt_uring_t).
+ * @param  fd      : socket file descriptor
+ * @retval int     : fixed file index, -1 = Error
+ */
+int mqtt_uring_register_fd(mqtt_uring_t *ring, int fd)
+{
+	int32_t  file_fd    = fd;
+	uint32_t word_index = 0;
+	int      file_index = 0;
+
+	if(ring == NULL || fd < 0)
+		return FUNC_OPTS_ERROR;
+
+	/* First free index of file table */
+	for(word_index = 0; word_index < URING_MAX_FILES / 64 && ring->file_map[word_index] == UINT64_MAX; word_index++);
+
+	if(word_index == URING_MAX_FILES / 64)
+	{
+		errno = ENFILE;
+
+		return FUNC_OPTS_ERROR;
+	}
+
+	file_index = (int)(word_index * 64) + __builtin_ctzll(~ring->file_map[word_index]);
+
+	if(mqtt_uring_update_file(ring, (uint32_t)file_index, &file_fd) < 0)
+		return FUNC_OPTS_ERROR;
+
+	ring->file_map[file_index / 64] |= (uint64_t)1 << (file_index % 64);
+	ring->file_count++;
+
+	return file_index;
+}
+
+
+
+/*
+ * @brief  Removes socket from fixed file table, descriptor is not closed.
+ * @param  *ring        : pointer to io_uring structure (mqtt_uring_t).
+ * @param  file_index   : fixed file index from mqtt_uring_register_fd()
+ * @retval int8_t       : 1 = Success, -1 = Error
+ */
+int8_t mqtt_uring_unregister_fd(mqtt_uring_t *ring, int file_index)
+{
+	int32_t fd = -1;
+
+	if(ring == NULL || file_index < 0 || file_index >= URING_MAX_FILES)
+		return FUNC_OPTS_ERROR;
+
+	if(!(ring->file_map[file_index / 64] & ((uint64_t)1 << (file_index % 64))))
+		return FUNC_OPTS_ERROR;
+
+	if(mqtt_uring_update_file(ring, (uint32_t)file_index, &fd) < 0)
+		return FUNC_OPTS_ERROR;
+
+	ring->file_map[file_index / 64] &= ~((uint64_t)1 << (file_index % 64));
+	ring->file_count--;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Queues multishot receive, each arriving chunk completes into a provided buffer
+ *         without submitting again, (re-queue when completion has more = 0).
+ * @param  *ring        : pointer to io_uring structure (mqtt_uring_t).
+ * @param  file_index   : fixed file index
+ * @param  user_data    : returned with each completion
+ * @retval int8_t       : 1 = Success, -1 = Submission queue full
+ */
+int8_t mqtt_uring_recv(mqtt_uring_t *ring, int file_index, uint64_t user_data)
+{
+	struct io_uring_sqe *sqe = NULL;
+
+	if(ring == NULL || (sqe = mqtt_uring_get_sqe(ring)) == NULL)
+		return FUNC_OPTS_ERROR;
+
+	sqe->opcode    = IORING_OP_RECV;
+	sqe->flags     = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+	sqe->ioprio    = IORING_RECV_MULTISHOT;
+	sqe->fd        = file_index;
+	sqe->buf_group = MQTT_URING_BUFFER_GROUP;
+	sqe->user_data = user_data;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Queues send of buffer, buffer must stay valid until completion.
+ * @param  *ring        : pointer to io_uring structure (mqtt_uring_t).
+ * @param  file_index   : fixed file index
+ * @param  *buffer      : data to send
+ * @param  length       : length of data
+ * @param  user_data    : returned with completion
+ * @retval int8_t       : 1 = Success, -1 = Submission queue full
+ */
+int8_t mqtt_uring_send(mqtt_uring_t *ring, int file_index, const void *buffer, size_t length, uint64_t user_data)
+{
+	struct io_uring_sqe *sqe = NULL;
+
+	if(ring == NULL || buffer == NULL || (sqe = mqtt_uring_get_sqe(ring)) == NULL)
+		return FUNC_OPTS_ERROR;
+
+	sqe->opcode    = IORING_OP_SEND;
+	sqe->flags     = IOSQE_FIXED_FILE;
+	sqe->fd        = file_index;
+	sqe->addr      = (uint64_t)(uintptr_t)buffer;
+	sqe->len       = (uint32_t)length;
+	sqe->msg_flags = MSG_NOSIGNAL;
+	sqe->user_data = user_data;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Queues scatter-gather write, (e.g. PUBLISH burst from mqtt_publish_iov() or mqtt_publish_batch_iov()),
+ *         vector array and buffers must stay valid until completion.
+ * @param  *ring        : pointer to io_uring structure (mqtt_uring_t).
+ * @param  file_index   : fixed file index
+ * @param  *vector      : IO vector array
+ * @param  count        : number of IO vectors
+ * @param  user_data    : returned with completion
+ * @retval int8_t       : 1 = Success, -1 = Submission queue full
+ */
+int8_t mqtt_uring_writev(mqtt_uring_t *ring, int file_index, const mqtt_iovec_t *vector, int count, uint64_t user_data)
+{
+	struct io_uring_sqe *sqe = NULL;
+
+	if(ring == NULL || vector == NULL || count <= 0 || (sqe = mqtt_uring_get_sqe(ring)) == NULL)
+		return FUNC_OPTS_ERROR;
+
+	sqe->opcode    = IORING_OP_WRITEV;
+	sqe->flags     = IOSQE_FIXED_FILE;
+	sqe->fd        = file_index;
+	sqe->addr      = (uint64_t)(uintptr_t)vector;
+	sqe->len       = (uint32_t)count;
+	sqe->user_data = user_data;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Submits all queued operations and optionally waits for completions, one system call
+ *         for any number of operations and connections.
+ * @param  *ring        : pointer to io_uring structure (mqtt_uring_t).
+ * @param  wait_count   : completions to wait for, (0 = do not wait)
+ * @param  timeout_ms   : wait timeout in milliseconds, (-1 = wait forever)
+ * @retval int          : number of submitted operations, -1 = Error (errno is set, ETIME on time out)
+ */
+int mqtt_uring_submit(mqtt_uring_t *ring, uint32_t wait_count, int timeout_ms)
+{
+	struct io_uring_getevents_arg wait_arg;
+	struct __kernel_timespec      wait_time;
+
+	uint32_t submit_count = 0;
+	uint32_t enter_flags  = 0;
+	long     retval       = 0;
+
+	if(ring == NULL)
+		return FUNC_OPTS_ERROR;
+
+	submit_count = ring->sq_local_tail - *ring->sq_tail;
+
+	/* Completions already waiting, no system call needed */
+	if(wait_count > 0 && URING_LOAD_ACQUIRE(ring->cq_tail) - *ring->cq_head >= wait_count)
+		wait_count = 0;
+
+	if(submit_count == 0 && wait_count == 0)
+		return 0;
+
+	URING_STORE_RELEASE(ring->sq_tail, ring->sq_local_tail);
+
+	memset(&wait_arg, 0, sizeof(wait_arg));
+
+	if(wait_count > 0)
+	{
+		enter_flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+
+		if(timeout_ms >= 0)
+		{
+			wait_time.tv_sec  = timeout_ms / 1000;
+			wait_time.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+
+			wait_arg.ts = (uint64_t)(uintptr_t)&wait_time;
+		}
+	}
+
+	ring->enter_calls++;
+
+	retval = syscall(__NR_io_uring_enter, ring->ring_fd, submit_count, wait_count, enter_flags,
+			         (enter_flags & IORING_ENTER_EXT_ARG) ? &wait_arg : NULL, sizeof(wait_arg));
+
+	if(retval < 0)
+		return FUNC_OPTS_ERROR;
+
+	ring->submitted += (uint64_t)retval;
+
+	return (int)retval;
+}
+
+
+
+/*
+ * @brief  Reads next completion from completion queue, no system call.
+ * @param  *ring        : pointer to io_uring structure (mqtt_uring_t).
+ * @param  *completion  : pointer to completion structure (mqtt_uring_completion_t).
+ * @retval int8_t       : 1 = completion read, 0 = completion queue empty, -1 = Error
+ */
+int8_t mqtt_uring_complete(mqtt_uring_t *ring, mqtt_uring_completion_t *completion)
+{
+	struct io_uring_cqe *cqe = NULL;
+
+	uint32_t head = 0;
+
+	if(ring == NULL || completion == NULL)
+		return FUNC_OPTS_ERROR;
+
+	head = *ring->cq_head;
+
+	if(head == URING_LOAD_ACQUIRE(ring->cq_tail))
+		return 0;
+
+	cqe = &ring->cqes[head & ring->cq_mask];
+
+	completion->user_data = cqe->user_data;
+	completion->result    = cqe->res;
+	completion->more      = (cqe->flags & IORING_CQE_F_MORE) ? 1 : 0;
+	completion->buffer_id = MQTT_URING_NO_BUFFER;
+	completion->buffer    = NULL;
+
+	if(cqe->flags & IORING_CQE_F_BUFFER)
+	{
+		completion->buffer_id = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+		completion->buffer    = ring->buffers + (size_t)completion->buffer_id * URING_BUFFER_SIZE;
+	}
+
+	URING_STORE_RELEASE(ring->cq_head, head + 1);
+
+	ring->completed++;
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Returns receive buffer to buffer ring once its data is consumed.
+ * @param  *ring        : pointer to io_uring structure (mqtt_uring_t).
+ * @param  buffer_id    : buffer ID of receive completion
+ * @retval int8_t       : 1 = Success, -1 = Error
+ */
+int8_t mqtt_uring_buffer_release(mqtt_uring_t *ring, uint16_t buffer_id)
+{
+	struct io_uring_buf *buffer = NULL;
+
+	if(ring == NULL || buffer_id >= URING_BUFFER_COUNT)
+		return FUNC_OPTS_ERROR;
+
+	buffer = &ring->buffer_ring->bufs[ring->buffer_tail & (URING_BUFFER_COUNT - 1)];
+
+	buffer->addr = (uint64_t)(uintptr_t)(ring->buffers + (size_t)buffer_id * URING_BUFFER_SIZE);
+	buffer->len  = URING_BUFFER_SIZE;
+	buffer->bid  = buffer_id;
+
+	ring->buffer_tail++;
+
+	URING_STORE_RELEASE(&ring->buffer_ring->tail, ring->buffer_tail);
+
+	return FUNC_OPTS_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Closes io_uring and releases its mappings, registered descriptors are not closed.
+ * @param  *ring   : pointer to io_uring structure (mqtt_uring_t).
+ * @retval int8_t  : 1 = Success, -1 = Error
+ */
+int8_t mqtt_uring_close(mqtt_uring_t *ring)
+{
+	if(ring == NULL)
+		return FUNC_OPTS_ERROR;
+
+	if(ring->buffer_ring != NULL)
+		munmap(ring->buffer_ring, ring->buffer_size);
+
+	if(ring->sqes != NULL && ring->sqes != MAP_FAILED)
+		munmap(ring->sqes, ring->sqes_size);
+
+	if(ring->ring_memory != NULL && ring->ring_memory != MAP_FAILED)
+		munmap(ring->ring_memory, ring->ring_size);
+
+	if(ring->ring_fd >= 0)
+		close(ring->ring_fd);
+
+	memset(ring, 0, sizeof(mqtt_uring_t));
+
+	ring->ring_fd = -1;
+
+	return FUNC_OPTS_SUCCESS;
+}
@@ -37,8 +37,12 @@
 #include <stdint.h>
 #include <time.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
 
 #include "mqtt_client.h"
+#include "mqtt_notify.h"
+#include "mqtt_queue.h"
 
 
 /* @brief MACRO defines */
@@ -73,519 +77,263 @@
 
 
 
-/* Function set connection to mqtt server */
-int mqtt_broker_connect(int *fd, int port, char *server_address)
+/* Application state, changed by session events */
+typedef struct app_state
 {
+	char                   *client_name;
+	char                   *publish_topic;
+	mqtt_subscribe_entry_t *subscribe_list;
+	size_t                  subscribe_count;
+	uint8_t                 subscribed;
+	uint32_t                start_time;
 
-	int func_retval = 0;
-
-	struct sockaddr_in server;
-
-	/* Get client socket type */
-	if( (*fd = socket(AF_INET, SOCK_STREAM, 0)) < 0 )
-	{
-		func_retval = -1;
-	}
-
-
-	server.sin_family = AF_INET;
-	server.sin_port   = htons(port);
-
-	server.sin_addr.s_addr = inet_addr(server_address);
-
-
-	/* Connect to MQTT server host machine */
-	if( ( connect(*fd, (struct sockaddr*)&server, sizeof(server)) ) < 0)
-	{
-		func_retval = -2;
-	}
-
-	fcntl(*fd, F_SETFL, O_NONBLOCK);
-
-	return func_retval;
-}
+}app_state_t;
 
 
 
-int main()
+/* Function called by session for each received packet and for close of session */
+void app_session_event(void *context, mqtt_session_t *session, const mqtt_session_event_t *event)
 {
+	app_state_t *app = (app_state_t*)context;
 
-	/* Socket API related variable initializations */
-	int    client_sfd        = 0;
-	char   message[2000]     = {0};
-	char   read_buffer[1500] = {0};
-
-
-	/* MQTT client structure initializations */
-	mqtt_client_t publisher;
-	mqtt_client_t subscriber;
-
-
-	/* Client State machine related variable initializations */
-	size_t  message_length      = 0;
-	int8_t  retval              = 0;
-	int8_t  message_status      = 0;
-	uint8_t loop_state          = 0;
-	uint8_t mqtt_message_state  = 0;
-	uint16_t keep_alive_time    = 0;
-
-	uint8_t  subscribe_request      = 0;  /* will be modified by another thread or interrupt routine */
-	uint8_t  publish_request        = 0;  /* will be modified by another thread or interrupt routine */
-	uint8_t  subscribe_message_send = 0;
-	uint16_t subscribe_message_id   = 0;
-
-	clock_t  start_time = 0;
-
-	uint8_t read_qos_level = 0;
-
-	/* MQTT message buffers */
-	char *my_client_name   = "gateway|1990-adityamall";
-	char *my_client_topic  = "device1/message";
-	char user_name[]       = "device1.sensor";
-	char pass_word[]       = "4321";
-	char *pub_message;
-	char received_topic[30];
-	char received_message[100];
-
+	uint16_t suback_message_id = 0;
+	size_t   subscribe_index   = 0;
 
-	/* Connect to mqtt broker */
-#if LOOPBACK
-	mqtt_broker_connect(&client_sfd, PORT, LOCALHOST);
-#else
-	mqtt_broker_connect(&client_sfd, PORT, HOST_IP_ADDR);
-#endif
-
-	/* State machine initializations */
-	loop_state = FSM_RUN;
-
-	/* Update state to connect to send connect message */
-	mqtt_message_state = mqtt_connect_state;
-
-	subscribe_request = 1;
-	publish_request   = 1;
-
-
-	/* MQTT Finite state machine */
-	while(loop_state)
+	switch(event->type)
 	{
 
-		switch(mqtt_message_state)
-		{
-
-		case mqtt_idle_state:
-
-			fprintf(stdout,"FSM Idle State\n");
-
-			if(publish_request)
-				mqtt_message_state = mqtt_publish_state;
-
-			else if(subscribe_request)
-				mqtt_message_state = mqtt_subscribe_state;
-
-			else
-			{
-				mqtt_message_state = mqtt_read_state;
-			}
-
-
-			break;
-
-
-		case mqtt_read_state:
-
-			/* Read Message type from the socket read buffer */
-
-			fprintf(stdout,"FSM Read State\n");
-
-			memset(read_buffer, 0, sizeof(read_buffer));
-
-			/* Check for keep alive time for subscriber */
-			while( (( read(client_sfd, read_buffer, 1500) ) < 0) && (clock() < start_time + (keep_alive_time * CLOCKS_PER_SEC)));
-
-			/* Change state to  ping request after time out */
-			if(clock() > start_time + ((keep_alive_time - 1) * CLOCKS_PER_SEC))
-			{
-				printf("Time exceeded\n");
-				printf("Time: %ld\n", (clock() - start_time) / CLOCKS_PER_SEC);
-
-				mqtt_message_state = mqtt_pingrequest_state;
-
-				break;
-			}
-
-			publisher.message = (void*)read_buffer;
-
-			/* get MQTT message type and update state */
-			mqtt_message_state = get_mqtt_message_type(&publisher);
-			if(!mqtt_message_state)
-			{
-				mqtt_message_state = mqtt_disconnect_state;
-
-#if 0
-				/* connect again for subscriber time out*/
-				mqtt_broker_connect(&client_sfd, PORT, INADDR_ANY);
-
-				subscribe_request = 1;
-
-				mqtt_message_state = mqtt_connect_state;
-#endif
-
-			}
-
-			break;
-
-
-		case mqtt_connect_state:
-
-			/* Fill mqtt CONNECT message structure */
-
-			memset(message, '\0', sizeof(message));
-
-			publisher.connect_msg = (void *)message;
-
-			/* Setup User name password (optional) */
-			retval = mqtt_client_username_passwd(&publisher, user_name, pass_word);
-			if(retval == -1)
-			{
-				fprintf(stdout,"Bad value of user name or password\n");
-
-				mqtt_message_state = mqtt_exit_state;
-
-				break;
-			}
-
-
-			/* Set connect options */
-			retval = mqtt_connect_options(&publisher, MQTT_CLEAN_SESSION, MQTT_MESSAGE_NO_RETAIN, MQTT_QOS_FIRE_FORGET);
-			if(retval == -1)
-			{
-				fprintf(stdout,"Bad value of connect options params\n");
-
-				mqtt_message_state = mqtt_exit_state;
-
-				break;
-			}
-
-
-			/* Setup mqtt CONNECT Message  */
-
-			keep_alive_time = 60;
+	case MQTT_SESSION_EVENT_CONNECTED:
 
-			message_length = mqtt_connect(&publisher, my_client_name, keep_alive_time);
+		fprintf(stdout,"%s :Received CONNACK\n", app->client_name);
 
-			/* Send mqtt CONNECT  (through socket API) */
-			retval = write(client_sfd, (char*)publisher.connect_msg, message_length);
-			if(retval == -1)
-			{
-				printf("Connect write error, Socket closed by server \n");
-
-				mqtt_message_state = mqtt_exit_state;
-
-				break;
-			}
+		break;
 
-			/* Print debug message */
-			fprintf(stdout, "%s :Sending CONNECT\n", my_client_name);
 
-			/* Update state */
-			mqtt_message_state = mqtt_read_state;
-
-			start_time = clock();
-
-			break;
+	case MQTT_SESSION_EVENT_REFUSED:
 
+		/* Subscribe sent with CONNECT is dropped with the connection */
+		fprintf(stdout,"%s :Received CONNACK, connection refused :%d\n", app->client_name, event->return_code);
 
-		case mqtt_connack_state:
+		break;
 
-			/* @brief print debug message */
-			fprintf(stdout,"%s :Received CONNACK\n", my_client_name);
-
-			/* Check return code of CONNACK message */
-			publisher.connack_msg = (void *)read_buffer;
-
-			if(subscribe_request == 1)
-			{
-				mqtt_message_state = mqtt_subscribe_state;
-			}
-			else
-				mqtt_message_state = get_connack_status(&publisher);
-
-			break;
 
+	case MQTT_SESSION_EVENT_SUBSCRIBED:
 
-		case mqtt_publish_state:
+		fprintf(stdout,"%s :Received SUBACK\n", app->client_name);
 
-			/* Send publish only when requested */
-			if(publish_request == 1)
+		/* Return code of each topic filter, (granted qos or failure) */
+		if(mqtt_suback_parse(event->packet, app->subscribe_list, app->subscribe_count, &suback_message_id) == 1)
+		{
+			for(subscribe_index = 0; subscribe_index < app->subscribe_count; subscribe_index++)
 			{
-				pub_message = "Test Message from client PC";
-
-				/* Fill mqtt PUBLISH message structure */
-				memset(message, '\0', sizeof(message));
-
-				publisher.publish_msg = (void *)message;
-
-				/*Configure publish options */
-				message_status = mqtt_publish_options(&publisher, MQTT_MESSAGE_NO_RETAIN, MQTT_QOS_FIRE_FORGET);
-				if(message_status == -1)
-				{
-					fprintf(stdout, "publish options param error\n");
-
-					mqtt_message_state = mqtt_disconnect_state;
-
-					break;
-				}
-
-				/* Configure publish message */
-				message_length = mqtt_publish(&publisher, my_client_topic, pub_message);
-				if(message_length == 0)
-				{
-					fprintf(stdout,"publish message param error\n");
-
-					mqtt_message_state = mqtt_disconnect_state;
-
-					break;
-				}
-
-				/* @brief send publish message (Socket API) */
-				write(client_sfd, (char*)publisher.publish_msg, message_length);
-
-				/* @brief print debug message */
-				fprintf(stdout, "%s :Sending PUBLISH(\"%s\",...(%ld bytes))\n", my_client_name, my_client_topic, strlen(pub_message));
-
-				/* Update State according to quality of service */
-				if(message_status == MQTT_QOS_ATLEAST_ONCE || message_status == MQTT_QOS_EXACTLY_ONCE)
-				{
-					mqtt_message_state = mqtt_read_state;
-				}
-				else
-				{
-					/* check if subscribe request has been sent just before this publish */
-					if(subscribe_message_send == 1)
-					{
-						mqtt_message_state = mqtt_read_state;
-					}
-					else
-					{
-						mqtt_message_state =  mqtt_idle_state;
-					}
-
-					/* Clear publish request after sending publish message */
-					publish_request = 0;
-				}
+				fprintf(stdout,"%s :SUBACK %s, return code :%d\n", app->client_name, app->subscribe_list[subscribe_index].topic,
+						app->subscribe_list[subscribe_index].return_code);
 			}
-			else
-			{
-				/*read publish message received from broker*/
-
-				subscriber.publish_msg = (void*)read_buffer;
-
-				memset(received_topic, 0, sizeof(received_topic));
-
-				mqtt_read_publish(&subscriber, received_topic, received_message, &read_qos_level);
-
-				/* @brief print debug message */
-				fprintf(stdout, "%s :Received PUBLISH(\"%s\",...(%ld bytes))\n", my_client_name, received_topic, strlen(received_message));
-				fprintf(stdout, "%s :Received MESSAGE :%s\n", my_client_name, received_message);
-
-				subscribe_message_send = 0;
-
-				mqtt_message_state =  mqtt_idle_state;
-
-			}
-			break;
-
-
-
-		case mqtt_puback_state:
+		}
 
-			printf("%s :Received PUBACK\n",my_client_name);
+		printf("delay milli sec :%u\n", mqtt_timer_now() - app->start_time);
 
-			if(subscribe_message_send == 1)
-				mqtt_message_state = mqtt_read_state;
-			else
-				mqtt_message_state =  mqtt_disconnect_state;
+		/* Queued publish requests are sent once subscription is in place, message is received back on device1/# */
+		app->subscribed = 1;
 
-			publish_request = 0;
+		break;
 
 
-			break;
+	case MQTT_SESSION_EVENT_MESSAGE:
 
+		fprintf(stdout, "%s :Received PUBLISH(\"%.*s\",...(%ld bytes))\n", app->client_name, (int)event->publish->topic_length,
+				event->publish->topic, event->publish->message_length);
+		fprintf(stdout, "%s :Received MESSAGE :%.*s\n", app->client_name, (int)event->publish->message_length, event->publish->message);
 
+		break;
 
-		case mqtt_pubrec_state:
 
-			printf("%s :Received PUBREC\n",my_client_name);
+	case MQTT_SESSION_EVENT_PUBLISHED:
 
-			mqtt_message_state = mqtt_pubrel_state;
+		printf("%s :Received PUBACK\n", app->client_name);
 
-			break;
+		break;
 
 
+	case MQTT_SESSION_EVENT_PINGRESP:
 
-		case mqtt_pubrel_state:
+		fprintf(stdout,"%s :Received PINGRESP\n", app->client_name);
 
-			/* Fill mqtt PUBREL message strcuture */
-			memset(message, '\0', sizeof(message));
+		break;
 
-			publisher.pubrel_msg = (void *)message;
 
-			message_length = mqtt_publish_release(&publisher);
+	case MQTT_SESSION_EVENT_CLOSED:
 
-			/* @brief send pubrel message (Socket API) */
-			write(client_sfd, (char*)publisher.pubrel_msg, message_length);
+		if(event->error == ETIMEDOUT)
+			printf("Keep alive time exceeded, %u PINGREQ suppressed by traffic\n", session->keepalive.suppressed);
 
-			fprintf(stdout,"%s :Sending PUBREL\n",my_client_name);
-
-			mqtt_message_state = mqtt_read_state;
-
-			break;
+		fprintf(stdout,"%s :Session closed :%s\n", app->client_name, event->error ? strerror(event->error) : "DISCONNECT sent");
 
+		break;
 
-		case mqtt_pubcomp_state:
 
-			fprintf(stdout,"%s :Received PUBCOMP\n",my_client_name);
+	default:
+		break;
 
-			if(subscribe_message_send == 1)
-				mqtt_message_state = mqtt_read_state;
-			else
-				mqtt_message_state =  mqtt_disconnect_state;
+	}
+}
 
-			publish_request = 0;
 
-			break;
 
+int mqtt_broker_connect(int *fd, int port, char *server_address)
+{
 
-		case mqtt_disconnect_state:
+	int func_retval = 0;
 
-			/* @brief Fill DISCONNECT structure */
-			memset(message,'\0',sizeof(message));
+	struct sockaddr_in server;
 
-			publisher.disconnect_msg = (void*)message;
+	/* Get client socket type */
+	if( (*fd = socket(AF_INET, SOCK_STREAM, 0)) < 0 )
+	{
+		func_retval = -1;
+	}
 
-			message_length = mqtt_disconnect(&publisher);
 
-			/* Send Disconnect Message */
-			write(client_sfd, (char*)publisher.disconnect_msg, message_length);
+	server.sin_family = AF_INET;
+	server.sin_port   = htons(port);
 
-			/* @brief print debug message */
-			fprintf(stdout,"%s :Sending DISCONNECT\n",my_client_name);
+	server.sin_addr.s_addr = inet_addr(server_address);
 
-			/* Update State */
-			mqtt_message_state = mqtt_exit_state;
 
-			break;
+	/* Connect to MQTT server host machine */
+	if( ( connect(*fd, (struct sockaddr*)&server, sizeof(server)) ) < 0)
+	{
+		func_retval = -2;
+	}
 
+	fcntl(*fd, F_SETFL, O_NONBLOCK);
 
-		case mqtt_subscribe_state:
+	return func_retval;
+}
 
-			memset(message,'\0',sizeof(message));
 
-			subscriber.subscribe_msg = (void*)message;
 
-			message_length = mqtt_subscribe(&subscriber,"device1/#", MQTT_QOS_FIRE_FORGET, &subscribe_message_id);
 
-			write(client_sfd, (char*)subscriber.subscribe_msg, message_length);
+int main()
+{
 
-			/* @brief print debug message */
-			fprintf(stdout,"%s :Sending SUBSCRIBE\n",my_client_name);
+	/* Socket API related variable initializations */
+	int     client_sfd = 0;
+	uint8_t read_buffer[1500];
+	uint8_t output_buffer[OUTPUT_BUFFER_SIZE];
+	uint8_t publish_storage[MQTT_QUEUE_STORAGE_SIZE(PUBLISH_QUEUE_CELL_SIZE, PUBLISH_QUEUE_CELLS)] MQTT_RING_ALIGNED;
+
+	/* Notification group, one descriptor for application loop, (socket, timers and wake ups) */
+	mqtt_notify_t        notify_group;
+	mqtt_notify_member_t session_member;
+	struct pollfd        notify_poll;
+
+	/* Publish requests, can be queued by other threads */
+	mqtt_queue_t         publish_queue;
+	char                 *pub_message = "Test Message from client PC";
+	int32_t              published    = 0;
+
+	/* Keep alive timer wheel and session engine */
+	mqtt_timer_wheel_t  timer_wheel;
+	mqtt_session_t      session;
+
+	/* Topic filters subscribed with one SUBSCRIBE packet */
+	mqtt_subscribe_entry_t subscribe_list[] =
+	{
+		{ "device1/#",        MQTT_QOS_FIRE_FORGET, 0 },
+		{ "device2/pressure", MQTT_QOS_FIRE_FORGET, 0 },
+	};
 
-#if 1 /* Subscribe two topics */
-			memset(message,'\0',sizeof(message));
+	/* MQTT message buffers */
+	char user_name[]       = "device1.sensor";
+	char pass_word[]       = "4321";
 
-			subscriber.subscribe_msg = (void*)message;
+	uint16_t keep_alive_time = 60;
 
-			message_length = mqtt_subscribe(&subscriber,"device2/pressure", MQTT_QOS_FIRE_FORGET, &subscribe_message_id);
+	app_state_t app =
+	{
+		.client_name     = "gateway|1990-adityamall",
+		.publish_topic   = "device1/message",
+		.subscribe_list  = subscribe_list,
+		.subscribe_count = sizeof(subscribe_list) / sizeof(subscribe_list[0]),
+	};
 
-			write(client_sfd, (char*)subscriber.subscribe_msg, message_length);
 
-			/* @brief print debug message */
-			fprintf(stdout,"%s :Sending SUBSCRIBE 2\n",my_client_name);
+	/* Connect to mqtt broker */
+#if LOOPBACK
+	if(mqtt_broker_connect(&client_sfd, PORT, LOCALHOST) < 0)
+#else
+	if(mqtt_broker_connect(&client_sfd, PORT, HOST_IP_ADDR) < 0)
 #endif
-			/* Update State */
-			mqtt_message_state = mqtt_read_state;
-
-			subscribe_message_send = 1;
-
-			break;
-
-
-		case mqtt_suback_state:
-
-			fprintf(stdout,"%s :Received SUBACK\n",my_client_name);
-
-			mqtt_message_state =  mqtt_idle_state;
+	{
+		printf("Connect error, no broker\n");
 
-			subscribe_request = 0;
+		return 0;
+	}
 
-			printf("delay micro sec :%ld\n", (clock()- start_time) * 1000000 / CLOCKS_PER_SEC);
+	/* Session reads socket itself and writes through its output buffer */
+	mqtt_timer_wheel_init(&timer_wheel, mqtt_timer_now());
 
-			break;
+	mqtt_session_init(&session, client_sfd, read, write, read_buffer, sizeof(read_buffer), output_buffer, sizeof(output_buffer),
+			          NULL, &timer_wheel, app_session_event, &app);
 
+	app.start_time = mqtt_timer_now();
 
-		case mqtt_pingrequest_state:
-
-			/* @brief Fill PINGREQ structure */
-			memset(message,'\0',sizeof(message));
+	/* Pipelined startup, SUBSCRIBE follows CONNECT in the same write, SUBACK is handled after CONNACK */
+	if(mqtt_session_connect(&session, app.client_name, user_name, pass_word, keep_alive_time, MQTT_CLEAN_SESSION, app.start_time) < 0 ||
+	   mqtt_session_subscribe(&session, subscribe_list, app.subscribe_count, app.start_time) < 0)
+	{
+		printf("Connect write error, Socket closed by server \n");
 
-			publisher.pingrequest_msg = (void*)message;
+		return 0;
+	}
 
-			message_length = mqtt_pingreq(&publisher);
+	fprintf(stdout, "%s :Sending CONNECT\n", app.client_name);
+	fprintf(stdout, "%s :Sending SUBSCRIBE\n", app.client_name);
 
-			/* Send Ping request Message */
-			write(client_sfd, (char*)publisher.pingrequest_msg, message_length);
+	/* Queued CONNECT and SUBSCRIBE are written by first dispatch */
+	if(mqtt_notify_init(&notify_group) < 0 || mqtt_notify_add(&notify_group, &session_member, &session) < 0)
+	{
+		printf("Notification group error\n");
 
-			/* @brief print debug message */
-			fprintf(stdout,"%s :Sending PINGREQ\n",my_client_name);
+		return 0;
+	}
 
-			/* Change state */
-			mqtt_message_state = mqtt_read_state;
+	/* Producers signal group when application loop sleeps on empty queue */
+	if(mqtt_queue_init(&publish_queue, publish_storage, PUBLISH_QUEUE_CELL_SIZE, PUBLISH_QUEUE_CELLS, &notify_group) < 0 ||
+	   mqtt_enqueue_publish(&publish_queue, app.publish_topic, pub_message, strlen(pub_message), MQTT_QOS_FIRE_FORGET,
+			                MQTT_MESSAGE_NO_RETAIN) < 0)
+	{
+		printf("Publish queue error\n");
 
-			/* Reset Timer */
-			start_time = 0;
+		return 0;
+	}
 
-			start_time = clock();
+	notify_poll.fd     = mqtt_notify_fd(&notify_group);
+	notify_poll.events = POLLIN;
 
+	/* Application loop sleeps on group descriptor, session runs until broker closes connection or keep alive fails */
+	while(session.state != MQTT_SESSION_CLOSED)
+	{
+		if(poll(&notify_poll, 1, -1) < 0 && errno != EINTR)
 			break;
 
-
-		case mqtt_pingresponse_state:
-
-			fprintf(stdout,"%s :Received PINGRESP\n", my_client_name);
-
-			start_time = 0;
-
-			start_time = clock();
-
-			mqtt_message_state = mqtt_read_state;
-
+		if(mqtt_notify_dispatch(&notify_group, mqtt_timer_now(), 0) < 0)
 			break;
 
+		/* Owner of session publishes queued requests in order */
+		if(app.subscribed && (published = mqtt_queue_drain(&publish_queue, &session, mqtt_timer_now(), 0)) > 0)
+			fprintf(stdout, "%s :Sending PUBLISH(\"%s\",...) x %d\n", app.client_name, app.publish_topic, published);
+	}
 
 
-		case mqtt_exit_state:
-
-			fprintf(stdout,"FSM Exit state \n");
-
-			/* Close socket */
-			shutdown(client_sfd, SHUT_RD);
-			close(client_sfd);
-
-			/* Suspend while loop */
-			loop_state = FSM_SUSPEND;
-
-			printf("Publish request status:%d\n", publish_request);
-			printf("Subscribe request status:%d\n", subscribe_request);
-			printf("Subscribe send status:%d\n", subscribe_message_send);
-
-			break;
-
-		default:
-			break;
+	/* Release notification group and close socket */
+	mqtt_notify_close(&notify_group);
 
-		}
+	shutdown(client_sfd, SHUT_RD);
+	close(client_sfd);
 
-	}
+	printf("Publish requests queued:%u\n", mqtt_queue_count(&publish_queue));
 
 	fprintf(stdout,"Exited FSM \n");
 
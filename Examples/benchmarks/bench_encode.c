@@ -0,0 +1,205 @@
+/**
+ ******************************************************************************
+ * @file    bench_encode.c
+ * @author  Aditya Mall,
+ * @brief   PUBLISH and PUBREL encoder benchmark
+ *
+ *  Info
+ *          Only for testing, (POSIX compatible only.)
+ *
+ *          Usage: bin/bench_encode [iterations]
+ *
+ *          Times a local copy of the baseline encoder, (#pragma pack(1) bit field
+ *          overlay written with mqtt_htons()), next to mqtt_publish() and
+ *          mqtt_publish_release() of the API, both encode the same packets.
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall </center></h2>
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+
+/* header files */
+#include <stdio.h>
+#include <string.h>
+#include "mqtt_client.h"
+#include "bench_utils.h"
+
+
+#define ENCODE_ITERATIONS  20000000   /* Default PUBLISH and PUBREL pairs encoded */
+#define BASELINE_NOIPA     __attribute__((noipa))    /* Not specialized for constant arguments, like API encoder */
+
+
+
+/* Baseline packet overlays, copied from mqtt_client.h before the byte encoder */
+#pragma pack(push, 1)
+
+typedef struct baseline_header
+{
+	uint8_t retain_flag     : 1;  /*!< Message Retain Flag, (LSB)                                              */
+	uint8_t qos_level       : 2;  /*!< Quality of service Level, (LSB)                                         */
+	uint8_t dup_flag        : 1;  /*!< Duplicate Flag, (LSB)                                                   */
+	uint8_t message_type    : 4;  /*!< MQTT Control Packet / Message Type, (MSB)                               */
+	uint8_t message_length;       /*!< Length of MQTT Message (Remaining Length, excludes fixed header length) */
+
+}BaselineHeader;
+
+
+typedef struct baseline_publish
+{
+	BaselineHeader fixed_header;              /*!< MQTT Fixed Header            */
+	uint16_t       topic_length;              /*!< Publish message topic length */
+	char           payload[MESSAGE_LENGTH];   /*!< publish message pay load     */
+
+}BaselinePublish;
+
+
+typedef struct baseline_pubrel
+{
+	BaselineHeader fixed_header;  /*!< MQTT Fixed Header                  */
+	uint16_t       message_id;    /*!< Publish release message Identifier */
+
+}BaselinePubrel;
+
+#pragma pack(pop)
+
+
+
+/*
+ * @brief  Baseline conversion to network byte order
+ * @param  value    : value in host byte order format
+ * @retval uint16_t : value network byte order format
+ */
+static uint16_t baselineHtons(uint16_t value)
+{
+	value  = ((value & 0xFF00) >> 8) + ((value & 0x00FF) << 8);
+
+	return value;
+}
+
+
+
+/*
+ * @brief  Baseline PUBLISH encoder, (qos 0 path of baseline mqtt_publish())
+ * @param  *publish        : publish overlay, qos and retain set by caller
+ * @param  *topic          : publish topic name
+ * @param  *message        : message to be published
+ * @param  messageLength   : length of publish message
+ * @retval size_t          : length of publish control packet, fail = 0
+ */
+static BASELINE_NOIPA size_t baselinePublish(BaselinePublish *publish, char *topic, char *message, uint16_t messageLength)
+{
+	uint8_t messageTotal = 0;
+	uint8_t topicLength  = (uint8_t)strlen(topic);
+
+	if(topicLength > MQTT_TOPIC_LENGTH || messageLength > PUBLISH_PAYLOAD_LENGTH)
+		return 0;
+
+	publish->fixed_header.message_type = MQTT_PUBLISH_MESSAGE;
+
+	publish->topic_length = baselineHtons(topicLength);
+
+	/* Baseline copies topic without terminator on purpose */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wstringop-truncation"
+	strncpy(publish->payload, topic, topicLength);
+#pragma GCC diagnostic pop
+	strncpy(publish->payload + topicLength, message, messageLength);
+
+	messageTotal = (uint8_t)(messageLength + topicLength + 2 + FIXED_HEADER_LENGTH);
+
+	publish->fixed_header.message_length = (uint8_t)(messageTotal - FIXED_HEADER_LENGTH);
+
+	return messageTotal;
+}
+
+
+
+/*
+ * @brief  Baseline PUBREL encoder, message ID is taken like current encoder, (baseline wrote 1)
+ * @param  *release    : pubrel overlay
+ * @param  messageId   : message ID
+ * @retval size_t      : length of publish release message
+ */
+static BASELINE_NOIPA size_t baselineRelease(BaselinePubrel *release, uint16_t messageId)
+{
+	release->fixed_header.qos_level    = MQTT_QOS_ATLEAST_ONCE;
+	release->fixed_header.message_type = MQTT_PUBREL_MESSAGE;
+
+	release->message_id = baselineHtons(messageId);
+
+	release->fixed_header.message_length = (uint8_t)(sizeof(BaselinePubrel) - FIXED_HEADER_LENGTH);
+
+	return sizeof(BaselinePubrel);
+}
+
+
+
+int main(int argc, char **argv)
+{
+	static uint8_t publishBuffer[sizeof(mqtt_publish_t)];
+	static uint8_t releaseBuffer[sizeof(mqtt_pubrel_t)];
+
+	static BaselinePublish baselinePublishBuffer;
+	static BaselinePubrel  baselineReleaseBuffer;
+
+	mqtt_client_t client;
+	long          iterations      = benchArgument(argc, argv, 1, ENCODE_ITERATIONS);
+	long          index           = 0;
+	size_t        encoded         = 0;
+	size_t        baselineEncoded = 0;
+	double        startTime       = 0;
+	double        elapsed         = 0;
+	double        baselineElapsed = 0;
+
+	mqtt_client_init(&client, NULL);
+
+	client.publish_msg = (mqtt_publish_t*)publishBuffer;
+	client.pubrel_msg  = (mqtt_pubrel_t*)releaseBuffer;
+
+	mqtt_publish_options(&client, MQTT_MESSAGE_NO_RETAIN, MQTT_QOS_FIRE_FORGET);
+
+	/* Baseline overlay encoder, qos 0 without retain like API run */
+	startTime = benchTime();
+
+	for(index = 0; index < iterations; index++)
+	{
+		baselineEncoded += baselinePublish(&baselinePublishBuffer, "sensors/temp", "hello", 5);
+		baselineEncoded += baselineRelease(&baselineReleaseBuffer, (uint16_t)index | 1);
+	}
+
+	baselineElapsed = benchTime() - startTime;
+
+	startTime = benchTime();
+
+	for(index = 0; index < iterations; index++)
+	{
+		encoded += mqtt_publish(&client, "sensors/temp", "hello", 5);
+		encoded += mqtt_publish_release(&client, (uint16_t)index | 1);
+	}
+
+	elapsed = benchTime() - startTime;
+
+	/* Encoded length is printed, so the loops are not optimized away */
+	printf("%ld PUBLISH + PUBREL pairs\n", iterations);
+	printf("encoder                               ns/iteration        bytes\n");
+	printf("baseline overlay + mqtt_htons         %12.1f %12zu\n", baselineElapsed * 1e9 / (double)iterations, baselineEncoded);
+	printf("mqtt_publish + mqtt_publish_release   %12.1f %12zu\n", elapsed * 1e9 / (double)iterations, encoded);
+
+	return 0;
+}
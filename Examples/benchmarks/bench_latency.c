@@ -0,0 +1,294 @@
+/**
+ ******************************************************************************
+ * @file    bench_latency.c
+ * @author  Aditya Mall,
+ * @brief   Unix domain socket vs TCP loopback benchmark of one session
+ *
+ *  Info
+ *          Only for testing, (POSIX compatible only.)
+ *
+ *          Usage: bin/bench_latency <port> <unix:/path> [round trips] [messages] [profile]
+ *
+ *          Run one bin/broker_stub on the port and one on the unix socket first. Each
+ *          transport measures qos 1 round trip of single publish (p50, p99), then
+ *          pipelined qos 1 publish rate and client CPU per message. Profile ("low-latency",
+ *          "throughput", "default") is applied with mqtt_socket_apply() before connect,
+ *          without profile only TCP_NODELAY is set.
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall </center></h2>
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+
+/* header files */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include "mqtt_notify.h"
+#include "mqtt_socket.h"
+#include "bench_utils.h"
+
+
+#define LATENCY_ROUND_TRIPS  10000     /* Default single publish round trips            */
+#define LATENCY_MESSAGES     200000    /* Default pipelined qos 1 messages              */
+#define LATENCY_INPUT_SIZE   4096      /* Session input buffer                          */
+#define LATENCY_BATCH        256       /* Acknowledged IDs given in one completed event */
+
+
+
+/* Session of one transport, events are counted by callback */
+typedef struct bench_link
+{
+	mqtt_session_t        session;
+	mqtt_notify_t         group;
+	mqtt_notify_member_t  member;
+	mqtt_timer_wheel_t    wheel;
+	mqtt_inflight_t       inflight;
+	uint8_t               input[LATENCY_INPUT_SIZE];
+	uint8_t               output[OUTPUT_BUFFER_SIZE];
+	uint16_t              completedIds[LATENCY_BATCH];
+	long                  completed;
+	int                   closed;
+
+}BenchLink;
+
+
+
+/*
+ * @brief  Session event callback
+ * @param  *context  : link (BenchLink)
+ * @param  *session  : session
+ * @param  *event    : session event
+ * @retval None
+ */
+static void benchEvent(void *context, mqtt_session_t *session, const mqtt_session_event_t *event)
+{
+	BenchLink *link = (BenchLink*)context;
+
+	(void)session;
+
+	if(event->type == MQTT_SESSION_EVENT_PUBLISHED)
+		link->completed++;
+
+	else if(event->type == MQTT_SESSION_EVENT_COMPLETED)
+		link->completed += event->message_count;
+
+	else if(event->type == MQTT_SESSION_EVENT_CLOSED)
+		link->closed = 1;
+}
+
+
+
+/*
+ * @brief  Waits for notification and dispatches ready session
+ * @param  *link        : link
+ * @param  timeout_ms   : poll timeout, (-1 = no timeout)
+ * @retval None
+ */
+static void benchDispatch(BenchLink *link, int timeout_ms)
+{
+	struct pollfd ready;
+
+	ready.fd     = mqtt_notify_fd(&link->group);
+	ready.events = POLLIN;
+
+	poll(&ready, 1, timeout_ms);
+
+	mqtt_notify_dispatch(&link->group, mqtt_timer_now(), 0);
+}
+
+
+
+/*
+ * @brief  Sorts round trip times
+ * @param  *first  : round trip
+ * @param  *second : round trip
+ * @retval int     : order
+ */
+static int benchCompare(const void *first, const void *second)
+{
+	double a = *(const double*)first;
+	double b = *(const double*)second;
+
+	return (a < b) ? -1 : (a > b);
+}
+
+
+
+/*
+ * @brief  Measures round trip, pipelined rate and CPU of one transport
+ * @param  *address     : port or unix:/path
+ * @param  roundTrips   : single publish round trips
+ * @param  messages     : pipelined qos 1 messages
+ * @param  *profile     : socket profile, NULL = TCP_NODELAY only
+ * @retval int          : 0 = Success, -1 = Error
+ */
+static int benchTransport(const char *address, long roundTrips, long messages, const char *profile)
+{
+	static BenchLink link;
+
+	mqtt_socket_options_t  options;
+	mqtt_session_read_t    readFunction = read;
+	double                *latency      = calloc((size_t)roundTrips, sizeof(double));
+	double                 startTime    = 0;
+	double                 cpuTime      = 0;
+	long                   target       = 0;
+	long                   sent         = 0;
+	long                   index        = 0;
+	int                    queued       = 0;
+	int                    fd           = -1;
+
+	mqtt_socket_options_init(&options);
+
+	if(profile == NULL)
+	{
+		fd = benchConnect(address);
+	}
+	else if(mqtt_socket_profile(&options, profile) < 0)
+	{
+		perror(profile);
+
+		return -1;
+	}
+	else
+	{
+		/* Refused options are reported, run goes on with kernel default of those */
+		fd = benchSocket(address);
+
+		if(fd >= 0 && mqtt_socket_apply(fd, &options) < 0)
+			printf("%s: options refused 0x%02x, (%s)\n", address, options.failed, strerror(errno));
+
+		fd = benchConnectSocket(fd, address);
+	}
+
+	if(fd < 0 || latency == NULL)
+	{
+		perror(address);
+
+		return -1;
+	}
+
+	if(options.quick_ack == 1)
+		readFunction = mqtt_socket_read_quickack;
+
+	memset(&link, 0, sizeof(link));
+
+	mqtt_timer_wheel_init(&link.wheel, mqtt_timer_now());
+	mqtt_inflight_init(&link.inflight);
+	mqtt_notify_init(&link.group);
+
+	mqtt_session_init(&link.session, fd, readFunction, write, link.input, sizeof(link.input), link.output, sizeof(link.output),
+			          &link.inflight, &link.wheel, benchEvent, &link);
+	mqtt_session_batch(&link.session, link.completedIds, LATENCY_BATCH);
+
+	/* Every publish is written at once unless profile sets flush deadline */
+	link.session.output.deadline_us = (options.flush_deadline >= 0) ? (uint32_t)options.flush_deadline : 0;
+
+	mqtt_session_connect(&link.session, "bench", NULL, NULL, 30, MQTT_CLEAN_SESSION, mqtt_timer_now());
+	mqtt_notify_add(&link.group, &link.member, &link.session);
+
+	while(link.session.state != MQTT_SESSION_CONNECTED && !link.closed)
+		benchDispatch(&link, -1);
+
+	/* Single publish round trips */
+	for(index = 0; index < roundTrips && !link.closed; index++)
+	{
+		target    = link.completed + 1;
+		startTime = benchTime();
+
+		mqtt_session_publish(&link.session, "bench/latency", "payload-0123456789", 18, MQTT_QOS_ATLEAST_ONCE,
+				             MQTT_MESSAGE_NO_RETAIN, mqtt_timer_now());
+		mqtt_notify_signal(&link.group);
+
+		while(link.completed < target && !link.closed)
+			benchDispatch(&link, -1);
+
+		latency[index] = benchTime() - startTime;
+	}
+
+	qsort(latency, (size_t)roundTrips, sizeof(double), benchCompare);
+
+	/* Pipelined publish, queued up to send window between dispatches */
+	target    = link.completed + messages;
+	startTime = benchTime();
+	cpuTime   = benchCpuTime();
+
+	while(link.completed < target && !link.closed)
+	{
+		queued = 0;
+
+		while(sent < messages && mqtt_session_publish(&link.session, "bench/rate", "payload-0123456789", 18,
+				                                      MQTT_QOS_ATLEAST_ONCE, MQTT_MESSAGE_NO_RETAIN, mqtt_timer_now()) >= 0)
+		{
+			sent++;
+			queued = 1;
+		}
+
+		if(queued)
+			mqtt_notify_signal(&link.group);
+
+		benchDispatch(&link, -1);
+	}
+
+	startTime = benchTime() - startTime;
+	cpuTime   = benchCpuTime() - cpuTime;
+
+	printf("%-20s %9.1f %9.1f %12.0f %14.2f\n", address, latency[roundTrips / 2] * 1e6, latency[roundTrips * 99 / 100] * 1e6,
+		   (double)messages / startTime, cpuTime * 1e6 / (double)messages);
+
+	mqtt_session_disconnect(&link.session, mqtt_timer_now());
+	mqtt_notify_signal(&link.group);
+
+	while(!link.closed)
+		benchDispatch(&link, 100);
+
+	mqtt_notify_close(&link.group);
+
+	close(fd);
+	free(latency);
+
+	return 0;
+}
+
+
+
+int main(int argc, char **argv)
+{
+	char *profile    = (argc > 5) ? argv[5] : NULL;
+	long  roundTrips = benchArgument(argc, argv, 3, LATENCY_ROUND_TRIPS);
+	long  messages   = benchArgument(argc, argv, 4, LATENCY_MESSAGES);
+
+	if(argc < 3)
+	{
+		printf("Usage : %s <port> <unix:/path> [round trips] [messages] [profile]\n", argv[0]);
+
+		return 1;
+	}
+
+	printf("socket profile: %s\n", (profile != NULL) ? profile : "none, TCP_NODELAY");
+	printf("transport             p50 us    p99 us        msg/s   cpu us / msg\n");
+
+	if(benchTransport(argv[1], roundTrips, messages, profile) < 0 ||
+	   benchTransport(argv[2], roundTrips, messages, profile) < 0)
+		return 1;
+
+	return 0;
+}
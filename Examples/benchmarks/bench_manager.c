@@ -0,0 +1,265 @@
+/**
+ ******************************************************************************
+ * @file    bench_manager.c
+ * @author  Aditya Mall,
+ * @brief   Connection manager benchmark, thousands of sessions on one thread
+ *
+ *  Info
+ *          Only for testing, (POSIX compatible only.)
+ *
+ *          Usage: bin/bench_manager <port | unix:/path> [sessions] [messages] [keepalive]
+ *
+ *          Run bin/broker_stub first, raise open file limit (ulimit -n) above session
+ *          count. Keep alive below 10 seconds also measures PINGREQ rounds.
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall </center></h2>
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+
+/* header files */
+#include <stdio.h>
+#include <string.h>
+#include "mqtt_manager.h"
+#include "bench_utils.h"
+
+
+#define MANAGER_SESSIONS    10000     /* Default sessions                              */
+#define MANAGER_MESSAGES    10        /* Default QoS 1 messages of each session        */
+#define MANAGER_KEEPALIVE   60        /* Default keep alive, seconds                   */
+#define MANAGER_POOL        1024      /* Pooled buffers and in-flight tables           */
+
+
+
+/* Event counts of all sessions */
+typedef struct bench_counts
+{
+	long connected;
+	long completed;
+	long pings;
+	long closed;
+
+}BenchCounts;
+
+
+static BenchCounts benchCounts;
+
+
+
+/*
+ * @brief  Session event callback of managed sessions
+ * @param  *context  : unused
+ * @param  *session  : session
+ * @param  *event    : session event
+ * @retval None
+ */
+static void benchEvent(void *context, mqtt_session_t *session, const mqtt_session_event_t *event)
+{
+	(void)context;
+	(void)session;
+
+	switch(event->type)
+	{
+
+	case MQTT_SESSION_EVENT_CONNECTED:
+		benchCounts.connected++;
+		break;
+
+	case MQTT_SESSION_EVENT_PUBLISHED:
+		benchCounts.completed++;
+		break;
+
+	case MQTT_SESSION_EVENT_COMPLETED:
+		benchCounts.completed += event->message_count;
+		break;
+
+	case MQTT_SESSION_EVENT_PINGRESP:
+		benchCounts.pings++;
+		break;
+
+	case MQTT_SESSION_EVENT_CLOSED:
+		benchCounts.closed++;
+		break;
+
+	default:
+		break;
+
+	}
+}
+
+
+
+/*
+ * @brief  Returns resident set size of process
+ * @param  None
+ * @retval long : kilobytes
+ */
+static long benchResident(void)
+{
+	FILE *status = fopen("/proc/self/status", "r");
+	char  line[256];
+	long  resident = 0;
+
+	if(status == NULL)
+		return 0;
+
+	while(fgets(line, sizeof(line), status) != NULL)
+	{
+		if(strncmp(line, "VmRSS:", 6) == 0)
+			resident = atol(line + 6);
+	}
+
+	fclose(status);
+
+	return resident;
+}
+
+
+
+int main(int argc, char **argv)
+{
+	static mqtt_manager_t manager;
+
+	mqtt_session_t **sessions     = NULL;
+	uint32_t        *sent         = NULL;
+	char             clientId[CLIENT_ID_LENGTH + 1];
+	long             sessionCount = benchArgument(argc, argv, 2, MANAGER_SESSIONS);
+	long             messages     = benchArgument(argc, argv, 3, MANAGER_MESSAGES);
+	long             keepAlive    = benchArgument(argc, argv, 4, MANAGER_KEEPALIVE);
+	long             target       = sessionCount * messages;
+	long             index        = 0;
+	long             disconnected = 0;
+	long             residentBase = 0;
+	long             residentInit = 0;
+	long             residentIdle = 0;
+	double           startTime    = 0;
+	int              fd           = -1;
+
+	if(argc < 2)
+	{
+		printf("Usage : %s <port | unix:/path> [sessions] [messages] [keepalive]\n", argv[0]);
+
+		return 1;
+	}
+
+	sessions = calloc((size_t)sessionCount, sizeof(mqtt_session_t*));
+	sent     = calloc((size_t)sessionCount, sizeof(uint32_t));
+
+	residentBase = benchResident();
+
+	if(sessions == NULL || sent == NULL ||
+	   mqtt_manager_init(&manager, (uint32_t)sessionCount, MANAGER_POOL, MANAGER_POOL, benchEvent) < 0)
+	{
+		perror("manager");
+
+		return 1;
+	}
+
+	residentInit = benchResident();
+
+	/* Sessions connect while earlier ones are serviced */
+	startTime = benchTime();
+
+	for(index = 0; index < sessionCount; index++)
+	{
+		fd = benchConnect(argv[1]);
+
+		if(fd < 0 || (sessions[index] = mqtt_manager_open(&manager, fd, NULL)) == NULL)
+		{
+			perror("connect, (ulimit -n)");
+
+			return 1;
+		}
+
+		snprintf(clientId, sizeof(clientId), "dev-%05ld", index);
+
+		mqtt_session_connect(sessions[index], clientId, NULL, NULL, (uint16_t)keepAlive, MQTT_CLEAN_SESSION, mqtt_timer_now());
+
+		if((index & 255) == 255)
+			mqtt_manager_run(&manager, 0);
+	}
+
+	while(benchCounts.connected < sessionCount)
+		mqtt_manager_run(&manager, -1);
+
+	residentIdle = benchResident();
+
+	printf("connect                 : %ld sessions in %.3f s\n", sessionCount, benchTime() - startTime);
+	printf("slot size               : %zu bytes\n", sizeof(mqtt_manager_slot_t));
+	printf("idle rss incl. pool     : %.0f bytes/session, (init %ld KB, idle %ld KB)\n",
+		   (double)(residentIdle - residentInit) * 1024.0 / (double)sessionCount, residentInit - residentBase, residentIdle - residentBase);
+
+	/* QoS 1 burst, sessions that get no buffer are tried again after next run */
+	startTime = benchTime();
+
+	while(benchCounts.completed < target)
+	{
+		for(index = 0; index < sessionCount; index++)
+		{
+			while(sent[index] < messages && mqtt_manager_lease(&manager, sessions[index], 1) > 0 &&
+				  mqtt_session_publish(sessions[index], "dev/t", "payload-0123456789", 18, MQTT_QOS_ATLEAST_ONCE,
+					                   MQTT_MESSAGE_NO_RETAIN, mqtt_timer_now()) >= 0)
+			{
+				sent[index]++;
+			}
+		}
+
+		mqtt_manager_run(&manager, -1);
+	}
+
+	printf("qos 1 publish           : %ld messages in %.3f s (%.0f msg/s), block peak %u, table peak %u\n", target,
+		   benchTime() - startTime, (double)target / (benchTime() - startTime), manager.block_peak, manager.table_peak);
+
+	while(manager.block_lent > 0 || manager.table_lent > 0)
+		mqtt_manager_run(&manager, 0);
+
+	if(keepAlive < 10)
+	{
+		startTime = benchTime();
+
+		while(benchTime() - startTime < (double)keepAlive * 1.6)
+			mqtt_manager_run(&manager, 1000);
+
+		printf("keep alive %2ld s         : %ld PINGRESP in %.1f s\n", keepAlive, benchCounts.pings, benchTime() - startTime);
+	}
+
+	/* Graceful DISCONNECT, as many as pool buffers allow per run */
+	startTime = benchTime();
+
+	while(manager.session_count > 0)
+	{
+		while(disconnected < sessionCount && mqtt_manager_lease(&manager, sessions[disconnected], 0) > 0)
+		{
+			mqtt_session_disconnect(sessions[disconnected], mqtt_timer_now());
+
+			disconnected++;
+		}
+
+		mqtt_manager_run(&manager, 100);
+	}
+
+	printf("disconnect              : %.3f s, %ld closed\n", benchTime() - startTime, benchCounts.closed);
+
+	mqtt_manager_free(&manager);
+
+	free(sessions);
+	free(sent);
+
+	return 0;
+}
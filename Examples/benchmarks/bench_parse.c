@@ -0,0 +1,144 @@
+/**
+ ******************************************************************************
+ * @file    bench_parse.c
+ * @author  Aditya Mall,
+ * @brief   Received PUBLISH read and parse benchmark
+ *
+ *  Info
+ *          Only for testing, (POSIX compatible only.)
+ *
+ *          Usage: bin/bench_parse [iterations]
+ *
+ *          Sweeps payloads from 16 bytes to 64 KB, every 8th payload byte is NUL.
+ *          Iterations are given for payloads up to 1 KB, larger payloads run fewer
+ *          so every size copies about the same bytes.
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall </center></h2>
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+
+/* header files */
+#include <stdio.h>
+#include <string.h>
+#include "mqtt_client.h"
+#include "bench_utils.h"
+
+
+#define PARSE_ITERATIONS  2000000    /* Default reads of encoded PUBLISH up to 1 KB payload */
+#define PARSE_PAYLOAD_MIN 16         /* Smallest payload of sweep                           */
+#define PARSE_PAYLOAD_MAX 65536      /* Largest payload of sweep                            */
+#define PARSE_NUL_STRIDE  8          /* Every 8th payload byte is NUL                       */
+
+
+
+int main(int argc, char **argv)
+{
+	static uint8_t packetBuffer[MQTT_PUBLISH_HEADER_LENGTH + PARSE_PAYLOAD_MAX];
+	static char    receivedMessage[PARSE_PAYLOAD_MAX];
+	static char    payload[PARSE_PAYLOAD_MAX];
+
+	mqtt_client_t       client;
+	mqtt_decoder_t      decoder;
+	mqtt_packet_t       packet;
+	mqtt_publish_view_t view;
+	mqtt_iovec_t        vector[MQTT_PUBLISH_IOV_COUNT];
+	char                topic[MQTT_TOPIC_LENGTH + 1];
+	uint8_t             messageStatus = 0;
+	size_t              payloadLength = 0;
+	size_t              packetLength  = 0;
+	size_t              total         = 0;
+	long                iterations    = benchArgument(argc, argv, 1, PARSE_ITERATIONS);
+	long                sizeRuns      = 0;
+	long                index         = 0;
+	double              startTime     = 0;
+	double              readTime      = 0;
+	double              parseTime     = 0;
+
+	mqtt_client_init(&client, NULL);
+
+	/* NUL bytes in payload, length comes from Remaining Length field */
+	for(index = 0; index < PARSE_PAYLOAD_MAX; index++)
+		payload[index] = (index % PARSE_NUL_STRIDE == PARSE_NUL_STRIDE - 1) ? '\0' : 'x';
+
+	/* Copying read of client API takes packet from publish structure pointer */
+	client.publish_msg = (mqtt_publish_t*)packetBuffer;
+
+	printf("payload bytes   mqtt_read_publish ns/msg   mqtt_publish_parse ns/msg   iterations\n");
+
+	for(payloadLength = PARSE_PAYLOAD_MIN; payloadLength <= PARSE_PAYLOAD_MAX; payloadLength *= 4)
+	{
+		sizeRuns = (payloadLength > 1024) ? iterations / (long)(payloadLength / 1024) : iterations;
+
+		/* Packet is laid out contiguous, as received, (publish structure holds at most PUBLISH_MESSAGE_LENGTH) */
+		packetLength = mqtt_publish_iov(packetBuffer, MQTT_PUBLISH_HEADER_LENGTH, "tele/cbor", payload, payloadLength,
+				                        MQTT_MESSAGE_NO_RETAIN, MQTT_QOS_FIRE_FORGET, 0, vector);
+		if(packetLength == 0)
+		{
+			printf("%zu byte PUBLISH not encoded\n", payloadLength);
+
+			return 1;
+		}
+
+		memcpy(packetBuffer + vector[0].iov_len, payload, payloadLength);
+
+		if(mqtt_read_publish(&client, topic, receivedMessage, sizeof(receivedMessage), &messageStatus) != payloadLength ||
+		   memcmp(receivedMessage, payload, payloadLength) != 0)
+		{
+			printf("%zu byte PUBLISH not read back\n", payloadLength);
+
+			return 1;
+		}
+
+		startTime = benchTime();
+
+		for(index = 0; index < sizeRuns; index++)
+			total += mqtt_read_publish(&client, topic, receivedMessage, sizeof(receivedMessage), &messageStatus);
+
+		readTime = benchTime() - startTime;
+
+		/* Zero copy view of decoded packet */
+		mqtt_decoder_init(&decoder, packetBuffer, sizeof(packetBuffer));
+		mqtt_decoder_commit(&decoder, packetLength);
+
+		if(mqtt_decoder_next(&decoder, &packet) <= 0)
+		{
+			printf("%zu byte PUBLISH not decoded\n", payloadLength);
+
+			return 1;
+		}
+
+		startTime = benchTime();
+
+		for(index = 0; index < sizeRuns; index++)
+		{
+			if(mqtt_publish_parse(&packet, &view) > 0)
+				total += view.message_length;
+		}
+
+		parseTime = benchTime() - startTime;
+
+		printf("%13zu %26.1f %27.1f %12ld\n", payloadLength, readTime * 1e9 / (double)sizeRuns, parseTime * 1e9 / (double)sizeRuns, sizeRuns);
+	}
+
+	/* Read and parsed length is printed, so the loops are not optimized away */
+	printf("%zu bytes read and parsed\n", total);
+
+	return 0;
+}
@@ -0,0 +1,394 @@
+/**
+ ******************************************************************************
+ * @file    bench_shard.c
+ * @author  Aditya Mall,
+ * @brief   Sharded runtime benchmark, scaling from 1 to 16 shards
+ *
+ *  Info
+ *          Only for testing, (POSIX compatible only.)
+ *
+ *          Usage: bin/bench_shard <port | unix:/path> [max shards] [sessions] [messages] [producers]
+ *
+ *          Runs 1, 2, 4 .. max shards (default 16), shards are pinned from CPU 0 and wrap
+ *          around online CPUs. Every run starts its own broker_stub (from directory of
+ *          bench_shard) on the address with one worker thread per shard, stub workers
+ *          are pinned from the last CPU downwards. Raise open file limit (ulimit -n)
+ *          above session count. Scaling is only meaningful with at least 2 * max
+ *          shards + producers CPUs.
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall </center></h2>
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+
+/* header files */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <signal.h>
+#include <spawn.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include "mqtt_shard.h"
+#include "bench_utils.h"
+
+
+#define SHARD_BENCH_SHARDS     16        /* Default most shards                           */
+#define SHARD_BENCH_SESSIONS   10000     /* Default sessions                              */
+#define SHARD_BENCH_MESSAGES   5         /* Default QoS 1 messages of each session        */
+#define SHARD_BENCH_PRODUCERS  4         /* Default publishing threads                    */
+#define SHARD_BENCH_THREADS    32        /* Most publishing threads                       */
+#define SHARD_BENCH_POOL       1024      /* Pooled buffers and in-flight tables of shard  */
+#define SHARD_BENCH_STUB_WAIT  5.0       /* Seconds until started broker stub listens     */
+#define SHARD_BENCH_PATH       4096      /* Path of broker stub                           */
+
+
+
+/* Run of benchmark, counters are written by shard threads */
+typedef struct bench_run
+{
+	mqtt_shards_t shards;
+	long          sessions;
+	long          messages;
+	long          producers;
+	long          connected;
+	long          completed;
+	long          closed;
+	long          retries;
+
+}BenchRun;
+
+
+/* Publishing thread */
+typedef struct bench_producer
+{
+	BenchRun  *run;
+	pthread_t  thread;
+	long       first;
+
+}BenchProducer;
+
+
+static BenchRun benchRun;
+static char     benchStubPath[SHARD_BENCH_PATH];
+
+
+extern char **environ;
+
+
+
+/*
+ * @brief  Session event callback, called on shard threads
+ * @param  *context  : unused
+ * @param  *session  : session
+ * @param  *event    : session event
+ * @retval None
+ */
+static void benchEvent(void *context, mqtt_session_t *session, const mqtt_session_event_t *event)
+{
+	(void)context;
+	(void)session;
+
+	switch(event->type)
+	{
+
+	case MQTT_SESSION_EVENT_CONNECTED:
+		__atomic_fetch_add(&benchRun.connected, 1, __ATOMIC_RELAXED);
+		break;
+
+	case MQTT_SESSION_EVENT_PUBLISHED:
+		__atomic_fetch_add(&benchRun.completed, 1, __ATOMIC_RELAXED);
+		break;
+
+	case MQTT_SESSION_EVENT_COMPLETED:
+		__atomic_fetch_add(&benchRun.completed, (long)event->message_count, __ATOMIC_RELAXED);
+		break;
+
+	case MQTT_SESSION_EVENT_CLOSED:
+		__atomic_fetch_add(&benchRun.closed, 1, __ATOMIC_RELAXED);
+		break;
+
+	default:
+		break;
+
+	}
+}
+
+
+
+/*
+ * @brief  Waits until counter written by shard threads reaches target
+ * @param  *counter : counter
+ * @param  target   : target
+ * @retval None
+ */
+static void benchWait(long *counter, long target)
+{
+	while(__atomic_load_n(counter, __ATOMIC_RELAXED) < target)
+		usleep(100);
+}
+
+
+
+/*
+ * @brief  Publishing thread, publishes on every producer count'th session, retries full ring
+ * @param  *argument : producer (BenchProducer)
+ * @retval void*     : NULL
+ */
+static void *benchPublish(void *argument)
+{
+	BenchProducer *producer = (BenchProducer*)argument;
+	BenchRun      *run      = producer->run;
+	char           clientId[CLIENT_ID_LENGTH + 1];
+	long           message  = 0;
+	long           index    = 0;
+	int            ring     = mqtt_shard_producer(&run->shards);
+
+	if(ring < 0)
+	{
+		perror("producer");
+
+		return NULL;
+	}
+
+	for(message = 0; message < run->messages; message++)
+	{
+		for(index = producer->first; index < run->sessions; index += run->producers)
+		{
+			snprintf(clientId, sizeof(clientId), "dev-%05u", (unsigned)index);
+
+			while(mqtt_shard_publish(&run->shards, ring, clientId, "dev/t", "payload-0123456789", 18,
+					                 MQTT_QOS_ATLEAST_ONCE, MQTT_MESSAGE_NO_RETAIN) < 0)
+			{
+				if(errno != EAGAIN)
+				{
+					perror("publish");
+
+					return NULL;
+				}
+
+				__atomic_fetch_add(&run->retries, 1, __ATOMIC_RELAXED);
+
+				sched_yield();
+			}
+		}
+	}
+
+	return NULL;
+}
+
+
+
+/*
+ * @brief  Starts broker stub of one run, stub exits once all sessions are closed again
+ * @param  *address    : broker stub address
+ * @param  sessions    : connections of run
+ * @param  threads     : worker threads of stub
+ * @param  *fd         : first connection to started stub
+ * @retval pid_t       : stub process, -1 = Error
+ */
+static pid_t benchStubStart(const char *address, long sessions, uint16_t threads, int *fd)
+{
+	char   limit[24];
+	char   workers[24];
+	char  *arguments[] = {benchStubPath, (char*)address, limit, workers, NULL};
+	double startTime   = benchTime();
+	pid_t  stub        = -1;
+	int    retval      = 0;
+
+	snprintf(limit, sizeof(limit), "%ld", sessions);
+	snprintf(workers, sizeof(workers), "%u", threads);
+
+	retval = posix_spawn(&stub, benchStubPath, NULL, NULL, arguments, environ);
+	if(retval != 0)
+	{
+		errno = retval;
+
+		return -1;
+	}
+
+	/* Stub is ready once it accepts, first connection is kept as first session */
+	while((*fd = benchConnect(address)) < 0 && (errno == ECONNREFUSED || errno == ENOENT) &&
+		  benchTime() - startTime < SHARD_BENCH_STUB_WAIT)
+		usleep(1000);
+
+	if(*fd < 0)
+	{
+		kill(stub, SIGTERM);
+		waitpid(stub, NULL, 0);
+
+		return -1;
+	}
+
+	return stub;
+}
+
+
+
+/*
+ * @brief  Runs connect, publish and disconnect on given number of shards
+ * @param  *address    : broker stub address
+ * @param  shardCount  : number of shards
+ * @retval int         : 0 = Success, -1 = Error
+ */
+static int benchShards(const char *address, uint16_t shardCount)
+{
+	static BenchProducer producers[SHARD_BENCH_THREADS];
+
+	BenchRun *run          = &benchRun;
+	char      clientId[CLIENT_ID_LENGTH + 1];
+	long      target       = run->sessions * run->messages;
+	long      index        = 0;
+	double    startTime    = 0;
+	double    connectTime  = 0;
+	double    publishTime  = 0;
+	double    cpuTime      = 0;
+	int       ring         = -1;
+	int       fd           = -1;
+	pid_t     stub         = -1;
+
+	run->connected = 0;
+	run->completed = 0;
+	run->closed    = 0;
+	run->retries   = 0;
+
+	/* Every shard can hold all sessions, hash of client ID is not perfectly even */
+	if(mqtt_shard_init(&run->shards, shardCount, (uint32_t)run->sessions, SHARD_BENCH_POOL, SHARD_BENCH_POOL, benchEvent) < 0 ||
+	   mqtt_shard_start(&run->shards, 0) < 0 || (ring = mqtt_shard_producer(&run->shards)) < 0)
+	{
+		perror("shards");
+
+		return -1;
+	}
+
+	stub = benchStubStart(address, run->sessions, shardCount, &fd);
+	if(stub < 0)
+	{
+		perror(benchStubPath);
+
+		return -1;
+	}
+
+	startTime = benchTime();
+
+	for(index = 0; index < run->sessions; index++)
+	{
+		if(index > 0)
+			fd = benchConnect(address);
+
+		if(fd < 0)
+		{
+			perror("connect, (ulimit -n)");
+
+			kill(stub, SIGTERM);
+
+			return -1;
+		}
+
+		snprintf(clientId, sizeof(clientId), "dev-%05u", (unsigned)index);
+
+		while(mqtt_shard_open(&run->shards, ring, clientId, fd, 60, NULL) < 0)
+			sched_yield();
+	}
+
+	benchWait(&run->connected, run->sessions);
+
+	connectTime = benchTime() - startTime;
+
+	startTime = benchTime();
+	cpuTime   = benchCpuTime();
+
+	for(index = 0; index < run->producers; index++)
+	{
+		producers[index].run   = run;
+		producers[index].first = index;
+
+		pthread_create(&producers[index].thread, NULL, benchPublish, &producers[index]);
+	}
+
+	for(index = 0; index < run->producers; index++)
+		pthread_join(producers[index].thread, NULL);
+
+	benchWait(&run->completed, target);
+
+	publishTime = benchTime() - startTime;
+	cpuTime     = benchCpuTime() - cpuTime;
+
+	for(index = 0; index < run->sessions; index++)
+	{
+		snprintf(clientId, sizeof(clientId), "dev-%05u", (unsigned)index);
+
+		while(mqtt_shard_disconnect(&run->shards, ring, clientId) < 0)
+			sched_yield();
+	}
+
+	benchWait(&run->closed, run->sessions);
+
+	waitpid(stub, NULL, 0);
+
+	printf("%6u %11.3f %12.0f %14.2f %12ld\n", shardCount, connectTime, (double)target / publishTime,
+		   cpuTime * 1e6 / (double)target, run->retries);
+
+	mqtt_shard_stop(&run->shards);
+	mqtt_shard_free(&run->shards);
+
+	return 0;
+}
+
+
+
+int main(int argc, char **argv)
+{
+	long  shardMax   = benchArgument(argc, argv, 2, SHARD_BENCH_SHARDS);
+	long  shardCount = 0;
+	char *directory  = NULL;
+
+	if(argc < 2)
+	{
+		printf("Usage : %s <port | unix:/path> [max shards] [sessions] [messages] [producers]\n", argv[0]);
+
+		return 1;
+	}
+
+	/* Broker stub is built next to bench_shard */
+	directory = strrchr(argv[0], '/');
+
+	snprintf(benchStubPath, sizeof(benchStubPath), "%.*sbroker_stub", (directory != NULL) ? (int)(directory - argv[0] + 1) : 0, argv[0]);
+
+	benchRun.sessions  = benchArgument(argc, argv, 3, SHARD_BENCH_SESSIONS);
+	benchRun.messages  = benchArgument(argc, argv, 4, SHARD_BENCH_MESSAGES);
+	benchRun.producers = benchArgument(argc, argv, 5, SHARD_BENCH_PRODUCERS);
+
+	if(benchRun.producers > SHARD_BENCH_THREADS)
+		benchRun.producers = SHARD_BENCH_THREADS;
+
+	printf("%ld online CPUs, %ld sessions, %ld qos 1 messages each, %ld producers\n", sysconf(_SC_NPROCESSORS_ONLN),
+		   benchRun.sessions, benchRun.messages, benchRun.producers);
+	printf("shards   connect s        msg/s   cpu us / msg   ring full\n");
+
+	for(shardCount = 1; shardCount <= shardMax; shardCount *= 2)
+	{
+		if(benchShards(argv[1], (uint16_t)shardCount) < 0)
+			return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,412 @@
+/**
+ ******************************************************************************
+ * @file    bench_uring.c
+ * @author  Aditya Mall,
+ * @brief   io_uring transport benchmark, compared with read/write and epoll
+ *
+ *  Info
+ *          Only for testing, (POSIX compatible only, Linux 6.0 or later for io_uring.)
+ *
+ *          Usage: bin/bench_uring [connections] [rounds]
+ *
+ *          Every round sends one 32 byte QoS 1 PUBLISH on each loopback connection, the
+ *          peer side answers each with a PUBACK from plain blocking read and write calls.
+ *          System calls of the client side are counted per message.
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall </center></h2>
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+
+/* header files */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "mqtt_uring.h"
+#include "bench_utils.h"
+
+
+#define URING_CONNECTIONS  512       /* Default loopback connections              */
+#define URING_ROUNDS       200       /* Default rounds, one PUBLISH per connection */
+#define URING_MAX_CONNS    4096      /* Most loopback connections                 */
+#define URING_PUBLISH_SIZE 32        /* Size of sent PUBLISH                      */
+#define URING_PUBACK_SIZE  4         /* Size of received PUBACK                   */
+#define URING_SEND_TAG     (1U << 31) /* User data of send operations             */
+
+
+
+/* Loopback connections of benchmark */
+typedef struct bench_links
+{
+	int     clients[URING_MAX_CONNS];
+	int     servers[URING_MAX_CONNS];
+	int     count;
+	uint8_t publish[URING_PUBLISH_SIZE];
+
+}BenchLinks;
+
+
+
+/*
+ * @brief  Opens loopback TCP connection pairs, (TCP_NODELAY on both ends)
+ * @param  *links  : connections
+ * @retval int     : 0 = Success, -1 = Error
+ */
+static int benchOpen(BenchLinks *links)
+{
+	struct sockaddr_in address;
+	socklen_t          addressLength = sizeof(address);
+	int                listenFd      = -1;
+	int                option        = 1;
+	int                index         = 0;
+
+	memset(&address, 0, sizeof(address));
+
+	address.sin_family      = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	listenFd = socket(AF_INET, SOCK_STREAM, 0);
+
+	if(listenFd < 0 || bind(listenFd, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+	   listen(listenFd, URING_MAX_CONNS) < 0 || getsockname(listenFd, (struct sockaddr*)&address, &addressLength) < 0)
+	{
+		return -1;
+	}
+
+	for(index = 0; index < links->count; index++)
+	{
+		links->clients[index] = socket(AF_INET, SOCK_STREAM, 0);
+
+		if(links->clients[index] < 0 || connect(links->clients[index], (struct sockaddr*)&address, sizeof(address)) < 0)
+			return -1;
+
+		links->servers[index] = accept(listenFd, NULL, NULL);
+		if(links->servers[index] < 0)
+			return -1;
+
+		setsockopt(links->clients[index], IPPROTO_TCP, TCP_NODELAY, &option, sizeof(option));
+		setsockopt(links->servers[index], IPPROTO_TCP, TCP_NODELAY, &option, sizeof(option));
+	}
+
+	close(listenFd);
+
+	/* QoS 1 PUBLISH, remaining length 30 */
+	memset(links->publish, 'x', sizeof(links->publish));
+
+	links->publish[0] = 0x32;
+	links->publish[1] = URING_PUBLISH_SIZE - 2;
+
+	return 0;
+}
+
+
+
+/*
+ * @brief  Peer side of one round, reads PUBLISH and answers PUBACK on every connection
+ * @param  *links  : connections
+ * @retval None
+ */
+static void benchPeer(BenchLinks *links)
+{
+	static const uint8_t puback[URING_PUBACK_SIZE] = {0x40, 0x02, 0x00, 0x01};
+
+	uint8_t buffer[URING_PUBLISH_SIZE];
+	ssize_t received = 0;
+	size_t  length   = 0;
+	int     index    = 0;
+
+	for(index = 0; index < links->count; index++)
+	{
+		for(length = 0; length < sizeof(buffer); length += (received > 0) ? (size_t)received : 0)
+			received = read(links->servers[index], buffer, sizeof(buffer) - length);
+
+		if(write(links->servers[index], puback, sizeof(puback)) < 0)
+			return;
+	}
+}
+
+
+
+/*
+ * @brief  Prints result of one transport
+ * @param  *name       : transport name
+ * @param  *links      : connections
+ * @param  rounds      : rounds run
+ * @param  elapsed     : seconds
+ * @param  syscalls    : client side system calls
+ * @retval None
+ */
+static void benchReport(const char *name, BenchLinks *links, long rounds, double elapsed, long syscalls)
+{
+	double messages = (double)links->count * (double)rounds;
+
+	printf("%-19s: %8.0f msg/s  %.2f client syscalls/msg\n", name, messages / elapsed, (double)syscalls / messages);
+}
+
+
+
+/*
+ * @brief  Blocking read and write on every connection
+ * @param  *links   : connections
+ * @param  rounds   : rounds
+ * @retval None
+ */
+static void benchPlain(BenchLinks *links, long rounds)
+{
+	uint8_t buffer[URING_PUBACK_SIZE];
+	ssize_t received  = 0;
+	size_t  length    = 0;
+	long    syscalls  = 0;
+	long    round     = 0;
+	int     index     = 0;
+	double  startTime = benchTime();
+
+	for(round = 0; round < rounds; round++)
+	{
+		for(index = 0; index < links->count; index++, syscalls++)
+		{
+			if(write(links->clients[index], links->publish, sizeof(links->publish)) < 0)
+				return;
+		}
+
+		benchPeer(links);
+
+		for(index = 0; index < links->count; index++)
+		{
+			for(length = 0; length < sizeof(buffer); length += (received > 0) ? (size_t)received : 0, syscalls++)
+				received = read(links->clients[index], buffer, sizeof(buffer) - length);
+		}
+	}
+
+	benchReport("plain read/write", links, rounds, benchTime() - startTime, syscalls);
+}
+
+
+
+/*
+ * @brief  Writes on every connection, acknowledgments are read when epoll reports them
+ * @param  *links   : connections
+ * @param  rounds   : rounds
+ * @retval None
+ */
+static void benchEpoll(BenchLinks *links, long rounds)
+{
+	static struct epoll_event events[URING_MAX_CONNS];
+
+	struct epoll_event event;
+	uint8_t            buffer[64];
+	ssize_t            received  = 0;
+	long               syscalls  = 0;
+	long               round     = 0;
+	long               pending   = 0;
+	int                epollFd   = epoll_create1(0);
+	int                ready     = 0;
+	int                index     = 0;
+	double             startTime = 0;
+
+	for(index = 0; index < links->count; index++)
+	{
+		fcntl(links->clients[index], F_SETFL, O_NONBLOCK);
+
+		event.events   = EPOLLIN;
+		event.data.u32 = (uint32_t)index;
+
+		epoll_ctl(epollFd, EPOLL_CTL_ADD, links->clients[index], &event);
+	}
+
+	startTime = benchTime();
+
+	for(round = 0; round < rounds; round++)
+	{
+		for(index = 0; index < links->count; index++, syscalls++)
+		{
+			if(write(links->clients[index], links->publish, sizeof(links->publish)) < 0)
+				return;
+		}
+
+		benchPeer(links);
+
+		for(pending = links->count; pending > 0; syscalls++)
+		{
+			ready = epoll_wait(epollFd, events, links->count, -1);
+
+			for(index = 0; index < ready; index++, syscalls++)
+			{
+				received = read(links->clients[events[index].data.u32], buffer, sizeof(buffer));
+
+				if(received > 0)
+					pending -= received / URING_PUBACK_SIZE;
+			}
+		}
+	}
+
+	benchReport("epoll + read/write", links, rounds, benchTime() - startTime, syscalls);
+
+	close(epollFd);
+}
+
+
+
+/*
+ * @brief  Handles completion of io_uring transport, rearms finished multishot receive
+ * @param  *ring        : io_uring instance
+ * @param  *files       : registered file indices
+ * @param  *completion  : completion
+ * @retval long         : PUBACKs received
+ */
+static long benchComplete(mqtt_uring_t *ring, int *files, mqtt_uring_completion_t *completion)
+{
+	long received = 0;
+
+	if(completion->user_data & URING_SEND_TAG)
+		return 0;
+
+	if(completion->result > 0)
+	{
+		received = completion->result / URING_PUBACK_SIZE;
+
+		mqtt_uring_buffer_release(ring, completion->buffer_id);
+	}
+
+	if(!completion->more)
+	{
+		while(mqtt_uring_recv(ring, files[completion->user_data], completion->user_data) < 0)
+			mqtt_uring_submit(ring, 0, 0);
+	}
+
+	return received;
+}
+
+
+
+/*
+ * @brief  Sends are queued on every connection and submitted with one system call,
+ *         acknowledgments arrive through multishot receive
+ * @param  *links   : connections
+ * @param  rounds   : rounds
+ * @retval None
+ */
+static void benchUring(BenchLinks *links, long rounds)
+{
+	static mqtt_uring_t ring;
+	static int          files[URING_MAX_CONNS];
+
+	mqtt_uring_completion_t completion;
+	uint64_t                enterCalls = 0;
+	long                    round      = 0;
+	long                    pending    = 0;
+	int                     index      = 0;
+	double                  startTime  = 0;
+
+	if(mqtt_uring_init(&ring) < 0)
+	{
+		perror("io_uring");
+
+		return;
+	}
+
+	for(index = 0; index < links->count; index++)
+	{
+		files[index] = mqtt_uring_register_fd(&ring, links->clients[index]);
+
+		while(mqtt_uring_recv(&ring, files[index], (uint64_t)index) < 0)
+			mqtt_uring_submit(&ring, 0, 0);
+	}
+
+	mqtt_uring_submit(&ring, 0, 0);
+
+	enterCalls = ring.enter_calls;
+	startTime  = benchTime();
+
+	for(round = 0; round < rounds; round++)
+	{
+		pending = links->count;
+
+		for(index = 0; index < links->count; index++)
+		{
+			/* Full submission queue is submitted, completions seen meanwhile are counted */
+			while(mqtt_uring_send(&ring, files[index], links->publish, sizeof(links->publish), URING_SEND_TAG | (uint64_t)index) < 0)
+			{
+				mqtt_uring_submit(&ring, 0, 0);
+
+				while(mqtt_uring_complete(&ring, &completion) > 0)
+					pending -= benchComplete(&ring, files, &completion);
+			}
+		}
+
+		mqtt_uring_submit(&ring, 0, 0);
+
+		benchPeer(links);
+
+		while(pending > 0)
+		{
+			if(mqtt_uring_submit(&ring, 1, 2000) < 0 && errno == ETIME)
+			{
+				printf("io_uring           : PUBACK missing in round %ld\n", round);
+
+				mqtt_uring_close(&ring);
+
+				return;
+			}
+
+			while(mqtt_uring_complete(&ring, &completion) > 0)
+				pending -= benchComplete(&ring, files, &completion);
+		}
+	}
+
+	benchReport("io_uring", links, rounds, benchTime() - startTime, (long)(ring.enter_calls - enterCalls));
+
+	mqtt_uring_close(&ring);
+}
+
+
+
+int main(int argc, char **argv)
+{
+	static BenchLinks links;
+
+	long rounds = benchArgument(argc, argv, 2, URING_ROUNDS);
+
+	links.count = (int)benchArgument(argc, argv, 1, URING_CONNECTIONS);
+
+	if(links.count > URING_MAX_CONNS)
+		links.count = URING_MAX_CONNS;
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	if(benchOpen(&links) < 0)
+	{
+		perror("loopback connections");
+
+		return 1;
+	}
+
+	benchPlain(&links, rounds);
+	benchEpoll(&links, rounds);
+	benchUring(&links, rounds);
+
+	return 0;
+}
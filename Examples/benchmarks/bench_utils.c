@@ -0,0 +1,178 @@
+/**
+ ******************************************************************************
+ * @file    bench_utils.c
+ * @author  Aditya Mall,
+ * @brief   Benchmark helper functions
+ *
+ *  Info
+ *          Only for testing, (POSIX compatible only.)
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall </center></h2>
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+
+/* header files */
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "bench_utils.h"
+
+
+
+/*
+ * @brief  Returns monotonic time
+ * @param  None
+ * @retval double : seconds
+ */
+double benchTime(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+
+
+/*
+ * @brief  Returns user and system CPU time of process
+ * @param  None
+ * @retval double : seconds
+ */
+double benchCpuTime(void)
+{
+	struct rusage usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+
+	return (double)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+		   (double)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+
+
+/*
+ * @brief  Reads count argument, default is used when argument is missing or not positive
+ * @param  argc          : argument count of main
+ * @param  **argv        : arguments of main
+ * @param  index         : index of argument
+ * @param  defaultValue  : value of missing argument
+ * @retval long          : count
+ */
+long benchArgument(int argc, char **argv, int index, long defaultValue)
+{
+	long value = 0;
+
+	if(index < argc)
+		value = atol(argv[index]);
+
+	return (value > 0) ? value : defaultValue;
+}
+
+
+
+/*
+ * @brief  Creates unconnected socket of address family, options can be set before connect
+ * @param  *address : port on 127.0.0.1, or unix:/path
+ * @retval int      : socket descriptor, -1 = Error (errno is set)
+ */
+int benchSocket(const char *address)
+{
+	if(strncmp(address, "unix:", 5) == 0)
+		return socket(AF_UNIX, SOCK_STREAM, 0);
+
+	return socket(AF_INET, SOCK_STREAM, 0);
+}
+
+
+
+/*
+ * @brief  Connects socket created by benchSocket(), socket is non blocking once connected
+ * @param  fd       : socket descriptor, closed on error
+ * @param  *address : port on 127.0.0.1, or unix:/path
+ * @retval int      : socket descriptor, -1 = Error (errno is set)
+ */
+int benchConnectSocket(int fd, const char *address)
+{
+	struct sockaddr_un unixAddress;
+	struct sockaddr_in inetAddress;
+	int                retval = -1;
+
+	if(fd < 0)
+		return -1;
+
+	if(strncmp(address, "unix:", 5) == 0)
+	{
+		memset(&unixAddress, 0, sizeof(unixAddress));
+
+		unixAddress.sun_family = AF_UNIX;
+
+		strncpy(unixAddress.sun_path, address + 5, sizeof(unixAddress.sun_path) - 1);
+
+		retval = connect(fd, (struct sockaddr*)&unixAddress, sizeof(unixAddress));
+	}
+	else
+	{
+		memset(&inetAddress, 0, sizeof(inetAddress));
+
+		inetAddress.sin_family      = AF_INET;
+		inetAddress.sin_port        = htons((uint16_t)atoi(address));
+		inetAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		retval = connect(fd, (struct sockaddr*)&inetAddress, sizeof(inetAddress));
+	}
+
+	if(retval < 0)
+	{
+		close(fd);
+
+		return -1;
+	}
+
+	fcntl(fd, F_SETFL, O_NONBLOCK);
+
+	return fd;
+}
+
+
+
+/*
+ * @brief  Connects to broker stub, (TCP_NODELAY on TCP), socket is non blocking once connected
+ * @param  *address : port on 127.0.0.1, or unix:/path
+ * @retval int      : socket descriptor, -1 = Error (errno is set)
+ */
+int benchConnect(const char *address)
+{
+	int fd     = benchConnectSocket(benchSocket(address), address);
+	int option = 1;
+
+	if(fd >= 0 && strncmp(address, "unix:", 5) != 0)
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &option, sizeof(option));
+
+	return fd;
+}
@@ -0,0 +1,107 @@
+/**
+ ******************************************************************************
+ * @file    bench_utils.h
+ * @author  Aditya Mall,
+ * @brief   Benchmark helper header file
+ *
+ *  Info
+ *          Only for testing, (POSIX compatible only.)
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall </center></h2>
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+#ifndef BENCH_UTILS_H_
+#define BENCH_UTILS_H_
+
+
+
+/* header files */
+#include <stdint.h>
+#include <stdlib.h>
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                           Function Prototypes                              */
+/*                                                                            */
+/******************************************************************************/
+
+
+/*
+ * @brief  Returns monotonic time
+ * @param  None
+ * @retval double : seconds
+ */
+double benchTime(void);
+
+
+
+/*
+ * @brief  Returns user and system CPU time of process
+ * @param  None
+ * @retval double : seconds
+ */
+double benchCpuTime(void);
+
+
+
+/*
+ * @brief  Reads count argument, default is used when argument is missing or not positive
+ * @param  argc          : argument count of main
+ * @param  **argv        : arguments of main
+ * @param  index         : index of argument
+ * @param  defaultValue  : value of missing argument
+ * @retval long          : count
+ */
+long benchArgument(int argc, char **argv, int index, long defaultValue);
+
+
+
+/*
+ * @brief  Creates unconnected socket of address family, options can be set before connect
+ * @param  *address : port on 127.0.0.1, or unix:/path
+ * @retval int      : socket descriptor, -1 = Error (errno is set)
+ */
+int benchSocket(const char *address);
+
+
+
+/*
+ * @brief  Connects socket created by benchSocket(), socket is non blocking once connected
+ * @param  fd       : socket descriptor, closed on error
+ * @param  *address : port on 127.0.0.1, or unix:/path
+ * @retval int      : socket descriptor, -1 = Error (errno is set)
+ */
+int benchConnectSocket(int fd, const char *address);
+
+
+
+/*
+ * @brief  Connects to broker stub, (TCP_NODELAY on TCP), socket is non blocking once connected
+ * @param  *address : port on 127.0.0.1, or unix:/path
+ * @retval int      : socket descriptor, -1 = Error (errno is set)
+ */
+int benchConnect(const char *address);
+
+
+
+
+#endif /* BENCH_UTILS_H_ */
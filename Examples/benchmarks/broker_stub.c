@@ -0,0 +1,448 @@
+/**
+ ******************************************************************************
+ * @file    broker_stub.c
+ * @author  Aditya Mall,
+ * @brief   Minimal epoll broker for client benchmarks
+ *
+ *  Info
+ *          Only for testing, (POSIX compatible only.)
+ *
+ *          Usage: bin/broker_stub <port | unix:/path> [connections] [threads]
+ *
+ *          Answers CONNECT with CONNACK, PUBLISH with PUBACK or PUBREC, PUBREL with
+ *          PUBCOMP, SUBSCRIBE with SUBACK and PINGREQ with PINGRESP, messages are
+ *          not routed. Listens on 127.0.0.1, exits once given number of connections
+ *          were accepted and closed again (0 = never).
+ *
+ *          Every worker thread (default 1) runs its own epoll loop and is pinned from
+ *          the last online CPU downwards, away from shards pinned from CPU 0. TCP
+ *          workers have their own SO_REUSEPORT listener, unix socket workers share
+ *          one listener registered with EPOLLEXCLUSIVE.
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall </center></h2>
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+
+/* header files */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+
+#define STUB_BUFFER_SIZE  8192      /* Input and reply buffer of one connection */
+#define STUB_EVENTS       256       /* Events handled per epoll_wait            */
+#define STUB_BACKLOG      8192      /* Listen backlog, sessions connect at once  */
+#define STUB_THREADS      64        /* Most worker threads                      */
+
+
+
+/* Connection of stub broker */
+typedef struct stub_connection
+{
+	int     fd;
+	size_t  length;
+	uint8_t input[STUB_BUFFER_SIZE];
+
+}StubConnection;
+
+
+/* Worker thread of stub broker */
+typedef struct stub_worker
+{
+	pthread_t  thread;
+	int        listenFd;
+	int        epollFd;
+	int        cpu;
+
+}StubWorker;
+
+
+/* Connection counts of all workers */
+static long stubLimit;
+static long stubOpen;
+static long stubTotal;
+
+
+
+/*
+ * @brief  Writes replies, (stub replies are small, short write is not retried)
+ * @param  fd      : connection
+ * @param  *reply  : reply packets
+ * @param  length  : length of replies
+ * @retval None
+ */
+static void stubReply(int fd, const uint8_t *reply, size_t length)
+{
+	if(length > 0 && write(fd, reply, length) < 0)
+		return;
+}
+
+
+
+/*
+ * @brief  Answers complete packets of connection, partial packet is kept for next read
+ * @param  *connection : connection
+ * @retval None
+ */
+static void stubHandle(StubConnection *connection)
+{
+	uint8_t  reply[STUB_BUFFER_SIZE];
+	uint8_t *body         = NULL;
+	size_t   replyLength  = 0;
+	size_t   offset       = 0;
+	size_t   remaining    = 0;
+	size_t   multiplier   = 0;
+	size_t   headerLength = 0;
+	size_t   topicLength  = 0;
+	int      complete     = 0;
+	int      qos          = 0;
+
+	while(connection->length - offset >= 2)
+	{
+		/* Remaining Length, 1 to 4 bytes */
+		remaining  = 0;
+		multiplier = 1;
+		complete   = 0;
+
+		for(headerLength = 1; headerLength < 5 && offset + headerLength < connection->length; headerLength++)
+		{
+			remaining  += (connection->input[offset + headerLength] & 127) * multiplier;
+			multiplier *= 128;
+
+			if(!(connection->input[offset + headerLength] & 128))
+			{
+				complete = 1;
+
+				break;
+			}
+		}
+
+		if(!complete || connection->length - offset < headerLength + 1 + remaining)
+			break;
+
+		if(replyLength > sizeof(reply) - 8)
+		{
+			stubReply(connection->fd, reply, replyLength);
+
+			replyLength = 0;
+		}
+
+		body = connection->input + offset + headerLength + 1;
+
+		switch(connection->input[offset] >> 4)
+		{
+
+		case 1:
+
+			/* CONNECT, CONNACK accepted */
+			memcpy(reply + replyLength, "\x20\x02\x00\x00", 4);
+			replyLength += 4;
+
+			break;
+
+		case 3:
+
+			/* PUBLISH, qos 1 PUBACK, qos 2 PUBREC */
+			qos         = (connection->input[offset] >> 1) & 3;
+			topicLength = (size_t)body[0] << 8 | body[1];
+
+			if(qos > 0)
+			{
+				reply[replyLength++] = (qos == 1) ? 0x40 : 0x50;
+				reply[replyLength++] = 2;
+				reply[replyLength++] = body[2 + topicLength];
+				reply[replyLength++] = body[3 + topicLength];
+			}
+
+			break;
+
+		case 6:
+
+			/* PUBREL, PUBCOMP */
+			reply[replyLength++] = 0x70;
+			reply[replyLength++] = 2;
+			reply[replyLength++] = body[0];
+			reply[replyLength++] = body[1];
+
+			break;
+
+		case 8:
+
+			/* SUBSCRIBE, SUBACK of one topic */
+			reply[replyLength++] = 0x90;
+			reply[replyLength++] = 3;
+			reply[replyLength++] = body[0];
+			reply[replyLength++] = body[1];
+			reply[replyLength++] = 0;
+
+			break;
+
+		case 12:
+
+			/* PINGREQ, PINGRESP */
+			reply[replyLength++] = 0xD0;
+			reply[replyLength++] = 0;
+
+			break;
+
+		default:
+
+			break;
+
+		}
+
+		offset += headerLength + 1 + remaining;
+	}
+
+	stubReply(connection->fd, reply, replyLength);
+
+	memmove(connection->input, connection->input + offset, connection->length - offset);
+
+	connection->length -= offset;
+}
+
+
+
+/*
+ * @brief  Opens listening socket of stub
+ * @param  *address  : port or unix:/path
+ * @param  reusePort : 1 = TCP listener shares port with listeners of other workers
+ * @retval int       : listening socket, -1 = Error
+ */
+static int stubListen(const char *address, int reusePort)
+{
+	struct sockaddr_un unixAddress;
+	struct sockaddr_in inetAddress;
+	int                listenFd = -1;
+	int                option   = 1;
+
+	if(strncmp(address, "unix:", 5) == 0)
+	{
+		memset(&unixAddress, 0, sizeof(unixAddress));
+
+		unixAddress.sun_family = AF_UNIX;
+
+		strncpy(unixAddress.sun_path, address + 5, sizeof(unixAddress.sun_path) - 1);
+
+		unlink(unixAddress.sun_path);
+
+		listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+		if(listenFd < 0 || bind(listenFd, (struct sockaddr*)&unixAddress, sizeof(unixAddress)) < 0)
+			return -1;
+	}
+	else
+	{
+		memset(&inetAddress, 0, sizeof(inetAddress));
+
+		inetAddress.sin_family      = AF_INET;
+		inetAddress.sin_port        = htons((uint16_t)atoi(address));
+		inetAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		listenFd = socket(AF_INET, SOCK_STREAM, 0);
+		if(listenFd < 0)
+			return -1;
+
+		setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option));
+
+		if(reusePort && setsockopt(listenFd, SOL_SOCKET, SO_REUSEPORT, &option, sizeof(option)) < 0)
+			return -1;
+
+		if(bind(listenFd, (struct sockaddr*)&inetAddress, sizeof(inetAddress)) < 0)
+			return -1;
+	}
+
+	if(listen(listenFd, STUB_BACKLOG) < 0)
+		return -1;
+
+	fcntl(listenFd, F_SETFL, O_NONBLOCK);
+
+	return listenFd;
+}
+
+
+
+/*
+ * @brief  Worker thread, accepts and answers connections of its own epoll loop
+ * @param  *argument : worker (StubWorker)
+ * @retval void*     : never returns, process exits after last connection
+ */
+static void *stubRun(void *argument)
+{
+	StubWorker         *worker     = (StubWorker*)argument;
+	StubConnection     *connection = NULL;
+	struct epoll_event  events[STUB_EVENTS];
+	struct epoll_event  event;
+	cpu_set_t           cpuSet;
+	ssize_t             received   = 0;
+	int                 option     = 1;
+	int                 ready      = 0;
+	int                 index      = 0;
+	int                 fd         = -1;
+
+	/* Restricted CPU sets (containers) leave worker unpinned */
+	CPU_ZERO(&cpuSet);
+	CPU_SET(worker->cpu, &cpuSet);
+
+	pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+
+	for(;;)
+	{
+		ready = epoll_wait(worker->epollFd, events, STUB_EVENTS, -1);
+
+		for(index = 0; index < ready; index++)
+		{
+			connection = events[index].data.ptr;
+
+			/* New connections, shared unix listener is drained by whichever worker wakes */
+			if(connection == NULL)
+			{
+				while((fd = accept(worker->listenFd, NULL, NULL)) >= 0)
+				{
+					fcntl(fd, F_SETFL, O_NONBLOCK);
+					setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &option, sizeof(option));
+
+					connection = calloc(1, sizeof(StubConnection));
+					if(connection == NULL)
+					{
+						close(fd);
+
+						continue;
+					}
+
+					connection->fd = fd;
+
+					event.events   = EPOLLIN;
+					event.data.ptr = connection;
+
+					epoll_ctl(worker->epollFd, EPOLL_CTL_ADD, fd, &event);
+
+					/* Open is counted first, other worker never sees all closed while total is reached */
+					__atomic_fetch_add(&stubOpen, 1, __ATOMIC_SEQ_CST);
+					__atomic_fetch_add(&stubTotal, 1, __ATOMIC_SEQ_CST);
+				}
+
+				continue;
+			}
+
+			received = read(connection->fd, connection->input + connection->length, sizeof(connection->input) - connection->length);
+
+			if(received > 0)
+			{
+				connection->length += (size_t)received;
+
+				stubHandle(connection);
+
+				continue;
+			}
+
+			if(received < 0 && errno == EAGAIN)
+				continue;
+
+			close(connection->fd);
+			free(connection);
+
+			if(__atomic_sub_fetch(&stubOpen, 1, __ATOMIC_SEQ_CST) == 0 && stubLimit > 0 &&
+			   __atomic_load_n(&stubTotal, __ATOMIC_SEQ_CST) >= stubLimit)
+				exit(0);
+		}
+	}
+
+	return NULL;
+}
+
+
+
+int main(int argc, char **argv)
+{
+	static StubWorker workers[STUB_THREADS];
+
+	struct epoll_event  event;
+	long                threads  = 1;
+	long                cpuCount = sysconf(_SC_NPROCESSORS_ONLN);
+	long                index    = 0;
+	int                 isUnix   = 0;
+
+	if(argc < 2)
+	{
+		printf("Usage : %s <port | unix:/path> [connections] [threads]\n", argv[0]);
+
+		return 1;
+	}
+
+	stubLimit = (argc > 2) ? atol(argv[2]) : 0;
+	threads   = (argc > 3) ? atol(argv[3]) : 1;
+	isUnix    = (strncmp(argv[1], "unix:", 5) == 0);
+
+	if(threads < 1)
+		threads = 1;
+
+	if(threads > STUB_THREADS)
+		threads = STUB_THREADS;
+
+	if(cpuCount < 1)
+		cpuCount = 1;
+
+	/* Every listener is open before first worker runs, connections spread over all of them */
+	for(index = 0; index < threads; index++)
+	{
+		workers[index].listenFd = (isUnix && index > 0) ? workers[0].listenFd : stubListen(argv[1], !isUnix);
+		workers[index].epollFd  = epoll_create1(0);
+		workers[index].cpu      = (int)(cpuCount - 1 - index % cpuCount);
+
+		event.events   = isUnix ? (EPOLLIN | EPOLLEXCLUSIVE) : EPOLLIN;
+		event.data.ptr = NULL;
+
+		if(workers[index].listenFd < 0 || workers[index].epollFd < 0 ||
+		   epoll_ctl(workers[index].epollFd, EPOLL_CTL_ADD, workers[index].listenFd, &event) < 0)
+		{
+			perror("broker stub");
+
+			return 1;
+		}
+	}
+
+	for(index = 0; index < threads; index++)
+	{
+		if(pthread_create(&workers[index].thread, NULL, stubRun, &workers[index]) != 0)
+		{
+			perror("broker stub");
+
+			return 1;
+		}
+	}
+
+	pthread_join(workers[0].thread, NULL);
+
+	return 0;
+}
@@ -53,6 +53,15 @@ enum error_codes
 	NO_TOPIC_NAME        = -16,
 	KEEP_ALIVE_ERROR     = -17,
 	BROKER_PORT_ERROR    = -18,
+	MESSAGE_LENGTH_ERROR = -19,
+	REPEAT_COUNT_ERROR   = -20,
+	URING_INIT_ERROR     = -21,
+	FLUSH_DEADLINE_ERROR = -22,
+	INGEST_PATH_ERROR    = -23,
+	DAEMON_ERROR         = -24,
+	INGEST_ERROR         = -25,
+	SOCKET_PROFILE_ERROR = -26,
+	SOCKET_OPTION_ERROR  = -27,
 
 };
 
@@ -37,14 +37,23 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <arpa/inet.h>
 #include <stdint.h>
 #include <time.h>
 #include <fcntl.h>
 #include <stdlib.h>
+#include <errno.h>
 
 #include "mqtt_client.h"
+#include "mqtt_event_loop.h"
+#include "mqtt_output.h"
+#include "mqtt_timer.h"
+#include "mqtt_ingest.h"
+#include "mqtt_socket.h"
 #include "iot_client.h"
+#include "iot_uring.h"
+#include "iot_daemon.h"
 
 
 
@@ -83,7 +92,7 @@
 
 
 /* Function Prototypes */
-int mqtt_broker_connect(int *fd, int port, char *server_address);
+int mqtt_broker_connect(int *fd, int port, char *server_address, mqtt_socket_options_t *options);
 
 int parse_command_line_args(IotClient *clientObj, int argc, char **argv, char *buffer);
 
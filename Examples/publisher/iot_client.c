@@ -56,13 +56,24 @@ ClientRetVal clientBegin(IotClient *client)
 		client->returnValue      = 0;
 		client->keepAliveTime    = 0;
 		client->debugRequest     = 0;
+		client->publishCount     = 0;
+		client->optimisticStart  = 0;
+		client->uringTransport   = 0;
+		client->flushDeadline    = -1;
+		client->daemonMode       = 0;
+		client->socketProfile    = NULL;
+
+		/* Socket options are kept at kernel default until set by flags or profile */
+		mqtt_socket_options_init(&client->socketOptions);
 
 		/* Allocate Memory */
-		client->serverAddress = malloc(sizeof(char) * MAX_ADDRESS_LENGTH);
+		client->serverAddress = malloc(sizeof(char) * (MAX_ADDRESS_LENGTH + 1));
 		client->topicName     = malloc(sizeof(char) * MAX_TOPIC_LENGTH);
+		client->ingestPath    = malloc(sizeof(char) * (MAX_ADDRESS_LENGTH + 1));
 
-		memset(client->serverAddress, 0, sizeof(MAX_ADDRESS_LENGTH));
+		memset(client->serverAddress, 0, sizeof(char) * (MAX_ADDRESS_LENGTH + 1));
 		memset(client->topicName, 0, sizeof(MAX_TOPIC_LENGTH));
+		memset(client->ingestPath, 0, sizeof(char) * (MAX_ADDRESS_LENGTH + 1));
 
 		errorCode = FUNC_CODE_SUCCESS;
 
@@ -90,10 +101,7 @@ ClientRetVal clientConnect(IotClient *client)
 	}
 	else
 	{
-		errorCode = client->connectServer(&client->socketDescriptor, client->serverPortNumber, client->serverAddress);
-
-		errorCode = FUNC_CODE_SUCCESS;
-
+		errorCode = client->connectServer(&client->socketDescriptor, client->serverPortNumber, client->serverAddress, &client->socketOptions);
 	}
 	return errorCode;
 }
@@ -126,6 +134,12 @@ ClientRetVal clientEnd(IotClient *client)
 		client->returnValue      = 0;
 		client->keepAliveTime    = 0;
 		client->debugRequest     = 0;
+		client->publishCount     = 0;
+		client->optimisticStart  = 0;
+		client->uringTransport   = 0;
+		client->flushDeadline    = -1;
+		client->daemonMode       = 0;
+		client->socketProfile    = NULL;
 
 		free(client->serverAddress);
 		client->serverAddress = NULL;
@@ -133,6 +147,9 @@ ClientRetVal clientEnd(IotClient *client)
 		free(client->topicName);
 		client->topicName = NULL;
 
+		free(client->ingestPath);
+		client->ingestPath = NULL;
+
 		client->returnValue = FUNC_CODE_SUCCESS;
 
 		client->close(client->socketDescriptor);
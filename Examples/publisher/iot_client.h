@@ -32,7 +32,9 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <sys/uio.h>
 #include "error_codes.h"
+#include "mqtt_socket.h"
 
 
 /******************************************************************************/
@@ -41,9 +43,7 @@
 /*                                                                            */
 /******************************************************************************/
 
-#pragma pack(1)
-
-#define MAX_ADDRESS_LENGTH  15
+#define MAX_ADDRESS_LENGTH  112   /* IPv4 address or "unix:" followed by socket path */
 #define MAX_TOPIC_LENGTH    30
 
 
@@ -72,14 +72,24 @@ typedef struct client
 	int  cleanSession;
 	int  keepAliveTime;
 	int  debugRequest;
+	int  publishCount;
+	int  optimisticStart;
+	int  uringTransport;
+	int  flushDeadline;
+	int  daemonMode;
+	char *ingestPath;
+	char *socketProfile;
+
+	mqtt_socket_options_t socketOptions;
 
 	ClientRetVal returnValue;
 
 	/* Methods */
 	int     (*getCommands)(struct client *clientObj, int  argc, char **agrv, char *buffer);
-	int     (*connectServer)(int *descriptor, int portNumber, char *serverAddr);
+	int     (*connectServer)(int *descriptor, int portNumber, char *serverAddr, mqtt_socket_options_t *options);
 
 	ssize_t (*write)(int descriptor, const void *buffer, size_t length);
+	ssize_t (*writev)(int descriptor, const struct iovec *vector, int count);
 	ssize_t (*read)(int descriptor, void *buffer, size_t length);
 	int     (*close)(int descriptor);
 
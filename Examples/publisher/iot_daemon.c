@@ -0,0 +1,294 @@
+/**
+ ******************************************************************************
+ * @file    iot_daemon.c
+ * @author  Aditya Mall,
+ * @brief   Example MQTT publish client, for mosquitto MQTT Broker
+ *
+ *  Info
+ *          Only for testing, (POSIX compatible only.)
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall </center></h2>
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+
+/* header files */
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include "mqtt_session.h"
+#include "mqtt_notify.h"
+#include "mqtt_ingest.h"
+#include "iot_daemon.h"
+
+
+/* Poll list entries */
+#define DAEMON_POLL_GROUP   0
+#define DAEMON_POLL_INGEST  1
+#define DAEMON_POLL_COUNT   2
+
+
+
+/* Daemon state, one broker session per process */
+typedef struct daemon_state
+{
+	IotClient *client;
+	char      *clientName;
+	uint64_t   publishCount;
+	uint64_t   completeCount;
+
+}DaemonState;
+
+
+static volatile sig_atomic_t daemonStop = 0;
+
+
+
+/*
+ * @brief  Signal handler, daemon disconnects once queued messages are sent
+ * @param  signalNumber : SIGINT or SIGTERM
+ * @retval None
+ */
+static void daemonSignal(int signalNumber)
+{
+	(void)signalNumber;
+
+	daemonStop = 1;
+}
+
+
+
+/*
+ * @brief  Session event callback of daemon session
+ * @param  *context  : daemon state
+ * @param  *session  : broker session
+ * @param  *event    : session event
+ * @retval None
+ */
+static void daemonEvent(void *context, mqtt_session_t *session, const mqtt_session_event_t *event)
+{
+	DaemonState *state = (DaemonState*)context;
+
+	(void)session;
+
+	switch(event->type)
+	{
+
+	case MQTT_SESSION_EVENT_CONNECTED:
+
+		if(state->client->debugRequest)
+			fprintf(stdout, "%s :Received CONNACK, ingest queue at %s\n", state->clientName, state->client->ingestPath);
+
+		break;
+
+
+	case MQTT_SESSION_EVENT_REFUSED:
+
+		fprintf(stderr, "%s :Received CONNACK, connection refused :%d\n", state->clientName, event->return_code);
+
+		break;
+
+
+	case MQTT_SESSION_EVENT_PUBLISHED:
+
+		state->completeCount++;
+
+		break;
+
+
+	case MQTT_SESSION_EVENT_COMPLETED:
+
+		state->completeCount += event->message_count;
+
+		break;
+
+
+	case MQTT_SESSION_EVENT_CLOSED:
+
+		if(state->client->debugRequest)
+			fprintf(stdout, "%s :Session closed :%s\n", state->clientName, event->error ? strerror(event->error) : "DISCONNECT sent");
+
+		break;
+
+
+	default:
+		break;
+
+	}
+}
+
+
+
+/*
+ * @brief  Keeps broker session open and publishes messages queued by other processes through
+ *         shared memory ingest queue, runs until broker closes session or SIGINT, SIGTERM
+ * @param  *client      : pointer to IOT client structure, (connected to broker)
+ * @param  *clientName  : client ID of session
+ * @param  *userName    : user name
+ * @param  *password    : password
+ * @retval ClientRetVal : FUNC_CODE_SUCCESS, DAEMON_ERROR
+ */
+ClientRetVal daemonRun(IotClient *client, char *clientName, char *userName, char *password)
+{
+	/* Session buffers, input holds only acknowledgments and PINGRESP */
+	static uint8_t  inputBuffer[1500];
+	static uint8_t  outputBuffer[OUTPUT_BUFFER_SIZE];
+	static uint16_t completedIds[INFLIGHT_TABLE_SIZE];
+
+	mqtt_timer_wheel_t   timerWheel;
+	mqtt_inflight_t      inflightTable;
+	mqtt_session_t       session;
+	mqtt_notify_t        notifyGroup;
+	mqtt_notify_member_t sessionMember;
+	mqtt_ingest_t        ingest;
+	struct pollfd        pollList[DAEMON_POLL_COUNT];
+	struct sigaction     stopAction;
+
+	DaemonState state   = {.client = client, .clientName = clientName};
+	int32_t     drained = 0;
+	int         timeout = -1;
+
+	memset(&stopAction, 0, sizeof(stopAction));
+
+	stopAction.sa_handler = daemonSignal;
+
+	sigaction(SIGINT, &stopAction, NULL);
+	sigaction(SIGTERM, &stopAction, NULL);
+
+	mqtt_timer_wheel_init(&timerWheel, mqtt_timer_now());
+	mqtt_inflight_init(&inflightTable);
+
+	if(mqtt_session_init(&session, client->socketDescriptor, client->read, client->write, inputBuffer, sizeof(inputBuffer),
+			             outputBuffer, sizeof(outputBuffer), &inflightTable, &timerWheel, daemonEvent, &state) < 0 ||
+	   mqtt_session_batch(&session, completedIds, INFLIGHT_TABLE_SIZE) < 0)
+	{
+		return DAEMON_ERROR;
+	}
+
+	/* Coalescing deadline of command line */
+	session.output.deadline_us = (uint32_t)client->flushDeadline;
+
+	if(mqtt_notify_init(&notifyGroup) < 0 || mqtt_notify_add(&notifyGroup, &sessionMember, &session) < 0)
+		return DAEMON_ERROR;
+
+	/* Producers wake daemon through eventfd of notification group */
+	if(mqtt_session_connect(&session, clientName, userName, password, (uint16_t)client->keepAliveTime, MQTT_CLEAN_SESSION, mqtt_timer_now()) < 0 ||
+	   mqtt_ingest_open(&ingest, client->ingestPath, INGEST_QUEUE_CELL_SIZE, INGEST_QUEUE_CELLS, &notifyGroup) < 0)
+	{
+		fprintf(stderr, "%s :Ingest queue error :%s\n", clientName, strerror(errno));
+
+		mqtt_notify_close(&notifyGroup);
+
+		return DAEMON_ERROR;
+	}
+
+	pollList[DAEMON_POLL_GROUP].fd      = mqtt_notify_fd(&notifyGroup);
+	pollList[DAEMON_POLL_GROUP].events  = POLLIN;
+	pollList[DAEMON_POLL_INGEST].fd     = mqtt_ingest_fd(&ingest);
+	pollList[DAEMON_POLL_INGEST].events = POLLIN;
+
+	while(session.state != MQTT_SESSION_CLOSED)
+	{
+		/* Stop request, DISCONNECT once queue is drained and in-flight messages are completed */
+		if(daemonStop && session.state == MQTT_SESSION_CONNECTED && mqtt_queue_count(&ingest.queue) == 0 && inflightTable.count == 0)
+			mqtt_session_disconnect(&session, mqtt_timer_now());
+
+		/* Session not yet connected or stopping is checked again without producer wake up */
+		timeout = daemonStop ? 100 : -1;
+
+		if(poll(pollList, DAEMON_POLL_COUNT, timeout) < 0)
+		{
+			if(errno == EINTR)
+				continue;
+
+			break;
+		}
+
+		if(pollList[DAEMON_POLL_INGEST].revents & POLLIN)
+			mqtt_ingest_accept(&ingest);
+
+		if(mqtt_notify_dispatch(&notifyGroup, mqtt_timer_now(), 0) < 0)
+			break;
+
+		/* Messages queued while session waits for CONNACK stay queued */
+		if((drained = mqtt_queue_drain(&ingest.queue, &session, mqtt_timer_now(), 0)) > 0)
+			state.publishCount += (uint64_t)drained;
+	}
+
+	if(client->debugRequest)
+	{
+		fprintf(stdout, "%s :Published %lu, completed %lu, rejected full %u, dropped %u, producers %u\n", clientName,
+				(unsigned long)state.publishCount, (unsigned long)state.completeCount, ingest.queue.ring->rejected,
+				ingest.queue.ring->dropped, ingest.attached);
+	}
+
+	mqtt_ingest_close(&ingest);
+	mqtt_notify_close(&notifyGroup);
+
+	return FUNC_CODE_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Queues publish of command line in ingest queue of running daemon, no broker connection
+ * @param  *client      : pointer to IOT client structure
+ * @param  *message     : publish message
+ * @retval ClientRetVal : FUNC_CODE_SUCCESS, INGEST_ERROR
+ */
+ClientRetVal daemonSubmit(IotClient *client, char *message)
+{
+	mqtt_ingest_t ingest;
+	int           count = 0;
+	int           retry = 0;
+
+	if(mqtt_ingest_connect(&ingest, client->ingestPath) < 0)
+	{
+		fprintf(stderr, "Ingest queue error :%s\n", strerror(errno));
+
+		return INGEST_ERROR;
+	}
+
+	for(count = 0; count < client->publishCount; count++)
+	{
+		/* Full queue, daemon is given time to send */
+		for(retry = 0; mqtt_enqueue_publish(&ingest.queue, client->topicName, message, strlen(message),
+				                            (mqtt_qos_t)client->qualityOfService, (uint8_t)client->messageRetain) < 0; retry++)
+		{
+			if(errno != EAGAIN || retry == INGEST_RETRY_COUNT)
+			{
+				fprintf(stderr, "Ingest queue error :%s, %d messages queued\n", strerror(errno), count);
+
+				mqtt_ingest_close(&ingest);
+
+				return INGEST_ERROR;
+			}
+
+			usleep(INGEST_RETRY_DELAY);
+		}
+	}
+
+	if(client->debugRequest)
+		fprintf(stdout, "Queued %d PUBLISH(\"%s\",...(%lu bytes)) in ingest queue\n", count, client->topicName, (unsigned long)strlen(message));
+
+	mqtt_ingest_close(&ingest);
+
+	return FUNC_CODE_SUCCESS;
+}
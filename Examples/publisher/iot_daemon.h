@@ -0,0 +1,61 @@
+/**
+ ******************************************************************************
+ * @file    iot_daemon.h
+ * @author  Aditya Mall,
+ * @brief   Example MQTT publish client, for mosquitto MQTT Broker
+ *
+ *  Info
+ *          Only for testing, (POSIX compatible only.)
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall </center></h2>
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+#ifndef IOT_DAEMON_H_
+#define IOT_DAEMON_H_
+
+#include "iot_client.h"
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                            Macro Defines                                   */
+/*                                                                            */
+/******************************************************************************/
+
+#define INGEST_RETRY_COUNT  10000    /* Tries of full ingest queue before publish is given up */
+#define INGEST_RETRY_DELAY  100      /* Microseconds between tries of full ingest queue       */
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*                           Function Prototypes                              */
+/*                                                                            */
+/******************************************************************************/
+
+
+ClientRetVal daemonRun(IotClient *client, char *clientName, char *userName, char *password);
+
+ClientRetVal daemonSubmit(IotClient *client, char *message);
+
+
+
+
+#endif /* IOT_DAEMON_H_ */
@@ -0,0 +1,404 @@
+/**
+ ******************************************************************************
+ * @file    iot_uring.c
+ * @author  Aditya Mall,
+ * @brief   Example MQTT publish client, for mosquitto MQTT Broker
+ *
+ *  Info
+ *          Only for testing, (POSIX compatible only.)
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 Aditya Mall </center></h2>
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+/* header files */
+#include <errno.h>
+#include <unistd.h>
+#include "mqtt_uring.h"
+#include "iot_uring.h"
+
+
+/* Completion user data */
+#define URING_RECV_DATA  0
+#define URING_SEND_DATA  1
+
+
+
+/* io_uring transport state, one connection per process in this example */
+typedef struct uring_transport
+{
+	mqtt_uring_t ring;
+	int          fileIndex;
+	int          waitTimeout;
+	int          lastError;
+	int          peerClosed;
+	int          recvArmed;
+
+	/* Double buffered send, one half is filled while the other is in flight */
+	uint8_t      sendBuffer[2][URING_SEND_BUFFER_SIZE];
+	size_t       sendLength[2];
+	size_t       sendOffset[2];
+	int          sendBusy[2];
+	int          sendActive;
+
+	/* Receive completions not yet consumed by read */
+	mqtt_uring_completion_t recvQueue[URING_BUFFER_COUNT];
+	uint16_t     recvHead;
+	uint16_t     recvTail;
+	size_t       recvOffset;
+
+}UringTransport;
+
+
+static UringTransport uringTransport;
+
+
+
+/*
+ * @brief  Handles all completions in completion queue
+ * @param  None
+ * @retval None
+ */
+static void uringReap(void)
+{
+	mqtt_uring_completion_t completion;
+	int half = 0;
+
+	while(mqtt_uring_complete(&uringTransport.ring, &completion) == 1)
+	{
+		if(completion.user_data == URING_RECV_DATA)
+		{
+			if(completion.more == 0)
+				uringTransport.recvArmed = 0;
+
+			if(completion.result > 0)
+			{
+				uringTransport.recvQueue[uringTransport.recvTail++ & (URING_BUFFER_COUNT - 1)] = completion;
+			}
+			else if(completion.result == 0)
+			{
+				uringTransport.peerClosed = 1;
+			}
+			else if(completion.result != -ENOBUFS)
+			{
+				/* Out of buffers only stops multishot receive, armed again once buffers are released */
+				uringTransport.lastError = -completion.result;
+			}
+		}
+		else
+		{
+			half = (int)(completion.user_data - URING_SEND_DATA);
+
+			if(completion.result < 0)
+			{
+				uringTransport.lastError = -completion.result;
+				uringTransport.sendBusy[half] = 0;
+			}
+			else if(uringTransport.sendOffset[half] + completion.result < uringTransport.sendLength[half])
+			{
+				/* Short send, queue rest of buffer */
+				uringTransport.sendOffset[half] += completion.result;
+
+				mqtt_uring_send(&uringTransport.ring, uringTransport.fileIndex,
+						        uringTransport.sendBuffer[half] + uringTransport.sendOffset[half],
+						        uringTransport.sendLength[half] - uringTransport.sendOffset[half], completion.user_data);
+			}
+			else
+			{
+				uringTransport.sendBusy[half] = 0;
+			}
+		}
+	}
+
+	/* Multishot receive stopped, arm again while receive buffers are free */
+	if(!uringTransport.recvArmed && !uringTransport.peerClosed && !uringTransport.lastError &&
+	   (uint16_t)(uringTransport.recvTail - uringTransport.recvHead) < URING_BUFFER_COUNT)
+	{
+		if(mqtt_uring_recv(&uringTransport.ring, uringTransport.fileIndex, URING_RECV_DATA) == 1)
+			uringTransport.recvArmed = 1;
+	}
+}
+
+
+
+/*
+ * @brief  Queues send of filled half of send buffer and switches to other half
+ * @param  None
+ * @retval int : 0 = Success, -1 = Error
+ */
+static int uringFlush(void)
+{
+	int active = uringTransport.sendActive;
+
+	if(uringTransport.sendLength[active] == 0)
+		return 0;
+
+	uringTransport.sendOffset[active] = 0;
+	uringTransport.sendBusy[active]   = 1;
+
+	mqtt_uring_send(&uringTransport.ring, uringTransport.fileIndex, uringTransport.sendBuffer[active],
+			        uringTransport.sendLength[active], URING_SEND_DATA + active);
+
+	active ^= 1;
+
+	/* Other half still in flight, wait for it */
+	while(uringTransport.sendBusy[active] && !uringTransport.lastError)
+	{
+		if(mqtt_uring_submit(&uringTransport.ring, 1, -1) < 0 && errno != EINTR)
+			uringTransport.lastError = errno;
+
+		uringReap();
+	}
+
+	uringTransport.sendLength[active] = 0;
+	uringTransport.sendActive         = active;
+
+	return uringTransport.lastError ? -1 : 0;
+}
+
+
+
+/*
+ * @brief  Copies data into send buffer, sent on next read or close
+ * @param  *buffer : data
+ * @param  length  : length of data
+ * @retval int     : 0 = Success, -1 = Error
+ */
+static int uringQueue(const uint8_t *buffer, size_t length)
+{
+	size_t space = 0;
+	int    active;
+
+	while(length > 0)
+	{
+		active = uringTransport.sendActive;
+		space  = URING_SEND_BUFFER_SIZE - uringTransport.sendLength[active];
+
+		if(space == 0)
+		{
+			if(uringFlush() < 0)
+				return -1;
+
+			continue;
+		}
+
+		if(space > length)
+			space = length;
+
+		memcpy(uringTransport.sendBuffer[active] + uringTransport.sendLength[active], buffer, space);
+
+		uringTransport.sendLength[active] += space;
+
+		buffer += space;
+		length -= space;
+	}
+
+	return 0;
+}
+
+
+
+/*
+ * @brief  Switches client to io_uring transport, socket must be connected
+ * @param  IotClient : pointer to IOT client structure
+ * @retval int8_t    : 0 = Success, URING_INIT_ERROR = Error
+ */
+ClientRetVal uringTransportBegin(IotClient *client)
+{
+	if(client == NULL)
+		return URING_INIT_ERROR;
+
+	memset(&uringTransport, 0, sizeof(uringTransport));
+
+	if(mqtt_uring_init(&uringTransport.ring) < 0)
+		return URING_INIT_ERROR;
+
+	uringTransport.fileIndex = mqtt_uring_register_fd(&uringTransport.ring, client->socketDescriptor);
+
+	if(uringTransport.fileIndex < 0)
+	{
+		mqtt_uring_close(&uringTransport.ring);
+
+		return URING_INIT_ERROR;
+	}
+
+	/* Read gives up after keep alive time without input, same as epoll path */
+	uringTransport.waitTimeout = client->keepAliveTime * 1000;
+
+	/* Multishot receive stays armed for connection lifetime, submitted with first write */
+	mqtt_uring_recv(&uringTransport.ring, uringTransport.fileIndex, URING_RECV_DATA);
+
+	uringTransport.recvArmed = 1;
+
+	client->write  = uringWrite;
+	client->writev = uringWritev;
+	client->read   = uringRead;
+	client->close  = uringClose;
+
+	return FUNC_CODE_SUCCESS;
+}
+
+
+
+/*
+ * @brief  Queues write, data is copied and sent with next read, (one system call for all writes)
+ * @param  descriptor : socket descriptor, (registered at begin)
+ * @param  *buffer    : data
+ * @param  length     : length of data
+ * @retval ssize_t    : length, -1 = Error
+ */
+ssize_t uringWrite(int descriptor, const void *buffer, size_t length)
+{
+	(void)descriptor;
+
+	if(uringTransport.lastError || uringQueue((const uint8_t*)buffer, length) < 0)
+	{
+		errno = uringTransport.lastError;
+
+		return -1;
+	}
+
+	return (ssize_t)length;
+}
+
+
+
+/*
+ * @brief  Queues scatter-gather write, (PUBLISH burst)
+ * @param  descriptor : socket descriptor, (registered at begin)
+ * @param  *vector    : IO vector array
+ * @param  count      : number of IO vectors
+ * @retval ssize_t    : total length, -1 = Error
+ */
+ssize_t uringWritev(int descriptor, const struct iovec *vector, int count)
+{
+	ssize_t total = 0;
+	int     index = 0;
+
+	for(index = 0; index < count; index++)
+	{
+		if(uringWrite(descriptor, vector[index].iov_base, vector[index].iov_len) < 0)
+			return -1;
+
+		total += (ssize_t)vector[index].iov_len;
+	}
+
+	return total;
+}
+
+
+
+/*
+ * @brief  Sends queued writes and reads received data, waits in io_uring_enter for input
+ * @param  descriptor : socket descriptor, (registered at begin)
+ * @param  *buffer    : read buffer
+ * @param  length     : read buffer length
+ * @retval ssize_t    : bytes read, 0 = closed by server, -1 = Error (ETIMEDOUT after keep alive time)
+ */
+ssize_t uringRead(int descriptor, void *buffer, size_t length)
+{
+	mqtt_uring_completion_t *completion = NULL;
+	size_t copy_length = 0;
+
+	(void)descriptor;
+
+	if(uringFlush() < 0)
+	{
+		errno = uringTransport.lastError;
+
+		return -1;
+	}
+
+	/* Send queued writes and wait for input in one system call */
+	while(uringTransport.recvHead == uringTransport.recvTail)
+	{
+		if(uringTransport.peerClosed)
+			return 0;
+
+		if(uringTransport.lastError)
+		{
+			errno = uringTransport.lastError;
+
+			return -1;
+		}
+
+		if(mqtt_uring_submit(&uringTransport.ring, 1, uringTransport.waitTimeout) < 0)
+		{
+			if(errno == ETIME)
+			{
+				errno = ETIMEDOUT;
+
+				return -1;
+			}
+
+			if(errno != EINTR)
+				uringTransport.lastError = errno;
+		}
+
+		uringReap();
+	}
+
+	completion = &uringTransport.recvQueue[uringTransport.recvHead & (URING_BUFFER_COUNT - 1)];
+
+	copy_length = (size_t)completion->result - uringTransport.recvOffset;
+
+	if(copy_length > length)
+		copy_length = length;
+
+	memcpy(buffer, completion->buffer + uringTransport.recvOffset, copy_length);
+
+	uringTransport.recvOffset += copy_length;
+
+	/* Buffer consumed, give it back to kernel */
+	if(uringTransport.recvOffset == (size_t)completion->result)
+	{
+		mqtt_uring_buffer_release(&uringTransport.ring, completion->buffer_id);
+
+		uringTransport.recvHead++;
+		uringTransport.recvOffset = 0;
+	}
+
+	return (ssize_t)copy_length;
+}
+
+
+
+/*
+ * @brief  Sends queued writes, (DISCONNECT), releases io_uring and closes socket
+ * @param  descriptor : socket descriptor
+ * @retval int        : 0 = Success, -1 = Error
+ */
+int uringClose(int descriptor)
+{
+	if(uringFlush() == 0)
+	{
+		while((uringTransport.sendBusy[0] || uringTransport.sendBusy[1]) && !uringTransport.lastError)
+		{
+			if(mqtt_uring_submit(&uringTransport.ring, 1, -1) < 0 && errno != EINTR)
+				break;
+
+			uringReap();
+		}
+	}
+
+	mqtt_uring_unregister_fd(&uringTransport.ring, uringTransport.fileIndex);
+	mqtt_uring_close(&uringTransport.ring);
+
+	return close(descriptor);
+}
@@ -33,16 +33,76 @@
 
 
 
+/*
+ * @brief  Waits until socket takes all queued output, (DISCONNECT and full PUBREL buffer)
+ * @param  *output     : output buffer
+ * @param  *loop       : event loop of socket
+ * @param  *source     : socket event source
+ * @param  timeout_ms  : longest wait for socket, (keep alive time)
+ * @retval int         : 0 = Success, -1 = Error or time out
+ */
+static int outputDrain(mqtt_output_t *output, mqtt_event_loop_t *loop, mqtt_event_source_t *source, int timeout_ms)
+{
+	int retval = 0;
+
+	if(mqtt_output_flush(output) < 0 && errno != EAGAIN)
+		return -1;
+
+	while(mqtt_output_events(output) == MQTT_EVENT_WRITE)
+	{
+		mqtt_event_loop_modify(loop, source, MQTT_EVENT_READ | MQTT_EVENT_WRITE);
+
+		if(mqtt_event_loop_run(loop, timeout_ms) <= 0)
+		{
+			retval = -1;
+
+			break;
+		}
+
+		if(mqtt_output_flush(output) < 0 && errno != EAGAIN)
+		{
+			retval = -1;
+
+			break;
+		}
+	}
+
+	mqtt_event_loop_modify(loop, source, MQTT_EVENT_READ);
+
+	return retval;
+}
+
+
+
 /* Main function */
 int main(int argc, char **argv)
 {
 
 	/* Socket API related variable initializations */
-	char   message[2000]     = {0};
-	char   read_buffer[1500] = {0};
+	char   message[sizeof(mqtt_publish_t)] = {0};
+	uint8_t read_buffer[1500] = {0};
+	uint8_t *read_pointer     = NULL;
+	size_t  read_length       = 0;
+	ssize_t read_count        = 0;
+
+	/* Event loop, read state sleeps on socket instead of polling it */
+	mqtt_event_loop_t   event_loop;
+	mqtt_event_source_t socket_source;
+
+	/* MQTT input stream decoder */
+	mqtt_decoder_t decoder;
+	mqtt_packet_t  packet;
 
 	/* MQTT client structure initializations */
-	mqtt_client_t publisher;
+	mqtt_client_t   publisher;
+	mqtt_inflight_t inflight_table;
+	uint16_t        message_id      = 0;
+	uint32_t        publish_barrier = 0;
+
+	/* PUBREL messages of qos 2 exchanges, written together once read input is consumed */
+	uint8_t      pubrel_buffer[MQTT_INFLIGHT_SLOTS * MQTT_PUBREL_LENGTH];
+	size_t       pubrel_length = 0;
+	mqtt_iovec_t pubrel_vector = {.iov_base = pubrel_buffer};
 
 	/* Client State machine related variable initializations */
 	size_t  message_length      = 0;
@@ -57,7 +117,26 @@ int main(int argc, char **argv)
 	char user_name[]       = "device1.sensor";
 	char pass_word[]       = "4321";
 
-	char publish_message[100];
+	char publish_message[PUBLISH_PAYLOAD_LENGTH + 1];
+
+	/* PUBLISH header scratch buffer, message is queued from publish_message */
+	uint8_t      publish_header[MQTT_PUBLISH_HEADER_LENGTH];
+	mqtt_iovec_t publish_vector[MQTT_PUBLISH_IOV_COUNT];
+	uint16_t     publish_burst        = 0;
+
+	/* Output buffer, packets are coalesced into segment sized writes */
+	uint8_t       output_buffer[OUTPUT_BUFFER_SIZE];
+	mqtt_output_t output;
+	uint8_t       publish_blocked = 0;
+
+	/* Optimistic startup, CONNECT is sent with first burst and CONNACK checked later */
+	size_t   connect_length    = 0;
+	uint8_t  connack_pending   = 0;
+	int      unconfirmed_count = 0;
+
+	/* Messages not delivered because broker refused connection, (exit status is failure) */
+	int      undelivered_count = 0;
+	uint8_t  connect_refused   = 0;
 
 	/* Initialize client object */
 	IotClient Publisher =
@@ -65,6 +144,7 @@ int main(int argc, char **argv)
 			.connectServer = mqtt_broker_connect,
 			.getCommands   = parse_command_line_args,
 			.write         = write,
+			.writev        = writev,
 			.read          = read,
 			.close         = close,
 	};
@@ -83,6 +163,20 @@ int main(int argc, char **argv)
 	}
 
 
+	/* Queue message in shared memory of running daemon, no broker connection */
+	if(strlen(Publisher.ingestPath) > 0 && Publisher.daemonMode == 0)
+	{
+		Publisher.returnValue = daemonSubmit(&Publisher, publish_message);
+		if(Publisher.returnValue < 0)
+		{
+			fprintf(stderr, "ERROR!!: Ingest Queue Error: %d\n", Publisher.returnValue);
+			exit(EXIT_FAILURE);
+		}
+
+		exit(EXIT_SUCCESS);
+	}
+
+
 	/* Connect to MQTT broker */
 	Publisher.returnValue = clientConnect(&Publisher);
 	if(Publisher.returnValue < 0)
@@ -92,6 +186,67 @@ int main(int argc, char **argv)
 	}
 
 
+	/* Refused socket options are reported, connection continues with kernel defaults for them */
+	if(Publisher.socketOptions.failed)
+	{
+		fprintf(stderr, "WARNING!!: Socket options refused by kernel: 0x%02x, (mqtt_socket_option_t bits)\n", Publisher.socketOptions.failed);
+	}
+
+	/* Quick ACK is cleared by kernel, set again after each read */
+	if(Publisher.socketOptions.quick_ack == 1 && !(Publisher.socketOptions.failed & MQTT_SOCKET_QUICK_ACK))
+	{
+		Publisher.read = mqtt_socket_read_quickack;
+	}
+
+
+	/* Keep session open and publish messages of ingest queue, (read/write transport) */
+	if(Publisher.daemonMode)
+	{
+		Publisher.returnValue = daemonRun(&Publisher, my_client_name, user_name, pass_word);
+
+		clientEnd(&Publisher);
+
+		if(Publisher.returnValue < 0)
+		{
+			fprintf(stderr, "ERROR!!: Daemon Error: %d\n", Publisher.returnValue);
+			exit(EXIT_FAILURE);
+		}
+
+		exit(EXIT_SUCCESS);
+	}
+
+
+	/* Replace read and write methods with io_uring transport */
+	if(Publisher.uringTransport)
+	{
+		Publisher.returnValue = uringTransportBegin(&Publisher);
+		if(Publisher.returnValue < 0)
+		{
+			fprintf(stderr, "ERROR!!: io_uring Transport Error: %d\n", Publisher.returnValue);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+
+	/* Initialize mqtt client, in-flight table and input stream decoder */
+	mqtt_inflight_init(&inflight_table);
+	mqtt_client_init(&publisher, &inflight_table);
+	mqtt_decoder_init(&decoder, read_buffer, sizeof(read_buffer));
+
+
+	/* Packets are written through output buffer, (after transport is selected) */
+	mqtt_output_init(&output, output_buffer, sizeof(output_buffer), Publisher.socketDescriptor, Publisher.write, (uint32_t)Publisher.flushDeadline);
+
+
+	/* Register socket for read events */
+	if(mqtt_event_loop_init(&event_loop) < 0 ||
+	   mqtt_event_loop_add(&event_loop, &socket_source, Publisher.socketDescriptor, MQTT_EVENT_READ, NULL, NULL) < 0)
+	{
+		fprintf(stderr, "ERROR!!: Event Loop Error\n");
+		exit(EXIT_FAILURE);
+	}
+
+
 	/* State machine initializations */
 	loop_state = FSM_RUN;
 
@@ -122,12 +277,77 @@ int main(int argc, char **argv)
 			if(Publisher.debugRequest > 1)
 				fprintf(stdout,"FSM Read State\n");
 
-			memset(read_buffer, 0, sizeof(read_buffer));
+			/* Read socket only when no complete packet is left in the decoder */
+			while( (retval = mqtt_decoder_next(&decoder, &packet)) == 0 )
+			{
+				/* Send pending PUBREL messages before waiting for more input, (stalled output takes them later) */
+				if(pubrel_length > 0 && mqtt_output_events(&output) == 0)
+					break;
+
+				/* Queued packets are sent before waiting for their response, stalled output is resumed on write event */
+				if(mqtt_output_events(&output) == 0 && mqtt_output_pending(&output) > 0 &&
+				   mqtt_output_flush(&output) < 0 && errno != EAGAIN)
+					break;
+
+				/* Output drained below low water, publish more */
+				if(publish_blocked && mqtt_output_writable(&output) == 1)
+					break;
+
+				read_pointer = mqtt_decoder_buffer(&decoder, &read_length);
+
+				read_count = Publisher.read(Publisher.socketDescriptor, read_pointer, read_length);
 
-			/* Check for keep alive time for subscriber */
-			while( ( Publisher.read(Publisher.socketDescriptor, read_buffer, 1500) ) < 0 );
+				/* No input yet, sleep until socket is readable or broker is silent for keep alive time */
+				if(read_count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+				{
+					/* Wait for write event too while socket send buffer is full */
+					mqtt_event_loop_modify(&event_loop, &socket_source, MQTT_EVENT_READ | mqtt_output_events(&output));
+
+					if(mqtt_event_loop_run(&event_loop, Publisher.keepAliveTime * 1000) > 0)
+					{
+						if((socket_source.revents & MQTT_EVENT_WRITE) && mqtt_output_flush(&output) < 0 && errno != EAGAIN)
+							break;
+
+						continue;
+					}
+
+					if(Publisher.debugRequest)
+						fprintf(stderr, "%s :No response from broker\n", my_client_name);
+
+					break;
+				}
+
+				/* Socket closed by server or read error */
+				if(read_count <= 0)
+					break;
+
+				mqtt_decoder_commit(&decoder, read_count);
+			}
+
+			if(retval == 0 && publish_blocked && mqtt_output_writable(&output) == 1)
+			{
+				publish_blocked = 0;
+
+				mqtt_message_state = mqtt_publish_state;
+
+				break;
+			}
+
+			if(retval == 0 && pubrel_length > 0)
+			{
+				mqtt_message_state = mqtt_pubrel_state;
+
+				break;
+			}
+
+			if(retval != 1)
+			{
+				mqtt_message_state = mqtt_disconnect_state;
+
+				break;
+			}
 
-			publisher.message = (void*)read_buffer;
+			publisher.message = (void*)packet.packet;
 
 			/* get MQTT message type and update state */
 			mqtt_message_state = get_mqtt_message_type(&publisher);
@@ -176,8 +396,18 @@ int main(int argc, char **argv)
 
 			message_length = mqtt_connect(&publisher, my_client_name, (int16_t)Publisher.keepAliveTime);
 
-			retval = Publisher.write(Publisher.socketDescriptor, (char*)publisher.connect_msg, message_length);
-			if(retval < 0)
+			/* Optimistic startup, CONNECT waits for the first publish burst */
+			if(Publisher.optimisticStart)
+			{
+				connect_length  = message_length;
+				connack_pending = 1;
+
+				mqtt_message_state = mqtt_publish_state;
+
+				break;
+			}
+
+			if(mqtt_output_queue(&output, publisher.connect_msg, message_length, mqtt_timer_now_us()) < 0)
 			{
 				printf("write error, Socket closed by server\n");
 
@@ -204,24 +434,46 @@ int main(int argc, char **argv)
 				fprintf(stdout,"%s :Received CONNACK\n", my_client_name);
 
 			/* Check return code of CONNACK message */
-			publisher.connack_msg = (void *)read_buffer;
+			publisher.connack_msg = (void *)packet.packet;
 
-			mqtt_message_state = get_connack_status(&publisher);
+			/* Publish if connection accepted, else disconnect */
+			if(get_connack_status(&publisher) == MQTT_CONNECTION_ACCEPTED)
+			{
+				mqtt_message_state = mqtt_publish_state;
 
-			break;
+				/* Optimistic startup, messages are already sent */
+				if(connack_pending)
+				{
+					connack_pending   = 0;
+					unconfirmed_count = 0;
+
+					if(Publisher.publishCount == 0)
+						mqtt_message_state = mqtt_inflight_barrier_done(&inflight_table, publish_barrier) == 1 ? mqtt_disconnect_state : mqtt_read_state;
+				}
+			}
+			else
+			{
+				/* Broker drops messages sent before CONNACK, they fail with the ones not sent yet */
+				undelivered_count = Publisher.publishCount;
 
+				if(connack_pending)
+					undelivered_count += unconfirmed_count + mqtt_inflight_rollback(&inflight_table, NULL, NULL);
 
-		case mqtt_publish_state:
+				Publisher.publishCount = 0;
+				connect_refused        = 1;
 
+				fprintf(stderr, "ERROR!!: CONNECT refused, %d messages not delivered\n", undelivered_count);
+
+				mqtt_message_state = mqtt_disconnect_state;
+			}
+
+			break;
 
-			/* Fill mqtt PUBLISH message structure */
-			memset(message, '\0', sizeof(message));
 
-			publisher.publish_msg = (void *)message;
+		case mqtt_publish_state:
 
-			/*Configure publish options */
-			message_status = mqtt_publish_options(&publisher, Publisher.messageRetain, Publisher.qualityOfService);
-			if(message_status == -1)
+			/* Check publish options */
+			if(Publisher.qualityOfService >= MQTT_QOS_RESERVED)
 			{
 				fprintf(stdout, "publish options param error\n");
 
@@ -230,31 +482,115 @@ int main(int argc, char **argv)
 				break;
 			}
 
-			/* Configure publish message */
-			message_length = mqtt_publish(&publisher, Publisher.topicName, publish_message);
-			if(message_length == 0)
+			message_status = Publisher.qualityOfService;
+
+			publish_burst = 0;
+
+			/* CONNECT of optimistic startup goes out in the same write as the first burst */
+			if(connect_length > 0)
 			{
-				fprintf(stdout,"publish message param error\n");
+				if(mqtt_output_queue(&output, message, connect_length, mqtt_timer_now_us()) < 0)
+				{
+					printf("write error, Socket closed by server\n");
 
-				mqtt_message_state = mqtt_disconnect_state;
+					mqtt_message_state = mqtt_exit_state;
 
-				break;
+					break;
+				}
+
+				if(Publisher.debugRequest > 0)
+					fprintf(stdout, "%s :Sending CONNECT\n", my_client_name);
+
+				connect_length = 0;
 			}
 
-			Publisher.write(Publisher.socketDescriptor, (char*)publisher.publish_msg, message_length);
+			/* Send publish messages while send window is open, (qos 0 is not acknowledged) */
+			while(Publisher.publishCount > 0 && publish_burst < MQTT_INFLIGHT_SLOTS && mqtt_output_writable(&output) == 1)
+			{
+				/* Allocate message ID for qos > 0, stop when send window is full */
+				if(message_status > MQTT_QOS_FIRE_FORGET)
+				{
+					message_id = mqtt_inflight_acquire(&inflight_table, MQTT_INFLIGHT_PUBLISH_SENT, (mqtt_qos_t)message_status, 0, NULL, 0);
+					if(message_id == 0)
+						break;
+				}
 
-			/* print debug message */
-			if(Publisher.debugRequest > 0)
-				fprintf(stdout, "%s :Sending PUBLISH(\"%s\",...(%ld bytes))\n", my_client_name, Publisher.topicName, strlen(publish_message));
+				/* Encode PUBLISH header, message is sent from its own buffer */
+				message_length = mqtt_publish_iov(publish_header, sizeof(publish_header), Publisher.topicName, publish_message, strlen(publish_message),
+						                          (uint8_t)Publisher.messageRetain, (mqtt_qos_t)Publisher.qualityOfService, message_id,
+						                          publish_vector);
+				if(message_length == 0)
+				{
+					fprintf(stdout,"publish message param error\n");
+
+					mqtt_message_state = mqtt_disconnect_state;
+
+					break;
+				}
+
+				/* Burst is coalesced in output buffer, written when a segment is full */
+				if(mqtt_output_queue_vector(&output, publish_vector, MQTT_PUBLISH_IOV_COUNT, 1, mqtt_timer_now_us()) < 0)
+				{
+					/* Socket send buffer full, message is published again once output drains */
+					if(errno == EAGAIN)
+					{
+						if(message_status > MQTT_QOS_FIRE_FORGET)
+							mqtt_inflight_release(&inflight_table, message_id);
+
+						break;
+					}
+
+					printf("write error, Socket closed by server\n");
+
+					mqtt_message_state = mqtt_exit_state;
+
+					break;
+				}
+
+				publish_burst++;
+
+				Publisher.publishCount--;
+
+				if(connack_pending && message_status == MQTT_QOS_FIRE_FORGET)
+					unconfirmed_count++;
+
+				/* print debug message */
+				if(Publisher.debugRequest > 0)
+					fprintf(stdout, "%s :Sending PUBLISH(\"%s\",...(%ld bytes))\n", my_client_name, Publisher.topicName, strlen(publish_message));
+			}
+
+			if(mqtt_message_state == mqtt_disconnect_state || mqtt_message_state == mqtt_exit_state)
+				break;
+
+			/* Tail of burst waits at most flush deadline */
+			mqtt_output_poll(&output, mqtt_timer_now_us());
+
+			/* Output would block, wait for socket to drain it before publishing more */
+			if(Publisher.publishCount > 0 && mqtt_output_writable(&output) == 0)
+			{
+				publish_blocked = 1;
+
+				mqtt_message_state = mqtt_read_state;
 
-			/* Update State according to quality of service */
+				break;
+			}
+
+			/* Update State according to quality of service, wait for all messages to be acknowledged */
 			if(message_status == MQTT_QOS_ATLEAST_ONCE || message_status == MQTT_QOS_EXACTLY_ONCE)
 			{
+				if(Publisher.publishCount == 0)
+					publish_barrier = mqtt_inflight_barrier(&inflight_table);
+
 				mqtt_message_state = mqtt_read_state;
 			}
+			else if(Publisher.publishCount > 0)
+			{
+				mqtt_message_state = mqtt_publish_state;
+			}
 			else
 			{
-				mqtt_message_state =  mqtt_disconnect_state;
+				/* Optimistic startup, wait for CONNACK before disconnect */
+				mqtt_message_state = connack_pending ? mqtt_read_state : mqtt_disconnect_state;
 			}
 
 			break;
@@ -266,7 +602,18 @@ int main(int argc, char **argv)
 			if(Publisher.debugRequest > 0)
 				printf("%s :Received PUBACK\n",my_client_name);
 
-			mqtt_message_state =  mqtt_disconnect_state;
+			/* Acknowledgments can arrive in any order */
+			mqtt_inflight_ack(&inflight_table, &packet);
+
+			/* Send more messages if window is open, disconnect when all messages are acknowledged */
+			if(Publisher.publishCount > 0)
+				mqtt_message_state = mqtt_publish_state;
+
+			else if(mqtt_inflight_barrier_done(&inflight_table, publish_barrier) == 1)
+				mqtt_message_state = mqtt_disconnect_state;
+
+			else
+				mqtt_message_state = mqtt_read_state;
 
 			break;
 
@@ -277,7 +624,32 @@ int main(int argc, char **argv)
 			if(Publisher.debugRequest > 0)
 				printf("%s :Received PUBREC\n",my_client_name);
 
-			mqtt_message_state = mqtt_pubrel_state;
+			/* PUBREL is queued for every PUBREC, exchanges of all message IDs run at once */
+			retval = mqtt_inflight_process(&inflight_table, &packet, 0, pubrel_buffer, sizeof(pubrel_buffer), &pubrel_length);
+			if(retval < 0)
+			{
+				/* PUBREL buffer full, (repeated PUBRECs), send it and queue again */
+				pubrel_vector.iov_len = pubrel_length;
+
+				if(mqtt_output_queue_vector(&output, &pubrel_vector, 1, pubrel_length / MQTT_PUBREL_LENGTH, mqtt_timer_now_us()) < 0)
+				{
+					if(errno != EAGAIN || outputDrain(&output, &event_loop, &socket_source, Publisher.keepAliveTime * 1000) < 0 ||
+					   mqtt_output_queue_vector(&output, &pubrel_vector, 1, pubrel_length / MQTT_PUBREL_LENGTH, mqtt_timer_now_us()) < 0)
+					{
+						printf("write error, Socket closed by server\n");
+
+						mqtt_message_state = mqtt_exit_state;
+
+						break;
+					}
+				}
+
+				pubrel_length = 0;
+
+				mqtt_inflight_process(&inflight_table, &packet, 0, pubrel_buffer, sizeof(pubrel_buffer), &pubrel_length);
+			}
+
+			mqtt_message_state = mqtt_read_state;
 
 			break;
 
@@ -285,18 +657,30 @@ int main(int argc, char **argv)
 
 		case mqtt_pubrel_state:
 
-			/* Fill MQTT PUBREL message structure */
-			memset(message, '\0', sizeof(message));
+			/* Queue all PUBREL messages at once, written with next flush */
+			pubrel_vector.iov_len = pubrel_length;
 
-			publisher.pubrel_msg = (void *)message;
+			if(mqtt_output_queue_vector(&output, &pubrel_vector, 1, pubrel_length / MQTT_PUBREL_LENGTH, mqtt_timer_now_us()) < 0)
+			{
+				/* Output would block, PUBREL messages stay queued until socket takes more data */
+				if(errno == EAGAIN)
+				{
+					mqtt_message_state = mqtt_read_state;
 
-			message_length = mqtt_publish_release(&publisher);
+					break;
+				}
 
-			/* Send PUBREL message (Socket API) */
-			Publisher.write(Publisher.socketDescriptor, (char*)publisher.pubrel_msg, message_length);
+				printf("write error, Socket closed by server\n");
+
+				mqtt_message_state = mqtt_exit_state;
+
+				break;
+			}
 
 			if(Publisher.debugRequest > 0)
-				fprintf(stdout,"%s :Sending PUBREL\n",my_client_name);
+				fprintf(stdout,"%s :Sending PUBREL x %ld\n",my_client_name, pubrel_length / MQTT_PUBREL_LENGTH);
+
+			pubrel_length = 0;
 
 			mqtt_message_state = mqtt_read_state;
 
@@ -308,7 +692,17 @@ int main(int argc, char **argv)
 			if(Publisher.debugRequest > 0)
 				fprintf(stdout,"%s :Received PUBCOMP\n",my_client_name);
 
-			mqtt_message_state =  mqtt_disconnect_state;
+			mqtt_inflight_process(&inflight_table, &packet, 0, pubrel_buffer, sizeof(pubrel_buffer), &pubrel_length);
+
+			/* Send more messages if window is open, disconnect when all messages are acknowledged */
+			if(Publisher.publishCount > 0)
+				mqtt_message_state = mqtt_publish_state;
+
+			else if(mqtt_inflight_barrier_done(&inflight_table, publish_barrier) == 1)
+				mqtt_message_state = mqtt_disconnect_state;
+
+			else
+				mqtt_message_state = mqtt_read_state;
 
 			break;
 
@@ -322,8 +716,10 @@ int main(int argc, char **argv)
 
 			message_length = mqtt_disconnect(&publisher);
 
-			/* Send Disconnect Message */
-			Publisher.write(Publisher.socketDescriptor, (char*)publisher.disconnect_msg, message_length);
+			/* Send Disconnect Message, wait for socket if output is full */
+			if(mqtt_output_queue(&output, publisher.disconnect_msg, message_length, mqtt_timer_now_us()) < 0 && errno == EAGAIN &&
+			   outputDrain(&output, &event_loop, &socket_source, Publisher.keepAliveTime * 1000) == 0)
+				mqtt_output_queue(&output, publisher.disconnect_msg, message_length, mqtt_timer_now_us());
 
 			/* brief print debug message */
 			if(Publisher.debugRequest == 1)
@@ -343,7 +739,23 @@ int main(int argc, char **argv)
 			/* Suspend while loop */
 			loop_state = FSM_SUSPEND;
 
-			/* Deinit Client */
+			/* Write remaining packets */
+			outputDrain(&output, &event_loop, &socket_source, Publisher.keepAliveTime * 1000);
+
+			if(Publisher.debugRequest > 0)
+			{
+				fprintf(stdout, "%s :Output %lu packets in %lu writes, (%lu bytes)\n", my_client_name,
+						(unsigned long)output.packet_count, (unsigned long)output.write_count, (unsigned long)output.byte_count);
+
+				fprintf(stdout, "%s :Output stalled %lu times, producer blocked %lu times, peak %lu bytes queued\n", my_client_name,
+						(unsigned long)output.stall_count, (unsigned long)output.blocked_count, (unsigned long)output.peak_pending);
+			}
+
+			/* Release event loop, close connection and deinit Client */
+			mqtt_event_loop_close(&event_loop);
+
+			Publisher.close(Publisher.socketDescriptor);
+
 			clientEnd(&Publisher);
 
 			break;
@@ -358,6 +770,9 @@ int main(int argc, char **argv)
 	if(Publisher.debugRequest)
 		fprintf(stdout,"Exited FSM \n");
 
+	if(connect_refused)
+		exit(EXIT_FAILURE);
+
 	return 0;
 }
 
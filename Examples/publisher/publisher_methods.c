@@ -50,6 +50,22 @@
 #define PORT_FLAG_OPTNL          "-p"
 #define DEBUG_FLAG               "-d"
 #define DEBUG_ALL_FLAG           "-dl"
+#define REPEAT_FLAG              "--repeat"
+#define OPTIMISTIC_FLAG          "--optimistic"
+#define URING_FLAG               "--uring"
+#define FLUSH_DEADLINE_FLAG      "--flush-deadline"
+#define DAEMON_FLAG              "--daemon"
+#define INGEST_FLAG              "--ingest"
+#define PROFILE_FLAG             "--profile"
+#define NODELAY_FLAG             "--nodelay"
+#define QUICKACK_FLAG            "--quickack"
+#define CORK_FLAG                "--cork"
+#define SEND_BUFFER_FLAG         "--sndbuf"
+#define RECEIVE_BUFFER_FLAG      "--rcvbuf"
+#define BUSY_POLL_FLAG           "--busy-poll"
+#define USER_TIMEOUT_FLAG        "--user-timeout"
+
+#define UNIX_ADDRESS_PREFIX      "unix:"
 
 
 
@@ -91,6 +107,34 @@ static void errorHanlde(int errorNum)
 		fprintf(stderr,"\nError!!: Wrong Keep Alive Time value given through command line \n");
 		break;
 
+	case MESSAGE_LENGTH_ERROR:
+		fprintf(stderr,"\nError!!: Publish Message longer than %d bytes \n", PUBLISH_PAYLOAD_LENGTH);
+		break;
+
+	case REPEAT_COUNT_ERROR:
+		fprintf(stderr,"\nError!!: Wrong Repeat Count value given through command line \n");
+		break;
+
+	case ADDRESS_LENGTH_ERROR:
+		fprintf(stderr,"\nError!!: Host Address empty or longer than %d characters \n", MAX_ADDRESS_LENGTH);
+		break;
+
+	case INGEST_PATH_ERROR:
+		fprintf(stderr,"\nError!!: Ingest socket path empty or longer than %d characters \n", MQTT_INGEST_PATH_LENGTH - 1);
+		break;
+
+	case FLUSH_DEADLINE_ERROR:
+		fprintf(stderr,"\nError!!: Wrong Flush Deadline value given through command line \n");
+		break;
+
+	case SOCKET_PROFILE_ERROR:
+		fprintf(stderr,"\nError!!: Unknown Socket Profile, (default, low-latency, throughput) \n");
+		break;
+
+	case SOCKET_OPTION_ERROR:
+		fprintf(stderr,"\nError!!: Wrong Socket Option value given through command line \n");
+		break;
+
 	case COMMAND_WRONG_ARGS:
 		fprintf(stderr,"\nError!!: Wrong Arguments received through command line \n");
 		break;
@@ -105,15 +149,53 @@ static void errorHanlde(int errorNum)
 
 
 
-int mqtt_broker_connect(int *fd, int port, char *server_address)
+int mqtt_broker_connect(int *fd, int port, char *server_address, mqtt_socket_options_t *options)
 {
 
 	int func_retval = 0;
 
 	struct sockaddr_in server;
+	struct sockaddr_un local_server;
+
+	size_t prefix_length = strlen(UNIX_ADDRESS_PREFIX);
+
+	/* Broker on same host, "unix:/path" connects to unix domain socket, (port is not used) */
+	if(strncmp(server_address, UNIX_ADDRESS_PREFIX, prefix_length) == 0)
+	{
+		if(strlen(server_address + prefix_length) == 0 || strlen(server_address + prefix_length) >= sizeof(local_server.sun_path))
+		{
+			func_retval = ADDRESS_LENGTH_ERROR;
+		}
+		else if( (*fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 )
+		{
+			func_retval = CLIENT_SOCKET_ERROR;
+		}
+		else
+		{
+			/* Refused options are marked in options, connection is made with kernel defaults */
+			mqtt_socket_apply(*fd, options);
+
+			memset(&local_server, 0, sizeof(local_server));
+
+			local_server.sun_family = AF_UNIX;
+
+			strcpy(local_server.sun_path, server_address + prefix_length);
+
+			if( ( connect(*fd, (struct sockaddr*)&local_server, sizeof(local_server)) ) < 0)
+			{
+				func_retval = CLIENT_CONNECT_ERROR;
+			}
+			else
+			{
+				fcntl(*fd, F_SETFL, O_NONBLOCK);
+
+				func_retval = FUNC_CODE_SUCCESS;
+			}
+		}
+	}
 
 	/* Get client socket type */
-	if( (*fd = socket(AF_INET, SOCK_STREAM, 0)) < 0 )
+	else if( (*fd = socket(AF_INET, SOCK_STREAM, 0)) < 0 )
 	{
 		func_retval = CLIENT_SOCKET_ERROR;
 	}
@@ -124,6 +206,9 @@ int mqtt_broker_connect(int *fd, int port, char *server_address)
 
 		server.sin_addr.s_addr = inet_addr(server_address);
 
+		/* Options are set before SYN, receive buffer decides window scale */
+		mqtt_socket_apply(*fd, options);
+
 		/* Connect to MQTT server host machine */
 		if( ( connect(*fd, (struct sockaddr*)&server, sizeof(server)) ) < 0)
 		{
@@ -170,7 +255,8 @@ static int help_info(char **argv)
 
 	printf("\n");
 
-	printf("Usage : \"%s\" [-d Debug] [-dl Debug All] [-h hostaddr] [-k keepalive] [-p port] [-q qos] [-r retain] [-t topic] [-m message] \n", fileName);
+	printf("Usage : \"%s\" [-d Debug] [-dl Debug All] [-h hostaddr] [-k keepalive] [-p port] [-q qos] [-r retain] [-t topic] [-m message] [--repeat count] [--optimistic] [--uring] [--flush-deadline usec] [--daemon path | --ingest path] \n", fileName);
+	printf("        [--profile name] [--nodelay] [--quickack] [--cork] [--sndbuf bytes] [--rcvbuf bytes] [--busy-poll usec] [--user-timeout msec] \n");
 	printf("\n");
 	printf("        \"%s\" [--help] \n", fileName);
 
@@ -179,13 +265,28 @@ static int help_info(char **argv)
 
 	printf("  -d         : Print debug messages on STDOUT                                                \n");
 	printf("  -dl        : Print all debug messages on STDOUT                                            \n");
-	printf("  -h,--host  : Host Address, address of the broker/server                                    \n");
+	printf("  -h,--host  : Host Address, address of the broker/server, (unix:/path = unix domain socket)   \n");
 	printf("  -k         : Keep Alive Time, keep alive time for the client to be connected to the server \n");
 	printf("  -p,--port  : Port Number, port number on which broker/server is listening                  \n");
 	printf("  -q,--qos   : Quality Of Service, quality of service level if client (0, 1, 2)              \n");
 	printf("  -r         : Retain Message, for retaining the published messaged at the broker/server     \n");
 	printf("  -t,--topic : Message Topic, topic of the messaged published by the client                  \n");
 	printf("  -m         : Published Message, message to be published by the client                      \n");
+	printf("  --repeat   : Repeat Count, number of times message is published, (qos 1, 2 are pipelined)  \n");
+	printf("  --optimistic : Optimistic Start, publish with CONNECT before CONNACK, reported undelivered if refused \n");
+	printf("  --uring    : io_uring Transport, batched sends and multishot receive instead of read/write  \n");
+	printf("  --flush-deadline : Flush Deadline, microseconds packets wait to be coalesced, (0 = no delay)  \n");
+	printf("  --daemon   : Daemon Mode, keeps session open and publishes messages queued on unix socket path \n");
+	printf("  --ingest   : Ingest Queue, queues message in shared memory of daemon at path, (no connection) \n");
+	printf("  --profile  : Socket Profile, low-latency (nodelay, quickack, busy poll, no flush deadline) or  \n");
+	printf("               throughput (large socket buffers, cork, %d us flush deadline), flags override it  \n", SOCKET_BULK_DEADLINE);
+	printf("  --nodelay  : No Delay, TCP_NODELAY, small segments are sent without waiting for ACK          \n");
+	printf("  --quickack : Quick ACK, TCP_QUICKACK, received data is acknowledged at once                 \n");
+	printf("  --cork     : Cork, TCP_CORK, only full segments are sent until output is flushed            \n");
+	printf("  --sndbuf   : Send Buffer, SO_SNDBUF socket send buffer size in bytes                         \n");
+	printf("  --rcvbuf   : Receive Buffer, SO_RCVBUF socket receive buffer size in bytes                   \n");
+	printf("  --busy-poll : Busy Poll, SO_BUSY_POLL microseconds reads spin on device, (CAP_NET_ADMIN)    \n");
+	printf("  --user-timeout : User Timeout, TCP_USER_TIMEOUT milliseconds unacknowledged data may wait  \n");
 
 	printf("\n");
 	printf("\n");
@@ -195,6 +296,9 @@ static int help_info(char **argv)
 	printf("-k             : 60 Seconds                               \n");
 	printf("-q             : qos = 0 (Fire and Forget)                \n");
 	printf("-p             : Port 1883 (Default for Mosquitto Broker) \n");
+	printf("--repeat       : 1                                        \n");
+	printf("--flush-deadline : 200 Microseconds, (or of socket profile) \n");
+	printf("--profile      : default, (kernel socket options)         \n");
 
 	printf("\n");
 
@@ -213,7 +317,11 @@ static int args_check(int index, char **argv)
 			strcmp(argv[i+1], HOST_MACHINE_FLAG_OPTNL) && strcmp(argv[i+1], TOPIC_FLAG_OPTNL) && strcmp(argv[i+1], QOS_FLAG_OPTNL) && \
 			strcmp(argv[i+1], RETAIN_FLAG_OPTNL) && strcmp(argv[i+1], VERSION_FLAG) && strcmp(argv[i+1], HELP_FLAG) && strcmp(argv[i+1], KEEP_ALIVE_FLAG) && \
 			strcmp(argv[i+1], PORT_FLAG_OPTNL) && strcmp(argv[i+1], PORT_FLAG) && strcmp(argv[i+1], DEBUG_FLAG) && strcmp(argv[i+1], DEBUG_ALL_FLAG) && \
-			strcmp(argv[i+1], MESSAGE_FLAG) && strcmp(argv[i+1], KEEP_ALIVE_FLAG));
+			strcmp(argv[i+1], MESSAGE_FLAG) && strcmp(argv[i+1], KEEP_ALIVE_FLAG) && strcmp(argv[i+1], REPEAT_FLAG) && strcmp(argv[i+1], OPTIMISTIC_FLAG) && \
+			strcmp(argv[i+1], URING_FLAG) && strcmp(argv[i+1], FLUSH_DEADLINE_FLAG) && strcmp(argv[i+1], DAEMON_FLAG) && \
+			strcmp(argv[i+1], INGEST_FLAG) && strcmp(argv[i+1], PROFILE_FLAG) && strcmp(argv[i+1], NODELAY_FLAG) && \
+			strcmp(argv[i+1], QUICKACK_FLAG) && strcmp(argv[i+1], CORK_FLAG) && strcmp(argv[i+1], SEND_BUFFER_FLAG) && \
+			strcmp(argv[i+1], RECEIVE_BUFFER_FLAG) && strcmp(argv[i+1], BUSY_POLL_FLAG) && strcmp(argv[i+1], USER_TIMEOUT_FLAG));
 }
 
 
@@ -258,7 +366,7 @@ int parse_command_line_args(IotClient *clientObj, int argc, char **argv, char *b
 				else
 				{
 					/* Check size */
-					if(strlen(argv[index + 1]) <= MAX_ADDRESS_LENGTH || strlen(argv[index + 1]) > 0)
+					if(strlen(argv[index + 1]) <= MAX_ADDRESS_LENGTH && strlen(argv[index + 1]) > 0)
 					{
 						strcpy(clientObj->serverAddress, argv[index + 1]);
 					}
@@ -371,7 +479,13 @@ int parse_command_line_args(IotClient *clientObj, int argc, char **argv, char *b
 				{
 
 					/* Check size */
-					if(strlen(argv[index + 1]) > 0)
+					if(strlen(argv[index + 1]) > PUBLISH_PAYLOAD_LENGTH)
+					{
+						func_retval = MESSAGE_LENGTH_ERROR;
+
+						break;
+					}
+					else if(strlen(argv[index + 1]) > 0)
 					{
 						strcpy(buffer, argv[index+1]);
 					}
@@ -498,6 +612,174 @@ int parse_command_line_args(IotClient *clientObj, int argc, char **argv, char *b
 				}
 			}
 
+			else if( (strcmp(argv[index], OPTIMISTIC_FLAG) == 0) )
+			{
+				argumentMatch = 1;
+
+				clientObj->optimisticStart = 1;
+			}
+			else if( (strcmp(argv[index], URING_FLAG) == 0) )
+			{
+				argumentMatch = 1;
+
+				clientObj->uringTransport = 1;
+			}
+			else if( (strcmp(argv[index], REPEAT_FLAG) == 0) )
+			{
+
+				argumentMatch = 1;
+
+				if(argv[index + 1] == NULL)
+				{
+
+					func_retval = REPEAT_COUNT_ERROR;
+
+					break;
+				}
+				else if( args_check(index, argv) )
+				{
+
+					func_retval = REPEAT_COUNT_ERROR;
+
+					break;
+				}
+				else
+				{
+					clientObj->publishCount = atoi(argv[index + 1]);
+
+					if(clientObj->publishCount <= 0)
+					{
+						func_retval = REPEAT_COUNT_ERROR;
+
+						break;
+					}
+				}
+			}
+			else if( (strcmp(argv[index], FLUSH_DEADLINE_FLAG) == 0) )
+			{
+
+				argumentMatch = 1;
+
+				if(argv[index + 1] == NULL)
+				{
+
+					func_retval = FLUSH_DEADLINE_ERROR;
+
+					break;
+				}
+				else if( args_check(index, argv) )
+				{
+
+					func_retval = FLUSH_DEADLINE_ERROR;
+
+					break;
+				}
+				else
+				{
+					clientObj->flushDeadline = atoi(argv[index + 1]);
+
+					if(clientObj->flushDeadline < 0)
+					{
+						func_retval = FLUSH_DEADLINE_ERROR;
+
+						break;
+					}
+				}
+			}
+
+			else if( (strcmp(argv[index], DAEMON_FLAG) == 0) || (strcmp(argv[index], INGEST_FLAG) == 0) )
+			{
+
+				argumentMatch = 1;
+
+				if(argv[index + 1] == NULL || args_check(index, argv))
+				{
+
+					func_retval = INGEST_PATH_ERROR;
+
+					break;
+				}
+				else if(strlen(argv[index + 1]) > 0 && strlen(argv[index + 1]) < MQTT_INGEST_PATH_LENGTH)
+				{
+					strcpy(clientObj->ingestPath, argv[index + 1]);
+
+					clientObj->daemonMode = (strcmp(argv[index], DAEMON_FLAG) == 0);
+				}
+				else
+				{
+					func_retval = INGEST_PATH_ERROR;
+
+					break;
+				}
+			}
+
+			else if( (strcmp(argv[index], PROFILE_FLAG) == 0) )
+			{
+
+				argumentMatch = 1;
+
+				if(argv[index + 1] == NULL || args_check(index, argv))
+				{
+
+					func_retval = SOCKET_PROFILE_ERROR;
+
+					break;
+				}
+				else
+				{
+					/* Profile fills options not given by flags, after all flags are read */
+					clientObj->socketProfile = argv[index + 1];
+				}
+			}
+			else if( (strcmp(argv[index], NODELAY_FLAG) == 0) )
+			{
+				argumentMatch = 1;
+
+				clientObj->socketOptions.no_delay = 1;
+			}
+			else if( (strcmp(argv[index], QUICKACK_FLAG) == 0) )
+			{
+				argumentMatch = 1;
+
+				clientObj->socketOptions.quick_ack = 1;
+			}
+			else if( (strcmp(argv[index], CORK_FLAG) == 0) )
+			{
+				argumentMatch = 1;
+
+				clientObj->socketOptions.cork = 1;
+			}
+			else if( (strcmp(argv[index], SEND_BUFFER_FLAG) == 0) || (strcmp(argv[index], RECEIVE_BUFFER_FLAG) == 0) || \
+					 (strcmp(argv[index], BUSY_POLL_FLAG) == 0) || (strcmp(argv[index], USER_TIMEOUT_FLAG) == 0) )
+			{
+
+				argumentMatch = 1;
+
+				if(argv[index + 1] == NULL || args_check(index, argv) || atoi(argv[index + 1]) < 0)
+				{
+
+					func_retval = SOCKET_OPTION_ERROR;
+
+					break;
+				}
+				else if(strcmp(argv[index], SEND_BUFFER_FLAG) == 0)
+				{
+					clientObj->socketOptions.send_buffer = atoi(argv[index + 1]);
+				}
+				else if(strcmp(argv[index], RECEIVE_BUFFER_FLAG) == 0)
+				{
+					clientObj->socketOptions.receive_buffer = atoi(argv[index + 1]);
+				}
+				else if(strcmp(argv[index], BUSY_POLL_FLAG) == 0)
+				{
+					clientObj->socketOptions.busy_poll = atoi(argv[index + 1]);
+				}
+				else
+				{
+					clientObj->socketOptions.user_timeout = atoi(argv[index + 1]);
+				}
+			}
+
 		}/* Loop */
 
 	}/* Else Condition */
@@ -519,6 +801,26 @@ int parse_command_line_args(IotClient *clientObj, int argc, char **argv, char *b
 		clientObj->keepAliveTime = MQTT_DEFAULT_KEEPALIVE;
 	}
 
+	if(clientObj->publishCount == 0)
+	{
+		clientObj->publishCount = 1;
+	}
+
+	if(clientObj->socketProfile != NULL && func_retval == FUNC_CODE_SUCCESS)
+	{
+		if(mqtt_socket_profile(&clientObj->socketOptions, clientObj->socketProfile) < 0)
+			func_retval = SOCKET_PROFILE_ERROR;
+	}
+
+	/* --flush-deadline takes precedence over deadline of socket profile */
+	if(clientObj->flushDeadline < 0)
+	{
+		if(clientObj->socketOptions.flush_deadline >= 0)
+			clientObj->flushDeadline = clientObj->socketOptions.flush_deadline;
+		else
+			clientObj->flushDeadline = OUTPUT_FLUSH_DEADLINE;
+	}
+
 
 	/* Handle Error */
 